@@ -10,6 +10,7 @@ extern int main(void);
 
 // These are all defined by the linker via the lpc81x.ld linker script.
 extern unsigned int _text;
+extern unsigned int _esurvivors;
 extern unsigned int _etext;
 extern unsigned int _data;
 extern unsigned int _edata;
@@ -22,8 +23,8 @@ static inline void crt0(void)
     unsigned int *destination;
     unsigned int *end;
 
-    // Place stack canaries into RAM
-    destination = (unsigned int *)(0x10000000);
+    // Place stack canaries into RAM, sparing the data that survives reset
+    destination = (unsigned int *)(&_esurvivors);
     end = (unsigned int *)(0x10001000);
     while (destination < end) {
         *(destination++) = 0xcafebabe;
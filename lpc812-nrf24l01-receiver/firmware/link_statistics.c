@@ -0,0 +1,281 @@
+/******************************************************************************
+
+    Link statistics
+
+    Counts how well the link to the transmitter works, so that a receiver
+    can be taken to a venue and asked afterwards which hop channels suffer
+    there, for example from WiFi. The counters are updated from the main
+    loop and cost a few instructions each.
+
+    Sending any character to the UART receive input (CH3 in this build)
+    returns a report like this, one character per main loop iteration so
+    that the receiver keeps hopping meanwhile:
+
+        Hops 24000, empty 1210
+        Stick packets 45571, failsafe packets 470
+        Restarts 1, resyncs 3
+        Failsafe entries 0, longest outage 45 ms
+        Hop 0 channel 20: 2398
+        ...
+        Hop 19 channel 39: 1877
+
+    Sending 'c' clears the counters after the report.
+
+    Hops counts the hop timer events and empty the hops without a packet.
+    The packets are counted per hop index, which the report lists with its
+    RF channel. Restarts counts restart_packet_receiving(), which includes
+    the one at power-on and the one after binding; resyncs counts the
+    searches around the estimated hop index after missing packets. The
+    longest outage is the longest time between two stick data packets.
+
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <platform.h>
+#include <uart0.h>
+#include <link_statistics.h>
+
+#ifdef ENABLE_LINK_STATISTICS
+
+#ifdef ENABLE_PREPROCESSOR_OUTPUT
+    #error The link statistics and the pre-processor output both use the UART
+#endif
+
+#ifdef ENABLE_PACKET_RECORDER
+    #error The link statistics and the packet recorder both use the UART
+#endif
+
+
+#define CLEAR_COMMAND 'c'
+
+// Fits the longest report line
+#define LINE_SIZE 64
+
+#define REPORT_LINES (4 + NUMBER_OF_HOP_CHANNELS)
+#define REPORT_IDLE REPORT_LINES
+
+
+static const uint8_t *hop_data;
+
+static uint32_t hops;
+static uint32_t empty_hops;
+static uint32_t stick_packets;
+static uint32_t failsafe_packets;
+static uint32_t restarts;
+static uint32_t resyncs;
+static uint32_t failsafe_entries;
+static uint32_t longest_outage_us;
+static uint32_t packets[NUMBER_OF_HOP_CHANNELS];
+
+static bool packet_in_hop;
+static bool stick_data_received;
+static uint32_t last_stick_data_us;
+
+static char line[LINE_SIZE];
+static unsigned int line_length;
+static unsigned int line_index;
+static unsigned int report_line = REPORT_IDLE;
+static bool clear_requested;
+
+
+// ****************************************************************************
+static void clear_statistics(void)
+{
+    int i;
+
+    hops = 0;
+    empty_hops = 0;
+    stick_packets = 0;
+    failsafe_packets = 0;
+    restarts = 0;
+    resyncs = 0;
+    failsafe_entries = 0;
+    longest_outage_us = 0;
+    for (i = 0; i < NUMBER_OF_HOP_CHANNELS; i++) {
+        packets[i] = 0;
+    }
+}
+
+
+// ****************************************************************************
+// The hop channels are only read for the report
+// ****************************************************************************
+void statistics_hop_channels(const uint8_t *hop_channels)
+{
+    hop_data = hop_channels;
+}
+
+
+// ****************************************************************************
+void statistics_hop(void)
+{
+    ++hops;
+    if (!packet_in_hop) {
+        ++empty_hops;
+    }
+    packet_in_hop = false;
+}
+
+
+// ****************************************************************************
+// Stick data or failsafe packet received on the given hop index
+// ****************************************************************************
+void statistics_packet(uint8_t hop_index, bool stick_data)
+{
+    packet_in_hop = true;
+    ++packets[hop_index];
+
+    if (stick_data) {
+        uint32_t now_us = get_timestamp_us();
+
+        ++stick_packets;
+        if (stick_data_received  &&
+                now_us - last_stick_data_us > longest_outage_us) {
+            longest_outage_us = now_us - last_stick_data_us;
+        }
+        stick_data_received = true;
+        last_stick_data_us = now_us;
+    }
+    else {
+        ++failsafe_packets;
+    }
+}
+
+
+// ****************************************************************************
+void statistics_restart(void)
+{
+    ++restarts;
+}
+
+
+// ****************************************************************************
+void statistics_resync(void)
+{
+    ++resyncs;
+}
+
+
+// ****************************************************************************
+void statistics_failsafe(void)
+{
+    ++failsafe_entries;
+}
+
+
+// ****************************************************************************
+static void put_cstring(const char *cstring)
+{
+    while (*cstring  &&  line_length < LINE_SIZE) {
+        line[line_length++] = *cstring++;
+    }
+}
+
+
+// ****************************************************************************
+static void put_uint32(uint32_t value)
+{
+    char digits[10];
+    int count = 0;
+
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    while (count  &&  line_length < LINE_SIZE) {
+        line[line_length++] = digits[--count];
+    }
+}
+
+
+// ****************************************************************************
+static void format_report_line(unsigned int index)
+{
+    line_length = 0;
+    line_index = 0;
+
+    switch (index) {
+        case 0:
+            put_cstring("Hops ");
+            put_uint32(hops);
+            put_cstring(", empty ");
+            put_uint32(empty_hops);
+            break;
+
+        case 1:
+            put_cstring("Stick packets ");
+            put_uint32(stick_packets);
+            put_cstring(", failsafe packets ");
+            put_uint32(failsafe_packets);
+            break;
+
+        case 2:
+            put_cstring("Restarts ");
+            put_uint32(restarts);
+            put_cstring(", resyncs ");
+            put_uint32(resyncs);
+            break;
+
+        case 3:
+            put_cstring("Failsafe entries ");
+            put_uint32(failsafe_entries);
+            put_cstring(", longest outage ");
+            put_uint32(longest_outage_us / 1000);
+            put_cstring(" ms");
+            break;
+
+        default:
+            index -= 4;
+            put_cstring("Hop ");
+            put_uint32(index);
+            put_cstring(" channel ");
+            put_uint32(hop_data ? hop_data[index] : 0);
+            put_cstring(": ");
+            put_uint32(packets[index]);
+            break;
+    }
+
+    put_cstring("\n");
+}
+
+
+// ****************************************************************************
+// Called from the main loop: handles the requests received on the UART and
+// sends one character of the report whenever the UART is ready.
+// ****************************************************************************
+void output_link_statistics(void)
+{
+    if (uart0_read_is_byte_pending()) {
+        if (uart0_read_byte() == CLEAR_COMMAND) {
+            clear_requested = true;
+        }
+        if (report_line == REPORT_IDLE) {
+            report_line = 0;
+            line_length = 0;
+            line_index = 0;
+        }
+    }
+
+    if (line_index < line_length) {
+        if (uart0_send_is_ready()) {
+            uart0_send_char(line[line_index++]);
+        }
+        return;
+    }
+
+    if (report_line == REPORT_IDLE) {
+        return;
+    }
+
+    format_report_line(report_line++);
+
+    // Clear once the last line has its values
+    if (report_line == REPORT_IDLE  &&  clear_requested) {
+        clear_statistics();
+        clear_requested = false;
+    }
+}
+
+#endif // ENABLE_LINK_STATISTICS
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ENABLE_LINK_STATISTICS
+
+void statistics_hop_channels(const uint8_t *hop_channels);
+void statistics_hop(void);
+void statistics_packet(uint8_t hop_index, bool stick_data);
+void statistics_restart(void);
+void statistics_resync(void);
+void statistics_failsafe(void);
+void output_link_statistics(void);
+
+#else /* ENABLE_LINK_STATISTICS */
+
+#define statistics_hop_channels(hop_channels)
+#define statistics_hop()
+#define statistics_packet(hop_index, stick_data)
+#define statistics_restart()
+#define statistics_resync()
+#define statistics_failsafe()
+#define output_link_statistics()
+
+#endif /* ENABLE_LINK_STATISTICS */
@@ -13,6 +13,8 @@
 #include <spi.h>
 #include <rc_receiver.h>
 #include <preprocessor_output.h>
+#include <packet_recorder.h>
+#include <link_statistics.h>
 
 #include <LPC8xx_ROM_API.h>
 
@@ -26,6 +28,7 @@ void SysTick_handler(void);
 void PININT0_irq_handler(void);
 void SCT_irq_handler(void);
 void MRT_irq_handler(void);
+void WDT_irq_handler(void);
 
 
 
@@ -34,6 +37,8 @@ bool systick;
 
 static volatile uint32_t systick_count;
 
+static volatile uint32_t systick_total;
+
 
 
 // ****************************************************************************
@@ -179,6 +184,12 @@ static void init_hardware(void)
                           (GPIO_BIT_NRF_MISO << 8) |    // SPI0_MISO
                           (GPIO_BIT_NRF_MOSI << 0);     // SPI0_MOSI
 
+    // NRF_IRQ also drives PININT0, see below
+    LPC_SWM->PINASSIGN5 = (GPIO_BIT_NRF_IRQ << 24) |    // CTIN_0
+                          (0xff << 16) |
+                          (0xff << 8) |
+                          (0xff << 0);
+
     LPC_SWM->PINASSIGN6 = (GPIO_BIT_CH1 << 24) |        // CTOUT_0
                           (0xff << 16) |
                           (0xff << 8) |
@@ -201,6 +212,14 @@ static void init_hardware(void)
     GPIO_NRF_CE = 0;
     GPIO_LED = 0;
 
+#ifdef ENABLE_LINK_STATISTICS
+    // CH3 becomes the UART input on which the link statistics are requested
+    LPC_SWM->PINASSIGN7 |= (0xff << 8);
+    LPC_SWM->PINASSIGN0 = (LPC_SWM->PINASSIGN0 & ~(0xff << 8)) |
+                          (GPIO_BIT_CH3 << 8);          // UART0_RX
+    LPC_GPIO_PORT->DIR0 &= ~(1 << GPIO_BIT_CH3);
+#endif
+
 
     // ------------------------
     // Configure SCTimer globally for two 16-bit counters
@@ -217,6 +236,8 @@ static void init_hardware(void)
     // Timer L is used for frequency hopping. It is configured as a simple
     // auto-reload that fires an interrupt in regular intervals, using event[4].
     // The rc_receiver.c takes care of setting the counter and limit values.
+    // Event 5 captures timer L into CAP[1].L on the falling edge of NRF_IRQ
+    // (CTIN_0), timing each packet within the hop period in hardware.
     LPC_SCT->CONFIG = (1 << 18) |                   // Auto-limit on counter H
                       (1 << 17);                    // Auto-limit on counter L
 
@@ -257,6 +278,14 @@ static void init_hardware(void)
                              (0x1 << 12);           // Match condition only
     LPC_SCT->EVEN |= (1 << 4);                      // Event 4 generates an interrupt
 
+    LPC_SCT->REGMODE_L |= (1 << 1);                 // Register 1 of counter L captures
+    LPC_SCT->EVENT[5].STATE = 0xFFFF;               // Event happens in all states
+    LPC_SCT->EVENT[5].CTRL = (0 << 4) |             // Select counter L
+                             (0 << 6) |             // Input CTIN_0
+                             (0x2 << 10) |          // Falling edge
+                             (0x2 << 12);           // IO condition only
+    LPC_SCT->CAPCTRL[1].L = (1 << 5);               // Event 5 loads CAP[1].L
+
 
     // ------------------------
     // Configure the exernal interrupt from the NRF chip
@@ -275,6 +304,9 @@ static void init_hardware(void)
     // The application can use more than 100ms when erasing a single page
     // of flash, so we give us more than that.
     LPC_WWDT->TC = 2000;
+    // Warn just before the reset, so that the receiver can note the hop
+    // timing for resuming the link after it
+    LPC_WWDT->WARNINT = WATCHDOG_WARNING_TICKS;
     feed_the_watchdog();
 
     // ------------------------
@@ -294,8 +326,19 @@ static void init_hardware_final(void)
     // Turn off peripheral clock for IOCON and SWM to preserve power
     LPC_SYSCON->SYSAHBCLKCTRL &= ~((1 << 18) | (1 << 7));
 
+    // The nRF24 and watchdog interrupts take a timestamp with
+    // get_timestamp_us(), which needs the SysTick interrupt to preempt them
+    // when the counter wraps
+    NVIC_SetPriority(PININT0_IRQn, 1);
+    NVIC_SetPriority(WDT_IRQn, 1);
     NVIC_EnableIRQ(PININT0_IRQn);
     NVIC_EnableIRQ(SCT_IRQn);
+    NVIC_EnableIRQ(WDT_IRQn);
+
+#ifdef ENABLE_LINK_STATISTICS
+    LPC_USART0->INTENSET = (1 << 0);    // Enable RXRDY interrupt
+    NVIC_EnableIRQ(UART0_IRQn);
+#endif
 }
 
 
@@ -317,11 +360,20 @@ void SCT_irq_handler(void)
 }
 
 
+// ****************************************************************************
+void WDT_irq_handler(void)
+{
+    LPC_WWDT->MOD |= (1 << 3);          // Clear the warning interrupt flag
+    watchdog_warning_handler();
+}
+
+
 // ****************************************************************************
 void SysTick_handler(void)
 {
     if (SysTick->CTRL & (1 << 16)) {       // Read and clear Countflag
         ++systick_count;
+        ++systick_total;
     }
 }
 
@@ -352,18 +404,56 @@ void invoke_ISP(void)
 
 
 // ****************************************************************************
-void delay_us(uint32_t microseconds)
+// Start the one-shot delay timer without waiting for it to expire, so that
+// the CPU can do other work in the meantime
+// ****************************************************************************
+void start_delay_us(uint32_t microseconds)
 {
     LPC_MRT->Channel[0].STAT |= 1;
     LPC_MRT->Channel[0].INTVAL =
         ((__SYSTEM_CLOCK / 1000000) * microseconds) & 0x7fffffff;
+}
+
 
+// ****************************************************************************
+// Wait until the delay started by start_delay_us() has expired
+// ****************************************************************************
+void wait_for_delay(void)
+{
     while (!(LPC_MRT->Channel[0].STAT & 1)) {
         ;
     }
 }
 
 
+// ****************************************************************************
+void delay_us(uint32_t microseconds)
+{
+    start_delay_us(microseconds);
+    wait_for_delay();
+}
+
+
+// ****************************************************************************
+// Microseconds since power-on, for time stamping received packets. Wraps
+// after 71 minutes.
+// ****************************************************************************
+uint32_t get_timestamp_us(void)
+{
+    uint32_t ticks;
+    uint32_t value;
+
+    // Read again if the SysTick interrupt counted in between
+    do {
+        ticks = systick_total;
+        value = SysTick->VAL;
+    } while (ticks != systick_total);
+
+    return ticks * __SYSTICK_IN_MS * 1000 +
+        (SysTick->LOAD - value) / (__SYSTEM_CLOCK / 1000000);
+}
+
+
 // ****************************************************************************
 int main(void)
 {
@@ -376,8 +466,11 @@ int main(void)
     uart0_send_cstring("Hardware initialized\n");
 #endif
 
-    // Wait a for a short time after power up before talking to the nRF24
-    delay_us(20000);
+    // Wait a for a short time after power up before talking to the nRF24.
+    // After a watchdog reset it has been powered all along.
+    if (!(LPC_SYSCON->SYSRSTSTAT & (1 << 2))) {
+        delay_us(20000);
+    }
     init_receiver();
 
 #ifndef NO_DEBUG
@@ -392,6 +485,14 @@ int main(void)
         output_preprocessor();
 #endif
 
+#ifdef ENABLE_PACKET_RECORDER
+        output_packet_recorder();
+#endif
+
+#ifdef ENABLE_LINK_STATISTICS
+        output_link_statistics();
+#endif
+
         stack_check();
         feed_the_watchdog();
     }
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ENABLE_PACKET_RECORDER
+
+void record_bind_data(const uint8_t *bind_data, bool bound);
+void record_rx_fifo_drain(void);
+void record_packet(const uint8_t *payload, uint32_t timestamp_us,
+    uint8_t hop_index, uint8_t hops_without_packet, bool binding);
+void output_packet_recorder(void);
+
+#else /* ENABLE_PACKET_RECORDER */
+
+#define record_bind_data(bind_data, bound)
+#define record_rx_fifo_drain()
+#define record_packet(payload, timestamp_us, hop_index, hops_without_packet, binding)
+#define output_packet_recorder()
+
+#endif /* ENABLE_PACKET_RECORDER */
@@ -7,9 +7,14 @@
 #define __SYSTICK_IN_MS 10
 
 #define NUMBER_OF_CHANNELS 3
+#define NUMBER_OF_HOP_CHANNELS 20
 #define SERVO_PULSE_CENTER 1500
 #define INITIAL_ENDPOINT_DELTA 200
 
+// The watchdog warning interrupt fires this many watchdog timer ticks (4
+// clocks of the ~9.4 kHz watchdog oscillator each) before the reset
+#define WATCHDOG_WARNING_TICKS 2
+
 
 // ****************************************************************************
 // IO pins: (LPC812 in TSSOP16 package)
@@ -55,3 +60,6 @@
 
 void invoke_ISP(void);
 void delay_us(uint32_t microseconds);
+void start_delay_us(uint32_t microseconds);
+void wait_for_delay(void);
+uint32_t get_timestamp_us(void);
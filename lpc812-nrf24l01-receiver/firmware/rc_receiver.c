@@ -5,16 +5,55 @@
 #include <rc_receiver.h>
 #include <persistent_storage.h>
 #include <rf.h>
+#include <spi.h>
 #include <uart0.h>
+#include <packet_recorder.h>
+#include <link_statistics.h>
 
 
 
 #define PAYLOAD_SIZE 10
 #define ADDRESS_WIDTH 5
-#define NUMBER_OF_HOP_CHANNELS 20
+#define MAX_RF_CHANNEL 125
 #define MAX_HOP_WITHOUT_PACKET 15
+// Once the hop timing PLL has locked, the receiver keeps hopping in step
+// with the transmitter through dropouts of up to 500 ms
+#define MAX_HOP_WITHOUT_PACKET_LOCKED 100
+// One more than the depth of the nRF24 RX FIFO, as another packet may arrive
+// while the FIFO is drained. A power of 2, so that the free running queue
+// indices wrap around without a gap.
+#define PACKET_QUEUE_SIZE 4
 #define FIRST_HOP_TIME_IN_US 2500
 #define HOP_TIME_IN_US 5000
+#define HOP_OFFSET_INVALID 0xffff
+
+// Hop timing PLL, see track_hop_timer(). The last packet of each hop is the
+// reference; it should arrive PLL_TARGET_US before the next hop. Packets
+// further than PLL_WINDOW_US from that are earlier packets of the hop, or
+// (if later) show that the reference is a later packet.
+#define PLL_TARGET_US FIRST_HOP_TIME_IN_US
+#define PLL_WINDOW_US 800
+#define PLL_PERIOD_LIMIT_US 10
+#define PLL_LOCK_UPDATES 16
+#define PLL_MAX_HOPS_WITHOUT_REFERENCE 4
+#define HOP_TIME_UNKNOWN 0xffff
+
+// One round of the resync search, see resync_hop()
+#define RESYNC_STEPS (2 * (NUMBER_OF_HOP_CHANNELS - 1))
+
+// Hop indices the cold start sweep moves on per hop, see acquisition_hop().
+// The sweep is only built with ENABLE_ACQUISITION_SWEEP.
+#define ACQUISITION_STEP 4
+
+// Warm restart, see resume_link(). The delay is the approximate time from
+// the watchdog warning interrupt until get_timestamp_us() counts after the
+// reset: the rest of the watchdog timeout, the boot ROM, and the start-up
+// of the crystal and PLL.
+#define SURVIVORS_SIGNATURE 0x4c696e6b
+#define WARM_RESTART_DELAY_US \
+    (WATCHDOG_WARNING_TICKS * 4 * 1000000 / 9375 + 1000)
+#define RESET_CAUSE_WATCHDOG (1 << 2)
+#define RESET_CAUSE_BROWN_OUT (1 << 3)
 
 #define FAILSAFE_TIMEOUT (640 / __SYSTICK_IN_MS)
 #define BIND_TIMEOUT (5000 / __SYSTICK_IN_MS)
@@ -41,12 +80,42 @@ uint16_t raw_data[2];
 bool successful_stick_data = false;
 
 
-static bool rf_int_fired = false;
+static volatile bool rf_int_fired = false;
+static volatile uint32_t rf_int_timestamp_us;
+static volatile uint16_t rf_int_hop_offset_us;
+static volatile unsigned int rf_int_hop_index;
 static unsigned int led_state;
 static unsigned int blink_timer;
 static unsigned int bind_button_timer;
 
 static uint8_t payload[PAYLOAD_SIZE];
+static uint16_t payload_hop_offset_us = HOP_OFFSET_INVALID;
+static unsigned int payload_hop_index;
+
+// Packets read from the RX FIFO that wait to be parsed, oldest first.
+//
+// A single-producer, single-consumer ring: only the code that reads the RX
+// FIFO advances packet_queue_tail, and only dequeue_packet() packet_queue_head.
+// So neither side disables interrupts when the FIFO is read in an interrupt
+// handler. The indices run freely; the queue holds
+// packet_queue_tail - packet_queue_head packets.
+typedef struct {
+    uint8_t payload[PAYLOAD_SIZE];
+    uint32_t timestamp_us;          // When the nRF24 signalled it
+    uint16_t hop_offset_us;         // Hop timer count at that time
+    uint8_t hop_index;              // Hop index the radio listened on
+} queued_packet_t;
+
+static queued_packet_t packet_queue[PACKET_QUEUE_SIZE];
+static volatile unsigned int packet_queue_head;
+static volatile unsigned int packet_queue_tail;
+
+#define PACKETS_QUEUED() (packet_queue_tail - packet_queue_head)
+#define PACKET_QUEUE_ENTRY(index) (&packet_queue[(index) % PACKET_QUEUE_SIZE])
+
+static bool dequeue_packet(void);
+static void pause_rx_draining(void);
+static void resume_rx_draining(void);
 
 static uint8_t failsafe_enabled;
 static uint16_t failsafe[NUMBER_OF_CHANNELS];
@@ -58,8 +127,52 @@ static unsigned int hops_without_packet;
 static unsigned int hop_index;
 static uint8_t hop_data[NUMBER_OF_HOP_CHANNELS];
 
+// While resyncing, the hop index that the receiver listens on and the
+// position in the search of resync_hop()
+static bool resyncing;
+static unsigned int resync_index;
+static unsigned int resync_step;
+
+// While acquiring after power up or binding, and the hops since the sweep
+// of acquisition_hop() last shifted its phase
+static bool acquiring;
+static unsigned int acquisition_hops;
+
+// Estimated hop period of the transmitter in 1/256 us, and the fraction of
+// a microsecond the hop timer is behind it
+static uint32_t hop_period_q8 = HOP_TIME_IN_US << 8;
+static uint32_t hop_period_fraction_q8;
+static unsigned int next_hop_period_us = HOP_TIME_IN_US;
+static unsigned int pll_updates;
+static unsigned int hops_without_reference;
+
+// Link state in the RAM that survives a reset, saved every hop. Only the
+// watchdog warning interrupt knows when the reset happens; it saves the time
+// into the hop in hop_offset_us, which is HOP_OFFSET_INVALID otherwise.
+typedef struct {
+    uint32_t signature;
+    uint32_t checksum;              // Of the fields below
+    uint32_t hop_period_q8;
+    uint16_t channels[NUMBER_OF_CHANNELS];
+    uint16_t failsafe[NUMBER_OF_CHANNELS];
+    uint16_t hop_offset_us;
+    uint8_t hop_index;
+    uint8_t failsafe_enabled;
+    bool synchronized;              // False while acquiring
+} survivors_t;
+
+static survivors_t survivors __attribute__ ((section(".survivors")));
+
+// The hop index and when its hop started, for the watchdog warning
+// interrupt. Written together by publish_hop_timestamp() only, so that the
+// interrupt never pairs a hop index with the start of another hop.
+static unsigned int hop_timestamp_index;
+static uint32_t hop_timestamp_us;
+
 static bool binding_requested = false;
 static bool binding = false;
+static unsigned int bind_state;
+static uint16_t checksum;
 static unsigned int bind_timer;
 static const uint8_t BIND_CHANNEL = 0x51;
 static const uint8_t BIND_ADDRESS[ADDRESS_WIDTH] = {0x12, 0x23, 0x23, 0x45, 0x78};
@@ -144,38 +257,326 @@ static void stop_hop_timer(void)
 
 
 // ****************************************************************************
-static void restart_hop_timer(void)
+// The current hop index started its hop at the given time. Called whenever
+// the hop index or the phase of the hop timer changes.
+// ****************************************************************************
+static void publish_hop_timestamp(uint32_t timestamp_us)
+{
+    __disable_irq();
+    hop_timestamp_index = hop_index;
+    hop_timestamp_us = timestamp_us;
+    __enable_irq();
+}
+
+
+// ****************************************************************************
+// Set the length of the hop after the current one. MATCHREL is loaded into
+// MATCH at the next hop.
+// ****************************************************************************
+static void set_next_hop_period(unsigned int period_us)
+{
+    LPC_SCT->MATCHREL[0].L = period_us - 1;
+}
+
+
+// ****************************************************************************
+// The hop after the current one lasts the estimated period of the
+// transmitter, rounded so that the fractions add up over the hops.
+// ****************************************************************************
+static void advance_hop_period(void)
+{
+    uint32_t period_q8 = hop_period_q8 + hop_period_fraction_q8;
+
+    next_hop_period_us = period_q8 >> 8;
+    hop_period_fraction_q8 = period_q8 & 0xff;
+    set_next_hop_period(next_hop_period_us);
+}
+
+
+// ****************************************************************************
+// Microseconds from the arrival of the packet until the next hop, or
+// HOP_TIME_UNKNOWN if the hop timer has hopped since. The SCTimer captured
+// the hop timer when the packet arrived.
+// ****************************************************************************
+static unsigned int get_hop_time_remaining_us(const queued_packet_t *packet)
 {
+    unsigned int match = LPC_SCT->MATCH[0].L;
+
+    if (packet->hop_offset_us > LPC_SCT->COUNT_L ||
+            packet->hop_offset_us > match) {
+        return HOP_TIME_UNKNOWN;
+    }
+    return match - packet->hop_offset_us;
+}
+
+
+// ****************************************************************************
+// Restart the hop timer as if it had started when the packet with the given
+// timestamp arrived, so that the hop time does not depend on how late the
+// main loop gets to the packet.
+// ****************************************************************************
+static void restart_hop_timer(uint32_t packet_timestamp_us)
+{
+    uint32_t now_us;
+    uint32_t elapsed_us;
+
     LPC_SCT->CTRL_L |= (1 << 2);
-    LPC_SCT->MATCHREL[0].L = HOP_TIME_IN_US - 1;
+    advance_hop_period();
 
     // We need to set the MATCH register, not the MATCHREL register here as
     // only after the first match the MATCHREL gets copied in!
     LPC_SCT->MATCH[0].L = FIRST_HOP_TIME_IN_US;
 
-    LPC_SCT->COUNT_L = 0;
+    now_us = get_timestamp_us();
+    elapsed_us = now_us - packet_timestamp_us;
+    if (elapsed_us >= FIRST_HOP_TIME_IN_US) {
+        elapsed_us = FIRST_HOP_TIME_IN_US - 1;
+    }
+
+    LPC_SCT->COUNT_L = elapsed_us;
     LPC_SCT->CTRL_L &= ~(1 << 2);
+    publish_hop_timestamp(now_us - elapsed_us);
 
     hops_without_packet = 0;
+    hops_without_reference = 0;
     perform_hop_requested = false;
 }
 
 
+// ****************************************************************************
+// Software PLL that keeps the hop timer in step with the transmitter, fed
+// with the newest received packet.
+//
+// The phase error is how much later than PLL_TARGET_US before the hop the
+// reference packet arrived. Half of it lengthens the next hop, and 1/32 of
+// it is integrated into the estimated hop period, which tracks the crystal
+// of the transmitter. Without a running hop timer, after a packet that
+// arrived later than the reference, or after several hops with only
+// earlier packets, the hop timer restarts from the packet instead.
+// ****************************************************************************
+static void track_hop_timer(const queued_packet_t *packet)
+{
+    unsigned int remaining_us;
+    int error_us;
+
+    hops_without_packet = 0;
+
+    if (LPC_SCT->CTRL_L & (1 << 2)) {
+        restart_hop_timer(packet->timestamp_us);
+        return;
+    }
+
+    remaining_us = get_hop_time_remaining_us(packet);
+    if (remaining_us == HOP_TIME_UNKNOWN) {
+        return;
+    }
+
+    error_us = PLL_TARGET_US - (int)remaining_us;
+    if (error_us < -PLL_WINDOW_US) {
+        if (hops_without_reference >= PLL_MAX_HOPS_WITHOUT_REFERENCE) {
+            restart_hop_timer(packet->timestamp_us);
+        }
+        return;
+    }
+    if (error_us > PLL_WINDOW_US) {
+        restart_hop_timer(packet->timestamp_us);
+        return;
+    }
+
+    hops_without_reference = 0;
+
+    hop_period_q8 += error_us * 8;
+    if (hop_period_q8 > ((HOP_TIME_IN_US + PLL_PERIOD_LIMIT_US) << 8)) {
+        hop_period_q8 = (HOP_TIME_IN_US + PLL_PERIOD_LIMIT_US) << 8;
+    }
+    if (hop_period_q8 < ((HOP_TIME_IN_US - PLL_PERIOD_LIMIT_US) << 8)) {
+        hop_period_q8 = (HOP_TIME_IN_US - PLL_PERIOD_LIMIT_US) << 8;
+    }
+
+    set_next_hop_period(next_hop_period_us + error_us / 2);
+
+    if (pll_updates < PLL_LOCK_UPDATES) {
+        ++pll_updates;
+    }
+}
+
+
+// ****************************************************************************
+// Nothing is known about the transmitter yet: run the hop timer freely and
+// wait on the hop index that restart_packet_receiving() set, or sweep
+// through the hop channels with acquisition_hop(). The first packet restarts
+// the hop timer from its arrival, and the hop index it came on is the hop
+// index of the transmitter.
+// ****************************************************************************
+static void start_acquisition(void)
+{
+    restart_hop_timer(get_timestamp_us());
+    acquiring = true;
+    acquisition_hops = 0;
+}
+
+
+// ****************************************************************************
+// With ENABLE_ACQUISITION_SWEEP, listen on the hop index ACQUISITION_STEP
+// further for one hop period. Otherwise stay on the hop index.
+//
+// Waiting on one channel, the receiver meets the transmitter within 20 hops
+// too, but a hop whose packets it just missed, because its hop period
+// started on the other side of them, is only tested again one hop later. The
+// transmitter moves one hop index per hop, so here the distance to it
+// changes by ACQUISITION_STEP - 1 = 3 per hop instead. As 3 and 20 have no
+// common divisor the sweep still tries every distance within 20 hops, while
+// listening on only 5 of the channels, and a nearly missed hop is met again
+// sooner on average. Should the packets of the transmitter keep falling just
+// outside the hop periods, the sweep shifts by half a hop every 20 hops.
+//
+// This pays off on a clean link only. A sweep hop overlaps only part of a
+// transmitter hop, so it holds fewer packets than a hop waited on one
+// channel. With packet loss these chances are missed more often, and the
+// sweep locks later. The receiver cannot tell the loss before its first
+// packet, hence it waits by default; see simulator/README.md.
+// ****************************************************************************
+static void acquisition_hop(void)
+{
+#ifdef ENABLE_ACQUISITION_SWEEP
+    hop_index = (hop_index + ACQUISITION_STEP) % NUMBER_OF_HOP_CHANNELS;
+    rf_hop(hop_index);
+
+    ++acquisition_hops;
+    if (acquisition_hops >= NUMBER_OF_HOP_CHANNELS) {
+        acquisition_hops = 0;
+        set_next_hop_period(next_hop_period_us + HOP_TIME_IN_US / 2);
+    }
+#endif
+}
+
+
+// ****************************************************************************
+// Start the hop timer elapsed_us into a hop of the estimated period
+// ****************************************************************************
+static void resume_hop_timer(unsigned int elapsed_us)
+{
+    LPC_SCT->CTRL_L |= (1 << 2);
+    advance_hop_period();
+    LPC_SCT->MATCH[0].L = next_hop_period_us - 1;
+    LPC_SCT->COUNT_L = elapsed_us;
+    LPC_SCT->CTRL_L &= ~(1 << 2);
+    publish_hop_timestamp(get_timestamp_us() - elapsed_us);
+
+    hops_without_packet = 0;
+    hops_without_reference = 0;
+    perform_hop_requested = false;
+}
+
+
+// ****************************************************************************
+static uint32_t get_survivors_checksum(void)
+{
+    const uint8_t *data = (const uint8_t *)&survivors.hop_period_q8;
+    const uint8_t *end = (const uint8_t *)(&survivors + 1);
+    uint32_t sum = 0;
+
+    while (data < end) {
+        sum = ((sum << 1) | (sum >> 31)) + *data++;
+    }
+    return sum;
+}
+
+
+// ****************************************************************************
+// Save the link state for resume_link(): the given hop index, and
+// hop_offset_us as described at survivors_t. The signature is invalid while
+// the fields are written, in case the reset strikes in between.
+// ****************************************************************************
+static void save_link_state(unsigned int index, uint16_t hop_offset_us)
+{
+    int i;
+
+    survivors.signature = 0;
+
+    survivors.hop_period_q8 = hop_period_q8;
+    for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
+        survivors.channels[i] = channels[i];
+        survivors.failsafe[i] = failsafe[i];
+    }
+    survivors.hop_offset_us = hop_offset_us;
+    survivors.hop_index = index % NUMBER_OF_HOP_CHANNELS;
+    survivors.failsafe_enabled = failsafe_enabled;
+    survivors.synchronized = !acquiring;
+
+    survivors.checksum = get_survivors_checksum();
+    survivors.signature = SURVIVORS_SIGNATURE;
+}
+
+
 // ****************************************************************************
 static void restart_packet_receiving(void)
 {
+    statistics_restart();
     stop_hop_timer();
 
     rf_clear_ce();
+    pause_rx_draining();
     hop_index = 0;
     hops_without_packet = 0;
+    pll_updates = 0;
+    resyncing = false;
     perform_hop_requested = false;
     rf_set_rx_address(DATA_PIPE_0, ADDRESS_WIDTH, model_address);
     rf_set_channel(hop_data[0]);
     rf_flush_rx_fifo();
+    while (dequeue_packet()) {
+        // Discard the packets received before the restart
+    }
+    payload_hop_offset_us = HOP_OFFSET_INVALID;
     rf_clear_irq(RX_RD);
     rf_int_fired = false;
+    resume_rx_draining();
     rf_set_ce();
+
+    start_acquisition();
+}
+
+
+// ****************************************************************************
+// Lost the transmitter: the hop timer keeps running, so hop_index carries on
+// as an estimate of the transmitter's hop index from the time since the last
+// packet. Search around it with resync_hop() instead of waiting on one
+// channel for the transmitter to come around.
+// ****************************************************************************
+static void start_resync(void)
+{
+    statistics_resync();
+    resyncing = true;
+    resync_step = 0;
+}
+
+
+// ****************************************************************************
+// Listen on the next hop index of the resync search. Every other hop is on
+// the estimated hop index, where the transmitter is after a dropout, so the
+// receiver picks it up within two hops. The hops in between try the hop
+// indices 1, -1, 2, -2, ... hops away from it, in a window that widens step
+// by step until it covers all hop channels, in case the estimate is wrong.
+// ****************************************************************************
+static void resync_hop(void)
+{
+    int offset = 0;
+
+    if (resync_step & 1) {
+        offset = (resync_step + 3) / 4;
+        if (resync_step & 2) {
+            offset = -offset;
+        }
+    }
+    resync_index = (hop_index + NUMBER_OF_HOP_CHANNELS + offset) %
+        NUMBER_OF_HOP_CHANNELS;
+    rf_hop(resync_index);
+
+    ++resync_step;
+    if (resync_step >= RESYNC_STEPS) {
+        resync_step = 0;
+    }
 }
 
 
@@ -191,6 +592,10 @@ static void parse_bind_data(void)
     for (i = 0; i < NUMBER_OF_HOP_CHANNELS; i++) {
         hop_data[i] = bind_storage_area[ADDRESS_WIDTH + i];
     }
+    rf_set_hop_channels(NUMBER_OF_HOP_CHANNELS, hop_data);
+    statistics_hop_channels(hop_data);
+
+    record_bind_data(bind_storage_area, binding);
 }
 
 
@@ -206,6 +611,223 @@ static void binding_done(void)
 }
 
 
+// ****************************************************************************
+// Copy the oldest packet of the queue into payload. Returns false if the
+// queue is empty.
+// ****************************************************************************
+static bool dequeue_packet(void)
+{
+    int i;
+
+    if (!PACKETS_QUEUED()) {
+        return false;
+    }
+
+    // Read the entry only after the tail index that published it
+    __DMB();
+
+    for (i = 0; i < PAYLOAD_SIZE; i++) {
+        payload[i] = PACKET_QUEUE_ENTRY(packet_queue_head)->payload[i];
+    }
+    payload_hop_offset_us = PACKET_QUEUE_ENTRY(packet_queue_head)->hop_offset_us;
+    payload_hop_index = PACKET_QUEUE_ENTRY(packet_queue_head)->hop_index;
+
+    // Free the entry only after it has been copied
+    __DMB();
+    ++packet_queue_head;
+
+    return true;
+}
+
+
+#ifdef ENABLE_ASYNC_RX
+
+#ifdef ENABLE_PACKET_RECORDER
+    #error The packet recorder does not support ENABLE_ASYNC_RX
+#endif
+
+// ****************************************************************************
+// Asynchronous reception: the PININT0 interrupt submits SPI jobs that move
+// the RX FIFO into the packet queue, so the packets are in RAM without
+// waiting for the main loop. rf_int_fired is set once the FIFO is empty.
+//
+// The jobs follow read_rx_fifo(): read a payload, then clear RX_DR, whose
+// STATUS byte tells whether another packet follows.
+// ****************************************************************************
+static spi_job_t rx_read_job;
+static spi_job_t rx_clear_job;
+static const uint8_t RX_CLEAR_VALUE = RX_RD;
+static volatile bool rx_draining;
+
+static void rx_read_done(spi_job_t *job);
+static void rx_clear_done(spi_job_t *job);
+
+
+// ****************************************************************************
+// Read the packet at the head of the RX FIFO into the free queue entry. If
+// the queue is full the packet is discarded, as the main loop may be copying
+// the oldest entry.
+// ****************************************************************************
+static void submit_rx_read(void)
+{
+    rx_read_job.command = R_RX_PAYLOAD;
+    rx_read_job.count = PAYLOAD_SIZE;
+    rx_read_job.tx_data = NULL;
+    rx_read_job.rx_data = NULL;
+    if (PACKETS_QUEUED() < PACKET_QUEUE_SIZE) {
+        rx_read_job.rx_data = PACKET_QUEUE_ENTRY(packet_queue_tail)->payload;
+    }
+    rx_read_job.callback = rx_read_done;
+    spi_submit(&rx_read_job);
+}
+
+
+// ****************************************************************************
+static void rx_read_done(spi_job_t *job)
+{
+    if (!RF_IS_RX_FIFO_EMPTY(job->status) && job->rx_data) {
+        PACKET_QUEUE_ENTRY(packet_queue_tail)->timestamp_us =
+            rf_int_timestamp_us;
+        PACKET_QUEUE_ENTRY(packet_queue_tail)->hop_offset_us =
+            rf_int_hop_offset_us;
+        PACKET_QUEUE_ENTRY(packet_queue_tail)->hop_index = rf_int_hop_index;
+
+        // Publish the entry only after it has been written
+        __DMB();
+        ++packet_queue_tail;
+    }
+
+    // Also clears RX_DR of a spurious interrupt
+    rx_clear_job.command = W_REGISTER | STATUS;
+    rx_clear_job.count = 1;
+    rx_clear_job.tx_data = &RX_CLEAR_VALUE;
+    rx_clear_job.rx_data = NULL;
+    rx_clear_job.callback = rx_clear_done;
+    spi_submit(&rx_clear_job);
+}
+
+
+// ****************************************************************************
+static void rx_clear_done(spi_job_t *job)
+{
+    if (!RF_IS_RX_FIFO_EMPTY(job->status)) {
+        submit_rx_read();
+        return;
+    }
+
+    rx_draining = false;
+    rf_int_fired = true;
+}
+
+
+// ****************************************************************************
+// Keep the PININT0 interrupt from starting to drain the RX FIFO, and wait
+// until the SPI jobs of a drain in progress are done. No packets are added
+// to the queue until resume_rx_draining().
+// ****************************************************************************
+static void pause_rx_draining(void)
+{
+    bool draining;
+
+    NVIC_DisableIRQ(PININT0_IRQn);
+    do {
+        __disable_irq();
+        draining = rx_draining;
+        __enable_irq();
+    } while (draining);
+}
+
+
+// ****************************************************************************
+static void resume_rx_draining(void)
+{
+    NVIC_EnableIRQ(PININT0_IRQn);
+}
+
+
+// The interrupt has drained the FIFO already
+#define read_rx_fifo()
+
+#else
+
+// ****************************************************************************
+// Read the packet at the head of the RX FIFO into the packet queue. If the
+// queue is full, the oldest packet is dropped; the main loop is both the
+// producer and the consumer here, so it may advance the head.
+// Returns the STATUS register value of the read. The queue is unchanged if
+// the FIFO was empty.
+// ****************************************************************************
+static uint8_t enqueue_packet(void)
+{
+    queued_packet_t *packet;
+    uint8_t status;
+
+    packet = PACKET_QUEUE_ENTRY(packet_queue_tail);
+
+    status = rf_read_fifo(packet->payload, PAYLOAD_SIZE);
+    if (RF_IS_RX_FIFO_EMPTY(status)) {
+        return status;
+    }
+
+    packet->timestamp_us = rf_int_timestamp_us;
+    packet->hop_offset_us = rf_int_hop_offset_us;
+    packet->hop_index = rf_int_hop_index;
+    record_packet(packet->payload, packet->timestamp_us, hop_index,
+        hops_without_packet, binding);
+
+    if (PACKETS_QUEUED() == PACKET_QUEUE_SIZE) {
+        ++packet_queue_head;
+    }
+    ++packet_queue_tail;
+
+    return status;
+}
+
+
+// ****************************************************************************
+// Move all packets from the receive FIFO into the packet queue, and clear
+// RX_DR.
+//
+// The STATUS byte of the FIFO read tells whether there was a packet, and
+// the one of clearing RX_DR afterwards whether another one follows. A single
+// packet takes two SPI transactions this way, instead of polling the FIFO
+// state before and after every read.
+// ****************************************************************************
+static void read_rx_fifo(void)
+{
+    uint8_t status;
+
+    record_rx_fifo_drain();
+    status = enqueue_packet();
+    while (!RF_IS_RX_FIFO_EMPTY(status)) {
+        status = rf_clear_irq(RX_RD);
+        if (RF_IS_RX_FIFO_EMPTY(status)) {
+            return;
+        }
+        status = enqueue_packet();
+    }
+
+    // Spurious interrupt: the FIFO was empty, RX_DR may still be set
+    rf_clear_irq(RX_RD);
+}
+
+
+// ****************************************************************************
+// The main loop drains the RX FIFO itself, so nothing else adds to the queue
+// ****************************************************************************
+static void pause_rx_draining(void)
+{
+}
+
+
+// ****************************************************************************
+static void resume_rx_draining(void)
+{
+}
+
+#endif
+
+
 // ****************************************************************************
 // The bind process works as follows:
 //
@@ -228,58 +850,16 @@ static void binding_done(void)
 // ..           Not used
 //
 // ****************************************************************************
-static void process_binding(void)
+static void parse_bind_payload(void)
 {
-    static unsigned int bind_state;
-    static uint16_t checksum;
     int i;
 
-    // ================================
-    if (!binding) {
-        if (!binding_requested) {
-            return;
-        }
-
-        binding_requested = false;
-        led_state = LED_STATE_BINDING;
-        binding = true;
+    // An address packet restarts binding in any state, so that a partial
+    // bind from another transmitter does not block ours. Hop data packets
+    // never match, their third byte is 0, 1 or 2.
+    if (payload[0] == 0xff  &&  payload[1] == 0xaa  &&  payload[2] == 0x55) {
         bind_state = 0;
-        bind_timer = BIND_TIMEOUT;
-
-#ifndef NO_DEBUG
-        uart0_send_cstring("Starting bind procedure\n");
-#endif
-
-        rf_clear_ce();
-        // Set special address 12h 23h 23h 45h 78h
-        rf_set_rx_address(0, ADDRESS_WIDTH, BIND_ADDRESS);
-        // Set special channel 0x51
-        rf_set_channel(BIND_CHANNEL);
-        rf_set_ce();
-        return;
-    }
-
-
-    // ================================
-    if (bind_timer == 0) {
-#ifndef NO_DEBUG
-        uart0_send_cstring("Bind timeout\n");
-#endif
-        binding_done();
-        return;
-    }
-
-
-    // ================================
-    if (!rf_int_fired) {
-        return;
-    }
-    rf_int_fired = false;
-
-    while (!rf_is_rx_fifo_emtpy()) {
-        rf_read_fifo(payload, PAYLOAD_SIZE);
     }
-    rf_clear_irq(RX_RD);
 
     switch (bind_state) {
         case 0:
@@ -334,6 +914,15 @@ static void process_binding(void)
                             bind_storage_area[19 + i] = payload[3 + i];
                         }
 
+                        // Corrupted bind data must not make us hop on
+                        // channels the nRF24 does not have
+                        for (i = 5; i < 5 + NUMBER_OF_HOP_CHANNELS; i++) {
+                            if (bind_storage_area[i] > MAX_RF_CHANNEL) {
+                                bind_state = 0;
+                                return;
+                            }
+                        }
+
                         save_persistent_storage(bind_storage_area);
                         parse_bind_data();
 #ifndef NO_DEBUG
@@ -354,49 +943,41 @@ static void process_binding(void)
 
 
 // ****************************************************************************
-static void process_receiving(void)
+static void process_binding(void)
 {
     // ================================
-    if (binding) {
-        return;
-    }
+    if (!binding) {
+        if (!binding_requested) {
+            return;
+        }
 
-    // ================================
-    // Process failsafe only if we ever got a successsful stick data payload
-    // after reset.
-    //
-    // This way the servo outputs stay off until we got successful stick
-    // data, so the servos do not got to the failsafe point after power up
-    // in case the transmitter is not on yet.
-    if (successful_stick_data) {
-        if (failsafe_timer == 0) {
-            int i;
+        binding_requested = false;
+        led_state = LED_STATE_BINDING;
+        binding = true;
+        bind_state = 0;
+        bind_timer = BIND_TIMEOUT;
 
-            for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
-                channels[i] = failsafe[i];
-            }
-            output_pulses();
+#ifndef NO_DEBUG
+        uart0_send_cstring("Starting bind procedure\n");
+#endif
 
-            led_state = LED_STATE_FAILSAFE;
-        }
+        rf_clear_ce();
+        // Set special address 12h 23h 23h 45h 78h
+        rf_set_rx_address(0, ADDRESS_WIDTH, BIND_ADDRESS);
+        // Set special channel 0x51
+        rf_set_channel(BIND_CHANNEL);
+        rf_set_ce();
+        return;
     }
 
 
     // ================================
-    if (perform_hop_requested) {
-        perform_hop_requested = false;
-        ++hops_without_packet;
-
-
-        if (hops_without_packet > MAX_HOP_WITHOUT_PACKET) {
-            restart_packet_receiving();
-        }
-        else {
-            rf_clear_ce();
-            hop_index = (hop_index + 1) % NUMBER_OF_HOP_CHANNELS;
-            rf_set_channel(hop_data[hop_index]);
-            rf_set_ce();
-        }
+    if (bind_timer == 0) {
+#ifndef NO_DEBUG
+        uart0_send_cstring("Bind timeout\n");
+#endif
+        binding_done();
+        return;
     }
 
 
@@ -406,21 +987,16 @@ static void process_receiving(void)
     }
     rf_int_fired = false;
 
-    while (!rf_is_rx_fifo_emtpy()) {
-        rf_read_fifo(payload, PAYLOAD_SIZE);
+    read_rx_fifo();
+    while (binding && dequeue_packet()) {
+        parse_bind_payload();
     }
-    rf_clear_irq(RX_RD);
-
-#ifndef NO_DEBUG
-    if (hops_without_packet > 1) {
-        uart0_send_uint32(hops_without_packet);
-        uart0_send_linefeed();
-    }
-#endif
-
-    restart_hop_timer();
+}
 
 
+// ****************************************************************************
+static void parse_payload(void)
+{
     // ================================
     // payload[7] is 0x55 for stick data
     if (payload[7] == 0x55) {   // Stick data
@@ -444,6 +1020,7 @@ static void process_receiving(void)
             LPC_SCT->CTRL_H &= ~(1u << 2);      // Start the SCTimer H
         }
         successful_stick_data = true;
+        statistics_packet(payload_hop_index, true);
 
         failsafe_timer = FAILSAFE_TIMEOUT;
         led_state = LED_STATE_RECEIVING;
@@ -451,6 +1028,8 @@ static void process_receiving(void)
     // ================================
     // payload[7] is 0xaa for failsafe data
     else if (payload[7] == 0xaa) {
+        statistics_packet(payload_hop_index, false);
+
         // payload[8]: 0x5a if enabled, 0x5b if disabled
         if (payload[8] == 0x5a) {
             failsafe_enabled = true;
@@ -467,6 +1046,129 @@ static void process_receiving(void)
 }
 
 
+// ****************************************************************************
+static void process_receiving(void)
+{
+    // ================================
+    if (binding) {
+        return;
+    }
+
+    // ================================
+    // Process failsafe only if we ever got a successsful stick data payload
+    // after reset.
+    //
+    // This way the servo outputs stay off until we got successful stick
+    // data, so the servos do not got to the failsafe point after power up
+    // in case the transmitter is not on yet.
+    if (successful_stick_data) {
+        if (failsafe_timer == 0) {
+            int i;
+
+            for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
+                channels[i] = failsafe[i];
+            }
+            output_pulses();
+
+            // Make sure the link is not lost because the nRF24 lost its
+            // configuration
+            if (led_state != LED_STATE_FAILSAFE) {
+                statistics_failsafe();
+                rf_clear_ce();
+                rf_verify_registers();
+                rf_set_ce();
+            }
+
+            led_state = LED_STATE_FAILSAFE;
+        }
+    }
+
+
+    // ================================
+    if (perform_hop_requested) {
+        perform_hop_requested = false;
+        if (hops_without_reference < PLL_MAX_HOPS_WITHOUT_REFERENCE) {
+            ++hops_without_reference;
+        }
+        statistics_hop();
+
+        // If we are missing too many packets we resync by searching the hop
+        // indices around the one the transmitter should be on. With the PLL
+        // locked we keep hopping in step for longer before.
+        if (!resyncing && !acquiring) {
+            ++hops_without_packet;
+            if (hops_without_packet > (pll_updates >= PLL_LOCK_UPDATES ?
+                    MAX_HOP_WITHOUT_PACKET_LOCKED : MAX_HOP_WITHOUT_PACKET)) {
+                start_resync();
+            }
+        }
+
+        advance_hop_period();
+        if (acquiring) {
+            acquisition_hop();
+        }
+        else {
+            hop_index = (hop_index + 1) % NUMBER_OF_HOP_CHANNELS;
+            if (resyncing) {
+                resync_hop();
+            }
+            else {
+                rf_hop(hop_index);
+            }
+        }
+
+        // The watchdog warning interrupt works from the published hop, so
+        // until here it still counts this hop onto the previous hop index.
+        // Nothing worth resuming before the first stick data.
+        publish_hop_timestamp(get_timestamp_us());
+        if (successful_stick_data) {
+            __disable_irq();
+            save_link_state(hop_index, HOP_OFFSET_INVALID);
+            __enable_irq();
+        }
+    }
+
+
+    // ================================
+    if (!rf_int_fired) {
+        return;
+    }
+    rf_int_fired = false;
+
+    read_rx_fifo();
+    if (!PACKETS_QUEUED()) {
+        return;     // Spurious interrupt
+    }
+
+#ifndef NO_DEBUG
+    if (hops_without_packet > 1) {
+        uart0_send_uint32(hops_without_packet);
+        uart0_send_linefeed();
+    }
+#endif
+
+    // The transmitter is on the hop index the resync listens on
+    if (resyncing) {
+        resyncing = false;
+        hop_index = resync_index;
+        publish_hop_timestamp(hop_timestamp_us);
+    }
+
+    // The sweep says nothing about the hop timing, so start over from the
+    // packet
+    if (acquiring) {
+        acquiring = false;
+        stop_hop_timer();
+    }
+
+    track_hop_timer(PACKET_QUEUE_ENTRY(packet_queue_tail - 1));
+
+    while (dequeue_packet()) {
+        parse_payload();
+    }
+}
+
+
 // ****************************************************************************
 static void process_systick(void)
 {
@@ -575,6 +1277,72 @@ static void process_led(void)
 }
 
 
+// ****************************************************************************
+// After a watchdog or brown-out reset, carry on with the link state that
+// survived it: the servos keep their positions, and the receiver hops where
+// the transmitter should be by now instead of searching from scratch.
+//
+// If the watchdog warning interrupt noted the time into the hop, the hop
+// timer continues from there; the PLL corrects the remaining error with the
+// first packet. Otherwise the time of the reset is unknown, and the receiver
+// resyncs around the earliest hop index the transmitter can be on.
+// ****************************************************************************
+static void resume_link(void)
+{
+    uint32_t reset_cause = LPC_SYSCON->SYSRSTSTAT;
+    uint32_t elapsed_us;
+    unsigned int period_us;
+    int i;
+
+    LPC_SYSCON->SYSRSTSTAT = reset_cause;   // Clear the reset causes
+
+    if (!(reset_cause & (RESET_CAUSE_WATCHDOG | RESET_CAUSE_BROWN_OUT))) {
+        return;
+    }
+    if (survivors.signature != SURVIVORS_SIGNATURE  ||
+            survivors.checksum != get_survivors_checksum()) {
+        return;
+    }
+
+    // Resume only once from the saved state
+    survivors.signature = 0;
+
+    for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
+        channels[i] = survivors.channels[i];
+        failsafe[i] = survivors.failsafe[i];
+    }
+    failsafe_enabled = survivors.failsafe_enabled;
+    output_pulses();
+    LPC_SCT->CTRL_H &= ~(1u << 2);          // Start the SCTimer H
+    successful_stick_data = true;
+
+    // Still acquiring, so carry on with that
+    if (!survivors.synchronized) {
+        return;
+    }
+
+    acquiring = false;
+    hop_period_q8 = survivors.hop_period_q8;
+    period_us = hop_period_q8 >> 8;
+
+    elapsed_us = get_timestamp_us();
+    if (survivors.hop_offset_us != HOP_OFFSET_INVALID) {
+        elapsed_us += survivors.hop_offset_us + WARM_RESTART_DELAY_US;
+    }
+    hop_index = (survivors.hop_index + elapsed_us / period_us) %
+        NUMBER_OF_HOP_CHANNELS;
+
+    if (survivors.hop_offset_us != HOP_OFFSET_INVALID) {
+        rf_hop(hop_index);
+        resume_hop_timer(elapsed_us % period_us);
+    }
+    else {
+        start_resync();
+        resync_hop();
+    }
+}
+
+
 // ****************************************************************************
 void init_receiver(void)
 {
@@ -594,6 +1362,7 @@ void init_receiver(void)
     rf_set_payload_size(DATA_PIPE_0, PAYLOAD_SIZE);
 
     restart_packet_receiving();
+    resume_link();
 
     led_state = LED_STATE_IDLE;
 }
@@ -610,10 +1379,48 @@ void process_receiver(void)
 }
 
 
+// ****************************************************************************
+// The packets read for this interrupt get its time as their timestamp, so
+// they do not depend on when the main loop gets to them.
 // ****************************************************************************
 void rf_interrupt_handler(void)
 {
+    rf_int_timestamp_us = get_timestamp_us();
+
+    // The SCTimer captured the hop timer at the falling edge of NRF_IRQ,
+    // before the interrupt latency. It is meaningless while the timer halts.
+    rf_int_hop_offset_us = (LPC_SCT->CTRL_L & (1 << 2)) ?
+        HOP_OFFSET_INVALID : LPC_SCT->CAP[1].L;
+
+    // The packets belong to the hop index the radio listens on now; the main
+    // loop may have moved on by the time it parses them
+    rf_int_hop_index = resyncing ? resync_index : hop_index;
+
+#ifdef ENABLE_ASYNC_RX
+    if (!rx_draining) {
+        rx_draining = true;
+        submit_rx_read();
+    }
+#else
     rf_int_fired = true;
+#endif
+}
+
+
+// ****************************************************************************
+// Microseconds since the last hop at the arrival of the packet parsed last,
+// captured in hardware by the SCTimer. Until the first hop after the hop
+// timer restarts, they count from the packet that restarted it.
+// Returns false if the hop timer was not running when the packet arrived.
+// ****************************************************************************
+bool get_packet_hop_offset_us(uint16_t *offset_us)
+{
+    if (payload_hop_offset_us == HOP_OFFSET_INVALID) {
+        return false;
+    }
+
+    *offset_us = payload_hop_offset_us;
+    return true;
 }
 
 
@@ -622,3 +1429,33 @@ void hop_timer_handler(void)
 {
     perform_hop_requested = true;
 }
+
+
+// ****************************************************************************
+// The watchdog resets the MCU in WATCHDOG_WARNING_TICKS. Save the link state
+// with the time into the hop for resume_link(). The main loop may be stuck,
+// so the hop timer may have hopped since the main loop last did.
+// ****************************************************************************
+void watchdog_warning_handler(void)
+{
+    int elapsed_us;
+    unsigned int offset_us;
+    unsigned int hops;
+
+    if (!successful_stick_data  ||  binding  ||  (LPC_SCT->CTRL_L & (1 << 2))) {
+        return;
+    }
+
+    // Right at the hop the counter has not cleared to 0 yet
+    offset_us = LPC_SCT->COUNT_L;
+    if (offset_us > LPC_SCT->MATCH[0].L) {
+        offset_us = 0;
+    }
+    elapsed_us = get_timestamp_us() - hop_timestamp_us - offset_us;
+    hops = 0;
+    if (elapsed_us > 0) {
+        hops = (elapsed_us + next_hop_period_us / 2) / next_hop_period_us;
+    }
+
+    save_link_state(hop_timestamp_index + hops, offset_us);
+}
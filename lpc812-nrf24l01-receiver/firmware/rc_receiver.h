@@ -1,6 +1,11 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+
 void process_receiver(void);
 void init_receiver(void);
 void rf_interrupt_handler(void);
 void hop_timer_handler(void);
+void watchdog_warning_handler(void);
+bool get_packet_hop_offset_us(uint16_t *offset_us);
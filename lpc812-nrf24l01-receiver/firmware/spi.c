@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #include <platform.h>
 #include <spi.h>
@@ -21,51 +22,280 @@
 #define SPI_TXDATCTL_EOF (1 << 21)
 #define SPI_TXDATCTL_RXIGNORE (1 << 22)
 #define SPI_TXDATCTL_LEN(l) ((l - 1) << 24)
+#define SPI_FRAME_IS_16_BIT(txdatctl) ((((txdatctl) >> 24) & 0xf) == 15)
+
+// Marks the frame with the command byte in spi_transaction(); not written to
+// TXDATCTL (bit 31 is reserved)
+#define SPI_FRAME_COMMAND (1u << 31)
+
+#define SPI_INT_RXRDY (1 << 0)
+
+// nRF24L01+ datasheet page 50: maximum data rate of 10 Mbps. The divider
+// rounds up, so the SPI clock is SPI_CLOCK or the next slower one that
+// __SYSTEM_CLOCK allows: 6 MHz at 12 MHz.
+#ifndef SPI_CLOCK
+    #define SPI_CLOCK 10000000
+#endif
+#if SPI_CLOCK > 10000000
+    #error The nRF24L01+ supports an SPI clock of up to 10 MHz
+#endif
+#define SPI_DIVIDER ((__SYSTEM_CLOCK + SPI_CLOCK - 1) / SPI_CLOCK)
+
+
+void SPI0_irq_handler(void);
+
+
+// Submitted jobs in order; the head is the one on the bus while job_running
+static spi_job_t * volatile job_queue_head;
+static spi_job_t *job_queue_tail;
+static volatile bool job_running;
+static unsigned int job_index;      // Bytes of the running job received so far
+
+// spi_transaction() owns the bus; queued jobs wait until it is done
+static volatile bool blocking_transfer;
 
 
 // ****************************************************************************
 void init_spi(void)
 {
-    // FIXME: check datasheet page 53..55 regarding timings
-    // LPC_SPI->DLY  = (0x2 << 0) | (0x2 << 4) | (0x5 << 12);
+    // nRF24L01+ datasheet page 50, table 27: CSN to SCK setup (Tcc) and SCK
+    // to CSN hold (Tcch) are 2 ns, CSN inactive time (Tcwh) is 50 ns. Half
+    // an SPI clock before the first and after the last SCK edge, and one
+    // SPI clock of SSEL deasserted between transfers, already meet them
+    // at 10 MHz, so no extra delays are needed.
+    LPC_SPI->DLY = 0;
 
-    // nRF24L01+ datasheet page 50: maximum data rate of 10Mbps
-    // To have some margin, we use 2 MHz SPI clock.
-    LPC_SPI->DIV = (__SYSTEM_CLOCK / 2000000) - 1;
+    LPC_SPI->DIV = SPI_DIVIDER - 1;
 
     LPC_SPI->CFG = SPI_CFG_ENABLE | SPI_CFG_MASTER;
 
-    LPC_SPI->TXCTRL =  SPI_TXDATCTL_EOF | SPI_TXDATCTL_LEN(8);
+    // Only the asynchronous reception submits jobs
+#ifdef ENABLE_ASYNC_RX
+    NVIC_EnableIRQ(SPI0_IRQn);
+#endif
 }
 
 
 // ****************************************************************************
-uint8_t spi_transaction(unsigned int count, uint8_t *buffer)
+// Put the command byte of the job at the head of the queue on the bus, unless
+// the bus is in use. Must be called with interrupts disabled or from the
+// SPI0 interrupt.
+// ****************************************************************************
+static void start_next_job(void)
 {
-    uint8_t *ptr = buffer;
+    if (job_running || blocking_transfer || job_queue_head == NULL) {
+        return;
+    }
 
-    // Wait for MSTIDLE
-    while (~LPC_SPI->STAT & SPI_STAT_MSTIDLE);
+    job_running = true;
+    job_index = 0;
+
+    LPC_SPI->TXDATCTL = SPI_TXDATCTL_LEN(8) |
+        (job_queue_head->count ? 0 : SPI_TXDATCTL_EOT) |
+        job_queue_head->command;
+    LPC_SPI->INTENSET = SPI_INT_RXRDY;
+}
+
+
+// ****************************************************************************
+// Queue a job. It starts right away if the bus is free, otherwise after the
+// jobs submitted before it and any running spi_transaction().
+// May be called from interrupt handlers, but not with interrupts disabled.
+// ****************************************************************************
+void spi_submit(spi_job_t *job)
+{
+    job->next = NULL;
 
-    while (count--) {
-        // Wait for TXRDY
+    __disable_irq();
+    if (job_queue_tail) {
+        job_queue_tail->next = job;
+    }
+    else {
+        job_queue_head = job;
+    }
+    job_queue_tail = job;
+    start_next_job();
+    __enable_irq();
+}
+
+
+// ****************************************************************************
+bool spi_is_idle(void)
+{
+    return job_queue_head == NULL;
+}
+
+
+// ****************************************************************************
+// One byte of the running job has been exchanged: store it and send the
+// next one, or start the next job. The last byte carries EOT, so SSEL
+// deasserts by itself.
+// ****************************************************************************
+void SPI0_irq_handler(void)
+{
+    spi_job_t *job = job_queue_head;
+    uint8_t value;
+
+    value = LPC_SPI->RXDAT;
+    if (job_index == 0) {
+        job->status = value;
+    }
+    else if (job->rx_data) {
+        job->rx_data[job_index - 1] = value;
+    }
+
+    if (job_index < job->count) {
+        LPC_SPI->TXDATCTL = SPI_TXDATCTL_LEN(8) |
+            (job_index + 1 == job->count ? SPI_TXDATCTL_EOT : 0) |
+            (job->tx_data ? job->tx_data[job_index] : 0);
+        ++job_index;
+        return;
+    }
+
+    LPC_SPI->INTENCLR = SPI_INT_RXRDY;
+
+    job_queue_head = job->next;
+    if (job_queue_head == NULL) {
+        job_queue_tail = NULL;
+    }
+    job_running = false;
+
+    if (job->callback) {
+        job->callback(job);
+    }
+    start_next_job();
+}
+
+
+// ****************************************************************************
+// The next data byte of a transaction: from tx_data, or zero if it is NULL
+// ****************************************************************************
+static uint32_t next_tx_byte(const uint8_t **tx_data)
+{
+    return *tx_data ? *(*tx_data)++ : 0;
+}
+
+
+// ****************************************************************************
+// Read the data of a frame that was sent without RXIGNORE. The first byte of
+// a transaction is the STATUS register, the others go to rx_data.
+// ****************************************************************************
+static void receive_frame(uint32_t frame, uint8_t *status, uint8_t **rx_data)
+{
+    uint16_t value;
+
+    // Wait for RXRDY
+    while (~LPC_SPI->STAT & SPI_STAT_RXRDY);
+
+    value = LPC_SPI->RXDAT & 0xffff;
+
+    if (frame & SPI_FRAME_COMMAND) {
+        if (!SPI_FRAME_IS_16_BIT(frame)) {
+            *status = value;
+            return;
+        }
+        *status = value >> 8;
+    }
+    else if (SPI_FRAME_IS_16_BIT(frame)) {
+        *(*rx_data)++ = value >> 8;
+    }
+
+    if (*rx_data) {
+        *(*rx_data)++ = value & 0xff;
+    }
+}
+
+
+// ****************************************************************************
+// Send the command byte, followed by count data bytes from tx_data, or zeros
+// if tx_data is NULL. The bytes received for the data go to rx_data unless
+// it is NULL, so payloads need no staging buffer.
+// Returns the STATUS register value, received with the command byte.
+//
+// The bytes go out in 16-bit frames, the first one with the command. Each
+// frame is queued in TXDATCTL while the previous one is on the bus, so they
+// follow each other without a gap; the data of the previous frame is read
+// after that. Without rx_data the frames after the first one are sent with
+// RXIGNORE and need no wait for RXRDY. The last frame carries EOT, which
+// ends the transfer.
+//
+// A running background job is completed first. Must not be called from
+// interrupt handlers.
+// ****************************************************************************
+uint8_t spi_transaction(uint8_t command, unsigned int count,
+    const uint8_t *tx_data, uint8_t *rx_data)
+{
+    uint32_t frame;
+    uint32_t pending = 0;
+    uint8_t status = 0;
+
+    // Take the bus over from the background jobs
+    for (;;) {
+        __disable_irq();
+        if (!job_running) {
+            blocking_transfer = true;
+            __enable_irq();
+            break;
+        }
+        __enable_irq();
+    }
+
+    // The first frame holds the command, and the first data byte if any
+    if (count) {
+        frame = SPI_TXDATCTL_LEN(16) | (command << 8) | next_tx_byte(&tx_data);
+        --count;
+    }
+    else {
+        frame = SPI_TXDATCTL_LEN(8) | command;
+    }
+    frame |= SPI_FRAME_COMMAND;
+
+    for (;;) {
+        if (!count) {
+            frame |= SPI_TXDATCTL_EOT;
+        }
+
+        // Wait for TXRDY: the previous frame has moved to the shift register
         while (~LPC_SPI->STAT & SPI_STAT_TXRDY);
 
-        LPC_SPI->TXDAT = *ptr;
+        LPC_SPI->TXDATCTL = frame & ~SPI_FRAME_COMMAND;
 
-        // Wait for RXRDY
-        while (~LPC_SPI->STAT & SPI_STAT_RXRDY);
+        if (!(frame & SPI_FRAME_COMMAND) && !(pending & SPI_TXDATCTL_RXIGNORE)) {
+            receive_frame(pending, &status, &rx_data);
+        }
+        pending = frame;
 
-        *ptr = LPC_SPI->RXDAT;
-        ++ptr;
+        if (!count) {
+            break;
+        }
+
+        if (count >= 2) {
+            frame = SPI_TXDATCTL_LEN(16) | (next_tx_byte(&tx_data) << 8);
+            frame |= next_tx_byte(&tx_data);
+            count -= 2;
+        }
+        else {
+            frame = SPI_TXDATCTL_LEN(8) | next_tx_byte(&tx_data);
+            count -= 1;
+        }
+        if (!rx_data) {
+            frame |= SPI_TXDATCTL_RXIGNORE;
+        }
     }
 
-    // Force END OF TRANSFER
-    LPC_SPI->STAT = SPI_STAT_ENDTRANSFER;
+    if (!(pending & SPI_TXDATCTL_RXIGNORE)) {
+        receive_frame(pending, &status, &rx_data);
+    }
 
-    // Wait for MSTIDLE
+    // Wait for MSTIDLE, so the nRF24 has acted on the command before the
+    // caller changes CE
     while (~LPC_SPI->STAT & SPI_STAT_MSTIDLE);
 
-    return *buffer;
-}
+    // Hand the bus back to jobs submitted in the meantime
+    __disable_irq();
+    blocking_transfer = false;
+    start_next_job();
+    __enable_irq();
 
+    return status;
+}
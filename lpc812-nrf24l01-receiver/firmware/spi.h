@@ -1,7 +1,24 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 
-void init_spi(void);
-uint8_t spi_transaction(unsigned int count, uint8_t *buffer);
+// A transaction run in the background by the SPI0 interrupt. command, count,
+// tx_data and rx_data are as for spi_transaction(); status receives the
+// STATUS register. The callback, if not NULL, runs in interrupt context once
+// the transaction is complete and may submit further jobs.
+typedef struct spi_job {
+    uint8_t command;
+    uint8_t count;
+    const uint8_t *tx_data;
+    uint8_t *rx_data;
+    uint8_t status;
+    void (* callback)(struct spi_job *job);
+    struct spi_job *next;
+} spi_job_t;
 
+void init_spi(void);
+uint8_t spi_transaction(uint8_t command, unsigned int count,
+    const uint8_t *tx_data, uint8_t *rx_data);
+void spi_submit(spi_job_t *job);
+bool spi_is_idle(void);
@@ -13,6 +13,7 @@
 #include <spi.h>
 #include <rc_receiver.h>
 #include <preprocessor_output.h>
+#include <packet_recorder.h>
 
 
 #define TIMER_16_MS     TIMER_VALUE_US(16000)
@@ -27,6 +28,8 @@ bool systick;
 
 static volatile uint8_t systick_count;
 
+static volatile uint32_t systick_total;
+
 
 // ****************************************************************************
 // Prototypes for the interrupt handlers located in other files
@@ -44,6 +47,7 @@ void timer0_isr(void) __interrupt ((0x000b - 3) / 8)
 {
     TIMER0 = TIMER_16_MS;
     ++systick_count;
+    ++systick_total;
 
     if (successful_stick_data) {
         // Start timer1 with a very short interval to kick off one set of
@@ -115,6 +119,68 @@ void delay_us(uint16_t microseconds)
 }
 
 
+// ****************************************************************************
+// Take a timestamp in an interrupt handler: only copy the Timer 0 state, and
+// convert it with timestamp_to_us() in the main loop. The 32-bit arithmetic
+// of the conversion uses library functions that are not reentrant.
+//
+// Timer 0 counts at __SYSTEM_CLOCK / 12 from TIMER_16_MS up to the overflow,
+// where timer0_isr reloads it. The RF interrupt calls this, so its locals
+// must not be overlaid with those of the main loop.
+// ****************************************************************************
+#pragma save
+#pragma nooverlay
+void capture_timestamp(timestamp_t *timestamp)
+{
+    uint8_t high;
+    uint8_t low;
+
+    IEN0_tf0 = 0;           // Disable Timer0 interrupt
+
+    // Read TH0 again in case TL0 overflowed in between
+    do {
+        high = TH0;
+        low = TL0;
+    } while (high != TH0);
+
+    timestamp->count = ((uint16_t)high << 8) | low;
+    timestamp->ticks = systick_total;
+
+    // Overflow that timer0_isr has not seen yet
+    if (TCON_tf0) {
+        ++timestamp->ticks;
+        timestamp->count = TIMER_16_MS;
+    }
+
+    IEN0_tf0 = 1;
+}
+#pragma restore
+
+
+// ****************************************************************************
+uint32_t timestamp_to_us(const timestamp_t *timestamp)
+{
+    return timestamp->ticks * TIMER_COUNTS_TO_US(0x10000 - TIMER_16_MS) +
+        TIMER_COUNTS_TO_US(timestamp->count - TIMER_16_MS);
+}
+
+
+// ****************************************************************************
+// Microseconds since power-on, for time stamping received packets
+// ****************************************************************************
+uint32_t get_timestamp_us(void)
+{
+    timestamp_t timestamp;
+
+    // capture_timestamp() is not reentrant
+    IEN1_rfirq = 0;
+    capture_timestamp(&timestamp);
+    IEN1_rfirq = 1;
+
+    return timestamp_to_us(&timestamp);
+}
+
+
 // ****************************************************************************
 int main(void)
 {
@@ -142,5 +208,9 @@ int main(void)
 #ifdef ENABLE_PREPROCESSOR_OUTPUT
         output_preprocessor();
 #endif
+
+#ifdef ENABLE_PACKET_RECORDER
+        output_packet_recorder();
+#endif
     }
 }
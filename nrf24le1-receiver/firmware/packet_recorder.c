@@ -0,0 +1,198 @@
+/******************************************************************************
+
+    Packet recorder
+
+    Streams every payload read from the nRF24 out of the UART, together with
+    the hop state of the receiver and a timestamp. tools/packet_recorder.py
+    writes the frames into a capture file, which simulator/packet_replay.c
+    plays back into the host build of rc_receiver.c.
+
+    Each frame is
+
+        0xa5, type, sequence number, body, CRC-8
+
+    The CRC-8 (polynomial 0x07, initial value 0) covers everything but the
+    0xa5. The sequence number increments with every frame, including the
+    frames that are dropped because the transmit buffer is full, so the
+    host can tell when the capture is incomplete. Multi-byte values are
+    little endian.
+
+    'B' bind data, at power-on and after successful binding (30 bytes):
+        timestamp (4), flags (1), model address (5), hop channels (20)
+        flags bit 0: written by the bind procedure
+
+    'P' packet, for every payload read from the RX FIFO (17 bytes):
+        timestamp (4), hop_index (1), hops_without_packet (1), flags (1),
+        payload (10)
+        flags bit 0: read by process_binding()
+        flags bit 1: not the first payload read from the RX FIFO after
+                     this RF interrupt
+
+    The timestamp counts microseconds since power-on.
+
+    The recorder is only available on the nRF24LE1 module hardware, as the
+    UART pins of the XR3100 and HKR3000 are used for other purposes.
+
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <platform.h>
+#include <uart0.h>
+#include <packet_recorder.h>
+
+#ifdef ENABLE_PACKET_RECORDER
+
+#ifdef ENABLE_PREPROCESSOR_OUTPUT
+    #error The packet recorder and the pre-processor output both use the UART
+#endif
+
+#ifndef NO_DEBUG
+    #error The packet recorder requires NO_DEBUG
+#endif
+
+
+#define SYNC_BYTE 0xa5
+#define FRAME_TYPE_BIND_DATA 'B'
+#define FRAME_TYPE_PACKET 'P'
+#define FRAME_OVERHEAD 4
+
+#define BIND_DATA_SIZE 25
+#define BIND_DATA_FLAG_BOUND (1 << 0)
+
+#define PAYLOAD_SIZE 10
+#define PACKET_FLAG_BINDING (1 << 0)
+#define PACKET_FLAG_SAME_DRAIN (1 << 1)
+
+// Room for six packet frames. Must be a power of 2 and not larger than 128
+// as the indices are 8 bit.
+#define BUFFER_SIZE 128
+#define BUFFER_INDEX_MASK (BUFFER_SIZE - 1)
+
+
+static __xdata uint8_t buffer[BUFFER_SIZE];
+static uint8_t read_index;
+static uint8_t write_index;
+static uint8_t crc;
+static uint8_t sequence;
+static bool first_of_drain;
+
+
+// ****************************************************************************
+static void put_byte(uint8_t data)
+{
+    uint8_t i;
+
+    buffer[write_index++ & BUFFER_INDEX_MASK] = data;
+
+    crc ^= data;
+    for (i = 0; i < 8; i++) {
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+    }
+}
+
+
+// ****************************************************************************
+static void put_uint32(uint32_t data)
+{
+    put_byte(data);
+    put_byte(data >> 8);
+    put_byte(data >> 16);
+    put_byte(data >> 24);
+}
+
+
+// ****************************************************************************
+// Returns false if the frame does not fit into the buffer. The sequence
+// number is consumed anyway, so the gap shows up in the capture.
+// ****************************************************************************
+static bool start_frame(uint8_t type, uint8_t body_size)
+{
+    if (BUFFER_SIZE - (uint8_t)(write_index - read_index) <
+            body_size + FRAME_OVERHEAD) {
+        ++sequence;
+        return false;
+    }
+
+    buffer[write_index++ & BUFFER_INDEX_MASK] = SYNC_BYTE;
+    crc = 0;
+    put_byte(type);
+    put_byte(sequence++);
+    return true;
+}
+
+
+// ****************************************************************************
+static void end_frame(void)
+{
+    buffer[write_index++ & BUFFER_INDEX_MASK] = crc;
+}
+
+
+// ****************************************************************************
+void record_bind_data(const uint8_t *bind_data, bool bound)
+{
+    uint32_t timestamp = get_timestamp_us();
+    uint8_t i;
+
+    if (!start_frame(FRAME_TYPE_BIND_DATA, 5 + BIND_DATA_SIZE)) {
+        return;
+    }
+
+    put_uint32(timestamp);
+    put_byte(bound ? BIND_DATA_FLAG_BOUND : 0);
+    for (i = 0; i < BIND_DATA_SIZE; i++) {
+        put_byte(bind_data[i]);
+    }
+    end_frame();
+}
+
+
+// ****************************************************************************
+void record_rx_fifo_drain(void)
+{
+    first_of_drain = true;
+}
+
+
+// ****************************************************************************
+void record_packet(const uint8_t *payload, uint32_t timestamp_us,
+    uint8_t hop_index, uint8_t hops_without_packet, bool binding)
+{
+    uint8_t flags = 0;
+    uint8_t i;
+
+    if (binding) {
+        flags |= PACKET_FLAG_BINDING;
+    }
+    if (!first_of_drain) {
+        flags |= PACKET_FLAG_SAME_DRAIN;
+    }
+    first_of_drain = false;
+
+    if (!start_frame(FRAME_TYPE_PACKET, 7 + PAYLOAD_SIZE)) {
+        return;
+    }
+
+    put_uint32(timestamp_us);
+    put_byte(hop_index);
+    put_byte(hops_without_packet);
+    put_byte(flags);
+    for (i = 0; i < PAYLOAD_SIZE; i++) {
+        put_byte(payload[i]);
+    }
+    end_frame();
+}
+
+
+// ****************************************************************************
+// Called from the main loop; sends one byte whenever the UART is ready
+// ****************************************************************************
+void output_packet_recorder(void)
+{
+    if (read_index != write_index  &&  uart0_send_is_ready()) {
+        uart0_send_char(buffer[read_index++ & BUFFER_INDEX_MASK]);
+    }
+}
+
+#endif // ENABLE_PACKET_RECORDER
@@ -11,10 +11,13 @@
 // One can use the CPPM output instead on HKR3000 and XR3100
 #if HARDWARE != NRF24LE1_MODULE
     #undef ENABLE_PREPROCESSOR_OUTPUT
+    #undef ENABLE_PACKET_RECORDER
     #undef ENABLE_UART
 #else
     #ifdef ENABLE_PREPROCESSOR_OUTPUT
         #define ENABLE_UART
+    #elif defined ENABLE_PACKET_RECORDER
+        #define ENABLE_UART
     #elif !defined NODEBUG
         #define ENABLE_UART
     #endif
@@ -27,7 +30,8 @@
 #define SERVO_PULSE_CENTER 1500
 #define INITIAL_ENDPOINT_DELTA 200
 
-#define TIMER_VALUE_US(x) (0xffff - ((uint32_t)(__SYSTEM_CLOCK / 1000) / 12 * x / 1000))
+#define TIMER_VALUE_US(x) (0xffff - ((uint32_t)(__SYSTEM_CLOCK / 1000) / 12 * (x) / 1000))
+#define TIMER_COUNTS_TO_US(x) ((uint32_t)(x) * 12 / (__SYSTEM_CLOCK / 1000000))
 
 
 // ****************************************************************************
@@ -147,6 +151,15 @@
 // ****************************************************************************
 
 
+// Timer 0 state of a timestamp, see capture_timestamp()
+typedef struct {
+    uint32_t ticks;
+    uint16_t count;
+} timestamp_t;
+
 void delay_us(uint16_t microseconds);
+uint32_t get_timestamp_us(void);
+void capture_timestamp(timestamp_t *timestamp);
+uint32_t timestamp_to_us(const timestamp_t *timestamp);
 
 #endif // __PLATFORM_H__
@@ -6,15 +6,42 @@
 #include <persistent_storage.h>
 #include <rf.h>
 #include <uart0.h>
+#include <packet_recorder.h>
 
 
 #define PAYLOAD_SIZE 10
 #define ADDRESS_WIDTH 5
+#define MAX_RF_CHANNEL 125
 #define NUMBER_OF_HOP_CHANNELS 20
 #define MAX_HOP_WITHOUT_PACKET 15
+// Once the hop timing PLL has locked, the receiver keeps hopping in step
+// with the transmitter through dropouts of up to 500 ms
+#define MAX_HOP_WITHOUT_PACKET_LOCKED 100
+// One more than the depth of the nRF24 RX FIFO, as another packet may arrive
+// while the FIFO is drained. A power of 2, so that the free running queue
+// indices wrap around without a gap.
+#define PACKET_QUEUE_SIZE 4
 #define FIRST_HOP_TIME_IN_US 2500
 #define HOP_TIME_IN_US 5000
 
+// Hop timing PLL, see track_hop_timer(). The last packet of each hop is the
+// reference; it should arrive PLL_TARGET_US before the next hop. Packets
+// further than PLL_WINDOW_US from that are earlier packets of the hop, or
+// (if later) show that the reference is a later packet.
+#define PLL_TARGET_US FIRST_HOP_TIME_IN_US
+#define PLL_WINDOW_US 800
+#define PLL_PERIOD_LIMIT_US 10
+#define PLL_LOCK_UPDATES 16
+#define PLL_MAX_HOPS_WITHOUT_REFERENCE 4
+#define HOP_TIME_UNKNOWN 0xffff
+
+// One round of the resync search, see resync_hop()
+#define RESYNC_STEPS (2 * (NUMBER_OF_HOP_CHANNELS - 1))
+
+// Hop indices the cold start sweep moves on per hop, see acquisition_hop().
+// The sweep is only built with ENABLE_ACQUISITION_SWEEP.
+#define ACQUISITION_STEP 4
+
 #define FAILSAFE_TIMEOUT (640 / __SYSTICK_IN_MS)
 #define BIND_TIMEOUT (5000 / __SYSTICK_IN_MS)
 #define ISP_TIMEOUT (3000 / __SYSTICK_IN_MS)
@@ -50,11 +77,31 @@ static __xdata uint16_t pulse_buffer_1_1;
 static __xdata uint16_t pulse_buffer_1_2;
 
 static bool rf_int_fired = false;
+static timestamp_t rf_int_timestamp;
 static uint8_t led_state;
 static uint16_t blink_timer;
 
 static __xdata uint8_t payload[PAYLOAD_SIZE];
 
+// Packets read from the RX FIFO that wait to be parsed, oldest first.
+//
+// A single-producer, single-consumer ring like on the other ports: only
+// enqueue_packet() advances packet_queue_tail, and only dequeue_packet() (or
+// a restart of the main loop) packet_queue_head. The indices run freely; the
+// queue holds packet_queue_tail - packet_queue_head packets.
+typedef struct {
+    uint8_t payload[PAYLOAD_SIZE];
+    uint32_t timestamp_us;          // When the nRF24 signalled it
+} queued_packet_t;
+
+static __xdata queued_packet_t packet_queue[PACKET_QUEUE_SIZE];
+static uint8_t packet_queue_head;
+static uint8_t packet_queue_tail;
+
+#define PACKETS_QUEUED() ((uint8_t)(packet_queue_tail - packet_queue_head))
+#define PACKET_QUEUE_ENTRY(index) \
+    (&packet_queue[(uint8_t)(index) % PACKET_QUEUE_SIZE])
+
 static uint8_t failsafe_enabled;
 static __xdata uint16_t failsafe[NUMBER_OF_CHANNELS];
 static uint16_t failsafe_timer;
@@ -65,8 +112,32 @@ static uint8_t hops_without_packet;
 static uint8_t hop_index;
 static __xdata uint8_t hop_data[NUMBER_OF_HOP_CHANNELS];
 
+// While resyncing, the hop index that the receiver listens on and the
+// position in the search of resync_hop()
+static bool resyncing;
+static uint8_t resync_index;
+static uint8_t resync_step;
+
+// While acquiring after power up or binding, and the hops since the sweep
+// of acquisition_hop() last shifted its phase
+static bool acquiring;
+static uint8_t acquisition_hops;
+
+// Estimated hop period of the transmitter in 1/256 us, and the fraction of
+// a microsecond the hop timer is behind it
+static __xdata uint32_t hop_period_q8 = (uint32_t)HOP_TIME_IN_US << 8;
+static __xdata uint8_t hop_period_fraction_q8;
+static __xdata uint16_t next_hop_period_us = HOP_TIME_IN_US;
+static uint8_t pll_updates;
+static uint8_t hops_without_reference;
+
+// Timer 2 value that hop_timer_handler() reloads for the next hop
+static volatile uint16_t hop_timer_reload = TIMER_VALUE_US(HOP_TIME_IN_US);
+
 static bool binding_requested = false;
 static bool binding = false;
+static uint8_t bind_state;
+static uint16_t checksum;
 static uint16_t bind_timer;
 static const uint8_t BIND_CHANNEL = 0x51;
 static const uint8_t BIND_ADDRESS[ADDRESS_WIDTH] = {0x12, 0x23, 0x23, 0x45, 0x78};
@@ -157,17 +228,195 @@ static void stop_hop_timer(void)
 
 
 // ****************************************************************************
-static void restart_hop_timer(void)
+// Set the length of the hop after the current one, which hop_timer_handler()
+// loads into Timer 2 at the next hop.
+// ****************************************************************************
+static void set_next_hop_period(uint16_t period_us)
+{
+    uint16_t reload = TIMER_VALUE_US(period_us);
+
+    IEN0_tf2 = 0;           // Disable Timer2 interrupt
+    hop_timer_reload = reload;
+    IEN0_tf2 = 1;
+}
+
+
+// ****************************************************************************
+// The hop after the current one lasts the estimated period of the
+// transmitter, rounded so that the fractions add up over the hops.
+// ****************************************************************************
+static void advance_hop_period(void)
 {
+    uint32_t period_q8 = hop_period_q8 + hop_period_fraction_q8;
+
+    next_hop_period_us = period_q8 >> 8;
+    hop_period_fraction_q8 = period_q8 & 0xff;
+    set_next_hop_period(next_hop_period_us);
+}
+
+
+// ****************************************************************************
+// Microseconds from the arrival of the packet until the next hop, or
+// HOP_TIME_UNKNOWN if the hop timer has evidently hopped since: the time
+// Timer 2 has left until it overflows, plus the time since the packet
+// arrived.
+// ****************************************************************************
+static uint16_t get_hop_time_remaining_us(const queued_packet_t *packet)
+{
+    uint16_t count;
+    uint16_t again;
+    uint32_t remaining_us;
+
+    // TL2 and TH2 are read one after the other, so a carry in between
+    // gives a wrong value; it does not match a second reading.
+    do {
+        count = TIMER2;
+        again = TIMER2;
+    } while ((uint16_t)(again - count) > 1);
+
+    remaining_us = TIMER_COUNTS_TO_US(0x10000 - again) +
+        (get_timestamp_us() - packet->timestamp_us);
+    if (remaining_us > HOP_TIME_IN_US + PLL_WINDOW_US) {
+        return HOP_TIME_UNKNOWN;
+    }
+    return remaining_us;
+}
+
+
+// ****************************************************************************
+// Restart the hop timer as if it had started when the packet with the given
+// timestamp arrived, so that the hop time does not depend on how late the
+// main loop gets to the packet.
+// ****************************************************************************
+static void restart_hop_timer(uint32_t packet_timestamp_us)
+{
+    uint32_t elapsed_us;
+
+    elapsed_us = get_timestamp_us() - packet_timestamp_us;
+    if (elapsed_us >= FIRST_HOP_TIME_IN_US) {
+        elapsed_us = FIRST_HOP_TIME_IN_US - 1;
+    }
+
     T2CON = 0;              // Stop timer 2
-    TIMER2 = TIMER_VALUE_US(FIRST_HOP_TIME_IN_US);
+    advance_hop_period();
+    TIMER2 = TIMER_VALUE_US(FIRST_HOP_TIME_IN_US - elapsed_us);
     T2CON = 0x01;           // Timer 2 clock = f/12, Reload Mode 0
 
     hops_without_packet = 0;
+    hops_without_reference = 0;
     perform_hop_requested = false;
 }
 
 
+// ****************************************************************************
+// Software PLL that keeps the hop timer in step with the transmitter, fed
+// with the newest received packet.
+//
+// The phase error is how much later than PLL_TARGET_US before the hop the
+// reference packet arrived. Half of it lengthens the next hop, and 1/32 of
+// it is integrated into the estimated hop period, which tracks the crystal
+// of the transmitter and the latency of the Timer 2 reload. Without a
+// running hop timer, after a packet that arrived later than the reference,
+// or after several hops with only earlier packets, the hop timer restarts
+// from the packet instead.
+// ****************************************************************************
+static void track_hop_timer(const queued_packet_t *packet)
+{
+    uint16_t remaining_us;
+    int16_t error_us;
+
+    hops_without_packet = 0;
+
+    if (!(T2CON & 0x03)) {
+        restart_hop_timer(packet->timestamp_us);
+        return;
+    }
+
+    remaining_us = get_hop_time_remaining_us(packet);
+    if (remaining_us == HOP_TIME_UNKNOWN) {
+        return;
+    }
+
+    error_us = PLL_TARGET_US - (int16_t)remaining_us;
+    if (error_us < -PLL_WINDOW_US) {
+        if (hops_without_reference >= PLL_MAX_HOPS_WITHOUT_REFERENCE) {
+            restart_hop_timer(packet->timestamp_us);
+        }
+        return;
+    }
+    if (error_us > PLL_WINDOW_US) {
+        restart_hop_timer(packet->timestamp_us);
+        return;
+    }
+
+    hops_without_reference = 0;
+
+    hop_period_q8 += error_us * 8;
+    if (hop_period_q8 > ((uint32_t)(HOP_TIME_IN_US + PLL_PERIOD_LIMIT_US) << 8)) {
+        hop_period_q8 = (uint32_t)(HOP_TIME_IN_US + PLL_PERIOD_LIMIT_US) << 8;
+    }
+    if (hop_period_q8 < ((uint32_t)(HOP_TIME_IN_US - PLL_PERIOD_LIMIT_US) << 8)) {
+        hop_period_q8 = (uint32_t)(HOP_TIME_IN_US - PLL_PERIOD_LIMIT_US) << 8;
+    }
+
+    set_next_hop_period(next_hop_period_us + error_us / 2);
+
+    if (pll_updates < PLL_LOCK_UPDATES) {
+        ++pll_updates;
+    }
+}
+
+
+// ****************************************************************************
+// Nothing is known about the transmitter yet: run the hop timer freely and
+// wait on the hop index that restart_packet_receiving() set, or sweep
+// through the hop channels with acquisition_hop(). The first packet restarts
+// the hop timer from its arrival, and the hop index it came on is the hop
+// index of the transmitter.
+// ****************************************************************************
+static void start_acquisition(void)
+{
+    restart_hop_timer(get_timestamp_us());
+    acquiring = true;
+    acquisition_hops = 0;
+}
+
+
+// ****************************************************************************
+// With ENABLE_ACQUISITION_SWEEP, listen on the hop index ACQUISITION_STEP
+// further for one hop period. Otherwise stay on the hop index.
+//
+// Waiting on one channel, the receiver meets the transmitter within 20 hops
+// too, but a hop whose packets it just missed, because its hop period
+// started on the other side of them, is only tested again one hop later. The
+// transmitter moves one hop index per hop, so here the distance to it
+// changes by ACQUISITION_STEP - 1 = 3 per hop instead. As 3 and 20 have no
+// common divisor the sweep still tries every distance within 20 hops, while
+// listening on only 5 of the channels, and a nearly missed hop is met again
+// sooner on average. Should the packets of the transmitter keep falling just
+// outside the hop periods, the sweep shifts by half a hop every 20 hops.
+//
+// This pays off on a clean link only. A sweep hop overlaps only part of a
+// transmitter hop, so it holds fewer packets than a hop waited on one
+// channel. With packet loss these chances are missed more often, and the
+// sweep locks later. The receiver cannot tell the loss before its first
+// packet, hence it waits by default; see simulator/README.md.
+// ****************************************************************************
+static void acquisition_hop(void)
+{
+#ifdef ENABLE_ACQUISITION_SWEEP
+    hop_index = (hop_index + ACQUISITION_STEP) % NUMBER_OF_HOP_CHANNELS;
+    rf_hop(hop_index);
+
+    ++acquisition_hops;
+    if (acquisition_hops >= NUMBER_OF_HOP_CHANNELS) {
+        acquisition_hops = 0;
+        set_next_hop_period(next_hop_period_us + HOP_TIME_IN_US / 2);
+    }
+#endif
+}
+
+
 // ****************************************************************************
 static void restart_packet_receiving(void)
 {
@@ -176,13 +425,59 @@ static void restart_packet_receiving(void)
     rf_clear_ce();
     hop_index = 0;
     hops_without_packet = 0;
+    pll_updates = 0;
+    resyncing = false;
     perform_hop_requested = false;
     rf_set_rx_address(DATA_PIPE_0, ADDRESS_WIDTH, model_address);
     rf_set_channel(hop_data[0]);
     rf_flush_rx_fifo();
+    packet_queue_head = packet_queue_tail;
     rf_clear_irq(RX_RD);
     rf_int_fired = false;
     rf_set_ce();
+
+    start_acquisition();
+}
+
+
+// ****************************************************************************
+// Lost the transmitter: the hop timer keeps running, so hop_index carries on
+// as an estimate of the transmitter's hop index from the time since the last
+// packet. Search around it with resync_hop() instead of waiting on one
+// channel for the transmitter to come around.
+// ****************************************************************************
+static void start_resync(void)
+{
+    resyncing = true;
+    resync_step = 0;
+}
+
+
+// ****************************************************************************
+// Listen on the next hop index of the resync search. Every other hop is on
+// the estimated hop index, where the transmitter is after a dropout, so the
+// receiver picks it up within two hops. The hops in between try the hop
+// indices 1, -1, 2, -2, ... hops away from it, in a window that widens step
+// by step until it covers all hop channels, in case the estimate is wrong.
+// ****************************************************************************
+static void resync_hop(void)
+{
+    int8_t offset = 0;
+
+    if (resync_step & 1) {
+        offset = (resync_step + 3) / 4;
+        if (resync_step & 2) {
+            offset = -offset;
+        }
+    }
+    resync_index = (hop_index + NUMBER_OF_HOP_CHANNELS + offset) %
+        NUMBER_OF_HOP_CHANNELS;
+    rf_hop(resync_index);
+
+    ++resync_step;
+    if (resync_step >= RESYNC_STEPS) {
+        resync_step = 0;
+    }
 }
 
 
@@ -198,6 +493,9 @@ static void parse_bind_data(void)
     for (i = 0; i < NUMBER_OF_HOP_CHANNELS; i++) {
         hop_data[i] = bind_storage_area[ADDRESS_WIDTH + i];
     }
+    rf_set_hop_channels(NUMBER_OF_HOP_CHANNELS, hop_data);
+
+    record_bind_data(bind_storage_area, binding);
 }
 
 
@@ -213,6 +511,108 @@ static void binding_done(void)
 }
 
 
+// ****************************************************************************
+// Time of the last RF interrupt in microseconds. The RF interrupt must not
+// overwrite rf_int_timestamp while it is copied.
+// ****************************************************************************
+static uint32_t get_rf_int_timestamp_us(void)
+{
+    timestamp_t timestamp;
+
+    IEN1_rfirq = 0;
+    timestamp.ticks = rf_int_timestamp.ticks;
+    timestamp.count = rf_int_timestamp.count;
+    IEN1_rfirq = 1;
+
+    return timestamp_to_us(&timestamp);
+}
+
+
+// ****************************************************************************
+// Read the packet at the head of the RX FIFO into the packet queue. If the
+// queue is full, the oldest packet is dropped.
+// Returns the STATUS register value of the read. The queue is unchanged if
+// the FIFO was empty.
+// ****************************************************************************
+static uint8_t enqueue_packet(uint32_t timestamp_us)
+{
+    __xdata queued_packet_t *packet;
+    uint8_t status;
+
+    packet = PACKET_QUEUE_ENTRY(packet_queue_tail);
+
+    status = rf_read_fifo(packet->payload, PAYLOAD_SIZE);
+    if (RF_IS_RX_FIFO_EMPTY(status)) {
+        return status;
+    }
+
+    packet->timestamp_us = timestamp_us;
+    record_packet(packet->payload, packet->timestamp_us, hop_index,
+        hops_without_packet, binding);
+
+    if (PACKETS_QUEUED() == PACKET_QUEUE_SIZE) {
+        ++packet_queue_head;
+    }
+    ++packet_queue_tail;
+
+    return status;
+}
+
+
+// ****************************************************************************
+// Copy the oldest packet of the queue into payload. Returns false if the
+// queue is empty.
+// ****************************************************************************
+static bool dequeue_packet(void)
+{
+    uint8_t i;
+
+    if (!PACKETS_QUEUED()) {
+        return false;
+    }
+
+    for (i = 0; i < PAYLOAD_SIZE; i++) {
+        payload[i] = PACKET_QUEUE_ENTRY(packet_queue_head)->payload[i];
+    }
+    ++packet_queue_head;
+
+    return true;
+}
+
+
+// ****************************************************************************
+// Move all packets from the receive FIFO into the packet queue, and clear
+// RX_DR.
+//
+// The STATUS byte of the FIFO read tells whether there was a packet, and
+// the one of clearing RX_DR afterwards whether another one follows. A single
+// packet takes two SPI transactions this way, instead of polling the FIFO
+// state before and after every read.
+// ****************************************************************************
+static void read_rx_fifo(void)
+{
+    uint32_t timestamp_us;
+    uint8_t status;
+
+    // The packets get the time of the interrupt that signalled them, not
+    // the time at which the main loop gets to them
+    timestamp_us = get_rf_int_timestamp_us();
+
+    record_rx_fifo_drain();
+    status = enqueue_packet(timestamp_us);
+    while (!RF_IS_RX_FIFO_EMPTY(status)) {
+        status = rf_clear_irq(RX_RD);
+        if (RF_IS_RX_FIFO_EMPTY(status)) {
+            return;
+        }
+        status = enqueue_packet(timestamp_us);
+    }
+
+    // Spurious interrupt: the FIFO was empty, RX_DR may still be set
+    rf_clear_irq(RX_RD);
+}
+
+
 // ****************************************************************************
 // The bind process works as follows:
 //
@@ -235,58 +635,17 @@ static void binding_done(void)
 // ..           Not used
 //
 // ****************************************************************************
-static void process_binding(void)
+static void parse_bind_payload(void)
 {
-    static uint8_t bind_state;
-    static uint16_t checksum;
     uint8_t i;
 
-    // ================================
-    if (!binding) {
-        if (!binding_requested) {
-            return;
-        }
-
-        led_state = LED_STATE_BINDING;
-        binding = true;
+    // An address packet restarts binding in any state, so that a partial
+    // bind from another transmitter does not block ours. Hop data packets
+    // never match, their third byte is 0, 1 or 2.
+    if (payload[0] == 0xff  &&  payload[1] == 0xaa  &&  payload[2] == 0x55) {
         bind_state = 0;
-        bind_timer = BIND_TIMEOUT;
-
-#ifndef NO_DEBUG
-        uart0_send_cstring("Starting bind procedure\n");
-#endif
-
-        rf_clear_ce();
-        // Set special address 12h 23h 23h 45h 78h
-        rf_set_rx_address(0, ADDRESS_WIDTH, BIND_ADDRESS);
-        // Set special channel 0x51
-        rf_set_channel(BIND_CHANNEL);
-        rf_set_ce();
-        return;
-    }
-
-
-    // ================================
-    if (bind_timer == 0) {
-#ifndef NO_DEBUG
-        uart0_send_cstring("Bind timeout\n");
-#endif
-        binding_done();
-        return;
     }
 
-
-    // ================================
-    if (!rf_int_fired) {
-        return;
-    }
-    rf_int_fired = false;
-
-    while (!rf_is_rx_fifo_emtpy()) {
-        rf_read_fifo(payload, PAYLOAD_SIZE);
-    }
-    rf_clear_irq(RX_RD);
-
     switch (bind_state) {
         case 0:
             if (payload[0] == 0xff) {
@@ -340,6 +699,15 @@ static void process_binding(void)
                             bind_storage_area[19 + i] = payload[3 + i];
                         }
 
+                        // Corrupted bind data must not make us hop on
+                        // channels the nRF24 does not have
+                        for (i = 5; i < 5 + NUMBER_OF_HOP_CHANNELS; i++) {
+                            if (bind_storage_area[i] > MAX_RF_CHANNEL) {
+                                bind_state = 0;
+                                return;
+                            }
+                        }
+
                         save_persistent_storage(bind_storage_area);
                         parse_bind_data();
 #ifndef NO_DEBUG
@@ -360,50 +728,40 @@ static void process_binding(void)
 
 
 // ****************************************************************************
-static void process_receiving(void)
+static void process_binding(void)
 {
     // ================================
-    if (binding) {
-        return;
-    }
+    if (!binding) {
+        if (!binding_requested) {
+            return;
+        }
 
-    // ================================
-    // Process failsafe only if we ever got a successsful stick data payload
-    // after reset.
-    //
-    // This way the servo outputs stay off until we got successful stick
-    // data, so the servos do not got to the failsafe point after power up
-    // in case the transmitter is not on yet.
-    if (successful_stick_data) {
-        if (failsafe_timer == 0) {
-            uint8_t i;
+        led_state = LED_STATE_BINDING;
+        binding = true;
+        bind_state = 0;
+        bind_timer = BIND_TIMEOUT;
 
-            for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
-                channels[i] = failsafe[i];
-            }
-            output_pulses();
+#ifndef NO_DEBUG
+        uart0_send_cstring("Starting bind procedure\n");
+#endif
 
-            led_state = LED_STATE_FAILSAFE;
-        }
+        rf_clear_ce();
+        // Set special address 12h 23h 23h 45h 78h
+        rf_set_rx_address(0, ADDRESS_WIDTH, BIND_ADDRESS);
+        // Set special channel 0x51
+        rf_set_channel(BIND_CHANNEL);
+        rf_set_ce();
+        return;
     }
 
 
     // ================================
-    if (perform_hop_requested) {
-        perform_hop_requested = false;
-        ++hops_without_packet;
-
-        // If we are missing too many packets we resync by switching to the
-        // first channel and waiting for a packet without hopping.
-        if (hops_without_packet > MAX_HOP_WITHOUT_PACKET) {
-            restart_packet_receiving();
-        }
-        else {
-            rf_clear_ce();
-            hop_index = (hop_index + 1) % NUMBER_OF_HOP_CHANNELS;
-            rf_set_channel(hop_data[hop_index]);
-            rf_set_ce();
-        }
+    if (bind_timer == 0) {
+#ifndef NO_DEBUG
+        uart0_send_cstring("Bind timeout\n");
+#endif
+        binding_done();
+        return;
     }
 
 
@@ -413,14 +771,16 @@ static void process_receiving(void)
     }
     rf_int_fired = false;
 
-    while (!rf_is_rx_fifo_emtpy()) {
-        rf_read_fifo(payload, PAYLOAD_SIZE);
+    read_rx_fifo();
+    while (binding && dequeue_packet()) {
+        parse_bind_payload();
     }
-    rf_clear_irq(RX_RD);
-
-    restart_hop_timer();
+}
 
 
+// ****************************************************************************
+static void parse_payload(void)
+{
     // ================================
     // payload[7] is 0x55 for stick data
     if (payload[7] == 0x55) {
@@ -463,6 +823,109 @@ static void process_receiving(void)
 }
 
 
+// ****************************************************************************
+static void process_receiving(void)
+{
+    // ================================
+    if (binding) {
+        return;
+    }
+
+    // ================================
+    // Process failsafe only if we ever got a successsful stick data payload
+    // after reset.
+    //
+    // This way the servo outputs stay off until we got successful stick
+    // data, so the servos do not got to the failsafe point after power up
+    // in case the transmitter is not on yet.
+    if (successful_stick_data) {
+        if (failsafe_timer == 0) {
+            uint8_t i;
+
+            for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
+                channels[i] = failsafe[i];
+            }
+            output_pulses();
+
+            // Make sure the link is not lost because the nRF24 lost its
+            // configuration
+            if (led_state != LED_STATE_FAILSAFE) {
+                rf_clear_ce();
+                rf_verify_registers();
+                rf_set_ce();
+            }
+
+            led_state = LED_STATE_FAILSAFE;
+        }
+    }
+
+
+    // ================================
+    if (perform_hop_requested) {
+        perform_hop_requested = false;
+        if (hops_without_reference < PLL_MAX_HOPS_WITHOUT_REFERENCE) {
+            ++hops_without_reference;
+        }
+
+        // If we are missing too many packets we resync by searching the hop
+        // indices around the one the transmitter should be on. With the PLL
+        // locked we keep hopping in step for longer before.
+        if (!resyncing && !acquiring) {
+            ++hops_without_packet;
+            if (hops_without_packet > (pll_updates >= PLL_LOCK_UPDATES ?
+                    MAX_HOP_WITHOUT_PACKET_LOCKED : MAX_HOP_WITHOUT_PACKET)) {
+                start_resync();
+            }
+        }
+
+        advance_hop_period();
+        if (acquiring) {
+            acquisition_hop();
+        }
+        else {
+            hop_index = (hop_index + 1) % NUMBER_OF_HOP_CHANNELS;
+            if (resyncing) {
+                resync_hop();
+            }
+            else {
+                rf_hop(hop_index);
+            }
+        }
+    }
+
+
+    // ================================
+    if (!rf_int_fired) {
+        return;
+    }
+    rf_int_fired = false;
+
+    read_rx_fifo();
+    if (!PACKETS_QUEUED()) {
+        return;     // Spurious interrupt
+    }
+
+    // The transmitter is on the hop index the resync listens on
+    if (resyncing) {
+        resyncing = false;
+        hop_index = resync_index;
+    }
+
+    // The sweep says nothing about the hop timing, so start over from the
+    // packet
+    if (acquiring) {
+        acquiring = false;
+        stop_hop_timer();
+    }
+
+    track_hop_timer(PACKET_QUEUE_ENTRY(packet_queue_tail - 1));
+
+    while (dequeue_packet()) {
+        parse_payload();
+    }
+}
+
+
 // ****************************************************************************
 static void process_systick(void)
 {
@@ -607,6 +1070,7 @@ void process_receiver(void)
 // ****************************************************************************
 void rf_interrupt_handler(void) __interrupt ((0x004b - 3) / 8)
 {
+    capture_timestamp(&rf_int_timestamp);
     rf_int_fired = true;
 }
 
@@ -617,7 +1081,7 @@ void rf_interrupt_handler(void) __interrupt ((0x004b - 3) / 8)
 void hop_timer_handler(void) __interrupt ((0x002b - 3) / 8)
 {
     IRCON_tf2 = 0;          // Clear the interrupt flag
-    TIMER2 = TIMER_VALUE_US(HOP_TIME_IN_US);
+    TIMER2 = hop_timer_reload;
 
     perform_hop_requested = true;
 }
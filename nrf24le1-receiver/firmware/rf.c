@@ -6,7 +6,21 @@
 #include <spi.h>
 #include <rf.h>
 
-static __xdata uint8_t spi_buffer[RF_MAX_BUFFER_LENGTH + 1];
+// RAM copy of the configuration registers of the nRF24, so that reading
+// them and writing an unchanged value takes no SPI transaction. Of the
+// multi-byte registers only the address of pipe 0 is kept, which
+// restart_packet_receiving() writes on every reacquisition.
+#define SHADOW_REGISTERS (RX_PW_P5 + 1)
+#define SHADOW_ADDRESS_WIDTH 5
+
+static __xdata uint8_t shadow[SHADOW_REGISTERS];
+static __xdata bool shadow_valid[SHADOW_REGISTERS];
+static __xdata uint8_t shadow_rx_address[SHADOW_ADDRESS_WIDTH];
+static uint8_t shadow_rx_address_width;     // 0 if not known
+
+// RF_CH values for rf_hop(), set by rf_set_hop_channels()
+static __xdata uint8_t hop_channels[RF_MAX_HOP_CHANNELS];
+static uint8_t number_of_hop_channels;
 
 
 // ****************************************************************************
@@ -35,8 +49,7 @@ static uint8_t get_pipe_no(uint8_t pipe)
 // ****************************************************************************
 static uint8_t rf_command(uint8_t cmd)
 {
-    spi_buffer[0] = cmd;
-    return spi_transaction(1, spi_buffer);
+    return spi_transaction(cmd, 0, NULL, NULL);
 }
 
 
@@ -46,18 +59,7 @@ static uint8_t rf_command(uint8_t cmd)
 // ****************************************************************************
 static uint8_t rf_write_command_buffer(uint8_t cmd, uint8_t count, const uint8_t *buffer)
 {
-    uint8_t i;
-
-    if (count > RF_MAX_BUFFER_LENGTH) {
-        count = RF_MAX_BUFFER_LENGTH;
-    }
-
-    spi_buffer[0] = cmd;
-    for (i = 0; i < count; i++) {
-        spi_buffer[i + 1] = buffer[i];
-    }
-
-    return spi_transaction(count + 1, spi_buffer);
+    return spi_transaction(cmd, count, buffer, NULL);
 }
 
 
@@ -67,38 +69,23 @@ static uint8_t rf_write_command_buffer(uint8_t cmd, uint8_t count, const uint8_t
 // ****************************************************************************
 static uint8_t rf_read_command_buffer(uint8_t cmd, uint8_t count, uint8_t *buffer)
 {
-    uint8_t i;
-
-    if (count > RF_MAX_BUFFER_LENGTH) {
-        count = RF_MAX_BUFFER_LENGTH;
-    }
-
-    spi_buffer[0] = cmd;
-
-    spi_transaction(count + 1, spi_buffer);
-
-    for (i = 0; i < count; i++) {
-        buffer[i] = spi_buffer[i + 1];
-    }
-
-    return spi_buffer[0];
+    return spi_transaction(cmd, count, NULL, buffer);
 }
 
 
 // ****************************************************************************
-static uint8_t rf_read_register(uint8_t reg)
+static uint8_t rf_read_register_spi(uint8_t reg)
 {
-    spi_buffer[0] = R_REGISTER | reg;
-    spi_buffer[1] = 0;
+    uint8_t value;
 
-    spi_transaction(2, spi_buffer);
+    spi_transaction(R_REGISTER | reg, 1, NULL, &value);
 
-    return spi_buffer[1];
+    return value;
 }
 
 
 // ****************************************************************************
-static void rf_write_register(uint8_t reg, uint8_t value)
+static uint8_t rf_write_register_spi(uint8_t reg, uint8_t value)
 {
     // Data sheet page 52: The nRF24L01+ must be in a standby or power down mode
     // before writing to the configuration registers.
@@ -111,10 +98,7 @@ static void rf_write_register(uint8_t reg, uint8_t value)
     //
     // It is left to the user of this library to set/clear CE properly.
 
-    spi_buffer[0] = W_REGISTER | reg;
-    spi_buffer[1] = value;
-
-    spi_transaction(2, spi_buffer);
+    return spi_transaction(W_REGISTER | reg, 1, &value, NULL);
 }
 
 
@@ -125,18 +109,78 @@ static void rf_write_register(uint8_t reg, uint8_t value)
 // ****************************************************************************
 static uint8_t rf_write_multi_byte_register(uint8_t reg, uint8_t count, const uint8_t *buffer)
 {
-    uint8_t i;
+    return spi_transaction(W_REGISTER | reg, count, buffer, NULL);
+}
+
 
-    if (count > RF_MAX_BUFFER_LENGTH) {
-        count = RF_MAX_BUFFER_LENGTH;
+// ****************************************************************************
+// Registers that are only changed by writing them are kept in the shadow.
+// STATUS, OBSERVE_TX and RPD are changed by the nRF24 itself; the addresses
+// are multi-byte registers.
+// ****************************************************************************
+static bool is_shadowed(uint8_t reg)
+{
+    if (reg >= SHADOW_REGISTERS) {
+        return false;
     }
 
-    spi_buffer[0] = W_REGISTER | reg;
-    for (i = 0; i < count; i++) {
-        spi_buffer[i + 1] = buffer[i];
+    if (reg >= RX_ADDR_P0 && reg <= TX_ADDR) {
+        return false;
+    }
+
+    return reg != STATUS && reg != OBSERVE_TX && reg != RPD;
+}
+
+
+// ****************************************************************************
+static uint8_t rf_read_register(uint8_t reg)
+{
+    if (!is_shadowed(reg)) {
+        return rf_read_register_spi(reg);
+    }
+
+    if (!shadow_valid[reg]) {
+        shadow[reg] = rf_read_register_spi(reg);
+        shadow_valid[reg] = true;
+    }
+    return shadow[reg];
+}
+
+
+// ****************************************************************************
+// Writing the value that a register already holds is skipped
+// ****************************************************************************
+static void rf_write_register(uint8_t reg, uint8_t value)
+{
+    if (is_shadowed(reg)) {
+        if (shadow_valid[reg] && shadow[reg] == value) {
+            return;
+        }
+        shadow[reg] = value;
+        shadow_valid[reg] = true;
+    }
+
+    rf_write_register_spi(reg, value);
+}
+
+
+// ****************************************************************************
+// Returns true if the shadow holds the given address for pipe 0
+// ****************************************************************************
+static bool is_rx_address_shadowed(uint8_t address_width, const uint8_t address[])
+{
+    uint8_t i;
+
+    if (address_width != shadow_rx_address_width) {
+        return false;
     }
 
-    return spi_transaction(count + 1, spi_buffer);
+    for (i = 0; i < address_width; i++) {
+        if (address[i] != shadow_rx_address[i]) {
+            return false;
+        }
+    }
+    return true;
 }
 
 
@@ -189,6 +233,7 @@ void rf_clear_ce(void)
 void rf_set_rx_address(uint8_t pipe, uint8_t address_width, const uint8_t address[])
 {
     uint8_t pipe_no;
+    uint8_t i;
 
     pipe_no = get_pipe_no(pipe);
 
@@ -198,6 +243,20 @@ void rf_set_rx_address(uint8_t pipe, uint8_t address_width, const uint8_t addres
         address_width = 1;
     }
 
+    if (pipe_no == 0) {
+        if (is_rx_address_shadowed(address_width, address)) {
+            return;
+        }
+
+        shadow_rx_address_width = 0;
+        if (address_width <= SHADOW_ADDRESS_WIDTH) {
+            for (i = 0; i < address_width; i++) {
+                shadow_rx_address[i] = address[i];
+            }
+            shadow_rx_address_width = address_width;
+        }
+    }
+
     rf_write_multi_byte_register(RX_ADDR_P0 + pipe_no, address_width, address);
 }
 
@@ -215,12 +274,60 @@ void rf_set_channel(uint8_t channel)
 }
 
 
+// ****************************************************************************
+// Store the RF_CH values of the given hop channels, so that a hop is a
+// single SPI transaction straight from this table.
+// ****************************************************************************
+void rf_set_hop_channels(uint8_t count, const uint8_t channels[])
+{
+    uint8_t i;
+
+    if (count > RF_MAX_HOP_CHANNELS) {
+        count = RF_MAX_HOP_CHANNELS;
+    }
+
+    for (i = 0; i < count; i++) {
+        hop_channels[i] = channels[i] & 0x7f;
+    }
+    number_of_hop_channels = count;
+}
+
+
+// ****************************************************************************
+// Tune to the hop channel with the given index: CE low, the RF_CH value of
+// rf_set_hop_channels(), CE high. Nothing is sent if the nRF24 is already
+// on that channel.
+//
+// The nRF24LE1 has no timer to spare for the CE to CSN delay, so
+// rf_set_ce() still waits for it.
+// ****************************************************************************
+void rf_hop(uint8_t hop_index)
+{
+    uint8_t channel;
+
+    if (hop_index >= number_of_hop_channels) {
+        return;
+    }
+
+    channel = hop_channels[hop_index];
+    if (shadow_valid[RF_CH] && shadow[RF_CH] == channel) {
+        return;
+    }
+    shadow[RF_CH] = channel;
+    shadow_valid[RF_CH] = true;
+
+    rf_clear_ce();
+    spi_transaction(W_REGISTER | RF_CH, 1, &hop_channels[hop_index], NULL);
+    rf_set_ce();
+}
+
+
 // ****************************************************************************
 // Return true if the receiver FIFO is empty
 // ****************************************************************************
 bool rf_is_rx_fifo_emtpy(void)
 {
-    return (rf_get_status() & 0x0e) == 0x0e;
+    return RF_IS_RX_FIFO_EMPTY(rf_get_status());
 }
 
 
@@ -229,30 +336,33 @@ bool rf_is_rx_fifo_emtpy(void)
 // ****************************************************************************
 bool rf_is_tx_fifo_full(void)
 {
-    return rf_get_status() & 0x01;
+    return rf_get_status() & TX_FULL;
 }
 
 
 // ****************************************************************************
-// Read one packet from the receive FIFO
+// Read one packet from the receive FIFO, straight into the buffer.
+// Returns the STATUS register value from before the read, so
+// RF_IS_RX_FIFO_EMPTY() tells whether there was a packet. If there was none
+// the buffer contents are undefined.
 // ****************************************************************************
-void rf_read_fifo(uint8_t *buffer, size_t byte_count)
+uint8_t rf_read_fifo(uint8_t *buffer, size_t byte_count)
 {
-    rf_read_command_buffer(R_RX_PAYLOAD, byte_count, buffer);
+    return rf_read_command_buffer(R_RX_PAYLOAD, byte_count, buffer);
 }
 
 
 // ****************************************************************************
-void rf_flush_rx_fifo(void)
+uint8_t rf_flush_rx_fifo(void)
 {
-    rf_command(FLUSH_RX);
+    return rf_command(FLUSH_RX);
 }
 
 
 // ****************************************************************************
-void rf_flush_tx_fifo(void)
+uint8_t rf_flush_tx_fifo(void)
 {
-    rf_command(FLUSH_TX);
+    return rf_command(FLUSH_TX);
 }
 
 
@@ -291,10 +401,14 @@ void rf_set_irq_source(uint8_t irq_source)
 //  MAX_RT: Clear "maximum retries" interrupt flag
 //
 // Multiple values can be or'ed together.
+//
+// Returns the STATUS register value from before clearing. Called after
+// rf_read_fifo(), its RX_P_NO tells whether more packets are waiting.
 // ****************************************************************************
-void rf_clear_irq(uint8_t irq_source)
+uint8_t rf_clear_irq(uint8_t irq_source)
 {
-    rf_write_register(STATUS, irq_source & 0x70);
+    // STATUS is not shadowed, so this always reaches the nRF24
+    return rf_write_register_spi(STATUS, irq_source & 0x70);
 }
 
 
@@ -489,3 +603,47 @@ void rf_enable_receiver(void)
     }
 }
 
+
+// ****************************************************************************
+// Compare the registers of the nRF24 with the shadow and write back those
+// that differ, e.g. after a brown-out has reset the nRF24 but not the MCU.
+// CE must be low. Returns true if all registers held the expected value.
+// ****************************************************************************
+bool rf_verify_registers(void)
+{
+    uint8_t address[SHADOW_ADDRESS_WIDTH];
+    uint8_t reg;
+    uint8_t value;
+    bool powered = true;
+    bool match = true;
+
+    for (reg = 0; reg < SHADOW_REGISTERS; reg++) {
+        if (!is_shadowed(reg) || !shadow_valid[reg]) {
+            continue;
+        }
+
+        value = rf_read_register_spi(reg);
+        if (value != shadow[reg]) {
+            if (reg == CONFIG && !(value & PWR_UP)) {
+                powered = false;
+            }
+            rf_write_register_spi(reg, shadow[reg]);
+            match = false;
+        }
+    }
+
+    if (shadow_rx_address_width) {
+        rf_read_command_buffer(R_REGISTER | RX_ADDR_P0, shadow_rx_address_width, address);
+        if (!is_rx_address_shadowed(shadow_rx_address_width, address)) {
+            rf_write_multi_byte_register(RX_ADDR_P0, shadow_rx_address_width, shadow_rx_address);
+            match = false;
+        }
+    }
+
+    // Same as in rf_enable_receiver(): Tpd2stby before CE may go high
+    if (!powered && (shadow[CONFIG] & PWR_UP)) {
+        delay_us(4500);
+    }
+
+    return match;
+}
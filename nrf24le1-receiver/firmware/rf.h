@@ -7,6 +7,7 @@
 #include <stdbool.h>
 
 #define RF_MAX_BUFFER_LENGTH 32
+#define RF_MAX_HOP_CHANNELS 20
 
 
 //******************************************************************************
@@ -46,6 +47,9 @@
     #define RF_DR_HIGH  (1 << 3)
 
 #define STATUS          0x07        // Status
+    #define TX_FULL     (1 << 0)    // TX FIFO full
+    #define RX_P_NO     (7 << 1)    // Data pipe of the payload at the RX FIFO head
+    #define RX_P_NO_EMPTY (7 << 1)  // RX_P_NO value when the RX FIFO is empty
 #define OBSERVE_TX      0x08        // Observe TX
 #define RPD             0x09        // Received Power Detector
 #define RX_ADDR_P0      0x0a        // RX address pipe0
@@ -86,6 +90,11 @@
 #define NO_AUTO_ACKNOWLEDGE 0
 
 
+// Every SPI transaction returns the STATUS register, sampled before the
+// command executes
+#define RF_IS_RX_FIFO_EMPTY(status) (((status) & RX_P_NO) == RX_P_NO_EMPTY)
+
+
 //******************************************************************************
 void rf_enable_clock(void);
 void rf_disable_clock(void);
@@ -96,18 +105,20 @@ uint8_t rf_get_status(void);
 
 bool rf_is_rx_fifo_emtpy(void);
 bool rf_is_tx_fifo_full(void);
-void rf_read_fifo(uint8_t *buffer, size_t byte_count);
-void rf_flush_rx_fifo(void);
-void rf_flush_tx_fifo(void);
+uint8_t rf_read_fifo(uint8_t *buffer, size_t byte_count);
+uint8_t rf_flush_rx_fifo(void);
+uint8_t rf_flush_tx_fifo(void);
 
 void rf_set_irq_source(uint8_t irq_source);
-void rf_clear_irq(uint8_t irq_source);
+uint8_t rf_clear_irq(uint8_t irq_source);
 
 void rf_enable_transmitter(void);
 void rf_enable_receiver(void);
 void rf_power_down(void);
 
 void rf_set_channel(uint8_t channel);
+void rf_set_hop_channels(uint8_t count, const uint8_t channels[]);
+void rf_hop(uint8_t hop_index);
 void rf_set_crc(uint8_t crc_size);
 void rf_set_data_rate(uint8_t data_rate);
 void rf_set_address_width(uint8_t aw);
@@ -116,4 +127,6 @@ void rf_set_data_pipes(uint8_t pipes, uint8_t auto_acknowledge_pipes);
 void rf_set_payload_size(uint8_t pipes, uint8_t payload_size);
 void rf_set_rx_address(uint8_t pipe, uint8_t address_width, const uint8_t address[]);
 
+bool rf_verify_registers(void);
+
 #endif
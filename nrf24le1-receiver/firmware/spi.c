@@ -14,24 +14,40 @@ void init_spi(void)
 
 
 // ****************************************************************************
-uint8_t spi_transaction(uint8_t count, uint8_t __xdata *buffer)
+// Send the command byte, followed by count data bytes from tx_data, or zeros
+// if tx_data is NULL. The bytes received for the data go to rx_data unless
+// it is NULL, so payloads need no staging buffer.
+// Returns the STATUS register value, received with the command byte.
+// ****************************************************************************
+uint8_t spi_transaction(uint8_t command, uint8_t count,
+    const uint8_t *tx_data, uint8_t *rx_data)
 {
-    uint8_t __xdata *ptr = buffer;
+    uint8_t status;
+    uint8_t value;
 
     RFCON_rfcsn = 0;
 
+    SPIRDAT = command;
+
+    // Wait for SPIF
+    while (!(SPIRSTAT & 0x02));
+
+    status = SPIRDAT;
+
     while (count--) {
-        SPIRDAT = *ptr;
+        SPIRDAT = tx_data ? *tx_data++ : 0;
 
         // Wait for SPIF
         while (!(SPIRSTAT & 0x02));
 
-        *ptr = SPIRDAT;
-        ++ptr;
+        value = SPIRDAT;
+        if (rx_data) {
+            *rx_data++ = value;
+        }
     }
 
     RFCON_rfcsn = 1;
 
-    return *buffer;
+    return status;
 }
 
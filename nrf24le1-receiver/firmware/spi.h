@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 void init_spi(void);
-uint8_t spi_transaction(uint8_t count, uint8_t __xdata *buffer);
+uint8_t spi_transaction(uint8_t command, uint8_t count,
+    const uint8_t *tx_data, uint8_t *rx_data);
 
 #endif
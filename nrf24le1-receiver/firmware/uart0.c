@@ -8,6 +8,16 @@
 
 #define NO_LEADING_ZEROS (0)
 
+#ifndef BAUDRATE
+    #define BAUDRATE 38400
+#endif
+
+// Baudrate generator with SMOD set:
+//     BAUDRATE = 2 * __SYSTEM_CLOCK / (64 * (1024 - S0REL))
+// At 16 MHz this gives 38461 baud for 38400, and exactly 125000 baud.
+#define S0REL_VALUE (1024 - \
+    (2UL * __SYSTEM_CLOCK + 32UL * BAUDRATE) / (64UL * BAUDRATE))
+
 
 // #define RECEIVE_BUFFER_SIZE (16)        // Must be modulo 2 for speed
 // #define RECEIVE_BUFFER_INDEX_MASK (RECEIVE_BUFFER_SIZE - 1)
@@ -78,8 +88,8 @@ void init_uart0(void)
     PCON |= 0x80;           // set SMOD bit
     ADCON_bd = 1;           // Sed BD bit
 
-    S0RELH = 0x03;
-    S0RELL = 0xf3;
+    S0RELH = S0REL_VALUE >> 8;
+    S0RELL = S0REL_VALUE & 0xff;
 
     S0CON_ti0 = 1;          // Set "Tx data was sent" flag
 }
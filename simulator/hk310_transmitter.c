@@ -0,0 +1,180 @@
+/******************************************************************************
+
+    Model of the HK310 / Turnigy 3XS transmitter as described in
+    doc/hkr3000-info.md.
+
+    Every 5 ms the transmitter hops to the next of the 20 hop channels and
+    sends two stick packets (or a stick and a failsafe packet) on it, plus
+    one bind packet on the fixed bind channel 0x51.
+
+    The position of the packets within the 5 ms slot has not been measured;
+    the offsets below are an assumption that spreads the three packets
+    evenly. The crystal drift of the transmitter is applied to the whole
+    schedule.
+
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include <hk310_transmitter.h>
+
+
+// Start of the packets relative to the start of the hop slot
+#define STICK_PACKET_1_OFFSET_US 200
+#define STICK_PACKET_2_OFFSET_US 1800
+#define BIND_PACKET_OFFSET_US 3400
+#define PACKETS_PER_HOP 3
+
+// Every FAILSAFE_INTERVAL hops the second stick packet is a failsafe packet
+#define FAILSAFE_INTERVAL 8
+
+#define STICK_CENTER 0xf82b
+#define STICK_AMPLITUDE 0x300
+
+
+static const uint8_t BIND_ADDRESS[HK310_ADDRESS_WIDTH] = {0x12, 0x23, 0x23, 0x45, 0x78};
+static const uint32_t PACKET_OFFSETS[PACKETS_PER_HOP] = {
+    STICK_PACKET_1_OFFSET_US, STICK_PACKET_2_OFFSET_US, BIND_PACKET_OFFSET_US
+};
+
+static uint8_t address[HK310_ADDRESS_WIDTH];
+static uint8_t hop_data[HK310_NUMBER_OF_HOP_CHANNELS];
+static uint16_t checksum;
+
+static uint64_t start_time;
+static double hop_time;
+static uint64_t hop_count;
+static unsigned int packet_in_hop;
+static unsigned int bind_packet_index;
+
+
+// ****************************************************************************
+// Stick values are always odd so they can never match the failsafe value
+// ****************************************************************************
+static uint16_t get_stick_value(uint64_t time_us, double period_s)
+{
+    double angle = 2.0 * M_PI * (time_us / 1e6) / period_s;
+
+    return ((uint16_t)(STICK_CENTER + STICK_AMPLITUDE * sin(angle))) | 1;
+}
+
+
+// ****************************************************************************
+static void put_stick(uint8_t *payload, unsigned int index, uint16_t value)
+{
+    payload[index * 2] = value & 0xff;
+    payload[index * 2 + 1] = value >> 8;
+}
+
+
+// ****************************************************************************
+static void build_bind_packet(uint8_t *payload)
+{
+    unsigned int i;
+
+    memset(payload, 0, HK310_PAYLOAD_SIZE);
+
+    if (bind_packet_index == 0) {
+        payload[0] = 0xff;
+        payload[1] = 0xaa;
+        payload[2] = 0x55;
+        for (i = 0; i < HK310_ADDRESS_WIDTH; i++) {
+            payload[3 + i] = address[i];
+        }
+    }
+    else {
+        payload[0] = checksum & 0xff;
+        payload[1] = checksum >> 8;
+        payload[2] = bind_packet_index - 1;
+        for (i = 0; i < 7; i++) {
+            unsigned int hop = (bind_packet_index - 1) * 7 + i;
+
+            if (hop < HK310_NUMBER_OF_HOP_CHANNELS) {
+                payload[3 + i] = hop_data[hop];
+            }
+        }
+    }
+
+    bind_packet_index = (bind_packet_index + 1) % 4;
+}
+
+
+// ****************************************************************************
+void hk310_init(const uint8_t *bind_data, uint64_t start_time_us,
+    double drift_ppm)
+{
+    unsigned int i;
+
+    memcpy(address, bind_data, HK310_ADDRESS_WIDTH);
+    memcpy(hop_data, &bind_data[HK310_ADDRESS_WIDTH],
+        HK310_NUMBER_OF_HOP_CHANNELS);
+
+    checksum = 0;
+    for (i = 0; i < HK310_ADDRESS_WIDTH; i++) {
+        checksum += address[i];
+    }
+
+    start_time = start_time_us;
+    hop_time = HK310_HOP_TIME_US * (1.0 + drift_ppm / 1e6);
+    hop_count = 0;
+    packet_in_hop = 0;
+    bind_packet_index = 0;
+}
+
+
+// ****************************************************************************
+// Returns the next packet the transmitter sends, in chronological order
+// ****************************************************************************
+void hk310_next_packet(hk310_packet_t *packet, uint32_t airtime_us)
+{
+    uint64_t slot_start;
+
+    slot_start = start_time + (uint64_t)(hop_count * hop_time);
+
+    packet->time_us = slot_start + PACKET_OFFSETS[packet_in_hop] + airtime_us;
+    packet->hop_index = hop_count % HK310_NUMBER_OF_HOP_CHANNELS;
+
+    if (packet_in_hop == 2) {
+        packet->type = HK310_PACKET_BIND;
+        packet->channel = HK310_BIND_CHANNEL;
+        packet->address = BIND_ADDRESS;
+        build_bind_packet(packet->payload);
+    }
+    else {
+        packet->channel = hop_data[packet->hop_index];
+        packet->address = address;
+
+        put_stick(packet->payload, 0, get_stick_value(packet->time_us, 2.0));
+        put_stick(packet->payload, 1, get_stick_value(packet->time_us, 3.1));
+        put_stick(packet->payload, 2, STICK_CENTER | 1);
+        packet->payload[6] = 0xb8;
+        packet->payload[9] = 0x0f;
+
+        if (packet_in_hop == 1 && (hop_count % FAILSAFE_INTERVAL) == 0) {
+            packet->type = HK310_PACKET_FAILSAFE;
+            put_stick(packet->payload, 0, HK310_FAILSAFE_STICK_VALUE);
+            put_stick(packet->payload, 1, HK310_FAILSAFE_STICK_VALUE);
+            packet->payload[7] = 0xaa;
+            packet->payload[8] = 0x5a;
+        }
+        else {
+            packet->type = HK310_PACKET_STICK;
+            packet->payload[7] = 0x55;
+            packet->payload[8] = 0x67;
+        }
+    }
+
+    if (++packet_in_hop == PACKETS_PER_HOP) {
+        packet_in_hop = 0;
+        ++hop_count;
+    }
+}
+
+
+// ****************************************************************************
+const uint8_t *hk310_get_bind_address(void)
+{
+    return BIND_ADDRESS;
+}
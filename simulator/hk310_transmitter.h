@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HK310_PAYLOAD_SIZE 10
+#define HK310_ADDRESS_WIDTH 5
+#define HK310_NUMBER_OF_HOP_CHANNELS 20
+#define HK310_BIND_DATA_SIZE (HK310_ADDRESS_WIDTH + HK310_NUMBER_OF_HOP_CHANNELS)
+#define HK310_HOP_TIME_US 5000
+#define HK310_BIND_CHANNEL 0x51
+
+#define HK310_PACKET_STICK 0
+#define HK310_PACKET_FAILSAFE 1
+#define HK310_PACKET_BIND 2
+
+// The stick values sent in failsafe packets. The simulated sticks never
+// reach these values, so the receiver outputs can be used to detect failsafe.
+#define HK310_FAILSAFE_STICK_VALUE 0xf840
+
+
+typedef struct {
+    uint64_t time_us;           // Time at which the transmission ends
+    uint8_t type;
+    uint8_t channel;
+    uint8_t hop_index;
+    const uint8_t *address;
+    uint8_t payload[HK310_PAYLOAD_SIZE];
+} hk310_packet_t;
+
+
+void hk310_init(const uint8_t *bind_data, uint64_t start_time_us,
+    double drift_ppm);
+void hk310_next_packet(hk310_packet_t *packet, uint32_t airtime_us);
+
+const uint8_t *hk310_get_bind_address(void);
@@ -0,0 +1,441 @@
+/******************************************************************************
+
+    RF link simulator
+
+    Runs the receiver firmware against the HK310 transmitter model on a
+    virtual clock and measures how quickly the receiver acquires the hop
+    sequence:
+
+    - time to first lock: from receiver power-on (with the transmitter
+      already running at a random point of its hop sequence) until the first
+      stick data is output
+    - reacquisition time: from the end of a dropout (all packets lost)
+      until the firmware reads the next packet from the radio
+    - failsafe entries per hour
+
+    The link can be degraded by random packet loss, burst interference that
+    blocks a range of RF channels for some time, periodic dropouts and
+    transmitter crystal drift. All randomness comes from a seeded generator,
+    so results are reproducible.
+
+    Usage: see usage() below
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <nrf24l01.h>
+#include <hk310_transmitter.h>
+#include <port.h>
+#include <prng.h>
+#include <simulation.h>
+
+
+#define NUMBER_OF_CHANNELS 3
+#define MAX_BURSTS 16
+
+
+typedef struct {
+    uint64_t end_time;
+    int first_channel;
+    int last_channel;
+} burst_t;
+
+typedef struct {
+    unsigned int count;
+    double sum;
+    double max;
+} statistic_t;
+
+typedef struct {
+    statistic_t lock_time;
+    statistic_t reacquisition_time;
+    unsigned int failsafe_entries;
+    unsigned int packets_sent;
+    unsigned int packets_read;
+} results_t;
+
+
+extern uint16_t channels[NUMBER_OF_CHANNELS];
+extern bool successful_stick_data;
+
+static const uint8_t BIND_DATA[HK310_BIND_DATA_SIZE] = {
+    0x2a, 0x91, 0x3c, 0x5e, 0x07,
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27
+};
+
+// Simulation parameters
+static double duration_s = 60.0;
+static unsigned int runs = 10;
+static double loss_percent;
+static double drift_ppm;
+static double burst_rate;
+static double burst_length_ms;
+static int burst_width;
+static double dropout_period_s;
+static double dropout_length_ms;
+static uint64_t seed = 1;
+static bool verbose;
+
+static burst_t bursts[MAX_BURSTS];
+static uint64_t next_burst_time;
+
+static results_t results;
+
+// State of the current run
+static unsigned int current_run;
+static bool locked;
+static bool in_failsafe;
+static bool waiting_for_reacquisition;
+static uint64_t dropout_end_time;
+static unsigned int last_payloads_read;
+
+
+// ****************************************************************************
+static void add_sample(statistic_t *statistic, double value)
+{
+    ++statistic->count;
+    statistic->sum += value;
+    if (value > statistic->max) {
+        statistic->max = value;
+    }
+}
+
+
+// ****************************************************************************
+static void merge_statistic(statistic_t *total, const statistic_t *statistic)
+{
+    total->count += statistic->count;
+    total->sum += statistic->sum;
+    if (statistic->max > total->max) {
+        total->max = statistic->max;
+    }
+}
+
+
+// ****************************************************************************
+static void print_statistic(const char *name, const statistic_t *statistic)
+{
+    if (statistic->count == 0) {
+        printf("%-36s n/a\n", name);
+        return;
+    }
+
+    printf("%-36s mean %7.1f ms   max %7.1f ms   (n=%u)\n", name,
+        statistic->sum / statistic->count, statistic->max, statistic->count);
+}
+
+
+// ****************************************************************************
+static bool is_in_dropout(uint64_t time_us)
+{
+    uint64_t period = dropout_period_s * 1e6;
+    uint64_t length = dropout_length_ms * 1e3;
+
+    if (period == 0 || length == 0 || time_us < SIMULATION_POWER_ON_TIME_US) {
+        return false;
+    }
+
+    return ((time_us - SIMULATION_POWER_ON_TIME_US) % period) >= (period - length);
+}
+
+
+// ****************************************************************************
+// Start new interference bursts up to the given time, and return whether the
+// channel is blocked by one of the active bursts.
+// ****************************************************************************
+static bool is_interfered(uint64_t time_us, uint8_t channel)
+{
+    unsigned int i;
+
+    if (burst_rate <= 0) {
+        return false;
+    }
+
+    while (next_burst_time <= time_us) {
+        for (i = 0; i < MAX_BURSTS; i++) {
+            if (bursts[i].end_time <= next_burst_time) {
+                int first = prng_next() % (126 - burst_width + 1);
+
+                bursts[i].end_time = next_burst_time + burst_length_ms * 1e3;
+                bursts[i].first_channel = first;
+                bursts[i].last_channel = first + burst_width - 1;
+                break;
+            }
+        }
+        next_burst_time += prng_exponential(burst_rate) * 1e6;
+    }
+
+    for (i = 0; i < MAX_BURSTS; i++) {
+        if (bursts[i].end_time > time_us &&
+                channel >= bursts[i].first_channel &&
+                channel <= bursts[i].last_channel) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// ****************************************************************************
+// Decide whether a packet makes it through the channel
+// ****************************************************************************
+static bool is_packet_lost(const hk310_packet_t *packet)
+{
+    if (packet->type != HK310_PACKET_BIND) {
+        ++results.packets_sent;
+    }
+
+    if (is_in_dropout(packet->time_us)) {
+        dropout_end_time = packet->time_us;
+        waiting_for_reacquisition = true;
+        return true;
+    }
+
+    if (is_interfered(packet->time_us, packet->channel)) {
+        return true;
+    }
+
+    return prng_uniform() * 100.0 < loss_percent;
+}
+
+
+// ****************************************************************************
+static bool is_in_failsafe(void)
+{
+    uint16_t failsafe = port_stick_to_channel(HK310_FAILSAFE_STICK_VALUE);
+
+    return channels[0] == failsafe && channels[1] == failsafe;
+}
+
+
+// ****************************************************************************
+// Evaluate the state of the firmware after each main loop iteration
+// ****************************************************************************
+static void check_receiver(uint64_t now)
+{
+    nrf24l01_spi_statistics_t statistics;
+
+    nrf24l01_get_spi_statistics(&statistics);
+    if (statistics.payloads_read != last_payloads_read) {
+        results.packets_read += statistics.payloads_read - last_payloads_read;
+        last_payloads_read = statistics.payloads_read;
+
+        if (waiting_for_reacquisition && !is_in_dropout(now)) {
+            waiting_for_reacquisition = false;
+            add_sample(&results.reacquisition_time,
+                (now - dropout_end_time) / 1e3);
+        }
+    }
+
+    if (!locked && successful_stick_data) {
+        locked = true;
+        add_sample(&results.lock_time,
+            (now - SIMULATION_POWER_ON_TIME_US) / 1e3);
+        if (verbose) {
+            printf("Run %u: first lock after %.1f ms\n", current_run,
+                (now - SIMULATION_POWER_ON_TIME_US) / 1e3);
+        }
+    }
+
+    if (is_in_failsafe() != in_failsafe) {
+        in_failsafe = !in_failsafe;
+        if (in_failsafe) {
+            ++results.failsafe_entries;
+            if (verbose) {
+                printf("Run %u: failsafe at %.3f s\n", current_run,
+                    (now - SIMULATION_POWER_ON_TIME_US) / 1e6);
+            }
+        }
+    }
+}
+
+
+// ****************************************************************************
+// One run of the simulation, starting with a power-on reset of the receiver.
+//
+// The firmware keeps its state in static variables, so each run is executed
+// in a forked process where they all start out with their initial values,
+// just like after a real reset. The results are passed back through a pipe.
+// ****************************************************************************
+static void simulate_run(unsigned int run)
+{
+    current_run = run;
+    memset(&results, 0, sizeof(results));
+
+    memset(bursts, 0, sizeof(bursts));
+    next_burst_time = (burst_rate > 0) ?
+        prng_exponential(burst_rate) * 1e6 : UINT64_MAX;
+
+    // The transmitter was switched on at a random point in time before the
+    // receiver powers up, so the receiver finds it at a random hop.
+    simulation_init(BIND_DATA, prng_next() % SIMULATION_POWER_ON_TIME_US,
+        drift_ppm);
+    simulation_set_loss_callback(is_packet_lost);
+    simulation_set_main_loop_callback(check_receiver);
+
+    simulation_run(duration_s * 1e6);
+}
+
+
+// ****************************************************************************
+static void run_simulation(unsigned int run, results_t *total)
+{
+    results_t run_results;
+    int fds[2];
+    pid_t pid;
+    int status;
+
+    // Advance the generator in the parent so every run gets its own
+    // random sequence
+    prng_next();
+
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        exit(1);
+    }
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        simulate_run(run);
+        fflush(stdout);
+        if (write(fds[1], &results, sizeof(results)) != sizeof(results)) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    if (read(fds[0], &run_results, sizeof(run_results)) !=
+            sizeof(run_results)) {
+        fprintf(stderr, "Run %u failed\n", run);
+        exit(1);
+    }
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    merge_statistic(&total->lock_time, &run_results.lock_time);
+    merge_statistic(&total->reacquisition_time,
+        &run_results.reacquisition_time);
+    total->failsafe_entries += run_results.failsafe_entries;
+    total->packets_sent += run_results.packets_sent;
+    total->packets_read += run_results.packets_read;
+}
+
+
+// ****************************************************************************
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -t seconds          Duration of each run (default 60)\n"
+        "  -r runs             Number of runs (default 10)\n"
+        "  -l percent          Random packet loss\n"
+        "  -c ppm              Transmitter crystal drift\n"
+        "  -i rate,ms,width    Interference bursts: bursts per second,\n"
+        "                      burst length and number of RF channels blocked\n"
+        "  -d seconds,ms       Dropout of the given length every n seconds\n"
+        "  -s seed             Seed for the random generator (default 1)\n"
+        "  -v                  Print events of each run\n", name);
+    exit(1);
+}
+
+
+// ****************************************************************************
+int main(int argc, char *argv[])
+{
+    results_t total;
+    double hours;
+    unsigned int run;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:r:l:c:i:d:s:v")) != -1) {
+        switch (opt) {
+            case 't':
+                duration_s = atof(optarg);
+                break;
+
+            case 'r':
+                runs = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'l':
+                loss_percent = atof(optarg);
+                break;
+
+            case 'c':
+                drift_ppm = atof(optarg);
+                break;
+
+            case 'i':
+                if (sscanf(optarg, "%lf,%lf,%d", &burst_rate, &burst_length_ms,
+                        &burst_width) != 3 || burst_width < 1 ||
+                        burst_width > 126) {
+                    usage(argv[0]);
+                }
+                break;
+
+            case 'd':
+                if (sscanf(optarg, "%lf,%lf", &dropout_period_s,
+                        &dropout_length_ms) != 2) {
+                    usage(argv[0]);
+                }
+                break;
+
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+
+            case 'v':
+                verbose = true;
+                break;
+
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    prng_seed(seed);
+    memset(&total, 0, sizeof(total));
+
+    for (run = 0; run < runs; run++) {
+        run_simulation(run, &total);
+    }
+
+    hours = runs * duration_s / 3600.0;
+
+    printf("\n%u runs of %.0f s; loss %.1f %%, drift %.0f ppm", runs,
+        duration_s, loss_percent, drift_ppm);
+    if (burst_rate > 0) {
+        printf(", %.2f bursts/s of %.0f ms over %d channels", burst_rate,
+            burst_length_ms, burst_width);
+    }
+    if (dropout_period_s > 0) {
+        printf(", %.0f ms dropout every %.0f s", dropout_length_ms,
+            dropout_period_s);
+    }
+    printf("\n\n");
+
+    print_statistic("Time to first lock", &total.lock_time);
+    print_statistic("Reacquisition after dropout", &total.reacquisition_time);
+    printf("%-36s %u (%.1f per hour)\n", "Failsafe entries",
+        total.failsafe_entries, total.failsafe_entries / hours);
+    printf("%-36s %u of %u (%.1f %%)\n", "Packets read by the firmware",
+        total.packets_read, total.packets_sent, total.packets_sent ?
+        100.0 * total.packets_read / total.packets_sent : 0.0);
+
+    return 0;
+}
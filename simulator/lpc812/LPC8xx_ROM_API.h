@@ -0,0 +1,15 @@
+#pragma once
+
+/******************************************************************************
+
+    Host replacement for LPC8xx_ROM_API.h, which main.c includes for the
+    IAP entry point.
+
+    The original defines iap_entry as a constant pointing into the boot
+    ROM. Here it is a variable, defined by the MCU model of the LPC812
+    (lpc812_mcu.c) as its model of the flash programming IAP commands.
+
+******************************************************************************/
+
+typedef void (* IAP)(unsigned int [], unsigned int[]);
+extern IAP iap_entry;
@@ -0,0 +1,124 @@
+#pragma once
+
+/******************************************************************************
+
+    Host replacement for the CMSIS Cortex-M0+ core header, which is included
+    by LPC8xx.h.
+
+    Only what the LPC812 firmware uses is provided: the SysTick registers
+    (as an ordinary variable), the NVIC functions and the interrupt and
+    barrier intrinsics. In the MCU model build (MCU_MODEL) they drive the
+    interrupt controller of mcu.c; otherwise they do nothing.
+
+******************************************************************************/
+#include <stdint.h>
+
+#ifdef MCU_MODEL
+#include <mcu.h>
+#endif
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t LOAD;
+    __IO uint32_t VAL;
+    __I  uint32_t CALIB;
+} SysTick_Type;
+
+extern SysTick_Type host_systick;
+#define SysTick (&host_systick)
+
+
+#ifdef MCU_MODEL
+
+// ****************************************************************************
+static inline void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    mcu_enable_irq(IRQn);
+}
+
+
+// ****************************************************************************
+static inline void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    mcu_disable_irq(IRQn);
+}
+
+
+// ****************************************************************************
+static inline void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    mcu_set_priority(IRQn, priority);
+}
+
+
+// ****************************************************************************
+static inline void __enable_irq(void)
+{
+    mcu_enable_interrupts();
+}
+
+
+// ****************************************************************************
+static inline void __disable_irq(void)
+{
+    mcu_disable_interrupts();
+}
+
+#else
+
+// ****************************************************************************
+static inline void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    (void) IRQn;
+}
+
+
+// ****************************************************************************
+static inline void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    (void) IRQn;
+}
+
+
+// ****************************************************************************
+static inline void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    (void) IRQn;
+    (void) priority;
+}
+
+
+// ****************************************************************************
+static inline void __enable_irq(void)
+{
+}
+
+
+// ****************************************************************************
+static inline void __disable_irq(void)
+{
+}
+
+#endif
+
+
+// ****************************************************************************
+// The firmware uses it to order its own accesses to data shared with the
+// interrupt handlers, so it must keep the compiler from reordering them
+// ****************************************************************************
+static inline void __DMB(void)
+{
+    __asm__ volatile ("" ::: "memory");
+}
+
+
+// ****************************************************************************
+static inline void __DSB(void)
+{
+}
+
+
+// ****************************************************************************
+static inline void __ISB(void)
+{
+}
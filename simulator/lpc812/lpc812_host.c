@@ -0,0 +1,561 @@
+/******************************************************************************
+
+    Host stand-ins for the parts of the LPC812 firmware that talk directly
+    to hardware and are not part of what we want to measure: the register
+    blocks, delay_us(), get_timestamp_us(), ISP entry, flash storage and
+    the SPI driver.
+
+    spi_transaction() is routed to the nRF24L01+ model. spi_submit() runs
+    the job on the spot, as if the SPI0 interrupt had completed it before
+    returning.
+
+    Also implements the port interface (port.h) for the simulation tools:
+    SCTimer counter L (the hop timer) and the SysTick are advanced on the
+    virtual clock, and the main loop is run the same way main.c does it.
+    SCTimer counter H generates the servo pulses in hardware; its events
+    and outputs are modelled with nanosecond timestamps.
+
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <platform.h>
+#include <spi.h>
+#include <persistent_storage.h>
+
+#include <rc_receiver.h>
+
+#include <nrf24l01.h>
+#include <port.h>
+#include <lpc812_host.h>
+
+
+// spi.c divides __SYSTEM_CLOCK down to SPI_CLOCK or the next slower clock
+#ifndef SPI_CLOCK
+    #define SPI_CLOCK 10000000
+#endif
+#define SPI_DIVIDER ((__SYSTEM_CLOCK + SPI_CLOCK - 1) / SPI_CLOCK)
+
+// spi.c sends the bytes in 16-bit frames, each queued while the previous one
+// is on the bus. It polls STAT about once per frame for TXRDY, for the
+// duration of a frame for RXRDY, and for MSTIDLE at the end. Write-only
+// frames after the first use RXIGNORE and skip the RXRDY wait. One
+// iteration of a poll loop (load from the APB, test, branch) takes about
+// SPI_POLL_CYCLES on the Cortex-M0+.
+#define SPI_POLL_CYCLES 6
+#define SPI_CYCLES_PER_FRAME (16 * SPI_DIVIDER)
+#define SPI_RXRDY_POLLS \
+    ((SPI_CYCLES_PER_FRAME + SPI_POLL_CYCLES - 1) / SPI_POLL_CYCLES)
+
+#define SCT_CTRL_HALT (1 << 2)
+#define SCT_CTRL_CLRCTR (1 << 3)
+#define SCT_HOP_TIMER_EVENT 4
+#define SCT_CTRL_PRE(ctrl) ((((ctrl) >> 5) & 0xff) + 1)
+
+
+LPC_SYSCON_TypeDef host_syscon;
+LPC_IOCON_TypeDef host_iocon;
+LPC_FLASHCTRL_TypeDef host_flashctrl;
+LPC_SWM_TypeDef host_swm;
+LPC_GPIO_PORT_TypeDef host_gpio_port;
+LPC_PIN_INT_TypeDef host_pin_int;
+LPC_MRT_TypeDef host_mrt;
+LPC_USART_TypeDef host_usart0;
+LPC_SPI_TypeDef host_spi0;
+LPC_SCT_TypeDef host_sct;
+LPC_WWDT_TypeDef host_wwdt;
+
+// Global flag that is true for one mainloop every __SYSTICK_IN_MS
+bool systick;
+
+static uint8_t flash_storage[NUMBER_OF_PERSISTENT_ELEMENTS];
+static uint32_t delay_us_total;
+static uint32_t pending_delay_us;
+static uint32_t spi_polls;
+
+static uint32_t systick_count;
+static uint32_t systick_timer;
+
+static port_edge_callback_t edge_callback;
+static uint64_t time_ns;
+
+static bool sct_h_running;
+static uint64_t sct_h_limit_time;
+static uint64_t sct_h_clear_time[NUMBER_OF_CHANNELS];
+static bool sct_h_output[NUMBER_OF_CHANNELS];
+
+
+// ****************************************************************************
+void lpc812_host_reset(const uint8_t *bind_data)
+{
+    memset(&host_syscon, 0, sizeof(host_syscon));
+    memset(&host_iocon, 0, sizeof(host_iocon));
+    memset(&host_flashctrl, 0, sizeof(host_flashctrl));
+    memset(&host_swm, 0, sizeof(host_swm));
+    memset((void *)&host_gpio_port, 0, sizeof(host_gpio_port));
+    memset(&host_pin_int, 0, sizeof(host_pin_int));
+    memset(&host_mrt, 0, sizeof(host_mrt));
+    memset(&host_usart0, 0, sizeof(host_usart0));
+    memset(&host_spi0, 0, sizeof(host_spi0));
+    memset(&host_sct, 0, sizeof(host_sct));
+    memset(&host_wwdt, 0, sizeof(host_wwdt));
+
+    // The bind button has a pull-up, so it reads as released
+    GPIO_BIND = 1;
+
+    memcpy(flash_storage, bind_data, NUMBER_OF_PERSISTENT_ELEMENTS);
+    delay_us_total = 0;
+    pending_delay_us = 0;
+    spi_polls = 0;
+
+    systick = false;
+    systick_count = 0;
+    systick_timer = __SYSTICK_IN_MS * 1000;
+
+    time_ns = 0;
+    sct_h_running = false;
+    memset(sct_h_output, 0, sizeof(sct_h_output));
+
+    // SCTimer L configuration as done by init_hardware() in main.c: halted,
+    // 1 MHz clock, match 0 as auto-limit and event 4 interrupt enabled.
+    LPC_SCT->CONFIG = (1 << 18) | (1 << 17);
+    LPC_SCT->CTRL_L = SCT_CTRL_HALT | (((__SYSTEM_CLOCK / 1000000) - 1) << 5);
+    LPC_SCT->EVEN = (1 << SCT_HOP_TIMER_EVENT);
+
+    // SCTimer H configuration for the servo outputs, also from main.c:
+    // halted, 750 ns clock, 10 ms period, 1.5 ms pulses
+    LPC_SCT->CTRL_H = SCT_CTRL_HALT | (((__SYSTEM_CLOCK / 1333333) - 1) << 5);
+    LPC_SCT->MATCHREL[0].H = (10000 * 4 / 3) - 1;
+    LPC_SCT->MATCHREL[1].H = SERVO_PULSE_CENTER * 4 / 3;
+    LPC_SCT->MATCHREL[2].H = SERVO_PULSE_CENTER * 4 / 3;
+    LPC_SCT->MATCHREL[3].H = SERVO_PULSE_CENTER * 4 / 3;
+
+    nrf24l01_reset();
+}
+
+
+// ****************************************************************************
+uint32_t lpc812_host_get_delay_us_total(void)
+{
+    return delay_us_total;
+}
+
+
+// ****************************************************************************
+// Number of 1 MHz ticks until counter L reaches its limit in MATCH[0].
+// The counter resets to 0 on the tick after the match, which we model by
+// setting it to 0xffff.
+// ****************************************************************************
+static uint32_t sct_l_time_to_match(void)
+{
+    if (LPC_SCT->CTRL_L & SCT_CTRL_HALT) {
+        return UINT32_MAX;
+    }
+
+    return (uint16_t)(LPC_SCT->MATCH[0].L - LPC_SCT->COUNT_L);
+}
+
+
+// ****************************************************************************
+static void sct_l_advance(uint32_t microseconds)
+{
+    if (LPC_SCT->CTRL_L & SCT_CTRL_CLRCTR) {
+        LPC_SCT->CTRL_L &= ~SCT_CTRL_CLRCTR;
+        LPC_SCT->COUNT_L = 0;
+    }
+
+    while (microseconds) {
+        uint32_t step = sct_l_time_to_match();
+
+        if (step == UINT32_MAX) {
+            return;
+        }
+
+        if (step > microseconds) {
+            LPC_SCT->COUNT_L += microseconds;
+            return;
+        }
+
+        microseconds -= step;
+        LPC_SCT->COUNT_L = 0xffff;
+        LPC_SCT->MATCH[0].L = LPC_SCT->MATCHREL[0].L;
+
+        LPC_SCT->EVFLAG |= (1 << SCT_HOP_TIMER_EVENT);
+        if (LPC_SCT->EVEN & (1 << SCT_HOP_TIMER_EVENT)) {
+            // SCT_irq_handler() in main.c
+            LPC_SCT->EVFLAG = (1 << SCT_HOP_TIMER_EVENT);
+            hop_timer_handler();
+        }
+
+        // A match value of 0 would fire on every tick; the firmware never
+        // does that, but guard against an endless loop.
+        if (LPC_SCT->MATCH[0].L == 0xffff) {
+            return;
+        }
+    }
+}
+
+
+// ****************************************************************************
+static uint64_t sct_h_ticks_to_ns(uint32_t ticks)
+{
+    return (uint64_t)ticks * SCT_CTRL_PRE(LPC_SCT->CTRL_H) * 1000000000ull /
+        __SYSTEM_CLOCK;
+}
+
+
+// ****************************************************************************
+static void sct_h_set_output(unsigned int output, bool level, uint64_t time)
+{
+    if (sct_h_output[output] == level) {
+        return;
+    }
+
+    sct_h_output[output] = level;
+    if (edge_callback) {
+        edge_callback(output, level, time);
+    }
+}
+
+
+// ****************************************************************************
+// Limit event (event 0): counter H has reached MATCH[0]. It sets all servo
+// outputs, and on the next tick the counter restarts at 0 with the match
+// registers reloaded. Event i + 1 clears output i when the counter reaches
+// MATCH[i + 1], so a pulse lasts MATCH[i + 1] + 1 ticks.
+// ****************************************************************************
+static void sct_h_limit(uint64_t time, bool set_outputs)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        LPC_SCT->MATCH[i].H = LPC_SCT->MATCHREL[i].H;
+    }
+
+    for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
+        if (set_outputs) {
+            sct_h_set_output(i, true, time);
+        }
+
+        sct_h_clear_time[i] = UINT64_MAX;
+        if (LPC_SCT->MATCH[i + 1].H <= LPC_SCT->MATCH[0].H) {
+            sct_h_clear_time[i] = time +
+                sct_h_ticks_to_ns(LPC_SCT->MATCH[i + 1].H + 1);
+        }
+    }
+
+    sct_h_limit_time = time + sct_h_ticks_to_ns(LPC_SCT->MATCH[0].H + 1);
+}
+
+
+// ****************************************************************************
+// Run counter H up to the current time.
+//
+// rc_receiver.c starts the counter by clearing its HALT bit when the first
+// stick data arrives. At that point MATCH[0] is still 0, so the limit event
+// fires right away and loads the reload values. Events 1..3 match at the
+// same time; the conflict leaves the outputs unchanged.
+// ****************************************************************************
+static void sct_h_advance(void)
+{
+    if (LPC_SCT->CTRL_H & SCT_CTRL_HALT) {
+        sct_h_running = false;
+        return;
+    }
+
+    if (!sct_h_running) {
+        sct_h_running = true;
+        sct_h_limit(time_ns, false);
+    }
+
+    while (1) {
+        uint64_t next = sct_h_limit_time;
+        int output = -1;
+        int i;
+
+        for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
+            if (sct_h_clear_time[i] <= next) {
+                next = sct_h_clear_time[i];
+                output = i;
+            }
+        }
+
+        if (next > time_ns) {
+            return;
+        }
+
+        if (output >= 0) {
+            sct_h_clear_time[output] = UINT64_MAX;
+            sct_h_set_output(output, false, next);
+        }
+        else {
+            sct_h_limit(next, true);
+        }
+    }
+}
+
+
+// ****************************************************************************
+void port_reset(const uint8_t *bind_data)
+{
+    lpc812_host_reset(bind_data);
+    init_receiver();
+}
+
+
+// ****************************************************************************
+uint32_t port_time_to_next_event(void)
+{
+    uint32_t sct = sct_l_time_to_match();
+
+    return (sct < systick_timer) ? sct : systick_timer;
+}
+
+
+// ****************************************************************************
+void port_advance(uint32_t microseconds)
+{
+    uint32_t remaining = microseconds;
+
+    // The main loop may have started counter H since the last call
+    sct_h_advance();
+
+    while (remaining) {
+        uint32_t step = port_time_to_next_event();
+
+        if (step == 0) {
+            step = 1;
+        }
+        if (step > remaining) {
+            step = remaining;
+        }
+
+        sct_l_advance(step);
+
+        systick_timer -= step;
+        if (systick_timer == 0) {
+            systick_timer = __SYSTICK_IN_MS * 1000;
+            ++systick_count;
+        }
+
+        time_ns += (uint64_t)step * 1000;
+        sct_h_advance();
+
+        remaining -= step;
+    }
+}
+
+
+// ****************************************************************************
+void port_rf_interrupt(void)
+{
+    // The SCTimer capture of the hop timer that init_hardware() sets up
+    LPC_SCT->MATCH[1].L = LPC_SCT->COUNT_L;
+
+    // PININT0_irq_handler() in main.c
+    LPC_PIN_INT->IST = (1 << 0);
+    rf_interrupt_handler();
+}
+
+
+// ****************************************************************************
+uint32_t port_run_main_loop(void)
+{
+    nrf24l01_spi_statistics_t before;
+    nrf24l01_spi_statistics_t after;
+    uint32_t delay_before = delay_us_total;
+
+    // service_systick() in main.c
+    if (systick_count) {
+        systick = true;
+        --systick_count;
+    }
+    else {
+        systick = false;
+    }
+
+    nrf24l01_get_spi_statistics(&before);
+    process_receiver();
+    nrf24l01_get_spi_statistics(&after);
+
+    return (delay_us_total - delay_before) +
+        (after.bytes - before.bytes) * 8 * 1000000 / port_get_spi_clock();
+}
+
+
+// ****************************************************************************
+bool port_is_main_loop_complete(void)
+{
+    return true;
+}
+
+
+// ****************************************************************************
+uint32_t port_get_spi_clock(void)
+{
+    return __SYSTEM_CLOCK / SPI_DIVIDER;
+}
+
+
+// ****************************************************************************
+uint32_t port_get_spi_polls(void)
+{
+    return spi_polls;
+}
+
+
+// ****************************************************************************
+uint16_t port_stick_to_channel(uint16_t stick)
+{
+    return 0xffff - stick;
+}
+
+
+// ****************************************************************************
+void port_set_bind_button(bool pressed)
+{
+    GPIO_BIND = pressed ? 0 : 1;
+}
+
+
+// ****************************************************************************
+bool port_binds_on_button_release(void)
+{
+    return true;
+}
+
+
+// ****************************************************************************
+const char *port_get_name(void)
+{
+    return "lpc812";
+}
+
+
+// ****************************************************************************
+const char *port_get_output_model(void)
+{
+    return "ideal SCTimer H, the outputs change exactly on the timer tick";
+}
+
+
+// ****************************************************************************
+bool port_has_output(unsigned int output)
+{
+    return output < NUMBER_OF_CHANNELS;
+}
+
+
+// ****************************************************************************
+void port_set_edge_callback(port_edge_callback_t callback)
+{
+    edge_callback = callback;
+}
+
+
+// ****************************************************************************
+// channels[] holds the pulse width in SCTimer H ticks of 750 ns
+// ****************************************************************************
+uint32_t port_channel_to_pulse_ns(uint16_t channel)
+{
+    return sct_h_ticks_to_ns(channel);
+}
+
+
+// ****************************************************************************
+bool nrf24l01_ce(void)
+{
+    return GPIO_NRF_CE != 0;
+}
+
+
+// ****************************************************************************
+void init_spi(void)
+{
+}
+
+
+// ****************************************************************************
+uint8_t spi_transaction(uint8_t command, unsigned int count,
+    const uint8_t *tx_data, uint8_t *rx_data)
+{
+    unsigned int frames = (count + 2) / 2;
+
+    spi_polls += 1 + frames + (rx_data ? frames : 1) * SPI_RXRDY_POLLS;
+    return nrf24l01_spi_transaction(command, count, tx_data, rx_data);
+}
+
+
+// ****************************************************************************
+void spi_submit(spi_job_t *job)
+{
+    job->next = NULL;
+    job->status = nrf24l01_spi_transaction(job->command, job->count,
+        job->tx_data, job->rx_data);
+    if (job->callback) {
+        job->callback(job);
+    }
+}
+
+
+// ****************************************************************************
+bool spi_is_idle(void)
+{
+    return true;
+}
+
+
+// ****************************************************************************
+void delay_us(uint32_t microseconds)
+{
+    delay_us_total += microseconds;
+}
+
+
+// ****************************************************************************
+// The delay timer runs while the firmware does other work; only the part it
+// waits for in wait_for_delay() keeps the CPU busy. The host counts the
+// whole delay as busy time if the firmware waits for it.
+// ****************************************************************************
+void start_delay_us(uint32_t microseconds)
+{
+    pending_delay_us = microseconds;
+}
+
+
+// ****************************************************************************
+void wait_for_delay(void)
+{
+    delay_us_total += pending_delay_us;
+    pending_delay_us = 0;
+}
+
+
+// ****************************************************************************
+// Simulation time at the start of the current main loop iteration
+// ****************************************************************************
+uint32_t get_timestamp_us(void)
+{
+    return time_ns / 1000;
+}
+
+
+// ****************************************************************************
+void invoke_ISP(void)
+{
+}
+
+
+// ****************************************************************************
+void load_persistent_storage(uint8_t *data)
+{
+    memcpy(data, flash_storage, NUMBER_OF_PERSISTENT_ELEMENTS);
+}
+
+
+// ****************************************************************************
+void save_persistent_storage(uint8_t *new_data)
+{
+    memcpy(flash_storage, new_data, NUMBER_OF_PERSISTENT_ELEMENTS);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+void lpc812_host_reset(const uint8_t *bind_data);
+uint32_t lpc812_host_get_delay_us_total(void);
@@ -0,0 +1,1645 @@
+/******************************************************************************
+
+    Register-level models of the LPC812 peripherals the firmware uses, so
+    that the complete firmware -- main.c, spi.c, uart0.c and
+    persistent_storage.c included -- runs unmodified on the host. See mcu.c
+    for the runtime that connects the register accesses to the models.
+
+    Modelled, on the CPU clock of mcu.c:
+
+    - SCTimer: two 16-bit counters with prescaler, HALT/STOP/CLRCTR, match
+      registers with reload, auto-limit, match events with state masks,
+      outputs with conflict resolution, the event flags and the interrupt.
+      Capture registers, loaded by events on edges of the nRF24 IRQ line
+      routed to a CTIN input; these I/O events only set their flag.
+      Not modelled: unified 32-bit mode, down and bidirectional counting,
+      I/O events combined with matches or acting on outputs, states and
+      limits, the input synchronization, the START register.
+    - SPI0 master: TXDAT holding register and shift register, RXDAT,
+      SSEL, EOT and ENDTRANSFER, RXIGNORE, frames of 8 and 16 bits, the
+      master stall while RXDAT is full. The nRF24L01+ model is clocked byte
+      by byte.
+    - USART0: transmitter timing from the main clock, UARTCLKDIV, the
+      fractional divider and BRG. Transmitted bytes are discarded.
+    - MRT: four channels in repeat, one-shot and bus-stall mode.
+    - Pin interrupts: edge mode, driven by the nRF24 IRQ line.
+    - SYSCON: PLL lock time; the other registers are plain memory.
+    - WWDT: only the feed sequence, which marks the end of a main loop
+      iteration.
+    - IAP: prepare, erase page, copy RAM to flash and reinvoke ISP, on the
+      page of persistent_data, with the flash timing of the data sheet.
+
+    The system clock is 12 MHz both on the IRC and, after init_hardware(),
+    on the PLL.
+
+    Also implements the port interface (port.h) for the simulation tools.
+
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <platform.h>
+#include <persistent_storage.h>
+#include <LPC8xx_ROM_API.h>
+
+#include <mcu.h>
+#include <nrf24l01.h>
+#include <port.h>
+
+
+#define CPU_CLOCK_MHZ (__SYSTEM_CLOCK / 1000000)
+
+// Models put the values of read-only registers in place, too
+#define SET_READ_ONLY(reg, value) (*(volatile uint32_t *)&(reg) = (value))
+#define IRC_CLOCK 12000000
+#define SYSOSC_CLOCK 16000000
+
+// One iteration of a poll loop (load from the APB, test, branch) takes about
+// POLL_CYCLES on the Cortex-M0+
+#define POLL_CYCLES 6
+
+// Data sheet: PLL lock time, flash page erase and programming time
+#define PLL_LOCK_NS 100000
+#define FLASH_ERASE_NS 100000000
+#define FLASH_PROGRAM_NS 1000000
+
+#define SYSCON_PDRUNCFG_SYSPLL_PD (1 << 7)
+
+#define SCT_CONFIG_NORELOAD_L (1 << 7)
+#define SCT_CONFIG_AUTOLIMIT_L (1 << 17)
+#define SCT_CTRL_STOP (1 << 1)
+#define SCT_CTRL_HALT (1 << 2)
+#define SCT_CTRL_CLRCTR (1 << 3)
+#define SCT_CTRL_PRE(ctrl) ((((ctrl) >> 5) & 0xff) + 1)
+#define SCT_EVENT_CTRL_MATCHSEL(ctrl) ((ctrl) & 0xf)
+#define SCT_EVENT_CTRL_HEVENT (1 << 4)
+#define SCT_EVENT_CTRL_COMBMODE(ctrl) (((ctrl) >> 12) & 0x3)
+#define SCT_EVENT_CTRL_STATELD (1 << 14)
+#define SCT_EVENT_CTRL_STATEV(ctrl) (((ctrl) >> 15) & 0x1f)
+#define SCT_EVENT_CTRL_IOSEL(ctrl) (((ctrl) >> 6) & 0xf)
+#define SCT_EVENT_CTRL_IOCOND(ctrl) (((ctrl) >> 10) & 0x3)
+#define SCT_COMBMODE_OR 0
+#define SCT_COMBMODE_MATCH 1
+#define SCT_COMBMODE_IO 2
+#define SCT_IOCOND_RISE 1
+#define SCT_IOCOND_FALL 2
+#define SCT_INPUTS 4
+#define SCT_RES_SET 1
+#define SCT_RES_CLEAR 2
+#define SCT_RES_TOGGLE 3
+
+#define SPI_STAT_RXRDY (1 << 0)
+#define SPI_STAT_TXRDY (1 << 1)
+#define SPI_STAT_RXOV (1 << 2)
+#define SPI_STAT_ENDTRANSFER (1 << 7)
+#define SPI_STAT_MSTIDLE (1 << 8)
+#define SPI_TXCTL_MASK 0x0fff0000
+#define SPI_TXCTL_EOT (1 << 20)
+#define SPI_TXCTL_RXIGNORE (1 << 22)
+#define SPI_TXCTL_LEN(ctl) ((((ctl) >> 24) & 0xf) + 1)
+
+#define UART_CFG_DATALEN(cfg) (7 + (((cfg) >> 2) & 0x3))
+#define UART_CFG_PARITY (0x3 << 4)
+#define UART_CFG_STOPLEN (1 << 6)
+#define UART_STAT_RXIDLE (1 << 1)
+#define UART_STAT_TXRDY (1 << 2)
+#define UART_STAT_TXIDLE (1 << 3)
+
+#define MRT_CHANNELS 4
+#define MRT_INTVAL_LOAD (1u << 31)
+#define MRT_INTVAL_IVALUE 0x7fffffff
+#define MRT_CTRL_INTEN (1 << 0)
+#define MRT_CTRL_MODE(ctrl) (((ctrl) >> 1) & 0x3)
+#define MRT_MODE_REPEAT 0
+#define MRT_MODE_BUS_STALL 2
+#define MRT_STAT_INTFLAG (1 << 0)
+#define MRT_STAT_RUN (1 << 1)
+
+#define PIN_INT_CHANNELS 8
+
+#define IAP_PREPARE_SECTORS 50
+#define IAP_COPY_RAM_TO_FLASH 51
+#define IAP_REINVOKE_ISP 57
+#define IAP_ERASE_PAGE 59
+#define IAP_CMD_SUCCESS 0
+#define IAP_INVALID_COMMAND 1
+#define IAP_SRC_ADDR_ERROR 2
+#define IAP_DST_ADDR_NOT_MAPPED 5
+#define IAP_COUNT_ERROR 6
+#define IAP_INVALID_SECTOR 7
+#define IAP_SECTOR_NOT_PREPARED 9
+
+
+// The state of one of the 16-bit SCTimer counters. The counter has the
+// value "value" since "cycle"; it only changes at match values, so the
+// model jumps from one to the next.
+typedef struct {
+    volatile uint16_t *ctrl;
+    volatile uint16_t *count;
+    volatile uint16_t *limit;
+    volatile uint16_t *halt;
+    volatile uint16_t *stop;
+    volatile uint16_t *state;
+    unsigned int half;
+
+    bool running;
+    bool evaluated;
+    bool at_limit;
+    uint16_t value;
+    uint64_t cycle;
+    uint32_t prescaler;
+} sct_counter_t;
+
+typedef struct {
+    bool running;
+    bool interrupt;
+    uint32_t interval;
+    uint64_t expiry_cycle;
+} mrt_channel_t;
+
+
+// Interrupt handlers of main.c and spi.c, which crt0.c puts into the vector
+// table
+void SysTick_handler(void);
+void PININT0_irq_handler(void);
+void SCT_irq_handler(void);
+void SPI0_irq_handler(void);
+
+extern const volatile uint8_t persistent_data[NUMBER_OF_PERSISTENT_ELEMENTS];
+
+static void iap(unsigned int command[], unsigned int result[]);
+IAP iap_entry = iap;
+
+
+LPC_SYSCON_TypeDef host_syscon;
+LPC_IOCON_TypeDef host_iocon;
+LPC_FLASHCTRL_TypeDef host_flashctrl;
+LPC_SWM_TypeDef host_swm;
+LPC_GPIO_PORT_TypeDef host_gpio_port;
+LPC_PIN_INT_TypeDef host_pin_int;
+LPC_MRT_TypeDef host_mrt;
+LPC_USART_TypeDef host_usart0;
+LPC_SPI_TypeDef host_spi0;
+LPC_SCT_TypeDef host_sct;
+LPC_WWDT_TypeDef host_wwdt;
+SysTick_Type host_systick;
+
+static port_edge_callback_t edge_callback;
+static uint64_t time_ns;
+
+static uint32_t syscon_pdruncfg;
+static uint64_t pll_lock_ns;
+
+static sct_counter_t sct_counters[2];
+static uint32_t sct_evflag;
+static uint32_t sct_output;
+
+static bool spi_selected;
+static bool spi_tx_full;
+static uint32_t spi_tx;
+static bool spi_shifting;
+static uint32_t spi_shift;
+static uint64_t spi_shift_end_cycle;
+static bool spi_rx_full;
+static uint16_t spi_rx;
+static bool spi_rx_overrun;
+static bool spi_end_transfer;
+static uint32_t spi_int_enable;
+
+static bool uart_tx_full;
+static bool uart_shifting;
+static uint64_t uart_shift_end_ns;
+
+static mrt_channel_t mrt_channels[MRT_CHANNELS];
+
+static uint32_t pin_int_rise;
+static uint32_t pin_int_fall;
+static uint32_t pin_int_ist;
+
+static bool wwdt_feed_started;
+
+static bool flash_prepared;
+
+static mcu_peripheral_t spi_peripheral;
+
+
+// ****************************************************************************
+static uint64_t now_cycle(void)
+{
+    return mcu_ns_to_cycles(mcu_get_time_ns());
+}
+
+
+// ****************************************************************************
+static uint64_t cycle_to_ns(uint64_t cycle)
+{
+    return (cycle == MCU_NEVER) ? MCU_NEVER : mcu_cycles_to_ns(cycle);
+}
+
+
+// ****************************************************************************
+static uint64_t earliest(uint64_t a, uint64_t b)
+{
+    return (a < b) ? a : b;
+}
+
+
+// ****************************************************************************
+// SYSCON: the PLL locks PLL_LOCK_NS after it is powered up or reconfigured
+// ****************************************************************************
+static void syscon_update(void)
+{
+}
+
+
+// ****************************************************************************
+static uint64_t syscon_read(volatile void *address, unsigned int size)
+{
+    bool powered = !(LPC_SYSCON->PDRUNCFG & SYSCON_PDRUNCFG_SYSPLL_PD);
+
+    (void) size;
+
+    if (address != &LPC_SYSCON->SYSPLLSTAT) {
+        return MCU_NEVER;
+    }
+
+    LPC_SYSCON->SYSPLLSTAT = (powered && mcu_get_time_ns() >= pll_lock_ns);
+    return (powered && mcu_get_time_ns() < pll_lock_ns) ? pll_lock_ns : MCU_NEVER;
+}
+
+
+// ****************************************************************************
+static void syscon_write(volatile void *address, unsigned int size)
+{
+    uint32_t powered_up = syscon_pdruncfg & ~LPC_SYSCON->PDRUNCFG;
+
+    (void) size;
+
+    if ((address == &LPC_SYSCON->PDRUNCFG &&
+            (powered_up & SYSCON_PDRUNCFG_SYSPLL_PD)) ||
+            address == &LPC_SYSCON->SYSPLLCTRL ||
+            address == &LPC_SYSCON->SYSPLLCLKUEN) {
+        pll_lock_ns = mcu_get_time_ns() + PLL_LOCK_NS;
+    }
+    syscon_pdruncfg = LPC_SYSCON->PDRUNCFG;
+}
+
+
+// ****************************************************************************
+// The main clock, which drives the USART
+// ****************************************************************************
+static uint32_t syscon_main_clock(void)
+{
+    uint32_t pll_input;
+
+    if (LPC_SYSCON->MAINCLKSEL != 3) {
+        return IRC_CLOCK;
+    }
+
+    pll_input = (LPC_SYSCON->SYSPLLCLKSEL == 1) ? SYSOSC_CLOCK : IRC_CLOCK;
+    return pll_input * ((LPC_SYSCON->SYSPLLCTRL & 0x1f) + 1);
+}
+
+
+// ****************************************************************************
+// SCTimer
+// ****************************************************************************
+static bool sct_is_capture(const sct_counter_t *c, unsigned int i)
+{
+    return ((c->half ? LPC_SCT->REGMODE_H : LPC_SCT->REGMODE_L) >> i) & 1;
+}
+
+
+// ****************************************************************************
+// The match value of register i, or a value the counter never takes before
+// its limit if the register captures
+// ****************************************************************************
+static uint32_t sct_match(const sct_counter_t *c, unsigned int i)
+{
+    if (sct_is_capture(c, i)) {
+        return 0x10000;
+    }
+    return (LPC_SCT->MATCH[i].U >> (16 * c->half)) & 0xffff;
+}
+
+
+// ****************************************************************************
+static void sct_reload(const sct_counter_t *c)
+{
+    unsigned int shift = 16 * c->half;
+    unsigned int i;
+
+    if (LPC_SCT->CONFIG & (SCT_CONFIG_NORELOAD_L << c->half)) {
+        return;
+    }
+
+    // MATCHREL of a capture register is its CAPCTRL
+    for (i = 0; i < CONFIG_SCT_nRG; i++) {
+        if (sct_is_capture(c, i)) {
+            continue;
+        }
+        LPC_SCT->MATCH[i].U = (LPC_SCT->MATCH[i].U & ~(0xffffu << shift)) |
+            (LPC_SCT->MATCHREL[i].U & (0xffffu << shift));
+    }
+}
+
+
+// ****************************************************************************
+static void sct_update_irq(void)
+{
+    mcu_set_irq_level(SCT_IRQn, (sct_evflag & LPC_SCT->EVEN) != 0);
+}
+
+
+// ****************************************************************************
+static void sct_set_outputs(uint32_t output, uint64_t cycle)
+{
+    uint32_t changed = output ^ sct_output;
+    unsigned int i;
+
+    sct_output = output;
+    LPC_SCT->OUTPUT = output;
+
+    for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
+        if ((changed & (1 << i)) && edge_callback) {
+            edge_callback(PORT_CH1 + i, (output >> i) & 1, cycle_to_ns(cycle));
+        }
+    }
+}
+
+
+// ****************************************************************************
+// The cycle at which the counter takes its next value of interest, and
+// that value
+// ****************************************************************************
+static uint64_t sct_next_step(const sct_counter_t *c, uint16_t *value)
+{
+    uint32_t next = 0xffff;
+    unsigned int i;
+
+    *value = c->value;
+
+    if (!c->running) {
+        return MCU_NEVER;
+    }
+
+    if (!c->evaluated) {
+        return c->cycle;
+    }
+
+    if (c->at_limit) {
+        *value = 0;
+        return c->cycle + c->prescaler;
+    }
+
+    for (i = 0; i < CONFIG_SCT_nRG; i++) {
+        uint32_t m = sct_match(c, i);
+
+        if (m > c->value && m < next) {
+            next = m;
+        }
+    }
+
+    *value = next;
+    return c->cycle + (uint64_t)(next - c->value) * c->prescaler;
+}
+
+
+// ****************************************************************************
+// The events of the counter at its current value
+// ****************************************************************************
+static void sct_evaluate(sct_counter_t *c)
+{
+    uint32_t fired = 0;
+    uint32_t output = sct_output;
+    unsigned int i;
+
+    for (i = 0; i < CONFIG_SCT_nEV; i++) {
+        uint32_t ctrl = LPC_SCT->EVENT[i].CTRL;
+        unsigned int matchsel = SCT_EVENT_CTRL_MATCHSEL(ctrl);
+        unsigned int combmode = SCT_EVENT_CTRL_COMBMODE(ctrl);
+
+        if (((ctrl & SCT_EVENT_CTRL_HEVENT) != 0) != c->half ||
+                *c->state >= 32 ||
+                !(LPC_SCT->EVENT[i].STATE & (1u << *c->state)) ||
+                (combmode != SCT_COMBMODE_OR && combmode != SCT_COMBMODE_MATCH) ||
+                matchsel >= CONFIG_SCT_nRG ||
+                sct_match(c, matchsel) != c->value) {
+            continue;
+        }
+
+        fired |= 1 << i;
+    }
+
+    if (c->value == 0xffff || (fired & *c->limit) ||
+            ((LPC_SCT->CONFIG & (SCT_CONFIG_AUTOLIMIT_L << c->half)) &&
+             sct_match(c, 0) == c->value)) {
+        c->at_limit = true;
+    }
+
+    if (!fired) {
+        return;
+    }
+
+    for (i = 0; i < CONFIG_SCT_nOU; i++) {
+        bool set = LPC_SCT->OUT[i].SET & fired;
+        bool clear = LPC_SCT->OUT[i].CLR & fired;
+        unsigned int resolution = set ? SCT_RES_SET : SCT_RES_CLEAR;
+
+        if (set && clear) {
+            resolution = (LPC_SCT->RES >> (2 * i)) & 0x3;
+        }
+
+        if (!set && !clear) {
+            continue;
+        }
+
+        switch (resolution) {
+            case SCT_RES_SET:
+                output |= 1 << i;
+                break;
+
+            case SCT_RES_CLEAR:
+                output &= ~(1 << i);
+                break;
+
+            case SCT_RES_TOGGLE:
+                output ^= 1 << i;
+                break;
+
+            default:
+                break;
+        }
+    }
+    sct_set_outputs(output, c->cycle);
+
+    for (i = 0; i < CONFIG_SCT_nEV; i++) {
+        uint32_t ctrl = LPC_SCT->EVENT[i].CTRL;
+
+        if (fired & (1 << i)) {
+            *c->state = ((ctrl & SCT_EVENT_CTRL_STATELD) ? 0 : *c->state) +
+                SCT_EVENT_CTRL_STATEV(ctrl);
+        }
+    }
+
+    if (fired & *c->halt) {
+        *c->ctrl |= SCT_CTRL_HALT;
+        c->running = false;
+    }
+    if (fired & *c->stop) {
+        *c->ctrl |= SCT_CTRL_STOP;
+        c->running = false;
+    }
+
+    sct_evflag |= fired;
+    sct_update_irq();
+}
+
+
+// ****************************************************************************
+static void sct_counter_update(sct_counter_t *c, uint64_t now)
+{
+    while (1) {
+        uint16_t value;
+        uint64_t cycle = sct_next_step(c, &value);
+
+        if (cycle > now) {
+            return;
+        }
+
+        if (c->evaluated) {
+            if (c->at_limit) {
+                c->at_limit = false;
+                sct_reload(c);
+            }
+            c->value = value;
+            c->cycle = cycle;
+        }
+
+        c->evaluated = true;
+        sct_evaluate(c);
+    }
+}
+
+
+// ****************************************************************************
+// The value of the counter at the given cycle, which must not be beyond its
+// next step
+// ****************************************************************************
+static uint16_t sct_counter_value(const sct_counter_t *c, uint64_t now)
+{
+    if (!c->running || !c->evaluated || c->at_limit) {
+        return c->value;
+    }
+    return c->value + (now - c->cycle) / c->prescaler;
+}
+
+
+// ****************************************************************************
+// Write to the CTRL register of a counter. The counter advances to the
+// last full tick, so that its value and the prescaler can change.
+// ****************************************************************************
+static void sct_counter_control(sct_counter_t *c, uint64_t now)
+{
+    uint16_t ctrl = *c->ctrl;
+    bool run = !(ctrl & (SCT_CTRL_HALT | SCT_CTRL_STOP));
+
+    if (c->running && !c->at_limit) {
+        uint64_t ticks = (now - c->cycle) / c->prescaler;
+
+        c->value += ticks;
+        c->cycle += ticks * c->prescaler;
+    }
+
+    if (ctrl & SCT_CTRL_CLRCTR) {
+        *c->ctrl = ctrl & ~SCT_CTRL_CLRCTR;
+        c->value = 0;
+        c->at_limit = false;
+        c->cycle = now;
+    }
+
+    // A counter that starts evaluates its events at its current value
+    if (run && !c->running) {
+        c->cycle = now;
+        c->evaluated = false;
+    }
+    c->running = run;
+    c->prescaler = SCT_CTRL_PRE(ctrl);
+}
+
+
+// ****************************************************************************
+static void sct_update(void)
+{
+    uint64_t now = now_cycle();
+
+    sct_counter_update(&sct_counters[0], now);
+    sct_counter_update(&sct_counters[1], now);
+}
+
+
+// ****************************************************************************
+static uint64_t sct_next_event_ns(void)
+{
+    uint16_t value;
+
+    return cycle_to_ns(earliest(sct_next_step(&sct_counters[0], &value),
+        sct_next_step(&sct_counters[1], &value)));
+}
+
+
+// ****************************************************************************
+static uint64_t sct_read(volatile void *address, unsigned int size)
+{
+    uint64_t now = now_cycle();
+
+    (void) address;
+    (void) size;
+
+    LPC_SCT->COUNT_L = sct_counter_value(&sct_counters[0], now);
+    LPC_SCT->COUNT_H = sct_counter_value(&sct_counters[1], now);
+    LPC_SCT->EVFLAG = sct_evflag;
+    LPC_SCT->OUTPUT = sct_output;
+
+    return sct_next_event_ns();
+}
+
+
+// ****************************************************************************
+static void sct_write(volatile void *address, unsigned int size)
+{
+    uint64_t now = now_cycle();
+    unsigned int i;
+
+    if (address == &LPC_SCT->CTRL_U || address == &LPC_SCT->CTRL_L ||
+            address == &LPC_SCT->CTRL_H) {
+        sct_counter_control(&sct_counters[0], now);
+        sct_counter_control(&sct_counters[1], now);
+    }
+    else if (address == &LPC_SCT->COUNT_U || address == &LPC_SCT->COUNT_H) {
+        // COUNT_L shares its address with COUNT_U; the size tells them apart
+        for (i = 0; i < 2; i++) {
+            sct_counter_t *c = &sct_counters[i];
+
+            if (size != sizeof(LPC_SCT->COUNT_U) && address != c->count) {
+                continue;
+            }
+            c->value = *c->count;
+            c->cycle = now;
+            c->at_limit = false;
+            c->evaluated = true;
+        }
+    }
+    else if (address == &LPC_SCT->EVFLAG) {
+        sct_evflag &= ~LPC_SCT->EVFLAG;
+        LPC_SCT->EVFLAG = sct_evflag;
+        sct_update_irq();
+    }
+    else if (address == &LPC_SCT->EVEN) {
+        sct_update_irq();
+    }
+    else if (address == &LPC_SCT->OUTPUT) {
+        sct_set_outputs(LPC_SCT->OUTPUT, now);
+    }
+}
+
+
+// ****************************************************************************
+// The pin that the switch matrix assigns to the SCTimer input CTIN_n
+// ****************************************************************************
+static unsigned int sct_input_pin(unsigned int input)
+{
+    if (input == 0) {
+        return LPC_SWM->PINASSIGN5 >> 24;
+    }
+    return (LPC_SWM->PINASSIGN6 >> (8 * (input - 1))) & 0xff;
+}
+
+
+// ****************************************************************************
+// An edge on a pin: fire the I/O events of the input it drives, and load the
+// capture registers these events select with the value of their counter
+// ****************************************************************************
+static void sct_pin_edge(unsigned int pin, bool rising)
+{
+    uint64_t now = now_cycle();
+    unsigned int iocond = rising ? SCT_IOCOND_RISE : SCT_IOCOND_FALL;
+    uint32_t fired = 0;
+    unsigned int i;
+    unsigned int j;
+
+    sct_update();
+
+    for (i = 0; i < CONFIG_SCT_nEV; i++) {
+        uint32_t ctrl = LPC_SCT->EVENT[i].CTRL;
+        sct_counter_t *c =
+            &sct_counters[(ctrl & SCT_EVENT_CTRL_HEVENT) ? 1 : 0];
+        unsigned int shift = 16 * c->half;
+
+        if (SCT_EVENT_CTRL_COMBMODE(ctrl) != SCT_COMBMODE_IO ||
+                SCT_EVENT_CTRL_IOSEL(ctrl) >= SCT_INPUTS ||
+                sct_input_pin(SCT_EVENT_CTRL_IOSEL(ctrl)) != pin ||
+                SCT_EVENT_CTRL_IOCOND(ctrl) != iocond ||
+                *c->state >= 32 ||
+                !(LPC_SCT->EVENT[i].STATE & (1u << *c->state))) {
+            continue;
+        }
+
+        fired |= 1 << i;
+
+        for (j = 0; j < CONFIG_SCT_nRG; j++) {
+            if (!sct_is_capture(c, j) ||
+                    !((LPC_SCT->CAPCTRL[j].U >> shift) & (1u << i))) {
+                continue;
+            }
+            LPC_SCT->MATCH[j].U = (LPC_SCT->MATCH[j].U & ~(0xffffu << shift)) |
+                ((uint32_t)sct_counter_value(c, now) << shift);
+        }
+    }
+
+    sct_evflag |= fired;
+    sct_update_irq();
+}
+
+
+// ****************************************************************************
+static void sct_reset(void)
+{
+    unsigned int i;
+
+    memset(&host_sct, 0, sizeof(host_sct));
+    LPC_SCT->CONFIG = 0x7e00;
+    LPC_SCT->CTRL_L = SCT_CTRL_HALT;
+    LPC_SCT->CTRL_H = SCT_CTRL_HALT;
+
+    for (i = 0; i < 2; i++) {
+        sct_counter_t *c = &sct_counters[i];
+
+        memset(c, 0, sizeof(*c));
+        c->half = i;
+        c->prescaler = 1;
+    }
+
+    sct_counters[0].ctrl = &LPC_SCT->CTRL_L;
+    sct_counters[0].count = &LPC_SCT->COUNT_L;
+    sct_counters[0].limit = &LPC_SCT->LIMIT_L;
+    sct_counters[0].halt = &LPC_SCT->HALT_L;
+    sct_counters[0].stop = &LPC_SCT->STOP_L;
+    sct_counters[0].state = &LPC_SCT->STATE_L;
+
+    sct_counters[1].ctrl = &LPC_SCT->CTRL_H;
+    sct_counters[1].count = &LPC_SCT->COUNT_H;
+    sct_counters[1].limit = &LPC_SCT->LIMIT_H;
+    sct_counters[1].halt = &LPC_SCT->HALT_H;
+    sct_counters[1].stop = &LPC_SCT->STOP_H;
+    sct_counters[1].state = &LPC_SCT->STATE_H;
+
+    sct_evflag = 0;
+    sct_output = 0;
+}
+
+
+// ****************************************************************************
+// SPI0 master. SSEL0 is CSN of the nRF24.
+// ****************************************************************************
+static void spi_deselect(void)
+{
+    if (spi_selected) {
+        spi_selected = false;
+        nrf24l01_spi_deselect();
+    }
+}
+
+
+// ****************************************************************************
+// Move the frame in TXDAT to the shift register, unless the master stalls
+// because RXDAT has not been read
+// ****************************************************************************
+static void spi_start_frame(uint64_t cycle)
+{
+    if (spi_shifting || !spi_tx_full ||
+            (spi_rx_full && !(spi_tx & SPI_TXCTL_RXIGNORE))) {
+        return;
+    }
+
+    spi_shift = spi_tx;
+    spi_tx_full = false;
+    spi_shifting = true;
+    spi_shift_end_cycle = cycle +
+        SPI_TXCTL_LEN(spi_shift) * (uint64_t)((LPC_SPI0->DIV & 0xffff) + 1);
+
+    if (!spi_selected) {
+        spi_selected = true;
+        nrf24l01_spi_select();
+    }
+}
+
+
+// ****************************************************************************
+// The frame has been shifted out, MSB first, in bytes to the nRF24
+// ****************************************************************************
+static void spi_end_frame(void)
+{
+    unsigned int bits = SPI_TXCTL_LEN(spi_shift);
+    uint16_t received = 0;
+
+    spi_shifting = false;
+
+    while (bits >= 8) {
+        bits -= 8;
+        received = (received << 8) |
+            nrf24l01_spi_exchange((spi_shift >> bits) & 0xff);
+    }
+
+    if (!(spi_shift & SPI_TXCTL_RXIGNORE)) {
+        if (spi_rx_full) {
+            spi_rx_overrun = true;
+        }
+        spi_rx = received;
+        spi_rx_full = true;
+    }
+
+    if ((spi_shift & SPI_TXCTL_EOT) || spi_end_transfer) {
+        spi_end_transfer = false;
+        spi_deselect();
+    }
+}
+
+
+// ****************************************************************************
+// Only RXRDY and TXRDY can interrupt
+// ****************************************************************************
+static void spi_update_irq(void)
+{
+    uint32_t status = (spi_rx_full ? SPI_STAT_RXRDY : 0) |
+        (spi_tx_full ? 0 : SPI_STAT_TXRDY);
+
+    SET_READ_ONLY(LPC_SPI0->INTSTAT, status & spi_int_enable);
+    mcu_set_irq_level(SPI0_IRQn, (status & spi_int_enable) != 0);
+}
+
+
+// ****************************************************************************
+static void spi_update(void)
+{
+    uint64_t now = now_cycle();
+
+    while (spi_shifting && spi_shift_end_cycle <= now) {
+        spi_end_frame();
+        spi_start_frame(spi_shift_end_cycle);
+    }
+    spi_update_irq();
+}
+
+
+// ****************************************************************************
+static uint64_t spi_next_event_ns(void)
+{
+    return spi_shifting ? cycle_to_ns(spi_shift_end_cycle) : MCU_NEVER;
+}
+
+
+// ****************************************************************************
+static uint64_t spi_read(volatile void *address, unsigned int size)
+{
+    (void) size;
+
+    if (address == &LPC_SPI0->STAT) {
+        ++spi_peripheral.polls;
+        LPC_SPI0->STAT = (spi_rx_full ? SPI_STAT_RXRDY : 0) |
+            (spi_tx_full ? 0 : SPI_STAT_TXRDY) |
+            (spi_rx_overrun ? SPI_STAT_RXOV : 0) |
+            ((spi_tx_full || spi_shifting) ? 0 : SPI_STAT_MSTIDLE);
+        return spi_next_event_ns();
+    }
+
+    if (address == &LPC_SPI0->RXDAT) {
+        SET_READ_ONLY(LPC_SPI0->RXDAT, spi_rx);
+        spi_rx_full = false;
+        spi_start_frame(now_cycle());
+        spi_update_irq();
+    }
+
+    return MCU_NEVER;
+}
+
+
+// ****************************************************************************
+static void spi_write(volatile void *address, unsigned int size)
+{
+    (void) size;
+
+    if (address == &LPC_SPI0->TXDAT) {
+        spi_tx = (LPC_SPI0->TXCTRL & SPI_TXCTL_MASK) |
+            (LPC_SPI0->TXDAT & 0xffff);
+        spi_tx_full = true;
+        spi_start_frame(now_cycle());
+    }
+    else if (address == &LPC_SPI0->TXDATCTL) {
+        spi_tx = LPC_SPI0->TXDATCTL;
+        LPC_SPI0->TXCTRL = spi_tx & SPI_TXCTL_MASK;
+        spi_tx_full = true;
+        spi_start_frame(now_cycle());
+    }
+    else if (address == &LPC_SPI0->STAT) {
+        if (LPC_SPI0->STAT & SPI_STAT_RXOV) {
+            spi_rx_overrun = false;
+        }
+        if (LPC_SPI0->STAT & SPI_STAT_ENDTRANSFER) {
+            if (spi_shifting) {
+                spi_end_transfer = true;
+            }
+            else {
+                spi_deselect();
+            }
+        }
+    }
+    else if (address == &LPC_SPI0->INTENSET) {
+        spi_int_enable |= LPC_SPI0->INTENSET;
+    }
+    else if (address == &LPC_SPI0->INTENCLR) {
+        spi_int_enable &= ~LPC_SPI0->INTENCLR;
+    }
+
+    LPC_SPI0->INTENSET = spi_int_enable;
+    spi_update_irq();
+}
+
+
+// ****************************************************************************
+static void spi_reset(void)
+{
+    memset(&host_spi0, 0, sizeof(host_spi0));
+    spi_selected = false;
+    spi_tx_full = false;
+    spi_shifting = false;
+    spi_rx_full = false;
+    spi_rx_overrun = false;
+    spi_end_transfer = false;
+    spi_int_enable = 0;
+}
+
+
+// ****************************************************************************
+// USART0 transmitter
+// ****************************************************************************
+static uint64_t uart_frame_ns(void)
+{
+    uint32_t cfg = LPC_USART0->CFG;
+    unsigned int bits = 1 + UART_CFG_DATALEN(cfg) +
+        ((cfg & UART_CFG_PARITY) ? 1 : 0) + ((cfg & UART_CFG_STOPLEN) ? 2 : 1);
+    double clock;
+
+    if (LPC_SYSCON->UARTCLKDIV == 0) {
+        return MCU_NEVER;
+    }
+
+    clock = (double)syscon_main_clock() / LPC_SYSCON->UARTCLKDIV /
+        (1.0 + (double)(LPC_SYSCON->UARTFRGMULT & 0xff) /
+            ((LPC_SYSCON->UARTFRGDIV & 0xff) + 1));
+
+    return bits * 16.0 * ((LPC_USART0->BRG & 0xffff) + 1) * 1e9 / clock;
+}
+
+
+// ****************************************************************************
+static void uart_start_frame(uint64_t start_ns)
+{
+    uint64_t frame_ns = uart_frame_ns();
+
+    if (uart_shifting || !uart_tx_full || frame_ns == MCU_NEVER) {
+        return;
+    }
+
+    uart_tx_full = false;
+    uart_shifting = true;
+    uart_shift_end_ns = start_ns + frame_ns;
+}
+
+
+// ****************************************************************************
+static void uart_update(void)
+{
+    while (uart_shifting && uart_shift_end_ns <= mcu_get_time_ns()) {
+        uart_shifting = false;
+        uart_start_frame(uart_shift_end_ns);
+    }
+}
+
+
+// ****************************************************************************
+static uint64_t uart_next_event_ns(void)
+{
+    return uart_shifting ? uart_shift_end_ns : MCU_NEVER;
+}
+
+
+// ****************************************************************************
+static uint64_t uart_read(volatile void *address, unsigned int size)
+{
+    (void) size;
+
+    if (address == &LPC_USART0->STAT) {
+        LPC_USART0->STAT = UART_STAT_RXIDLE |
+            (uart_tx_full ? 0 : UART_STAT_TXRDY) |
+            ((uart_tx_full || uart_shifting) ? 0 : UART_STAT_TXIDLE);
+    }
+
+    return uart_next_event_ns();
+}
+
+
+// ****************************************************************************
+static void uart_write(volatile void *address, unsigned int size)
+{
+    (void) size;
+
+    if (address == &LPC_USART0->TXDATA) {
+        uart_tx_full = true;
+        uart_start_frame(mcu_get_time_ns());
+    }
+}
+
+
+// ****************************************************************************
+static void uart_reset(void)
+{
+    memset(&host_usart0, 0, sizeof(host_usart0));
+    uart_tx_full = false;
+    uart_shifting = false;
+}
+
+
+// ****************************************************************************
+// Multi-rate timer
+// ****************************************************************************
+static void mrt_update_irq(void)
+{
+    bool level = false;
+    unsigned int i;
+
+    for (i = 0; i < MRT_CHANNELS; i++) {
+        if (mrt_channels[i].interrupt &&
+                (LPC_MRT->Channel[i].CTRL & MRT_CTRL_INTEN)) {
+            level = true;
+        }
+    }
+    mcu_set_irq_level(MRT_IRQn, level);
+}
+
+
+// ****************************************************************************
+static void mrt_update(void)
+{
+    uint64_t now = now_cycle();
+    unsigned int i;
+
+    for (i = 0; i < MRT_CHANNELS; i++) {
+        mrt_channel_t *channel = &mrt_channels[i];
+
+        while (channel->running && channel->expiry_cycle <= now) {
+            channel->interrupt = true;
+            if (MRT_CTRL_MODE(LPC_MRT->Channel[i].CTRL) == MRT_MODE_REPEAT &&
+                    channel->interval) {
+                channel->expiry_cycle += channel->interval;
+            }
+            else {
+                channel->running = false;
+            }
+        }
+    }
+    mrt_update_irq();
+}
+
+
+// ****************************************************************************
+static uint64_t mrt_next_event_ns(void)
+{
+    uint64_t next = MCU_NEVER;
+    unsigned int i;
+
+    for (i = 0; i < MRT_CHANNELS; i++) {
+        if (mrt_channels[i].running) {
+            next = earliest(next, mrt_channels[i].expiry_cycle);
+        }
+    }
+    return cycle_to_ns(next);
+}
+
+
+// ****************************************************************************
+static uint64_t mrt_read(volatile void *address, unsigned int size)
+{
+    uint64_t now = now_cycle();
+    uint32_t flags = 0;
+    uint32_t idle = 0;
+    unsigned int i;
+
+    (void) address;
+    (void) size;
+
+    for (i = 0; i < MRT_CHANNELS; i++) {
+        mrt_channel_t *channel = &mrt_channels[i];
+
+        LPC_MRT->Channel[i].STAT =
+            (channel->interrupt ? MRT_STAT_INTFLAG : 0) |
+            (channel->running ? MRT_STAT_RUN : 0);
+        LPC_MRT->Channel[i].TIMER = channel->running ?
+            channel->expiry_cycle - now - 1 : MRT_INTVAL_IVALUE;
+
+        if (channel->interrupt) {
+            flags |= 1 << i;
+        }
+    }
+
+    // The lowest idle channel
+    for (i = MRT_CHANNELS; i-- > 0;) {
+        if (!mrt_channels[i].running) {
+            idle = i << 4;
+        }
+    }
+    LPC_MRT->IRQ_FLAG = flags;
+    LPC_MRT->IDLE_CH = idle;
+
+    return mrt_next_event_ns();
+}
+
+
+// ****************************************************************************
+// Loading INTVAL starts an idle channel right away. A running one continues
+// with the new interval after its current one, unless LOAD is set.
+// ****************************************************************************
+static void mrt_load(unsigned int i)
+{
+    mrt_channel_t *channel = &mrt_channels[i];
+    uint32_t intval = LPC_MRT->Channel[i].INTVAL;
+
+    channel->interval = intval & MRT_INTVAL_IVALUE;
+    LPC_MRT->Channel[i].INTVAL = channel->interval;
+
+    if (channel->running && !(intval & MRT_INTVAL_LOAD)) {
+        return;
+    }
+
+    channel->running = (channel->interval != 0);
+    channel->expiry_cycle = now_cycle() + channel->interval;
+
+    // Bus-stall mode: the write itself takes until the timer expires
+    if (channel->running &&
+            MRT_CTRL_MODE(LPC_MRT->Channel[i].CTRL) == MRT_MODE_BUS_STALL) {
+        mcu_wait_until(cycle_to_ns(channel->expiry_cycle));
+        mrt_update();
+    }
+}
+
+
+// ****************************************************************************
+static void mrt_write(volatile void *address, unsigned int size)
+{
+    unsigned int i;
+
+    (void) size;
+
+    for (i = 0; i < MRT_CHANNELS; i++) {
+        if (address == &LPC_MRT->Channel[i].INTVAL) {
+            mrt_load(i);
+        }
+        else if (address == &LPC_MRT->Channel[i].STAT &&
+                (LPC_MRT->Channel[i].STAT & MRT_STAT_INTFLAG)) {
+            mrt_channels[i].interrupt = false;
+        }
+        else if (address == &LPC_MRT->IRQ_FLAG &&
+                (LPC_MRT->IRQ_FLAG & (1 << i))) {
+            mrt_channels[i].interrupt = false;
+        }
+    }
+    mrt_update_irq();
+}
+
+
+// ****************************************************************************
+static void mrt_reset(void)
+{
+    memset(&host_mrt, 0, sizeof(host_mrt));
+    memset(mrt_channels, 0, sizeof(mrt_channels));
+}
+
+
+// ****************************************************************************
+// Pin interrupts, edge sensitive only
+// ****************************************************************************
+static void pin_int_update_irq(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < PIN_INT_CHANNELS; i++) {
+        mcu_set_irq_level(PININT0_IRQn + i, (pin_int_ist >> i) & 1);
+    }
+}
+
+
+// ****************************************************************************
+static void pin_int_edge(unsigned int pin, bool rising)
+{
+    unsigned int i;
+
+    for (i = 0; i < PIN_INT_CHANNELS; i++) {
+        uint32_t bit = 1 << i;
+
+        if (LPC_SYSCON->PINTSEL[i] != pin || (LPC_PIN_INT->ISEL & bit)) {
+            continue;
+        }
+
+        if (rising) {
+            pin_int_rise |= bit;
+            if (LPC_PIN_INT->IENR & bit) {
+                pin_int_ist |= bit;
+            }
+        }
+        else {
+            pin_int_fall |= bit;
+            if (LPC_PIN_INT->IENF & bit) {
+                pin_int_ist |= bit;
+            }
+        }
+    }
+    pin_int_update_irq();
+}
+
+
+// ****************************************************************************
+static void pin_int_update(void)
+{
+}
+
+
+// ****************************************************************************
+static uint64_t pin_int_read(volatile void *address, unsigned int size)
+{
+    (void) address;
+    (void) size;
+
+    LPC_PIN_INT->RISE = pin_int_rise;
+    LPC_PIN_INT->FALL = pin_int_fall;
+    LPC_PIN_INT->IST = pin_int_ist;
+    return MCU_NEVER;
+}
+
+
+// ****************************************************************************
+static void pin_int_write(volatile void *address, unsigned int size)
+{
+    (void) size;
+
+    if (address == &LPC_PIN_INT->SIENR) {
+        LPC_PIN_INT->IENR |= LPC_PIN_INT->SIENR;
+    }
+    else if (address == &LPC_PIN_INT->CIENR) {
+        LPC_PIN_INT->IENR &= ~LPC_PIN_INT->CIENR;
+    }
+    else if (address == &LPC_PIN_INT->SIENF) {
+        LPC_PIN_INT->IENF |= LPC_PIN_INT->SIENF;
+    }
+    else if (address == &LPC_PIN_INT->CIENF) {
+        LPC_PIN_INT->IENF &= ~LPC_PIN_INT->CIENF;
+    }
+    else if (address == &LPC_PIN_INT->RISE) {
+        pin_int_rise &= ~LPC_PIN_INT->RISE;
+    }
+    else if (address == &LPC_PIN_INT->FALL) {
+        pin_int_fall &= ~LPC_PIN_INT->FALL;
+    }
+    else if (address == &LPC_PIN_INT->IST) {
+        // In edge mode this also clears the edge detection
+        pin_int_ist &= ~LPC_PIN_INT->IST;
+        pin_int_rise &= ~LPC_PIN_INT->IST;
+        pin_int_fall &= ~LPC_PIN_INT->IST;
+    }
+
+    LPC_PIN_INT->SIENR = 0;
+    LPC_PIN_INT->CIENR = 0;
+    LPC_PIN_INT->SIENF = 0;
+    LPC_PIN_INT->CIENF = 0;
+    pin_int_update_irq();
+}
+
+
+// ****************************************************************************
+// Watchdog: the main loop feeds it once per iteration
+// ****************************************************************************
+static void wwdt_update(void)
+{
+}
+
+
+// ****************************************************************************
+static uint64_t wwdt_read(volatile void *address, unsigned int size)
+{
+    (void) address;
+    (void) size;
+
+    return MCU_NEVER;
+}
+
+
+// ****************************************************************************
+static void wwdt_write(volatile void *address, unsigned int size)
+{
+    (void) size;
+
+    if (address != &LPC_WWDT->FEED) {
+        return;
+    }
+
+    if (LPC_WWDT->FEED == 0x55 && wwdt_feed_started) {
+        wwdt_feed_started = false;
+        mcu_end_of_main_loop();
+        return;
+    }
+    wwdt_feed_started = (LPC_WWDT->FEED == 0xaa);
+}
+
+
+// ****************************************************************************
+// IAP commands of the boot ROM, for the flash page of persistent_data. The
+// firmware calls them with interrupts disabled; the CPU is busy while the
+// flash is erased and programmed.
+// ****************************************************************************
+static void iap(unsigned int command[], unsigned int result[])
+{
+    unsigned int address = (unsigned int)(uintptr_t)persistent_data;
+    volatile uint8_t *flash = (volatile uint8_t *)persistent_data;
+    const uint8_t *source;
+    unsigned int i;
+
+    switch (command[0]) {
+        case IAP_PREPARE_SECTORS:
+            if (command[1] > command[2]) {
+                result[0] = IAP_INVALID_SECTOR;
+                return;
+            }
+            flash_prepared = (command[1] <= (address >> 10)) &&
+                ((address >> 10) <= command[2]);
+            result[0] = IAP_CMD_SUCCESS;
+            return;
+
+        case IAP_ERASE_PAGE:
+            if (!flash_prepared) {
+                result[0] = IAP_SECTOR_NOT_PREPARED;
+                return;
+            }
+            if (command[1] <= (address >> 6) && (address >> 6) <= command[2]) {
+                for (i = 0; i < NUMBER_OF_PERSISTENT_ELEMENTS; i++) {
+                    flash[i] = 0xff;
+                }
+            }
+            mcu_wait_until(mcu_get_time_ns() + FLASH_ERASE_NS);
+            flash_prepared = false;
+            result[0] = IAP_CMD_SUCCESS;
+            return;
+
+        case IAP_COPY_RAM_TO_FLASH:
+            if (!flash_prepared) {
+                result[0] = IAP_SECTOR_NOT_PREPARED;
+                return;
+            }
+            if (command[1] != address) {
+                result[0] = IAP_DST_ADDR_NOT_MAPPED;
+                return;
+            }
+            if (command[2] & 0x3) {
+                result[0] = IAP_SRC_ADDR_ERROR;
+                return;
+            }
+            if (command[3] != 64 && command[3] != 128 && command[3] != 256 &&
+                    command[3] != 512 && command[3] != 1024) {
+                result[0] = IAP_COUNT_ERROR;
+                return;
+            }
+
+            // Programming can only clear bits
+            source = (const uint8_t *)(uintptr_t)command[2];
+            for (i = 0; i < NUMBER_OF_PERSISTENT_ELEMENTS; i++) {
+                flash[i] &= source[i];
+            }
+            mcu_wait_until(mcu_get_time_ns() + FLASH_PROGRAM_NS);
+            flash_prepared = false;
+            result[0] = IAP_CMD_SUCCESS;
+            return;
+
+        case IAP_REINVOKE_ISP:
+            mcu_halt();
+            return;
+
+        default:
+            result[0] = IAP_INVALID_COMMAND;
+            return;
+    }
+}
+
+
+// ****************************************************************************
+static mcu_peripheral_t syscon_peripheral = {
+    .base = &host_syscon, .size = sizeof(host_syscon),
+    .update = syscon_update, .read = syscon_read, .write = syscon_write
+};
+
+static mcu_peripheral_t sct_peripheral = {
+    .base = &host_sct, .size = sizeof(host_sct),
+    .update = sct_update, .read = sct_read, .write = sct_write
+};
+
+static mcu_peripheral_t spi_peripheral = {
+    .base = &host_spi0, .size = sizeof(host_spi0),
+    .update = spi_update, .read = spi_read, .write = spi_write
+};
+
+static mcu_peripheral_t uart_peripheral = {
+    .base = &host_usart0, .size = sizeof(host_usart0),
+    .update = uart_update, .read = uart_read, .write = uart_write
+};
+
+static mcu_peripheral_t mrt_peripheral = {
+    .base = &host_mrt, .size = sizeof(host_mrt),
+    .update = mrt_update, .read = mrt_read, .write = mrt_write
+};
+
+static mcu_peripheral_t pin_int_peripheral = {
+    .base = &host_pin_int, .size = sizeof(host_pin_int),
+    .update = pin_int_update, .read = pin_int_read, .write = pin_int_write
+};
+
+static mcu_peripheral_t wwdt_peripheral = {
+    .base = &host_wwdt, .size = sizeof(host_wwdt),
+    .update = wwdt_update, .read = wwdt_read, .write = wwdt_write
+};
+
+
+// ****************************************************************************
+static void update_models(void)
+{
+    sct_update();
+    spi_update();
+    uart_update();
+    mrt_update();
+}
+
+
+// ****************************************************************************
+static uint64_t next_event_ns(void)
+{
+    uint64_t next = mcu_get_next_event_ns();
+
+    next = earliest(next, sct_next_event_ns());
+    next = earliest(next, spi_next_event_ns());
+    next = earliest(next, uart_next_event_ns());
+    next = earliest(next, mrt_next_event_ns());
+    return next;
+}
+
+
+// ****************************************************************************
+// Power-on reset. The firmware starts with the first port_run_main_loop();
+// init_receiver() runs after the 20 ms start-up delay of main().
+// ****************************************************************************
+void port_reset(const uint8_t *bind_data)
+{
+    volatile uint8_t *flash = (volatile uint8_t *)persistent_data;
+    unsigned int i;
+
+    memset(&host_syscon, 0, sizeof(host_syscon));
+    memset(&host_iocon, 0, sizeof(host_iocon));
+    memset(&host_flashctrl, 0, sizeof(host_flashctrl));
+    memset(&host_swm, 0, sizeof(host_swm));
+    memset((void *)&host_gpio_port, 0, sizeof(host_gpio_port));
+    memset(&host_pin_int, 0, sizeof(host_pin_int));
+    memset(&host_wwdt, 0, sizeof(host_wwdt));
+
+    LPC_SYSCON->PDRUNCFG = 0xedf0;
+    LPC_SYSCON->SYSAHBCLKDIV = 1;
+    syscon_pdruncfg = LPC_SYSCON->PDRUNCFG;
+    pll_lock_ns = 0;
+
+    sct_reset();
+    spi_reset();
+    uart_reset();
+    mrt_reset();
+    pin_int_rise = 0;
+    pin_int_fall = 0;
+    pin_int_ist = 0;
+    wwdt_feed_started = false;
+    flash_prepared = false;
+
+    // The bind button has a pull-up, so it reads as released
+    GPIO_BIND = 1;
+
+    for (i = 0; i < NUMBER_OF_PERSISTENT_ELEMENTS; i++) {
+        flash[i] = bind_data[i];
+    }
+
+    time_ns = 0;
+    mcu_reset(CPU_CLOCK_MHZ, POLL_CYCLES);
+    mcu_add_peripheral(&syscon_peripheral);
+    mcu_add_peripheral(&sct_peripheral);
+    mcu_add_peripheral(&spi_peripheral);
+    mcu_add_peripheral(&uart_peripheral);
+    mcu_add_peripheral(&mrt_peripheral);
+    mcu_add_peripheral(&pin_int_peripheral);
+    mcu_add_peripheral(&wwdt_peripheral);
+    mcu_add_systick(&host_systick);
+
+    mcu_set_handler(SysTick_IRQn, SysTick_handler);
+    mcu_set_handler(PININT0_IRQn, PININT0_irq_handler);
+    mcu_set_handler(SCT_IRQn, SCT_irq_handler);
+    mcu_set_handler(SPI0_IRQn, SPI0_irq_handler);
+
+    nrf24l01_reset();
+}
+
+
+// ****************************************************************************
+uint32_t port_time_to_next_event(void)
+{
+    uint64_t next = next_event_ns();
+
+    if (next == MCU_NEVER) {
+        return UINT32_MAX;
+    }
+    if (next <= time_ns + 1000) {
+        return 1;
+    }
+    return (next - time_ns + 999) / 1000;
+}
+
+
+// ****************************************************************************
+// Advance in steps from one model event to the next, running the interrupt
+// handlers that become pending on the way
+// ****************************************************************************
+void port_advance(uint32_t microseconds)
+{
+    uint64_t end = time_ns + (uint64_t)microseconds * 1000;
+
+    while (1) {
+        uint64_t next = next_event_ns();
+
+        if (next > end) {
+            break;
+        }
+        if (next > time_ns) {
+            time_ns = next;
+        }
+
+        mcu_set_simulation_time(time_ns);
+        update_models();
+        mcu_dispatch_interrupts();
+    }
+
+    time_ns = end;
+    mcu_set_simulation_time(time_ns);
+    update_models();
+    mcu_dispatch_interrupts();
+}
+
+
+// ****************************************************************************
+void port_rf_interrupt(void)
+{
+    sct_pin_edge(GPIO_BIT_NRF_IRQ, false);
+    pin_int_edge(GPIO_BIT_NRF_IRQ, false);
+    mcu_dispatch_interrupts();
+}
+
+
+// ****************************************************************************
+uint32_t port_run_main_loop(void)
+{
+    return mcu_run();
+}
+
+
+// ****************************************************************************
+bool port_is_main_loop_complete(void)
+{
+    return mcu_is_main_loop_complete();
+}
+
+
+// ****************************************************************************
+uint32_t port_get_spi_clock(void)
+{
+    return __SYSTEM_CLOCK / ((LPC_SPI0->DIV & 0xffff) + 1);
+}
+
+
+// ****************************************************************************
+uint32_t port_get_spi_polls(void)
+{
+    return spi_peripheral.polls;
+}
+
+
+// ****************************************************************************
+uint16_t port_stick_to_channel(uint16_t stick)
+{
+    return 0xffff - stick;
+}
+
+
+// ****************************************************************************
+void port_set_bind_button(bool pressed)
+{
+    GPIO_BIND = pressed ? 0 : 1;
+}
+
+
+// ****************************************************************************
+bool port_binds_on_button_release(void)
+{
+    return true;
+}
+
+
+// ****************************************************************************
+const char *port_get_name(void)
+{
+    return "lpc812_mcu";
+}
+
+
+// ****************************************************************************
+const char *port_get_output_model(void)
+{
+    return "register model of the SCTimer H, the outputs change exactly on the timer tick";
+}
+
+
+// ****************************************************************************
+bool port_has_output(unsigned int output)
+{
+    return output < NUMBER_OF_CHANNELS;
+}
+
+
+// ****************************************************************************
+void port_set_edge_callback(port_edge_callback_t callback)
+{
+    edge_callback = callback;
+}
+
+
+// ****************************************************************************
+// channels[] holds the pulse width in SCTimer H ticks
+// ****************************************************************************
+uint32_t port_channel_to_pulse_ns(uint16_t channel)
+{
+    return mcu_cycles_to_ns((uint64_t)channel * SCT_CTRL_PRE(LPC_SCT->CTRL_H));
+}
+
+
+// ****************************************************************************
+bool nrf24l01_ce(void)
+{
+    return GPIO_NRF_CE != 0;
+}
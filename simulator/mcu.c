@@ -0,0 +1,761 @@
+/******************************************************************************
+
+    Runtime for running the unmodified firmware of a port on the host,
+    including main.c with its busy-wait loops and interrupt handlers.
+
+    The firmware sources are compiled with -fsanitize=thread, but instead of
+    the ThreadSanitizer library this file provides the __tsan_* functions
+    the compiler calls before every memory access. Accesses that fall into
+    a registered peripheral go to its model:
+
+    - Before each access, the model is brought up to date with the
+      current time, and before a read it puts the register value in place.
+    - A write is passed to the model at the next access or function
+      return, when the value has arrived in memory.
+
+    A read of the same register by the same instruction twice in a row is
+    a busy-wait loop. Instead of spinning, the CPU skips ahead to the time
+    the model says the register changes next.
+
+    main() of the firmware runs as a coroutine. When it has to wait for
+    longer than the current microsecond it returns control to the
+    simulation, which advances the peripheral models and runs interrupt
+    handlers in the meantime, just like the hardware does. Interrupt
+    handlers that the simulation starts while main() is suspended run on the
+    host stack; when they busy-wait, the CPU time simply runs ahead of the
+    simulation, and main() continues only after that.
+
+    The NVIC is modelled with enable, pending and active state, priorities
+    and PRIMASK, so __disable_irq() defers interrupts the same way it does
+    on the hardware.
+
+    The SysTick timer is part of the core and modelled here as well.
+
+    The code the firmware executes between register accesses takes no time.
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ucontext.h>
+
+#include <mcu.h>
+
+
+#define MAX_PERIPHERALS 16
+#define FIRMWARE_STACK_SIZE (1024 * 1024)
+
+#define SYSTICK_IRQ (-1)
+#define SYSTICK_CTRL 0
+#define SYSTICK_LOAD 1
+#define SYSTICK_VAL 2
+#define SYSTICK_CTRL_ENABLE (1 << 0)
+#define SYSTICK_CTRL_TICKINT (1 << 1)
+#define SYSTICK_CTRL_CLKSOURCE (1 << 2)
+#define SYSTICK_CTRL_COUNTFLAG (1 << 16)
+#define SYSTICK_MAX_VALUE 0xffffff
+
+// Lower than all priorities the NVIC supports
+#define THREAD_PRIORITY 0x100
+
+#define IRQ_BIT(irq) (1ull << ((irq) - MCU_FIRST_IRQ))
+#define EXCEPTIONS (IRQ_BIT(0) - 1)
+
+
+static mcu_peripheral_t *peripherals[MAX_PERIPHERALS];
+static unsigned int number_of_peripherals;
+static uintptr_t lowest_address;
+static uintptr_t highest_address;
+
+static void (* handlers[MCU_NUMBER_OF_IRQS])(void);
+static uint32_t priorities[MCU_NUMBER_OF_IRQS];
+static uint64_t irq_enabled;
+static uint64_t irq_level;
+static uint64_t irq_pending;
+static uint64_t irq_active;
+static uint32_t current_priority;
+static bool primask;
+
+static uint32_t cycles_per_us;
+static unsigned int cycles_per_poll;
+static uint64_t simulation_time_ns;
+static uint64_t cpu_time_ns;
+
+static ucontext_t simulation_context;
+static ucontext_t firmware_context;
+static bool firmware_running;
+static bool halted;
+static uint32_t busy_us;
+static bool main_loop_complete;
+
+// Statically allocated so that, like all firmware data, it lies in the
+// lower 4 GB when linked with -no-pie. The LPC812 firmware passes RAM
+// addresses to the IAP as unsigned int.
+static uint8_t firmware_stack[FIRMWARE_STACK_SIZE] __attribute__ ((aligned (16)));
+
+static mcu_peripheral_t systick_peripheral;
+static volatile uint32_t *systick;
+static bool systick_enabled;
+static bool systick_countflag;
+static uint32_t systick_value;
+static uint64_t systick_zero_cycle;
+static uint64_t systick_zero_ns;
+
+static mcu_peripheral_t *pending_write_peripheral;
+static volatile void *pending_write_address;
+static unsigned int pending_write_size;
+static volatile void *last_read_address;
+static void *last_read_instruction;
+
+
+// ****************************************************************************
+static void fatal(const char *message)
+{
+    fprintf(stderr, "mcu: %s at %.6f s\n", message, cpu_time_ns / 1e9);
+    exit(1);
+}
+
+
+// ****************************************************************************
+// Return to the simulation, which resumes the firmware when the given
+// number of microseconds has passed, or at the next event if 0
+// ****************************************************************************
+static void yield(uint32_t microseconds)
+{
+    busy_us = microseconds;
+    firmware_running = false;
+    swapcontext(&firmware_context, &simulation_context);
+    firmware_running = true;
+}
+
+
+// ****************************************************************************
+static void firmware_entry(void)
+{
+    firmware_main();
+
+    fatal("main() of the firmware returned");
+}
+
+
+// ****************************************************************************
+void mcu_reset(uint32_t cpu_clock_mhz, unsigned int poll_cycles)
+{
+    unsigned int i;
+
+    number_of_peripherals = 0;
+    lowest_address = UINTPTR_MAX;
+    highest_address = 0;
+
+    for (i = 0; i < MCU_NUMBER_OF_IRQS; i++) {
+        handlers[i] = NULL;
+        priorities[i] = 0;
+    }
+    irq_enabled = EXCEPTIONS;
+    irq_level = 0;
+    irq_pending = 0;
+    irq_active = 0;
+    current_priority = THREAD_PRIORITY;
+    primask = false;
+
+    cycles_per_us = cpu_clock_mhz;
+    cycles_per_poll = poll_cycles;
+    simulation_time_ns = 0;
+    cpu_time_ns = 0;
+
+    pending_write_peripheral = NULL;
+    last_read_address = NULL;
+
+    systick = NULL;
+    systick_enabled = false;
+    systick_zero_ns = MCU_NEVER;
+
+    // Called from the simulation, so the old stack is not in use
+    getcontext(&firmware_context);
+    firmware_context.uc_stack.ss_sp = firmware_stack;
+    firmware_context.uc_stack.ss_size = FIRMWARE_STACK_SIZE;
+    firmware_context.uc_link = NULL;
+    makecontext(&firmware_context, firmware_entry, 0);
+    firmware_running = false;
+    halted = false;
+}
+
+
+// ****************************************************************************
+void mcu_add_peripheral(mcu_peripheral_t *peripheral)
+{
+    uintptr_t base = (uintptr_t)peripheral->base;
+
+    if (number_of_peripherals == MAX_PERIPHERALS) {
+        fatal("too many peripherals");
+    }
+
+    peripheral->polls = 0;
+    peripherals[number_of_peripherals++] = peripheral;
+
+    if (base < lowest_address) {
+        lowest_address = base;
+    }
+    if (base + peripheral->size > highest_address) {
+        highest_address = base + peripheral->size;
+    }
+}
+
+
+// ****************************************************************************
+void mcu_set_handler(int irq, void (* handler)(void))
+{
+    handlers[irq - MCU_FIRST_IRQ] = handler;
+}
+
+
+// ****************************************************************************
+uint64_t mcu_get_time_ns(void)
+{
+    return cpu_time_ns;
+}
+
+
+// ****************************************************************************
+uint64_t mcu_cycles_to_ns(uint64_t cycles)
+{
+    return (cycles * 1000 + cycles_per_us - 1) / cycles_per_us;
+}
+
+
+// ****************************************************************************
+uint64_t mcu_ns_to_cycles(uint64_t time_ns)
+{
+    return time_ns * cycles_per_us / 1000;
+}
+
+
+// ****************************************************************************
+// Waits that end within the current microsecond of the simulation are done
+// right away; the CPU time may run ahead of the simulation by that much.
+// ****************************************************************************
+void mcu_wait_until(uint64_t time_ns)
+{
+    while (cpu_time_ns < time_ns) {
+        if (!firmware_running || time_ns < simulation_time_ns + 1000) {
+            cpu_time_ns = time_ns;
+            return;
+        }
+
+        yield((time_ns - simulation_time_ns + 999) / 1000);
+    }
+}
+
+
+// ****************************************************************************
+void mcu_halt(void)
+{
+    halted = true;
+    while (1) {
+        yield(0);
+    }
+}
+
+
+// ****************************************************************************
+void mcu_set_irq_level(int irq, bool level)
+{
+    uint64_t bit = IRQ_BIT(irq);
+
+    if (level) {
+        irq_level |= bit;
+        if (!(irq_active & bit)) {
+            irq_pending |= bit;
+        }
+    }
+    else {
+        irq_level &= ~bit;
+        irq_pending &= ~bit;
+    }
+}
+
+
+// ****************************************************************************
+void mcu_set_irq_pending(int irq)
+{
+    irq_pending |= IRQ_BIT(irq);
+}
+
+
+// ****************************************************************************
+// SysTick: the 24-bit counter counts down from LOAD to 0 and reloads on the
+// next clock, so the period is LOAD + 1 clocks. Reaching 0 sets COUNTFLAG
+// and, with TICKINT, pends the SysTick exception. Its clock is the CPU
+// clock, or the CPU clock divided by 8 without CLKSOURCE, as on the STM32F0.
+// ****************************************************************************
+static uint32_t systick_clock_divider(void)
+{
+    return (systick[SYSTICK_CTRL] & SYSTICK_CTRL_CLKSOURCE) ? 1 : 8;
+}
+
+
+// ****************************************************************************
+static uint64_t systick_period(void)
+{
+    return (uint64_t)((systick[SYSTICK_LOAD] & SYSTICK_MAX_VALUE) + 1) *
+        systick_clock_divider();
+}
+
+
+// ****************************************************************************
+static void systick_set_zero_cycle(uint64_t cycle)
+{
+    systick_zero_cycle = cycle;
+    systick_zero_ns = mcu_cycles_to_ns(cycle);
+}
+
+
+// ****************************************************************************
+static uint32_t systick_current_value(void)
+{
+    uint64_t remaining;
+
+    if (!systick_enabled) {
+        return systick_value;
+    }
+
+    remaining = (systick_zero_cycle - mcu_ns_to_cycles(cpu_time_ns)) /
+        systick_clock_divider();
+
+    // Right after a reload from 0 the counter still reads 0
+    if (remaining > (systick[SYSTICK_LOAD] & SYSTICK_MAX_VALUE)) {
+        return 0;
+    }
+    return remaining;
+}
+
+
+// ****************************************************************************
+static void systick_update(void)
+{
+    uint64_t now = mcu_ns_to_cycles(cpu_time_ns);
+
+    while (systick_enabled && systick_zero_cycle <= now) {
+        systick_countflag = true;
+        if (systick[SYSTICK_CTRL] & SYSTICK_CTRL_TICKINT) {
+            mcu_set_irq_pending(SYSTICK_IRQ);
+        }
+
+        // A LOAD value of 0 stops the counter at 0
+        if ((systick[SYSTICK_LOAD] & SYSTICK_MAX_VALUE) == 0) {
+            systick_enabled = false;
+            systick_value = 0;
+            systick_zero_ns = MCU_NEVER;
+            break;
+        }
+        systick_set_zero_cycle(systick_zero_cycle + systick_period());
+    }
+}
+
+
+// ****************************************************************************
+static uint64_t systick_read(volatile void *address, unsigned int size)
+{
+    (void) size;
+
+    if (address == &systick[SYSTICK_CTRL]) {
+        // COUNTFLAG clears when read
+        systick[SYSTICK_CTRL] = (systick[SYSTICK_CTRL] & ~SYSTICK_CTRL_COUNTFLAG) |
+            (systick_countflag ? SYSTICK_CTRL_COUNTFLAG : 0);
+        systick_countflag = false;
+    }
+    else if (address == &systick[SYSTICK_VAL]) {
+        systick[SYSTICK_VAL] = systick_current_value();
+    }
+
+    return systick_zero_ns;
+}
+
+
+// ****************************************************************************
+static void systick_write(volatile void *address, unsigned int size)
+{
+    uint64_t now = mcu_ns_to_cycles(cpu_time_ns);
+    bool enable = systick[SYSTICK_CTRL] & SYSTICK_CTRL_ENABLE;
+
+    (void) size;
+
+    if (address == &systick[SYSTICK_VAL]) {
+        // Any write clears the counter and COUNTFLAG
+        systick_value = 0;
+        systick_countflag = false;
+        if (systick_enabled) {
+            systick_set_zero_cycle(now + systick_period());
+        }
+    }
+    else if (address == &systick[SYSTICK_CTRL]) {
+        if (enable && !systick_enabled) {
+            systick_set_zero_cycle(now + (systick_value ?
+                (uint64_t)systick_value * systick_clock_divider() :
+                systick_period()));
+        }
+        else if (!enable && systick_enabled) {
+            systick_value = systick_current_value();
+            systick_zero_ns = MCU_NEVER;
+        }
+        systick_enabled = enable;
+        systick[SYSTICK_CTRL] &= ~SYSTICK_CTRL_COUNTFLAG;
+    }
+}
+
+
+// ****************************************************************************
+void mcu_add_systick(volatile void *registers)
+{
+    systick = registers;
+    systick[SYSTICK_CTRL] = 0;
+    systick[SYSTICK_LOAD] = 0;
+    systick[SYSTICK_VAL] = 0;
+    systick_enabled = false;
+    systick_countflag = false;
+    systick_value = 0;
+    systick_zero_ns = MCU_NEVER;
+
+    systick_peripheral.base = registers;
+    systick_peripheral.size = 4 * sizeof(uint32_t);
+    systick_peripheral.update = systick_update;
+    systick_peripheral.read = systick_read;
+    systick_peripheral.write = systick_write;
+    mcu_add_peripheral(&systick_peripheral);
+}
+
+
+// ****************************************************************************
+uint64_t mcu_get_next_event_ns(void)
+{
+    return systick_zero_ns;
+}
+
+
+// ****************************************************************************
+static void flush_pending_write(void)
+{
+    mcu_peripheral_t *peripheral = pending_write_peripheral;
+
+    if (peripheral == NULL) {
+        return;
+    }
+
+    pending_write_peripheral = NULL;
+    peripheral->write(pending_write_address, pending_write_size);
+}
+
+
+// ****************************************************************************
+static void run_handler(unsigned int index)
+{
+    uint64_t bit = 1ull << index;
+    uint32_t interrupted_priority = current_priority;
+
+    if (handlers[index] == NULL) {
+        fatal("interrupt without handler");
+    }
+
+    irq_pending &= ~bit;
+    irq_active |= bit;
+    current_priority = priorities[index];
+    last_read_address = NULL;
+
+    handlers[index]();
+    flush_pending_write();
+
+    current_priority = interrupted_priority;
+    last_read_address = NULL;
+    irq_active &= ~bit;
+    if (irq_level & bit) {
+        irq_pending |= bit;
+    }
+}
+
+
+// ****************************************************************************
+// Run the pending interrupt handlers that may preempt what the CPU is
+// doing, highest priority (lowest number) first
+// ****************************************************************************
+void mcu_dispatch_interrupts(void)
+{
+    while (!primask) {
+        uint64_t ready = irq_pending & irq_enabled;
+        int best = -1;
+        int i;
+
+        for (i = 0; ready; i++, ready >>= 1) {
+            if ((ready & 1) && priorities[i] < current_priority &&
+                    (best < 0 || priorities[i] < priorities[best])) {
+                best = i;
+            }
+        }
+
+        if (best < 0) {
+            return;
+        }
+
+        run_handler(best);
+    }
+}
+
+
+// ****************************************************************************
+void mcu_end_of_main_loop(void)
+{
+    if (firmware_running && current_priority == THREAD_PRIORITY) {
+        main_loop_complete = true;
+        yield(0);
+    }
+}
+
+
+// ****************************************************************************
+void mcu_set_simulation_time(uint64_t time_ns)
+{
+    simulation_time_ns = time_ns;
+    if (cpu_time_ns < simulation_time_ns) {
+        cpu_time_ns = simulation_time_ns;
+    }
+    if (cpu_time_ns >= systick_zero_ns) {
+        systick_update();
+    }
+}
+
+
+// ****************************************************************************
+uint32_t mcu_run(void)
+{
+    if (halted) {
+        return 0;
+    }
+
+    main_loop_complete = false;
+
+    // Still busy in an interrupt handler that ran ahead of the simulation
+    if (cpu_time_ns >= simulation_time_ns + 1000) {
+        return (cpu_time_ns - simulation_time_ns) / 1000;
+    }
+
+    busy_us = 0;
+    firmware_running = true;
+    swapcontext(&simulation_context, &firmware_context);
+    return busy_us;
+}
+
+
+// ****************************************************************************
+bool mcu_is_main_loop_complete(void)
+{
+    return main_loop_complete;
+}
+
+
+// ****************************************************************************
+void mcu_enable_irq(int irq)
+{
+    flush_pending_write();
+    irq_enabled |= IRQ_BIT(irq);
+    mcu_dispatch_interrupts();
+}
+
+
+// ****************************************************************************
+void mcu_disable_irq(int irq)
+{
+    irq_enabled &= ~IRQ_BIT(irq) | EXCEPTIONS;
+}
+
+
+// ****************************************************************************
+// The Cortex-M0 has 2 priority bits, in the upper bits of the byte
+// ****************************************************************************
+void mcu_set_priority(int irq, uint32_t priority)
+{
+    priorities[irq - MCU_FIRST_IRQ] = priority & 0x3;
+}
+
+
+// ****************************************************************************
+void mcu_enable_interrupts(void)
+{
+    flush_pending_write();
+    primask = false;
+    mcu_dispatch_interrupts();
+}
+
+
+// ****************************************************************************
+void mcu_disable_interrupts(void)
+{
+    flush_pending_write();
+    primask = true;
+}
+
+
+// ****************************************************************************
+static mcu_peripheral_t *find_peripheral(volatile void *address)
+{
+    uintptr_t a = (uintptr_t)address;
+    unsigned int i;
+
+    if (a < lowest_address || a >= highest_address) {
+        return NULL;
+    }
+
+    for (i = 0; i < number_of_peripherals; i++) {
+        if (a - (uintptr_t)peripherals[i]->base < peripherals[i]->size) {
+            return peripherals[i];
+        }
+    }
+    return NULL;
+}
+
+
+// ****************************************************************************
+static void read_register(mcu_peripheral_t *peripheral,
+    volatile void *address, unsigned int size, void *instruction)
+{
+    bool polling = (address == last_read_address &&
+        instruction == last_read_instruction);
+    uint64_t start = cpu_time_ns;
+    uint64_t next;
+
+    last_read_address = address;
+    last_read_instruction = instruction;
+
+    peripheral->update();
+    next = peripheral->read(address, size);
+    if (!polling || next <= cpu_time_ns) {
+        return;
+    }
+
+    if (next != MCU_NEVER) {
+        mcu_wait_until(next);
+    }
+    else if (firmware_running) {
+        yield(0);
+    }
+    else {
+        fatal("interrupt handler waits for a register that never changes");
+    }
+
+    peripheral->polls += mcu_ns_to_cycles(cpu_time_ns - start) / cycles_per_poll;
+
+    if (cpu_time_ns >= systick_zero_ns) {
+        systick_update();
+    }
+    if (irq_pending & irq_enabled) {
+        mcu_dispatch_interrupts();
+        last_read_address = address;
+    }
+    peripheral->update();
+    peripheral->read(address, size);
+}
+
+
+// ****************************************************************************
+static void access(volatile void *address, unsigned int size, bool write,
+    void *instruction)
+{
+    mcu_peripheral_t *peripheral;
+
+    flush_pending_write();
+    if (cpu_time_ns >= systick_zero_ns) {
+        systick_update();
+    }
+    if (irq_pending & irq_enabled) {
+        mcu_dispatch_interrupts();
+    }
+
+    peripheral = find_peripheral(address);
+    if (peripheral == NULL) {
+        return;
+    }
+
+    // The write takes effect on the model as it was before
+    if (write) {
+        peripheral->update();
+        pending_write_peripheral = peripheral;
+        pending_write_address = address;
+        pending_write_size = size;
+        last_read_address = NULL;
+        return;
+    }
+
+    read_register(peripheral, address, size, instruction);
+}
+
+
+// ****************************************************************************
+// Entry points of the compiler instrumentation
+// ****************************************************************************
+#define TSAN_ACCESS(name, size, write) \
+    void name(void *address); \
+    void name(void *address) \
+    { \
+        access(address, size, write, __builtin_return_address(0)); \
+    }
+
+#define TSAN_ACCESS_SIZES(prefix) \
+    TSAN_ACCESS(prefix##read1, 1, false) \
+    TSAN_ACCESS(prefix##read2, 2, false) \
+    TSAN_ACCESS(prefix##read4, 4, false) \
+    TSAN_ACCESS(prefix##read8, 8, false) \
+    TSAN_ACCESS(prefix##read16, 16, false) \
+    TSAN_ACCESS(prefix##write1, 1, true) \
+    TSAN_ACCESS(prefix##write2, 2, true) \
+    TSAN_ACCESS(prefix##write4, 4, true) \
+    TSAN_ACCESS(prefix##write8, 8, true) \
+    TSAN_ACCESS(prefix##write16, 16, true)
+
+TSAN_ACCESS_SIZES(__tsan_)
+TSAN_ACCESS_SIZES(__tsan_unaligned_)
+TSAN_ACCESS_SIZES(__tsan_volatile_)
+TSAN_ACCESS_SIZES(__tsan_unaligned_volatile_)
+
+void __tsan_read_range(void *address, unsigned long size);
+void __tsan_write_range(void *address, unsigned long size);
+void __tsan_func_entry(void *caller);
+void __tsan_func_exit(void);
+void __tsan_init(void);
+
+
+// ****************************************************************************
+void __tsan_read_range(void *address, unsigned long size)
+{
+    access(address, size, false, __builtin_return_address(0));
+}
+
+
+// ****************************************************************************
+void __tsan_write_range(void *address, unsigned long size)
+{
+    access(address, size, true, __builtin_return_address(0));
+}
+
+
+// ****************************************************************************
+void __tsan_func_entry(void *caller)
+{
+    (void) caller;
+
+    flush_pending_write();
+}
+
+
+// ****************************************************************************
+void __tsan_func_exit(void)
+{
+    flush_pending_write();
+    if (irq_pending & irq_enabled) {
+        mcu_dispatch_interrupts();
+    }
+}
+
+
+// ****************************************************************************
+void __tsan_init(void)
+{
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// ****************************************************************************
+// Runtime for the MCU model ports, which run the unmodified firmware of a
+// port -- main.c included -- against register-level models of its
+// peripherals. See mcu.c for how register accesses reach the models.
+// ****************************************************************************
+
+// Time of an event that does not happen
+#define MCU_NEVER UINT64_MAX
+
+// Cortex-M0 exceptions have negative numbers, like IRQn_Type of CMSIS
+#define MCU_FIRST_IRQ (-16)
+#define MCU_NUMBER_OF_IRQS 48
+
+// A block of registers, or memory such as flash, of a peripheral model
+typedef struct {
+    volatile void *base;
+    size_t size;
+
+    // Called before every access of the firmware to the block. Brings the
+    // model up to date with mcu_get_time_ns().
+    void (* update)(void);
+
+    // Called after update() when the firmware reads from the block. Puts
+    // the current value into the register and returns the time at which it
+    // changes next without the firmware doing anything, or MCU_NEVER.
+    uint64_t (* read)(volatile void *address, unsigned int size);
+
+    // Called after the firmware has written to the block
+    void (* write)(volatile void *address, unsigned int size);
+
+    // Busy-wait loop iterations spent polling the block. The model counts
+    // the status register reads; the runtime adds the iterations of the
+    // waits it skips.
+    uint32_t polls;
+} mcu_peripheral_t;
+
+
+// Restart the firmware at firmware_main(), with a CPU clock of the given
+// frequency. One iteration of a busy-wait loop takes poll_cycles. All
+// peripherals and interrupt handlers must be registered again.
+void mcu_reset(uint32_t cpu_clock_mhz, unsigned int poll_cycles);
+
+void mcu_add_peripheral(mcu_peripheral_t *peripheral);
+void mcu_set_handler(int irq, void (* handler)(void));
+
+// The SysTick timer of the core, with its registers at the given address
+// (SysTick_Type of the host core header). Its interrupt is exception -1.
+void mcu_add_systick(volatile void *registers);
+
+// Time of the next SysTick interrupt, or MCU_NEVER
+uint64_t mcu_get_next_event_ns(void);
+
+// Time of the CPU in nanoseconds since mcu_reset(). It runs ahead of the
+// simulation while an interrupt handler busy-waits.
+uint64_t mcu_get_time_ns(void);
+
+// Conversion between CPU clock cycles and time, rounding up
+uint64_t mcu_cycles_to_ns(uint64_t cycles);
+uint64_t mcu_ns_to_cycles(uint64_t time_ns);
+
+// The CPU is busy until the given time, e.g. in an IAP call
+void mcu_wait_until(uint64_t time_ns);
+
+// The CPU stops executing the firmware, e.g. when it enters the ISP
+void mcu_halt(void);
+
+// Interrupt request lines of the peripherals. A level interrupt stays
+// pending while the line is active; mcu_set_irq_pending() is for edge
+// triggered ones such as SysTick.
+void mcu_set_irq_level(int irq, bool level);
+void mcu_set_irq_pending(int irq);
+
+// Called by the watchdog model when the main loop feeds the watchdog:
+// the iteration is complete, so port_run_main_loop() returns.
+void mcu_end_of_main_loop(void);
+
+// port.h glue: the simulation has advanced to the given time; run the
+// interrupt handlers that are pending. The peripheral models must be up to
+// date before dispatching.
+void mcu_set_simulation_time(uint64_t time_ns);
+void mcu_dispatch_interrupts(void);
+
+// Run the firmware until it waits for the next event or for longer than
+// the current microsecond. Returns the microseconds the CPU stays busy.
+uint32_t mcu_run(void);
+
+// Whether the last mcu_run() ended with the main loop feeding the watchdog,
+// rather than waiting in the middle of an iteration
+bool mcu_is_main_loop_complete(void);
+
+// Called by the CMSIS functions of the host core headers
+void mcu_enable_irq(int irq);
+void mcu_disable_irq(int irq);
+void mcu_set_priority(int irq, uint32_t priority);
+void mcu_enable_interrupts(void);
+void mcu_disable_interrupts(void);
+
+// main() of the firmware, renamed on the compiler command line
+int firmware_main(void);
@@ -0,0 +1,521 @@
+/******************************************************************************
+
+    Behavioural model of the nRF24L01+ as seen through its SPI interface.
+
+    Only the receive side is modelled, which is all the receivers use:
+    configuration registers, the 3-level RX FIFO, the STATUS/FIFO_STATUS
+    flags and the IRQ pin. Packets are put "on air" by calling
+    nrf24l01_receive_packet() at the time the transmission ends; they end up
+    in the RX FIFO only if the radio is powered up in RX mode with CE high
+    and has been tuned to the right channel and address for the whole
+    duration of the packet, including the PLL settling time.
+
+    All SPI traffic is counted so that the cost of firmware changes can be
+    measured on the host.
+
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <rf.h>
+#include <nrf24l01.h>
+
+
+#define STATUS_RX_P_NO_EMPTY (0x07 << 1)
+#define STATUS_IRQ_FLAGS (0x70)
+
+#define FIFO_STATUS_RX_EMPTY (1 << 0)
+#define FIFO_STATUS_RX_FULL (1 << 1)
+#define FIFO_STATUS_TX_EMPTY (1 << 4)
+
+
+static uint8_t registers[0x20];
+static uint8_t rx_address_p0[NRF24L01_MAX_ADDRESS_WIDTH];
+static uint8_t rx_address_p1[NRF24L01_MAX_ADDRESS_WIDTH];
+static uint8_t tx_address[NRF24L01_MAX_ADDRESS_WIDTH];
+
+static uint8_t rx_fifo[NRF24L01_RX_FIFO_DEPTH][NRF24L01_MAX_PAYLOAD_SIZE];
+static uint8_t rx_fifo_size[NRF24L01_RX_FIFO_DEPTH];
+static unsigned int rx_fifo_count;
+
+static nrf24l01_spi_statistics_t spi_statistics;
+
+static bool spi_selected;
+static unsigned int spi_count;
+static unsigned int spi_response_count;
+static uint8_t spi_bytes[NRF24L01_MAX_TRANSACTION_SIZE];
+static uint8_t spi_response[NRF24L01_MAX_TRANSACTION_SIZE];
+
+static uint64_t now;
+static uint64_t tuned_time;
+
+
+// ****************************************************************************
+// Returns the address register for the multi-byte address registers, or NULL
+// for all other registers.
+// ****************************************************************************
+static uint8_t *get_address_register(uint8_t reg)
+{
+    switch (reg) {
+        case RX_ADDR_P0:
+            return rx_address_p0;
+
+        case RX_ADDR_P1:
+            return rx_address_p1;
+
+        case TX_ADDR:
+            return tx_address;
+
+        default:
+            return NULL;
+    }
+}
+
+
+// ****************************************************************************
+static uint8_t get_address_width(void)
+{
+    return (registers[SETUP_AW] & 0x03) + 2;
+}
+
+
+// ****************************************************************************
+static void update_fifo_status(void)
+{
+    registers[STATUS] &= ~STATUS_RX_P_NO_EMPTY;
+    registers[FIFO_STATUS] = FIFO_STATUS_TX_EMPTY;
+
+    if (rx_fifo_count == 0) {
+        registers[STATUS] |= STATUS_RX_P_NO_EMPTY;
+        registers[FIFO_STATUS] |= FIFO_STATUS_RX_EMPTY;
+    }
+
+    if (rx_fifo_count == NRF24L01_RX_FIFO_DEPTH) {
+        registers[FIFO_STATUS] |= FIFO_STATUS_RX_FULL;
+    }
+}
+
+
+// ****************************************************************************
+static void pop_rx_fifo(void)
+{
+    unsigned int i;
+
+    if (rx_fifo_count == 0) {
+        return;
+    }
+
+    for (i = 1; i < rx_fifo_count; i++) {
+        memcpy(rx_fifo[i - 1], rx_fifo[i], NRF24L01_MAX_PAYLOAD_SIZE);
+        rx_fifo_size[i - 1] = rx_fifo_size[i];
+    }
+    --rx_fifo_count;
+    update_fifo_status();
+}
+
+
+// ****************************************************************************
+static void write_register(uint8_t reg, unsigned int count, const uint8_t *data)
+{
+    uint8_t *address;
+    unsigned int i;
+
+    if (count == 0) {
+        return;
+    }
+
+    address = get_address_register(reg);
+    if (address) {
+        for (i = 0; i < count && i < NRF24L01_MAX_ADDRESS_WIDTH; i++) {
+            address[i] = data[i];
+        }
+        if (reg == RX_ADDR_P0) {
+            tuned_time = now;
+        }
+        return;
+    }
+
+    switch (reg) {
+        case STATUS:
+            // Writing 1 clears the interrupt flags, all other bits read-only
+            registers[STATUS] &= ~(data[0] & STATUS_IRQ_FLAGS);
+            break;
+
+        case RF_CH:
+            registers[RF_CH] = data[0] & 0x7f;
+            tuned_time = now;
+            break;
+
+        case OBSERVE_TX:
+        case RPD:
+        case FIFO_STATUS:
+            // Read-only registers
+            break;
+
+        default:
+            if (reg < sizeof(registers)) {
+                registers[reg] = data[0];
+            }
+            break;
+    }
+}
+
+
+// ****************************************************************************
+static void read_register(uint8_t reg, unsigned int count, uint8_t *data)
+{
+    uint8_t *address;
+    unsigned int i;
+
+    address = get_address_register(reg);
+
+    for (i = 0; i < count; i++) {
+        if (address) {
+            data[i] = (i < NRF24L01_MAX_ADDRESS_WIDTH) ? address[i] : 0;
+        }
+        else if (reg < RX_ADDR_P2 || reg > RX_ADDR_P5 || i == 0) {
+            data[i] = registers[reg & 0x1f];
+        }
+        else {
+            data[i] = 0;
+        }
+    }
+}
+
+
+// ****************************************************************************
+void nrf24l01_reset(void)
+{
+    static const uint8_t default_address_p0[] = {0xe7, 0xe7, 0xe7, 0xe7, 0xe7};
+    static const uint8_t default_address_p1[] = {0xc2, 0xc2, 0xc2, 0xc2, 0xc2};
+
+    // Reset values according to the nRF24L01+ data sheet, chapter 9.1
+    memset(registers, 0, sizeof(registers));
+    registers[CONFIG] = EN_CRC;
+    registers[EN_AA] = 0x3f;
+    registers[EN_RXADDR] = 0x03;
+    registers[SETUP_AW] = 0x03;
+    registers[SETUP_RETR] = 0x03;
+    registers[RF_CH] = 0x02;
+    registers[RF_SETUP] = 0x0e;
+    registers[RX_ADDR_P2] = 0xc3;
+    registers[RX_ADDR_P3] = 0xc4;
+    registers[RX_ADDR_P4] = 0xc5;
+    registers[RX_ADDR_P5] = 0xc6;
+
+    memcpy(rx_address_p0, default_address_p0, NRF24L01_MAX_ADDRESS_WIDTH);
+    memcpy(rx_address_p1, default_address_p1, NRF24L01_MAX_ADDRESS_WIDTH);
+    memcpy(tx_address, default_address_p0, NRF24L01_MAX_ADDRESS_WIDTH);
+
+    rx_fifo_count = 0;
+    update_fifo_status();
+
+    memset(&spi_statistics, 0, sizeof(spi_statistics));
+    spi_selected = false;
+
+    now = 0;
+    tuned_time = 0;
+}
+
+
+// ****************************************************************************
+// Advance the time of the model. The time is used to decide whether the
+// radio has been on the right channel long enough to receive a packet.
+// ****************************************************************************
+void nrf24l01_set_time(uint64_t time_us)
+{
+    now = time_us;
+}
+
+
+// ****************************************************************************
+// Time on air of a packet with the current configuration: preamble, address,
+// 9 bit packet control field, payload and CRC.
+// ****************************************************************************
+uint32_t nrf24l01_get_airtime_us(uint8_t payload_size)
+{
+    uint8_t config = registers[CONFIG];
+    uint8_t rf_setup = registers[RF_SETUP];
+    uint32_t bits;
+    uint32_t bits_per_ms;
+
+    bits = (1 + get_address_width() + payload_size) * 8 + 9;
+    if (config & EN_CRC) {
+        bits += (config & CRC0) ? 16 : 8;
+    }
+
+    if (rf_setup & RF_DR_LOW) {
+        bits_per_ms = 250;
+    }
+    else if (rf_setup & RF_DR_HIGH) {
+        bits_per_ms = 2000;
+    }
+    else {
+        bits_per_ms = 1000;
+    }
+
+    return (bits * 1000 + bits_per_ms - 1) / bits_per_ms;
+}
+
+
+// ****************************************************************************
+// Process a complete SPI transaction (CSN low .. CSN high) in place: the
+// first byte returned is always the STATUS register.
+// ****************************************************************************
+static uint8_t process_transaction(unsigned int count, uint8_t *buffer)
+{
+    uint8_t cmd;
+    unsigned int i;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    ++spi_statistics.transactions;
+    spi_statistics.bytes += count;
+
+    cmd = buffer[0];
+    buffer[0] = registers[STATUS];
+
+    if (cmd <= (R_REGISTER | 0x1f)) {
+        read_register(cmd & 0x1f, count - 1, &buffer[1]);
+    }
+    else if (cmd <= (W_REGISTER | 0x1f)) {
+        write_register(cmd & 0x1f, count - 1, &buffer[1]);
+    }
+    else if (cmd == R_RX_PAYLOAD) {
+        if (rx_fifo_count) {
+            ++spi_statistics.payloads_read;
+        }
+        for (i = 1; i < count; i++) {
+            buffer[i] = (rx_fifo_count && (i - 1) < rx_fifo_size[0]) ?
+                rx_fifo[0][i - 1] : 0;
+        }
+        pop_rx_fifo();
+    }
+    else if (cmd == R_RX_PL_WID) {
+        if (count > 1) {
+            buffer[1] = rx_fifo_count ? rx_fifo_size[0] : 0;
+        }
+    }
+    else if (cmd == FLUSH_RX) {
+        rx_fifo_count = 0;
+        update_fifo_status();
+    }
+    else {
+        // FLUSH_TX, NOP and the TX related commands have no effect on the
+        // receive-only model
+    }
+
+    return buffer[0];
+}
+
+
+// ****************************************************************************
+// Process a complete SPI transaction with the interface of the
+// spi_transaction() functions of the firmware: the command byte, followed
+// by count data bytes from tx_data (zeros if NULL). The data bytes the chip
+// returns go to rx_data unless it is NULL. Returns the STATUS register.
+// ****************************************************************************
+uint8_t nrf24l01_spi_transaction(uint8_t command, unsigned int count,
+    const uint8_t *tx_data, uint8_t *rx_data)
+{
+    uint8_t buffer[NRF24L01_MAX_TRANSACTION_SIZE];
+    unsigned int i;
+
+    if (count > NRF24L01_MAX_TRANSACTION_SIZE - 1) {
+        count = NRF24L01_MAX_TRANSACTION_SIZE - 1;
+    }
+
+    buffer[0] = command;
+    for (i = 0; i < count; i++) {
+        buffer[i + 1] = tx_data ? tx_data[i] : 0;
+    }
+
+    process_transaction(count + 1, buffer);
+
+    if (rx_data) {
+        for (i = 0; i < count; i++) {
+            rx_data[i] = buffer[i + 1];
+        }
+    }
+
+    return buffer[0];
+}
+
+
+// ****************************************************************************
+// What the chip shifts out during a transaction with the given command: the
+// STATUS register followed by the data of the read commands
+// ****************************************************************************
+static void prepare_spi_response(uint8_t cmd)
+{
+    unsigned int i;
+
+    spi_response[0] = registers[STATUS];
+    spi_response_count = 1;
+
+    if (cmd <= (R_REGISTER | 0x1f)) {
+        read_register(cmd & 0x1f, NRF24L01_MAX_TRANSACTION_SIZE - 1,
+            &spi_response[1]);
+        spi_response_count = NRF24L01_MAX_TRANSACTION_SIZE;
+    }
+    else if (cmd == R_RX_PAYLOAD) {
+        for (i = 1; i < NRF24L01_MAX_TRANSACTION_SIZE; i++) {
+            spi_response[i] = (rx_fifo_count && (i - 1) < rx_fifo_size[0]) ?
+                rx_fifo[0][i - 1] : 0;
+        }
+        spi_response_count = NRF24L01_MAX_TRANSACTION_SIZE;
+    }
+    else if (cmd == R_RX_PL_WID) {
+        spi_response[1] = rx_fifo_count ? rx_fifo_size[0] : 0;
+        spi_response_count = 2;
+    }
+}
+
+
+// ****************************************************************************
+// CSN falling edge, for MCU models that clock the SPI bytes one by one
+// ****************************************************************************
+void nrf24l01_spi_select(void)
+{
+    spi_selected = true;
+    spi_count = 0;
+}
+
+
+// ****************************************************************************
+// Exchange one byte while CSN is low. The bytes the chip shifts out are
+// determined by the command byte; for the bytes of commands that do not
+// return data the model echoes what it receives, like
+// process_transaction() leaves them unchanged in the buffer.
+// ****************************************************************************
+uint8_t nrf24l01_spi_exchange(uint8_t data)
+{
+    unsigned int index = spi_count;
+
+    if (!spi_selected) {
+        return 0xff;
+    }
+
+    if (spi_count < NRF24L01_MAX_TRANSACTION_SIZE) {
+        spi_bytes[spi_count++] = data;
+    }
+
+    if (index == 0) {
+        prepare_spi_response(data);
+    }
+
+    return (index < spi_response_count) ? spi_response[index] : data;
+}
+
+
+// ****************************************************************************
+// CSN rising edge: the transaction takes effect
+// ****************************************************************************
+void nrf24l01_spi_deselect(void)
+{
+    if (spi_selected && spi_count) {
+        process_transaction(spi_count, spi_bytes);
+    }
+    spi_selected = false;
+}
+
+
+// ****************************************************************************
+// Offer a packet that was transmitted on the given channel to the radio.
+//
+// Returns true if the packet was accepted into the RX FIFO.
+// ****************************************************************************
+bool nrf24l01_receive_packet(uint8_t channel, const uint8_t *address,
+    uint8_t address_width, const uint8_t *payload, uint8_t payload_size)
+{
+    uint8_t config = registers[CONFIG];
+
+    if (!(config & PWR_UP) || !(config & PRIM_RX) || !nrf24l01_ce()) {
+        return false;
+    }
+
+    if (channel != registers[RF_CH]) {
+        return false;
+    }
+
+    // The radio must have settled on the channel before the packet started
+    if (now < tuned_time + NRF24L01_SETTLING_TIME_US +
+            nrf24l01_get_airtime_us(payload_size)) {
+        return false;
+    }
+
+    if (!(registers[EN_RXADDR] & DATA_PIPE_0)) {
+        return false;
+    }
+
+    if (address_width != get_address_width() ||
+            memcmp(address, rx_address_p0, address_width) != 0) {
+        return false;
+    }
+
+    // Fixed payload size only: a size mismatch results in a CRC error on
+    // the real chip, so the packet is dropped.
+    if (payload_size != registers[RX_PW_P0]) {
+        return false;
+    }
+
+    // Data sheet page 58: when the RX FIFO is full new packets are discarded
+    if (rx_fifo_count == NRF24L01_RX_FIFO_DEPTH) {
+        return false;
+    }
+
+    memcpy(rx_fifo[rx_fifo_count], payload, payload_size);
+    rx_fifo_size[rx_fifo_count] = payload_size;
+    ++rx_fifo_count;
+
+    registers[STATUS] |= RX_RD;
+    update_fifo_status();
+
+    return true;
+}
+
+
+// ****************************************************************************
+// The IRQ pin is active (low) when any interrupt flag is set whose source is
+// not masked in the CONFIG register.
+// ****************************************************************************
+bool nrf24l01_is_irq_active(void)
+{
+    uint8_t enabled = ~registers[CONFIG] & STATUS_IRQ_FLAGS;
+
+    return (registers[STATUS] & enabled) != 0;
+}
+
+
+// ****************************************************************************
+uint8_t nrf24l01_get_channel(void)
+{
+    return registers[RF_CH];
+}
+
+
+// ****************************************************************************
+uint8_t nrf24l01_get_register(uint8_t reg)
+{
+    return registers[reg & 0x1f];
+}
+
+
+// ****************************************************************************
+// Copies the address of data pipe 0 and returns its width
+// ****************************************************************************
+uint8_t nrf24l01_get_rx_address(uint8_t *address)
+{
+    memcpy(address, rx_address_p0, NRF24L01_MAX_ADDRESS_WIDTH);
+    return get_address_width();
+}
+
+
+// ****************************************************************************
+void nrf24l01_get_spi_statistics(nrf24l01_spi_statistics_t *statistics)
+{
+    *statistics = spi_statistics;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NRF24L01_RX_FIFO_DEPTH 3
+#define NRF24L01_MAX_PAYLOAD_SIZE 32
+#define NRF24L01_MAX_ADDRESS_WIDTH 5
+
+// Command byte and a full payload
+#define NRF24L01_MAX_TRANSACTION_SIZE (1 + NRF24L01_MAX_PAYLOAD_SIZE)
+
+// Data sheet page 22: Tstby2a, the PLL settling time before RX is active
+#define NRF24L01_SETTLING_TIME_US 130
+
+
+// SPI traffic counters, accumulated since the last nrf24l01_reset()
+typedef struct {
+    unsigned int transactions;
+    unsigned int bytes;
+    unsigned int payloads_read;
+} nrf24l01_spi_statistics_t;
+
+
+void nrf24l01_reset(void);
+void nrf24l01_set_time(uint64_t time_us);
+uint32_t nrf24l01_get_airtime_us(uint8_t payload_size);
+
+uint8_t nrf24l01_spi_transaction(uint8_t command, unsigned int count,
+    const uint8_t *tx_data, uint8_t *rx_data);
+
+// Byte level SPI interface for the MCU models
+void nrf24l01_spi_select(void);
+uint8_t nrf24l01_spi_exchange(uint8_t data);
+void nrf24l01_spi_deselect(void);
+
+bool nrf24l01_receive_packet(uint8_t channel, const uint8_t *address,
+    uint8_t address_width, const uint8_t *payload, uint8_t payload_size);
+
+bool nrf24l01_is_irq_active(void);
+uint8_t nrf24l01_get_channel(void);
+uint8_t nrf24l01_get_register(uint8_t reg);
+uint8_t nrf24l01_get_rx_address(uint8_t *address);
+
+void nrf24l01_get_spi_statistics(nrf24l01_spi_statistics_t *statistics);
+
+// Implemented by the port specific glue code: returns the state of the CE pin
+bool nrf24l01_ce(void);
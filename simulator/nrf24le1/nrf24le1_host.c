@@ -0,0 +1,787 @@
+/******************************************************************************
+
+    Host stand-ins for the parts of the nRF24LE1 firmware that talk directly
+    to hardware: delay_us(), the timestamps, the NV memory storage and the
+    SPI driver of the internal RF transceiver. spi_transaction() is
+    routed to the nRF24L01+ model. The SFRs themselves are plain variables
+    (see sdcc_host.h).
+
+    Also implements the port interface (port.h) for the simulation tools.
+    The virtual clock counts CPU clock cycles at 16 MHz; Timer 0, 1 and 2
+    count at f/12 (750 ns) and their interrupt handlers run when they
+    overflow, the same way main.c sets them up.
+
+    Unlike the ARM ports the servo pulses are timed in software: the Timer 1
+    interrupt handler toggles the outputs and reloads the timer for the next
+    pulse. The pulse widths therefore depend on when the handler starts
+    after the overflow, and on how many cycles into the handler the output
+    pins and TIMER1 are written.
+
+    Timer 1 is the only high priority interrupt. It preempts the Timer 0,
+    Timer 2 and RF handlers, which wait for each other and for it. Each
+    handler occupies the CPU for its cycle count, and an interrupt that
+    arrives during a RETI or a write to IEN0 waits for one more instruction,
+    as on any 8051. The cycle counts are counted by hand from the
+    instructions the handlers compile to, listed below; they are an
+    estimate, not a measurement, and pulse_bench says so in its report.
+
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <platform.h>
+#include <spi.h>
+#include <persistent_storage.h>
+
+#include <rc_receiver.h>
+
+#include <nrf24l01.h>
+#include <port.h>
+#include <prng.h>
+
+
+#define CLOCKS_PER_US (__SYSTEM_CLOCK / 1000000)
+#define CLOCKS_PER_TIMER_TICK 12
+
+// The RF transceiver SPI runs at CCLK / 2
+#define SPI_CLOCK (__SYSTEM_CLOCK / 2)
+
+// spi.c polls SPIF in SPIRSTAT for each byte. One iteration of the poll
+// loop (MOV A,direct; JNB) takes about SPI_POLL_CYCLES.
+#define SPI_POLL_CYCLES 5
+#define SPI_CYCLES_PER_BYTE (8 * __SYSTEM_CLOCK / SPI_CLOCK)
+#define SPI_SPIF_POLLS \
+    ((SPI_CYCLES_PER_BYTE + SPI_POLL_CYCLES - 1) / SPI_POLL_CYCLES)
+
+#define TIMER_16_MS TIMER_VALUE_US(16000)
+#define TIMER_150_US TIMER_VALUE_US(150)
+
+// The nRF24LE1 core executes an instruction in 1 to 4 clock cycles where
+// the standard 8051 needs 12 to 48, so the counts below are the machine
+// cycles of the standard instruction timing, one clock cycle each.
+
+// From a timer overflow until the first instruction of the handler: the
+// flag is polled in the next cycle, then the hardware LCALL to the vector
+// and the LJMP there. Before that the instruction in progress finishes,
+// which takes up to INSTRUCTION_CYCLES_MAX (MUL, DIV).
+#define INTERRUPT_LATENCY_CYCLES 5
+#define INSTRUCTION_CYCLES_MAX 4
+
+// servo_pulse_timer_handler() in rc_receiver.c, __using (1):
+//
+//      push acc; push dpl; push dph; push psw          8
+//      mov psw,#0x08                                   2
+//      clr GPIO_PPM                                    1
+//      inc servo_pulse_state                           1
+//      mov a,#n; cjne a,servo_pulse_state,...          3 per state tested
+//      clr/setb GPIO_CHx                               1 each
+//    states 1 to 3:
+//      jnb use_buffer_0,...; mov dptr,#pulse_buffer_.  4
+//      movx a,@dptr; mov r6,a; inc dptr;
+//      movx a,@dptr; mov r7,a                          8
+//      sjmp (buffer 0; buffer 1 is 2 cycles shorter)   2
+//      mov TH1,r7; mov TL1,r6                          4
+//      ljmp to the end                                 2
+//    state 4:
+//      clr TR1                                         1
+//      mov servo_pulse_state,#0                        2
+//
+//      setb GPIO_PPM                                   1
+//      pop psw; pop dph; pop dpl; pop acc; reti        10
+#define SERVO_ISR_PPM_LOW_CYCLES 11
+#define SERVO_ISR_INCREMENT_CYCLES 1
+#define SERVO_ISR_TEST_CYCLES 3
+#define SERVO_ISR_SBIT_CYCLES 1
+#define SERVO_ISR_TIMER_LOAD_CYCLES 18
+#define SERVO_ISR_PPM_HIGH_CYCLES 3
+#define SERVO_ISR_EPILOGUE_CYCLES 10
+
+// timer0_isr() in main.c:
+//
+//      push acc; push psw                              4
+//      mov TL0,#..; mov TH0,#..                        4
+//      inc systick_count                               1
+//      inc systick_total; clr a; cjne a,...            4 (no carry)
+//      jnb successful_stick_data,...                   2
+//      mov TL1,#..; mov TH1,#..; setb TR1              5
+//      pop psw; pop acc; reti                          6
+#define TIMER0_ISR_RELOAD_CYCLES 8
+#define TIMER0_ISR_TIMER1_CYCLES 20
+#define TIMER0_ISR_CYCLES 21
+#define TIMER0_ISR_SERVO_CYCLES 26
+
+// hop_timer_handler() in rc_receiver.c:
+//
+//      clr IRCON_tf2                                   1
+//      mov TL2,hop_timer_reload; mov TH2,...           4
+//      setb perform_hop_requested                      1
+//      reti                                            2
+#define HOP_ISR_RELOAD_CYCLES 5
+#define HOP_ISR_CYCLES 8
+
+// rf_interrupt_handler() in rc_receiver.c, which calls capture_timestamp()
+// in main.c and therefore saves all registers:
+//
+//      push bits, acc, b, dpl, dph, r7..r0, psw        26
+//      mov psw,#0x00                                   2
+//      mov dptr,#rf_int_timestamp; mov b,#0x40         4
+//      lcall capture_timestamp                         2
+//      mov r5,dpl; mov r6,dph; mov r7,b                6
+//      clr IEN0_tf0                                    1
+//      mov r4,TH0; mov r3,TL0; mov a,TH0; cjne a,ar4   7
+//      6 x mov a,..; lcall __gptrput (9); inc dptr     84
+//      jnb TCON_tf0,...                                2
+//      setb IEN0_tf0                                   1
+//      ret                                             2
+//      setb rf_int_fired                               1
+//      pop psw, r0..r7, dph, dpl, b, acc, bits         26
+//      reti                                            2
+#define RF_ISR_IEN0_CLEAR_CYCLES 41
+#define RF_ISR_IEN0_SET_CYCLES 135
+#define RF_ISR_CYCLES 166
+
+#define RETI_CYCLES 2
+#define MAX_BLOCKING_INSTRUCTIONS 3
+
+#define TIMER_STOPPED UINT64_MAX
+
+
+// A run of a low priority handler, in cycles: from its first instruction
+// to the end of its RETI, and the instructions after which the CPU executes
+// one more before it takes an interrupt
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint64_t blocking_start[MAX_BLOCKING_INSTRUCTIONS];
+    uint64_t blocking_end[MAX_BLOCKING_INSTRUCTIONS];
+    unsigned int blocking_count;
+} handler_run_t;
+
+
+typedef struct {
+    volatile uint16_t *counter;
+    // Counter value as last seen by the model, to detect firmware writes
+    uint16_t value;
+    uint64_t overflow_cycle;
+} le1_timer_t;
+
+
+// Global flag that is true for one mainloop every __SYSTICK_IN_MS
+bool systick;
+
+extern bool successful_stick_data;
+
+// Interrupt handlers in rc_receiver.c; main.c declares them for SDCC
+void rf_interrupt_handler(void);
+void hop_timer_handler(void);
+void servo_pulse_timer_handler(void);
+
+static uint8_t nv_storage[NUMBER_OF_PERSISTENT_ELEMENTS];
+static uint32_t delay_us_total;
+static uint32_t spi_polls;
+
+static uint32_t systick_count;
+
+static port_edge_callback_t edge_callback;
+static uint64_t cycles;
+
+static le1_timer_t timer0 = {&TIMER0, 0, TIMER_STOPPED};
+static le1_timer_t timer1 = {&TIMER1, 0, TIMER_STOPPED};
+static le1_timer_t timer2 = {&TIMER2, 0, TIMER_STOPPED};
+
+static bool outputs[PORT_NUMBER_OF_OUTPUTS];
+
+static handler_run_t low_priority_run;
+static uint64_t servo_isr_end;
+
+
+// ****************************************************************************
+static bool timer_is_running(const le1_timer_t *timer)
+{
+    if (timer == &timer0) {
+        return TCON_tr0;
+    }
+    if (timer == &timer1) {
+        return TCON_tr1;
+    }
+    return (T2CON & 0x03) != 0;
+}
+
+
+// ****************************************************************************
+// Make the counter register reflect the timer state at the given cycle, so
+// that a write by the firmware can be told apart from the running count.
+// ****************************************************************************
+static void timer_update_counter(le1_timer_t *timer, uint64_t cycle)
+{
+    uint32_t ticks_to_overflow;
+
+    if (timer->overflow_cycle == TIMER_STOPPED) {
+        return;
+    }
+
+    ticks_to_overflow = (timer->overflow_cycle - cycle +
+        CLOCKS_PER_TIMER_TICK - 1) / CLOCKS_PER_TIMER_TICK;
+    timer->value = 0x10000 - ticks_to_overflow;
+    *timer->counter = timer->value;
+}
+
+
+// ****************************************************************************
+// Pick up changes the firmware made to the timer. The counter increments on
+// the prescaler ticks, which run independently of the write.
+// ****************************************************************************
+static void timer_sync(le1_timer_t *timer, uint64_t cycle)
+{
+    uint64_t next_tick;
+
+    if (!timer_is_running(timer)) {
+        timer->overflow_cycle = TIMER_STOPPED;
+        timer->value = *timer->counter;
+        return;
+    }
+
+    if (timer->overflow_cycle != TIMER_STOPPED &&
+            *timer->counter == timer->value) {
+        return;
+    }
+
+    timer->value = *timer->counter;
+    next_tick = (cycle / CLOCKS_PER_TIMER_TICK + 1) * CLOCKS_PER_TIMER_TICK;
+    timer->overflow_cycle = next_tick +
+        (uint64_t)(0xffff - timer->value) * CLOCKS_PER_TIMER_TICK;
+}
+
+
+// ****************************************************************************
+static void update_all_counters(uint64_t cycle)
+{
+    timer_update_counter(&timer0, cycle);
+    timer_update_counter(&timer1, cycle);
+    timer_update_counter(&timer2, cycle);
+}
+
+
+// ****************************************************************************
+static void sync_all_timers(uint64_t cycle)
+{
+    timer_sync(&timer0, cycle);
+    timer_sync(&timer1, cycle);
+    timer_sync(&timer2, cycle);
+}
+
+
+// ****************************************************************************
+static void set_output(unsigned int output, bool level, uint64_t cycle)
+{
+    if (outputs[output] == level) {
+        return;
+    }
+
+    outputs[output] = level;
+    if (edge_callback) {
+        edge_callback(output, level, cycle * 1000 / CLOCKS_PER_US);
+    }
+}
+
+
+// ****************************************************************************
+// Cycle at which the handler of an interrupt requested at the given cycle
+// executes its first instruction. Low priority handlers wait until the
+// running handlers have returned. After a RETI, and after a write to IEN0,
+// one more instruction executes before an interrupt is taken.
+// ****************************************************************************
+static uint64_t get_handler_start(uint64_t request, bool high_priority)
+{
+    const handler_run_t *run = &low_priority_run;
+    uint64_t accepted = request + prng_next() % INSTRUCTION_CYCLES_MAX;
+    unsigned int i;
+
+    if (high_priority) {
+        for (i = 0; i < run->blocking_count; i++) {
+            if (request >= run->blocking_start[i] &&
+                    request < run->blocking_end[i]) {
+                accepted = run->blocking_end[i] + 1 +
+                    prng_next() % INSTRUCTION_CYCLES_MAX;
+            }
+        }
+    }
+    else {
+        uint64_t busy_until = run->end;
+
+        if (servo_isr_end > busy_until) {
+            busy_until = servo_isr_end;
+        }
+        if (accepted < busy_until) {
+            accepted = busy_until + 1 + prng_next() % INSTRUCTION_CYCLES_MAX;
+        }
+    }
+
+    return accepted + INTERRUPT_LATENCY_CYCLES;
+}
+
+
+// ****************************************************************************
+static void add_blocking_instruction(uint64_t end, unsigned int length)
+{
+    handler_run_t *run = &low_priority_run;
+
+    run->blocking_start[run->blocking_count] = end - length;
+    run->blocking_end[run->blocking_count] = end;
+    ++run->blocking_count;
+}
+
+
+// ****************************************************************************
+static void start_low_priority_run(uint64_t start, unsigned int length)
+{
+    handler_run_t *run = &low_priority_run;
+
+    run->start = start;
+    run->end = start + length;
+    run->blocking_count = 0;
+    add_blocking_instruction(run->end, RETI_CYCLES);
+}
+
+
+// ****************************************************************************
+// The Timer 1 handler that ran from the given cycles interrupted the low
+// priority handler, which continues afterwards
+// ****************************************************************************
+static void preempt_low_priority_run(uint64_t start, uint64_t end)
+{
+    handler_run_t *run = &low_priority_run;
+    unsigned int i;
+
+    if (start < run->start || start >= run->end) {
+        return;
+    }
+
+    run->end += end - start;
+    for (i = 0; i < run->blocking_count; i++) {
+        if (run->blocking_start[i] >= start) {
+            run->blocking_start[i] += end - start;
+            run->blocking_end[i] += end - start;
+        }
+    }
+}
+
+
+// ****************************************************************************
+// timer0_isr() in main.c: systick, and start of a new set of servo pulses.
+// Returns the cycles the handler takes.
+// ****************************************************************************
+static unsigned int timer0_interrupt(uint64_t cycle)
+{
+    TIMER0 = TIMER_16_MS;
+    ++systick_count;
+    timer_sync(&timer0, cycle + TIMER0_ISR_RELOAD_CYCLES);
+
+    if (!successful_stick_data) {
+        return TIMER0_ISR_CYCLES;
+    }
+
+    TIMER1 = TIMER_150_US;
+    TCON_tr1 = 1;
+    timer_sync(&timer1, cycle + TIMER0_ISR_TIMER1_CYCLES);
+    return TIMER0_ISR_SERVO_CYCLES;
+}
+
+
+// ****************************************************************************
+static unsigned int timer2_interrupt(uint64_t cycle)
+{
+    hop_timer_handler();
+    sync_all_timers(cycle + HOP_ISR_RELOAD_CYCLES);
+    return HOP_ISR_CYCLES;
+}
+
+
+// ****************************************************************************
+// Run servo_pulse_timer_handler() and time stamp its effects. Returns the
+// cycle at which its RETI completes.
+//
+// The handler is in one of four states: it raises CH1, lowers CH1 and
+// raises CH2, lowers CH2 and raises CH3, or lowers CH3 and stops the
+// timer. The state is recovered from the outputs that changed.
+// ****************************************************************************
+static uint64_t timer1_interrupt(uint64_t cycle)
+{
+    static const unsigned int channel_pins[NUMBER_OF_CHANNELS] = {
+        PORT_CH1, PORT_CH2, PORT_CH3
+    };
+    bool before[NUMBER_OF_CHANNELS];
+    bool after[NUMBER_OF_CHANNELS];
+    unsigned int state = NUMBER_OF_CHANNELS + 1;
+    unsigned int tests;
+    uint64_t gpio_cycle;
+    unsigned int i;
+
+    before[0] = GPIO_CH1;
+    before[1] = GPIO_CH2;
+    before[2] = GPIO_CH3;
+
+    servo_pulse_timer_handler();
+
+    after[0] = GPIO_CH1;
+    after[1] = GPIO_CH2;
+    after[2] = GPIO_CH3;
+
+    for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
+        if (!before[i] && after[i]) {
+            state = i + 1;
+        }
+    }
+
+    set_output(PORT_PPM, false, cycle + SERVO_ISR_PPM_LOW_CYCLES);
+
+    // The last state is the else branch after all tests
+    tests = state > NUMBER_OF_CHANNELS ? NUMBER_OF_CHANNELS : state;
+    gpio_cycle = cycle + SERVO_ISR_PPM_LOW_CYCLES +
+        SERVO_ISR_INCREMENT_CYCLES + tests * SERVO_ISR_TEST_CYCLES;
+
+    // The firmware lowers the previous output before raising the next one
+    for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
+        if (before[i] && !after[i]) {
+            gpio_cycle += SERVO_ISR_SBIT_CYCLES;
+            set_output(channel_pins[i], false, gpio_cycle);
+        }
+    }
+    for (i = 0; i < NUMBER_OF_CHANNELS; i++) {
+        if (!before[i] && after[i]) {
+            gpio_cycle += SERVO_ISR_SBIT_CYCLES;
+            set_output(channel_pins[i], true, gpio_cycle);
+        }
+    }
+
+    // Load TIMER1, or stop Timer 1 in the last state
+    if (state > NUMBER_OF_CHANNELS) {
+        gpio_cycle += SERVO_ISR_SBIT_CYCLES;
+    }
+    else {
+        gpio_cycle += SERVO_ISR_TIMER_LOAD_CYCLES;
+    }
+    sync_all_timers(gpio_cycle);
+
+    gpio_cycle += SERVO_ISR_PPM_HIGH_CYCLES;
+    set_output(PORT_PPM, true, gpio_cycle);
+
+    return gpio_cycle + SERVO_ISR_EPILOGUE_CYCLES;
+}
+
+
+// ****************************************************************************
+static le1_timer_t *next_overflow(void)
+{
+    le1_timer_t *next = &timer0;
+
+    if (timer1.overflow_cycle < next->overflow_cycle) {
+        next = &timer1;
+    }
+    if (timer2.overflow_cycle < next->overflow_cycle) {
+        next = &timer2;
+    }
+    return next;
+}
+
+
+// ****************************************************************************
+void port_reset(const uint8_t *bind_data)
+{
+    unsigned int i;
+
+    memcpy(nv_storage, bind_data, NUMBER_OF_PERSISTENT_ELEMENTS);
+    delay_us_total = 0;
+    spi_polls = 0;
+
+    systick = false;
+    systick_count = 0;
+    cycles = 0;
+
+    // init_hardware() in main.c. All servo outputs start high.
+    GPIO_CH1 = 1;
+    GPIO_CH2 = 1;
+    GPIO_CH3 = 1;
+    GPIO_PPM = 1;
+    GPIO_BIND = 1;
+    for (i = 0; i < PORT_NUMBER_OF_OUTPUTS; i++) {
+        outputs[i] = true;
+    }
+
+    TCON_tr0 = 0;
+    TCON_tr1 = 0;
+    T2CON = 0;
+    TIMER0 = TIMER_16_MS;
+    TCON_tr0 = 1;
+
+    timer0.overflow_cycle = TIMER_STOPPED;
+    timer1.overflow_cycle = TIMER_STOPPED;
+    timer2.overflow_cycle = TIMER_STOPPED;
+    sync_all_timers(cycles);
+
+    memset(&low_priority_run, 0, sizeof(low_priority_run));
+    servo_isr_end = 0;
+
+    nrf24l01_reset();
+
+    init_receiver();
+    sync_all_timers(cycles);
+}
+
+
+// ****************************************************************************
+// Microseconds until the next overflow of Timer 0 or 2, the ones that change
+// the state of the main loop. Timer 1 is handled within port_advance().
+// ****************************************************************************
+uint32_t port_time_to_next_event(void)
+{
+    uint64_t next = timer0.overflow_cycle;
+
+    if (timer2.overflow_cycle < next) {
+        next = timer2.overflow_cycle;
+    }
+    if (next == TIMER_STOPPED) {
+        return UINT32_MAX;
+    }
+
+    return (next - cycles + CLOCKS_PER_US - 1) / CLOCKS_PER_US;
+}
+
+
+// ****************************************************************************
+void port_advance(uint32_t microseconds)
+{
+    uint64_t end = cycles + (uint64_t)microseconds * CLOCKS_PER_US;
+
+    while (1) {
+        le1_timer_t *timer = next_overflow();
+        uint64_t overflow = timer->overflow_cycle;
+        uint64_t isr;
+
+        if (overflow > end) {
+            break;
+        }
+
+        // Counting restarts from 0 after the overflow
+        timer->value = 0;
+        *timer->counter = 0;
+        timer->overflow_cycle = overflow + 0x10000 * CLOCKS_PER_TIMER_TICK;
+
+        if (timer == &timer1) {
+            isr = get_handler_start(overflow, true);
+            update_all_counters(isr);
+            servo_isr_end = timer1_interrupt(isr);
+            preempt_low_priority_run(isr - INTERRUPT_LATENCY_CYCLES,
+                servo_isr_end);
+        }
+        else {
+            unsigned int length;
+
+            isr = get_handler_start(overflow, false);
+            update_all_counters(isr);
+            if (timer == &timer0) {
+                length = timer0_interrupt(isr);
+            }
+            else {
+                IRCON_tf2 = 1;
+                length = timer2_interrupt(isr);
+            }
+            start_low_priority_run(isr, length);
+        }
+    }
+
+    cycles = end;
+}
+
+
+// ****************************************************************************
+void port_rf_interrupt(void)
+{
+    uint64_t isr = get_handler_start(cycles, false);
+
+    rf_interrupt_handler();
+    start_low_priority_run(isr, RF_ISR_CYCLES);
+    add_blocking_instruction(isr + RF_ISR_IEN0_CLEAR_CYCLES, 1);
+    add_blocking_instruction(isr + RF_ISR_IEN0_SET_CYCLES, 1);
+}
+
+
+// ****************************************************************************
+uint32_t port_run_main_loop(void)
+{
+    nrf24l01_spi_statistics_t before;
+    nrf24l01_spi_statistics_t after;
+    uint32_t delay_before = delay_us_total;
+
+    // service_systick() in main.c
+    if (systick_count) {
+        systick = true;
+        --systick_count;
+    }
+    else {
+        systick = false;
+    }
+
+    update_all_counters(cycles);
+    nrf24l01_get_spi_statistics(&before);
+    process_receiver();
+    nrf24l01_get_spi_statistics(&after);
+    sync_all_timers(cycles);
+
+    return (delay_us_total - delay_before) +
+        (after.bytes - before.bytes) * 8 * 1000000 / SPI_CLOCK;
+}
+
+
+// ****************************************************************************
+bool port_is_main_loop_complete(void)
+{
+    return true;
+}
+
+
+// ****************************************************************************
+uint32_t port_get_spi_clock(void)
+{
+    return SPI_CLOCK;
+}
+
+
+// ****************************************************************************
+uint32_t port_get_spi_polls(void)
+{
+    return spi_polls;
+}
+
+
+// ****************************************************************************
+// The transmitter already sends the Timer 1 reload value for the pulse
+// ****************************************************************************
+uint16_t port_stick_to_channel(uint16_t stick)
+{
+    return stick;
+}
+
+
+// ****************************************************************************
+void port_set_bind_button(bool pressed)
+{
+    GPIO_BIND = pressed ? 0 : 1;
+}
+
+
+// ****************************************************************************
+bool port_binds_on_button_release(void)
+{
+    return false;
+}
+
+
+// ****************************************************************************
+const char *port_get_name(void)
+{
+    return "nrf24le1";
+}
+
+
+// ****************************************************************************
+const char *port_get_output_model(void)
+{
+    return "ESTIMATE, the Timer 1 handler times the pulses with cycle counts counted by hand, not measured";
+}
+
+
+// ****************************************************************************
+bool port_has_output(unsigned int output)
+{
+    return output < PORT_NUMBER_OF_OUTPUTS;
+}
+
+
+// ****************************************************************************
+void port_set_edge_callback(port_edge_callback_t callback)
+{
+    edge_callback = callback;
+}
+
+
+// ****************************************************************************
+// channels[] holds the Timer 1 reload value, which overflows after
+// 0x10000 - channel ticks of 750 ns
+// ****************************************************************************
+uint32_t port_channel_to_pulse_ns(uint16_t channel)
+{
+    return (uint32_t)((0x10000 - channel) * CLOCKS_PER_TIMER_TICK * 1000ull /
+        CLOCKS_PER_US);
+}
+
+
+// ****************************************************************************
+bool nrf24l01_ce(void)
+{
+    return RFCON_rfce;
+}
+
+
+// ****************************************************************************
+void init_spi(void)
+{
+}
+
+
+// ****************************************************************************
+uint8_t spi_transaction(uint8_t command, uint8_t count,
+    const uint8_t *tx_data, uint8_t *rx_data)
+{
+    spi_polls += (count + 1) * SPI_SPIF_POLLS;
+    return nrf24l01_spi_transaction(command, count, tx_data, rx_data);
+}
+
+
+// ****************************************************************************
+void delay_us(uint16_t microseconds)
+{
+    delay_us_total += microseconds;
+}
+
+
+// ****************************************************************************
+// Simulation time at the start of the current main loop iteration
+// ****************************************************************************
+uint32_t get_timestamp_us(void)
+{
+    return cycles / CLOCKS_PER_US;
+}
+
+
+// ****************************************************************************
+// The host keeps the microseconds of get_timestamp_us() in ticks, rather
+// than the Timer 0 state
+// ****************************************************************************
+void capture_timestamp(timestamp_t *timestamp)
+{
+    timestamp->ticks = get_timestamp_us();
+    timestamp->count = 0;
+}
+
+
+// ****************************************************************************
+uint32_t timestamp_to_us(const timestamp_t *timestamp)
+{
+    return timestamp->ticks;
+}
+
+
+// ****************************************************************************
+void load_persistent_storage(uint8_t *data)
+{
+    memcpy(data, nv_storage, NUMBER_OF_PERSISTENT_ELEMENTS);
+}
+
+
+// ****************************************************************************
+void save_persistent_storage(uint8_t *new_data)
+{
+    memcpy(nv_storage, new_data, NUMBER_OF_PERSISTENT_ELEMENTS);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+/******************************************************************************
+
+    Maps the SDCC language extensions used by the nRF24LE1 firmware to
+    plain C, so that its sources compile unmodified with the host compiler.
+    This file is force-included with -include.
+
+    Special function registers and bits become ordinary variables. They are
+    defined in nrf24le1.h, which every source file includes, so the objects
+    must be compiled with -fcommon. Bits that share an SFR on the real chip
+    are independent variables here; the firmware only ever accesses them
+    through their bit names.
+
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+#define __sfr volatile uint8_t
+#define __sfr16 volatile uint16_t
+#define __sbit volatile bool
+#define __bit bool
+#define __at(address)
+
+#define __data
+#define __idata
+#define __pdata
+#define __xdata
+#define __code const
+
+#define __interrupt(vector)
+#define __using(bank)
@@ -0,0 +1,337 @@
+/******************************************************************************
+
+    Per-packet cost benchmark for the LPC812 receiver firmware.
+
+    Runs the unmodified rc_receiver.c and rf.c on the host, feeding a recorded
+    stream of payloads into the nRF24L01+ model. For every received packet
+    and every hop it measures the SPI traffic generated by the firmware and,
+    where the kernel allows it, the number of host instructions executed.
+
+    Usage: packet_bench [-p packets_per_hop] [-v] capture.txt
+
+    The capture file contains one payload per line as 10 hexadecimal bytes,
+    e.g. "f1 f7 4a f8 8e f5 b8 55 67 0f". A line containing only "-"
+    represents a packet that was lost on air. Everything after a '#' is a
+    comment.
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <rc_receiver.h>
+
+#include <nrf24l01.h>
+#include <port.h>
+#include <lpc812_host.h>
+
+
+#define PAYLOAD_SIZE 10
+#define ADDRESS_WIDTH 5
+#define NUMBER_OF_HOP_CHANNELS 20
+#define DEFAULT_PACKETS_PER_HOP 2
+
+#define EVENT_STICK 0
+#define EVENT_FAILSAFE 1
+#define EVENT_OTHER 2
+#define EVENT_LOST 3
+#define EVENT_HOP 4
+#define NUMBER_OF_EVENTS 5
+
+#define PACKET_SPACING_US 1000
+
+
+typedef struct {
+    unsigned int count;
+    uint64_t spi_transactions;
+    uint64_t spi_bytes;
+    uint64_t instructions;
+    uint64_t nanoseconds;
+} cost_t;
+
+
+static const char *event_names[NUMBER_OF_EVENTS] = {
+    "stick packet", "failsafe packet", "other packet", "lost packet", "hop"
+};
+
+static const uint8_t bind_data[ADDRESS_WIDTH + NUMBER_OF_HOP_CHANNELS] = {
+    0x2a, 0x91, 0x3c, 0x5e, 0x07,
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27
+};
+
+static cost_t costs[NUMBER_OF_EVENTS];
+static int instruction_counter = -1;
+static bool verbose;
+
+// Virtual time for the nRF24 model. Packets are spaced far enough apart
+// that the PLL has always settled after a channel change.
+static uint64_t radio_time_us;
+
+
+// ****************************************************************************
+static void open_instruction_counter(void)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    instruction_counter = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+
+// ****************************************************************************
+static uint64_t read_instruction_counter(void)
+{
+    uint64_t value = 0;
+
+    if (instruction_counter < 0) {
+        return 0;
+    }
+
+    if (read(instruction_counter, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+    return value;
+}
+
+
+// ****************************************************************************
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+// ****************************************************************************
+// Run one iteration of the receiver main loop and add its cost to the given
+// event category.
+// ****************************************************************************
+static void measure_process_receiver(unsigned int event)
+{
+    nrf24l01_spi_statistics_t before;
+    nrf24l01_spi_statistics_t after;
+    uint64_t instructions;
+    uint64_t start;
+
+    nrf24l01_get_spi_statistics(&before);
+    instructions = read_instruction_counter();
+    start = now_ns();
+
+    process_receiver();
+
+    costs[event].nanoseconds += now_ns() - start;
+    costs[event].instructions += read_instruction_counter() - instructions;
+    nrf24l01_get_spi_statistics(&after);
+
+    costs[event].spi_transactions += after.transactions - before.transactions;
+    costs[event].spi_bytes += after.bytes - before.bytes;
+    ++costs[event].count;
+
+    if (verbose) {
+        printf("%-16s %3u SPI transactions, %3u bytes, RF_CH=%u\n",
+            event_names[event], after.transactions - before.transactions,
+            after.bytes - before.bytes, nrf24l01_get_channel());
+    }
+}
+
+
+// ****************************************************************************
+static void process_packet(const uint8_t *payload)
+{
+    unsigned int event;
+
+    if (payload == NULL) {
+        measure_process_receiver(EVENT_LOST);
+        return;
+    }
+
+    radio_time_us += PACKET_SPACING_US;
+    nrf24l01_set_time(radio_time_us);
+    nrf24l01_receive_packet(nrf24l01_get_channel(), bind_data, ADDRESS_WIDTH,
+        payload, PAYLOAD_SIZE);
+
+    // PININT0 fires on the falling edge of the nRF24 IRQ line
+    if (nrf24l01_is_irq_active()) {
+        rf_interrupt_handler();
+    }
+
+    if (payload[7] == 0x55) {
+        event = EVENT_STICK;
+    }
+    else if (payload[7] == 0xaa) {
+        event = EVENT_FAILSAFE;
+    }
+    else {
+        event = EVENT_OTHER;
+    }
+
+    measure_process_receiver(event);
+}
+
+
+// ****************************************************************************
+// Parse one line of the capture file.
+//
+// Returns 1 if a payload was found, 0 for a lost packet marker and -1 if
+// the line is empty or a comment.
+// ****************************************************************************
+static int parse_line(char *line, uint8_t *payload, unsigned int line_number)
+{
+    char *comment;
+    char *token;
+    char *end;
+    int count = 0;
+
+    comment = strchr(line, '#');
+    if (comment) {
+        *comment = '\0';
+    }
+
+    token = strtok(line, " \t\r\n");
+    if (token == NULL) {
+        return -1;
+    }
+
+    if (strcmp(token, "-") == 0) {
+        return 0;
+    }
+
+    while (token) {
+        unsigned long value = strtoul(token, &end, 16);
+
+        if (*end != '\0' || value > 0xff || count >= PAYLOAD_SIZE) {
+            fprintf(stderr, "Line %u: invalid payload\n", line_number);
+            exit(1);
+        }
+        payload[count++] = value;
+        token = strtok(NULL, " \t\r\n");
+    }
+
+    if (count != PAYLOAD_SIZE) {
+        fprintf(stderr, "Line %u: expected %d bytes\n", line_number,
+            PAYLOAD_SIZE);
+        exit(1);
+    }
+    return 1;
+}
+
+
+// ****************************************************************************
+static void print_report(unsigned int packets_per_hop)
+{
+    unsigned int i;
+
+    printf("\nPer-event cost of process_receiver() "
+        "(%u packets per hop, SPI at %.1f MHz)\n\n", packets_per_hop,
+        port_get_spi_clock() / 1e6);
+    printf("%-16s %7s %10s %10s %10s %13s %9s\n", "Event", "Count",
+        "SPI trans", "SPI bytes", "SPI us", "Instructions", "Host ns");
+
+    for (i = 0; i < NUMBER_OF_EVENTS; i++) {
+        cost_t *c = &costs[i];
+        double n = c->count ? c->count : 1;
+
+        printf("%-16s %7u %10.2f %10.2f %10.1f ", event_names[i], c->count,
+            c->spi_transactions / n, c->spi_bytes / n,
+            c->spi_bytes * 8.0 * 1000000.0 / port_get_spi_clock() / n);
+
+        if (instruction_counter < 0) {
+            printf("%13s", "n/a");
+        }
+        else {
+            printf("%13.1f", c->instructions / n);
+        }
+        printf(" %9.1f\n", c->nanoseconds / n);
+    }
+}
+
+
+// ****************************************************************************
+int main(int argc, char *argv[])
+{
+    unsigned int packets_per_hop = DEFAULT_PACKETS_PER_HOP;
+    unsigned int slot = 0;
+    unsigned int line_number = 0;
+    uint8_t payload[PAYLOAD_SIZE];
+    char line[256];
+    FILE *capture;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:v")) != -1) {
+        switch (opt) {
+            case 'p':
+                packets_per_hop = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'v':
+                verbose = true;
+                break;
+
+            default:
+                fprintf(stderr,
+                    "Usage: %s [-p packets_per_hop] [-v] capture.txt\n",
+                    argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc || packets_per_hop == 0) {
+        fprintf(stderr, "Usage: %s [-p packets_per_hop] [-v] capture.txt\n",
+            argv[0]);
+        return 1;
+    }
+
+    capture = fopen(argv[optind], "r");
+    if (capture == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    lpc812_host_reset(bind_data);
+    init_receiver();
+
+    open_instruction_counter();
+    if (instruction_counter >= 0) {
+        ioctl(instruction_counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    while (fgets(line, sizeof(line), capture)) {
+        int result;
+
+        result = parse_line(line, payload, ++line_number);
+        if (result < 0) {
+            continue;
+        }
+
+        process_packet(result ? payload : NULL);
+
+        // The transmitter moves on to the next channel after sending
+        // packets_per_hop packets; so does the receiver's hop timer.
+        if (++slot == packets_per_hop) {
+            slot = 0;
+            hop_timer_handler();
+            measure_process_receiver(EVENT_HOP);
+        }
+    }
+
+    fclose(capture);
+    print_report(packets_per_hop);
+
+    return 0;
+}
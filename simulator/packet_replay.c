@@ -0,0 +1,585 @@
+/******************************************************************************
+
+    Packet replay
+
+    Plays one session of a capture file, written by tools/packet_recorder.py
+    from the frames of the packet recorder firmware, back into the host
+    build of the receiver firmware.
+
+    Every recorded packet is put on air at the time the firmware read it,
+    on the hop channel given by the recorded hop_index, so the receiver
+    only gets it if its hop sequence is where it was when the packet was
+    recorded. Packets that were read from the RX FIFO in one go arrive
+    together. Packets read by process_binding() are sent on the bind
+    channel, and the bind button is pressed shortly before the first one.
+
+    A replay is deterministic: the same capture and firmware give the same
+    results every time. Packets the replayed firmware does not receive mark
+    where it diverges from the recorded session. The digest of the servo
+    outputs and the SPI traffic can be compared between firmware versions.
+
+    Usage: see usage() below
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <nrf24l01.h>
+#include <hk310_transmitter.h>
+#include <port.h>
+#include <simulation.h>
+
+
+#define NUMBER_OF_CHANNELS 3
+
+// Capture file, see tools/packet_recorder.py
+#define HEADER_MAGIC "RXCAP001"
+#define HEADER_SIZE 16
+#define INDEX_MAGIC "RXIX"
+#define INDEX_HEADER_SIZE 20
+#define INDEX_ENTRY_SIZE 24
+#define INDEX_FLAG_SESSION_START (1 << 0)
+
+// Frames of the packet recorder, see packet_recorder.c of the firmware
+#define SYNC_BYTE 0xa5
+#define FRAME_TYPE_BIND_DATA 'B'
+#define FRAME_TYPE_PACKET 'P'
+#define BIND_DATA_FRAME_SIZE (4 + 30)
+#define PACKET_FRAME_SIZE (4 + 17)
+
+#define BIND_DATA_FLAG_BOUND (1 << 0)
+#define PACKET_FLAG_BINDING (1 << 0)
+#define PACKET_FLAG_SAME_DRAIN (1 << 1)
+
+// The firmware samples the bind button every systick and starts binding at
+// the first systick after the button is pressed or released, depending on
+// the port. That systick lies between the last packet read by
+// process_receiving() and the first packet read by process_binding(), so the
+// edge is placed in the main loop that reads the former. The systick runs in
+// the same phase relative to power-on as in the recording. Without a
+// preceding packet the edge is placed one bind packet interval before the
+// first bind packet.
+#define BIND_BUTTON_HOLD_US 40000
+#define BIND_PACKET_INTERVAL_US 5000
+
+// Time to run after the last packet, so that the firmware finishes
+// processing it
+#define TRAILING_TIME_US 100000
+
+
+typedef struct {
+    uint8_t type;
+    uint8_t sequence;
+    uint8_t flags;
+    uint8_t hop_index;
+    uint8_t hops_without_packet;
+    uint8_t data[HK310_BIND_DATA_SIZE];     // Payload or bind data
+    uint64_t time_us;                       // On the simulation clock
+} frame_t;
+
+
+extern uint16_t channels[NUMBER_OF_CHANNELS];
+
+static frame_t *frames;
+static unsigned int frame_count;
+static unsigned int next_frame;
+static unsigned int lost_frames;
+
+static uint64_t *bind_edges;
+static unsigned int bind_edge_count;
+static unsigned int next_bind_edge;
+
+static uint8_t bind_data[HK310_BIND_DATA_SIZE];
+static uint64_t drain_time;
+
+static unsigned int packets;
+static unsigned int binding_packets;
+static unsigned int not_received;
+static unsigned int first_divergence;
+static uint64_t first_divergence_time;
+
+static uint16_t last_channels[NUMBER_OF_CHANNELS];
+static uint32_t output_digest = 2166136261u;
+static unsigned int output_changes;
+
+static bool verbose;
+
+
+// ****************************************************************************
+static uint32_t get_uint32(const uint8_t *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) |
+        ((uint32_t)data[3] << 24);
+}
+
+
+// ****************************************************************************
+static uint64_t get_uint64(const uint8_t *data)
+{
+    return get_uint32(data) | ((uint64_t)get_uint32(data + 4) << 32);
+}
+
+
+// ****************************************************************************
+static uint8_t crc8(const uint8_t *data, size_t length)
+{
+    uint8_t crc = 0;
+    int i;
+
+    while (length--) {
+        crc ^= *data++;
+        for (i = 0; i < 8; i++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+
+// ****************************************************************************
+static uint8_t *read_file(const char *filename, size_t *size)
+{
+    uint8_t *data;
+    FILE *f;
+    long length;
+
+    f = fopen(filename, "rb");
+    if (f == NULL) {
+        perror(filename);
+        exit(1);
+    }
+
+    fseek(f, 0, SEEK_END);
+    length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = malloc(length > 0 ? length : 1);
+    if (data == NULL || fread(data, 1, length, f) != (size_t)length) {
+        fprintf(stderr, "%s: read error\n", filename);
+        exit(1);
+    }
+    fclose(f);
+
+    *size = length;
+    return data;
+}
+
+
+// ****************************************************************************
+// Returns the size of the frame at data, or 0 if it is not a valid frame
+// ****************************************************************************
+static size_t check_frame(const uint8_t *data, size_t available)
+{
+    size_t size;
+
+    if (available < 2 || data[0] != SYNC_BYTE) {
+        return 0;
+    }
+
+    switch (data[1]) {
+        case FRAME_TYPE_BIND_DATA:
+            size = BIND_DATA_FRAME_SIZE;
+            break;
+
+        case FRAME_TYPE_PACKET:
+            size = PACKET_FRAME_SIZE;
+            break;
+
+        default:
+            return 0;
+    }
+
+    if (available < size || crc8(data + 1, size - 2) != data[size - 1]) {
+        return 0;
+    }
+    return size;
+}
+
+
+// ****************************************************************************
+static bool is_power_on(const uint8_t *data)
+{
+    return data[1] == FRAME_TYPE_BIND_DATA &&
+        !(data[7] & BIND_DATA_FLAG_BOUND);
+}
+
+
+// ****************************************************************************
+// Find the first frame of the given session, using the index if there is
+// one. Session 1 starts with the first power-on in the capture.
+// ****************************************************************************
+static size_t find_session(const uint8_t *data, size_t start, size_t end,
+    size_t index_offset, unsigned int session)
+{
+    unsigned int current = 0;
+    size_t offset;
+
+    if (index_offset) {
+        unsigned int count = get_uint32(data + index_offset + 4);
+        const uint8_t *entry = data + index_offset + INDEX_HEADER_SIZE;
+
+        while (count--) {
+            if ((entry[22] & INDEX_FLAG_SESSION_START) &&
+                    (unsigned int)(entry[20] | (entry[21] << 8)) == session) {
+                return get_uint64(entry);
+            }
+            entry += INDEX_ENTRY_SIZE;
+        }
+        return 0;
+    }
+
+    // No index: the recording was aborted, so scan the frames
+    offset = start;
+    while (offset < end) {
+        size_t size = check_frame(data + offset, end - offset);
+
+        if (size == 0) {
+            ++offset;
+            continue;
+        }
+        if (is_power_on(data + offset) && ++current == session) {
+            return offset;
+        }
+        offset += size;
+    }
+    return 0;
+}
+
+
+// ****************************************************************************
+static void load_session(const char *filename, unsigned int session)
+{
+    uint8_t *data;
+    size_t size;
+    size_t end;
+    size_t index_offset;
+    size_t offset;
+    uint64_t wraps = 0;
+    uint32_t last_timestamp = 0;
+    uint64_t power_on_time = 0;
+    int last_sequence = -1;
+
+    data = read_file(filename, &size);
+    if (size < HEADER_SIZE || memcmp(data, HEADER_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s: not a capture file\n", filename);
+        exit(1);
+    }
+
+    index_offset = get_uint64(data + 8);
+    end = size;
+    if (index_offset) {
+        if (index_offset + INDEX_HEADER_SIZE > size ||
+                memcmp(data + index_offset, INDEX_MAGIC, 4) != 0) {
+            fprintf(stderr, "%s: index is corrupt\n", filename);
+            exit(1);
+        }
+        end = index_offset;
+    }
+
+    offset = find_session(data, HEADER_SIZE, end, index_offset, session);
+    if (offset == 0) {
+        fprintf(stderr, "%s: no session %u\n", filename, session);
+        exit(1);
+    }
+
+    frames = calloc((end - offset) / PACKET_FRAME_SIZE + 1, sizeof(frame_t));
+    if (frames == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    while (offset < end) {
+        const uint8_t *d = data + offset;
+        frame_t *f = &frames[frame_count];
+        uint32_t timestamp;
+
+        size = check_frame(d, end - offset);
+        if (size == 0) {
+            fprintf(stderr, "%s: invalid frame at offset %zu\n", filename,
+                offset);
+            exit(1);
+        }
+        if (frame_count && is_power_on(d)) {
+            break;
+        }
+        offset += size;
+
+        f->type = d[1];
+        f->sequence = d[2];
+        timestamp = get_uint32(d + 3);
+        if (f->type == FRAME_TYPE_BIND_DATA) {
+            f->flags = d[7];
+            memcpy(f->data, d + 8, HK310_BIND_DATA_SIZE);
+        }
+        else {
+            f->hop_index = d[7];
+            f->hops_without_packet = d[8];
+            f->flags = d[9];
+            memcpy(f->data, d + 10, HK310_PAYLOAD_SIZE);
+        }
+
+        // The timestamp of the power-on frame is the time of
+        // init_receiver(), which is when the simulation powers on the
+        // receiver
+        if (frame_count == 0) {
+            power_on_time = timestamp;
+        }
+        else if (timestamp < last_timestamp) {
+            wraps += 1ull << 32;
+        }
+        last_timestamp = timestamp;
+        f->time_us = SIMULATION_POWER_ON_TIME_US + wraps + timestamp -
+            power_on_time;
+
+        if (last_sequence >= 0) {
+            lost_frames += (uint8_t)(f->sequence - last_sequence - 1);
+        }
+        else {
+            lost_frames += f->sequence;
+        }
+        last_sequence = f->sequence;
+
+        ++frame_count;
+    }
+
+    free(data);
+}
+
+
+// ****************************************************************************
+// The bind procedure starts before the first packet that process_binding()
+// reads, and ends with new bind data or any packet that it does not read.
+// ****************************************************************************
+static void find_bind_edges(void)
+{
+    bool binding = false;
+    unsigned int i;
+
+    bind_edges = calloc(frame_count, sizeof(uint64_t));
+    if (bind_edges == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    for (i = 0; i < frame_count; i++) {
+        const frame_t *f = &frames[i];
+
+        if (f->type == FRAME_TYPE_PACKET && (f->flags & PACKET_FLAG_BINDING)) {
+            if (!binding) {
+                const frame_t *previous = (i > 0) ? &frames[i - 1] : NULL;
+
+                if (previous  &&  previous->type == FRAME_TYPE_PACKET) {
+                    bind_edges[bind_edge_count++] = previous->time_us;
+                }
+                else {
+                    bind_edges[bind_edge_count++] =
+                        f->time_us - BIND_PACKET_INTERVAL_US;
+                }
+            }
+            binding = true;
+        }
+        else {
+            binding = false;
+        }
+    }
+}
+
+
+// ****************************************************************************
+static bool next_recorded_packet(hk310_packet_t *packet)
+{
+    while (next_frame < frame_count) {
+        const frame_t *f = &frames[next_frame++];
+
+        if (f->type == FRAME_TYPE_BIND_DATA) {
+            memcpy(bind_data, f->data, HK310_BIND_DATA_SIZE);
+            continue;
+        }
+
+        if (!(f->flags & PACKET_FLAG_SAME_DRAIN)) {
+            drain_time = f->time_us;
+        }
+        packet->time_us = drain_time;
+        packet->hop_index = f->hop_index;
+        memcpy(packet->payload, f->data, HK310_PAYLOAD_SIZE);
+
+        if (f->flags & PACKET_FLAG_BINDING) {
+            packet->type = HK310_PACKET_BIND;
+            packet->channel = HK310_BIND_CHANNEL;
+            packet->address = hk310_get_bind_address();
+        }
+        else {
+            packet->type = (f->data[7] == 0xaa) ?
+                HK310_PACKET_FAILSAFE : HK310_PACKET_STICK;
+            packet->channel = bind_data[HK310_ADDRESS_WIDTH +
+                f->hop_index % HK310_NUMBER_OF_HOP_CHANNELS];
+            packet->address = bind_data;
+        }
+        return true;
+    }
+    return false;
+}
+
+
+// ****************************************************************************
+static void check_packet(const hk310_packet_t *packet, bool received)
+{
+    ++packets;
+    if (packet->type == HK310_PACKET_BIND) {
+        ++binding_packets;
+    }
+
+    if (!received) {
+        if (not_received == 0) {
+            first_divergence = packets;
+            first_divergence_time = packet->time_us;
+        }
+        ++not_received;
+    }
+
+    if (verbose) {
+        printf("%12.6f s  hop %2u  channel 0x%02x  RF_CH 0x%02x  %s\n",
+            (packet->time_us - SIMULATION_POWER_ON_TIME_US) / 1e6,
+            packet->hop_index, packet->channel, nrf24l01_get_channel(),
+            received ? "received" : "NOT RECEIVED");
+    }
+}
+
+
+// ****************************************************************************
+static void check_receiver(uint64_t now)
+{
+    unsigned int i;
+
+    if (next_bind_edge < bind_edge_count) {
+        uint64_t press = bind_edges[next_bind_edge];
+
+        if (port_binds_on_button_release()) {
+            press -= BIND_BUTTON_HOLD_US;
+        }
+
+        if (now >= press + BIND_BUTTON_HOLD_US) {
+            port_set_bind_button(false);
+            ++next_bind_edge;
+        }
+        else if (now >= press) {
+            port_set_bind_button(true);
+        }
+    }
+
+    // FNV-1a over every change of the servo outputs and its time
+    if (memcmp(last_channels, channels, sizeof(last_channels)) != 0) {
+        uint8_t bytes[sizeof(channels) + sizeof(now)];
+
+        memcpy(last_channels, channels, sizeof(last_channels));
+        memcpy(bytes, channels, sizeof(channels));
+        memcpy(bytes + sizeof(channels), &now, sizeof(now));
+        for (i = 0; i < sizeof(bytes); i++) {
+            output_digest = (output_digest ^ bytes[i]) * 16777619u;
+        }
+        ++output_changes;
+    }
+}
+
+
+// ****************************************************************************
+static void print_report(const char *filename, unsigned int session,
+    uint64_t duration_us, double cpu_s)
+{
+    nrf24l01_spi_statistics_t spi;
+    double n;
+
+    nrf24l01_get_spi_statistics(&spi);
+    n = spi.payloads_read ? spi.payloads_read : 1;
+
+    printf("\n%s: session %u of %s, %.2f s\n\n", port_get_name(), session,
+        filename, duration_us / 1e6);
+
+    printf("%-32s %10u\n", "Recorded packets", packets);
+    printf("%-32s %10u\n", "  read by process_binding()", binding_packets);
+    printf("%-32s %10u\n", "Frames lost on the UART", lost_frames);
+    printf("%-32s %10u\n", "Packets read by the firmware", spi.payloads_read);
+    printf("%-32s %10u\n", "Packets not received", not_received);
+    if (not_received) {
+        printf("%-32s %10u at %.6f s\n", "  first divergence at packet",
+            first_divergence,
+            (first_divergence_time - SIMULATION_POWER_ON_TIME_US) / 1e6);
+    }
+    printf("%-32s 0x%08x (%u changes)\n", "Servo output digest",
+        output_digest, output_changes);
+    printf("%-32s %10.2f\n", "SPI transactions per packet",
+        spi.transactions / n);
+    printf("%-32s %10.2f\n", "SPI bytes per packet", spi.bytes / n);
+    printf("%-32s %10.1f\n", "Host CPU time per packet (us)",
+        cpu_s * 1e6 / n);
+
+    if (lost_frames) {
+        printf("\nThe capture is incomplete, so the replay may diverge.\n");
+    }
+}
+
+
+// ****************************************************************************
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options] capture.rxcap\n"
+        "  -S session          Session to replay (default 1)\n"
+        "  -v                  Print every packet\n",
+        name);
+    exit(1);
+}
+
+
+// ****************************************************************************
+int main(int argc, char *argv[])
+{
+    unsigned int session = 1;
+    uint64_t duration_us;
+    clock_t start;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "S:v")) != -1) {
+        switch (opt) {
+            case 'S':
+                session = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'v':
+                verbose = true;
+                break;
+
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    if (optind >= argc || session == 0) {
+        usage(argv[0]);
+    }
+
+    load_session(argv[optind], session);
+    find_bind_edges();
+    memcpy(bind_data, frames[0].data, HK310_BIND_DATA_SIZE);
+    next_frame = 1;
+    duration_us = frames[frame_count - 1].time_us + TRAILING_TIME_US -
+        SIMULATION_POWER_ON_TIME_US;
+
+    start = clock();
+
+    simulation_init(bind_data, 0, 0);
+    simulation_set_packet_source(next_recorded_packet);
+    simulation_set_packet_callback(check_packet);
+    simulation_set_main_loop_callback(check_receiver);
+    simulation_run(duration_us);
+
+    print_report(argv[optind], session, duration_us,
+        (double)(clock() - start) / CLOCKS_PER_SEC);
+
+    return 0;
+}
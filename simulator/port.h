@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ****************************************************************************
+// Interface between the port independent simulation tools and the glue code
+// of a particular receiver port. Each port links its own implementation.
+// ****************************************************************************
+
+// Power-on reset of MCU and radio, using the given 25 bytes of bind data as
+// content of the persistent storage. Runs the firmware initialization.
+void port_reset(const uint8_t *bind_data);
+
+// Microseconds until the next timer event of the MCU (hop timer, systick)
+uint32_t port_time_to_next_event(void);
+
+// Advance the MCU timers, running the interrupt handlers that become due
+void port_advance(uint32_t microseconds);
+
+// Falling edge on the nRF24 IRQ line
+void port_rf_interrupt(void);
+
+// Run one iteration of the firmware main loop. Returns the number of
+// microseconds spent in busy waiting (delay_us) and SPI transfers.
+uint32_t port_run_main_loop(void);
+
+// Whether the last port_run_main_loop() completed an iteration. Ports that
+// run the firmware main loop as is return early while it waits for a
+// peripheral, and resume the iteration in the next call.
+bool port_is_main_loop_complete(void);
+
+// SPI clock the port uses to talk to the nRF24
+uint32_t port_get_spi_clock(void);
+
+// Number of iterations the busy-wait loops in spi_transaction() of the port
+// spent polling the SPI status since port_reset(). Estimated from the SPI
+// clock and the CPU cycles of one loop iteration.
+uint32_t port_get_spi_polls(void);
+
+// Conversion of the 16-bit stick value sent over the air into the value
+// the firmware stores in channels[]
+uint16_t port_stick_to_channel(uint16_t stick);
+
+// Press or release the bind button. The firmware samples it every systick.
+void port_set_bind_button(bool pressed);
+
+// Whether the firmware starts the bind procedure when the bind button is
+// released (true) or when it is pressed (false)
+bool port_binds_on_button_release(void);
+
+
+// ****************************************************************************
+// Servo outputs
+// ****************************************************************************
+
+// Outputs as passed to the edge callback. CH1..CH3 correspond to
+// channels[0..2]; PPM is the combined output some ports provide.
+#define PORT_CH1 0
+#define PORT_CH2 1
+#define PORT_CH3 2
+#define PORT_PPM 3
+#define PORT_NUMBER_OF_OUTPUTS 4
+
+// Called whenever a servo output changes its level. time_ns counts from
+// port_reset() with the resolution of the timer that drives the output.
+typedef void (* port_edge_callback_t)(unsigned int output, bool level,
+    uint64_t time_ns);
+
+// Short name of the port, used in reports
+const char *port_get_name(void);
+
+// How the port models the timing of its servo outputs, for the pulse_bench
+// report
+const char *port_get_output_model(void);
+
+// Whether the port drives the given output at all
+bool port_has_output(unsigned int output);
+
+void port_set_edge_callback(port_edge_callback_t callback);
+
+// Nominal servo pulse width in nanoseconds for a value in channels[]
+uint32_t port_channel_to_pulse_ns(uint16_t channel);
@@ -0,0 +1,50 @@
+/******************************************************************************
+
+    Pseudo random numbers for the simulation tools.
+
+    xorshift64*, good enough for a simulation and identical on all hosts, so
+    that a given seed always reproduces the same results.
+
+******************************************************************************/
+#include <stdint.h>
+#include <math.h>
+
+#include <prng.h>
+
+
+static uint64_t state = 1;
+
+
+// ****************************************************************************
+void prng_seed(uint64_t seed)
+{
+    state = seed ? seed : 1;
+}
+
+
+// ****************************************************************************
+uint64_t prng_next(void)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dull;
+}
+
+
+// ****************************************************************************
+// Uniformly distributed random number in [0, 1)
+// ****************************************************************************
+double prng_uniform(void)
+{
+    return (prng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// ****************************************************************************
+// Exponentially distributed interval for events happening at the given rate
+// ****************************************************************************
+double prng_exponential(double rate)
+{
+    return -1.0 / rate * log1p(-prng_uniform());
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+void prng_seed(uint64_t seed);
+uint64_t prng_next(void);
+double prng_uniform(void);
+double prng_exponential(double rate);
@@ -0,0 +1,290 @@
+/******************************************************************************
+
+    Servo pulse accuracy and jitter benchmark
+
+    Runs the receiver firmware against the HK310 transmitter model over a
+    perfect link and records every edge on the servo outputs CH1..CH3 (and
+    on the PPM output for ports that have one). Each pulse is compared with
+    the value in channels[] at the time the pulse started:
+
+    - mean error: average difference between the measured and the nominal
+      pulse width, i.e. the systematic offset of the output stage
+    - standard deviation and a histogram of the jitter around the mean
+    - worst case: the largest deviation from the nominal width seen
+
+    For PPM the time between two falling edges is the pulse of a channel;
+    a gap of more than 3 ms marks the start of a frame.
+
+    Only pulses that start after the firmware received its first stick data
+    are measured. The output is the same for all ports so the reports can be
+    compared side by side.
+
+    Usage: see usage() below
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include <port.h>
+#include <prng.h>
+#include <simulation.h>
+
+
+#define NUMBER_OF_CHANNELS 3
+
+#define PPM_SYNC_GAP_NS 3000000
+
+#define HISTOGRAM_BIN_NS 250
+#define HISTOGRAM_RANGE_NS 2000
+#define HISTOGRAM_BINS (2 * HISTOGRAM_RANGE_NS / HISTOGRAM_BIN_NS)
+
+
+typedef struct {
+    unsigned int pulses;
+    double sum;
+    double sum_of_squares;
+    double worst;
+    // Deviations from the nominal width, in ns, for the jitter histogram
+    int32_t *errors;
+    unsigned int capacity;
+} output_statistics_t;
+
+
+extern uint16_t channels[NUMBER_OF_CHANNELS];
+extern bool successful_stick_data;
+
+static const char *output_names[PORT_NUMBER_OF_OUTPUTS] = {
+    "CH1", "CH2", "CH3", "PPM"
+};
+
+static const uint8_t BIND_DATA[HK310_BIND_DATA_SIZE] = {
+    0x2a, 0x91, 0x3c, 0x5e, 0x07,
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27
+};
+
+static double duration_s = 60.0;
+static uint64_t seed = 1;
+
+static output_statistics_t statistics[PORT_NUMBER_OF_OUTPUTS];
+
+// Start of the current pulse and the value it was commanded with
+static uint64_t rise_time[NUMBER_OF_CHANNELS];
+static uint16_t commanded[NUMBER_OF_CHANNELS];
+static bool pulse_valid[NUMBER_OF_CHANNELS];
+
+static uint64_t ppm_last_fall;
+static unsigned int ppm_index = NUMBER_OF_CHANNELS;
+static uint16_t ppm_commanded;
+
+
+// ****************************************************************************
+static void add_pulse(unsigned int output, uint64_t width_ns, uint16_t channel)
+{
+    output_statistics_t *s = &statistics[output];
+    double error = (double)width_ns - port_channel_to_pulse_ns(channel);
+
+    if (s->pulses == s->capacity) {
+        s->capacity = s->capacity ? 2 * s->capacity : 4096;
+        s->errors = realloc(s->errors, s->capacity * sizeof(s->errors[0]));
+        if (s->errors == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+
+    s->errors[s->pulses++] = (int32_t)error;
+    s->sum += error;
+    s->sum_of_squares += error * error;
+    if (fabs(error) > fabs(s->worst)) {
+        s->worst = error;
+    }
+}
+
+
+// ****************************************************************************
+static void ppm_edge(bool level, uint64_t time_ns)
+{
+    uint64_t interval;
+
+    // The falling edges are the channel separators
+    if (level) {
+        return;
+    }
+
+    interval = time_ns - ppm_last_fall;
+    ppm_last_fall = time_ns;
+
+    if (interval > PPM_SYNC_GAP_NS) {
+        ppm_index = 0;
+    }
+    else if (ppm_index < NUMBER_OF_CHANNELS) {
+        add_pulse(PORT_PPM, interval, ppm_commanded);
+        ++ppm_index;
+    }
+
+    if (ppm_index < NUMBER_OF_CHANNELS && successful_stick_data) {
+        ppm_commanded = channels[ppm_index];
+    }
+    else {
+        ppm_index = NUMBER_OF_CHANNELS;
+    }
+}
+
+
+// ****************************************************************************
+static void edge(unsigned int output, bool level, uint64_t time_ns)
+{
+    if (output == PORT_PPM) {
+        ppm_edge(level, time_ns);
+        return;
+    }
+
+    if (level) {
+        rise_time[output] = time_ns;
+        commanded[output] = channels[output];
+        pulse_valid[output] = successful_stick_data;
+        return;
+    }
+
+    if (pulse_valid[output]) {
+        add_pulse(output, time_ns - rise_time[output], commanded[output]);
+        pulse_valid[output] = false;
+    }
+}
+
+
+// ****************************************************************************
+static void print_report(void)
+{
+    unsigned int histogram[PORT_NUMBER_OF_OUTPUTS][HISTOGRAM_BINS + 2];
+    double mean[PORT_NUMBER_OF_OUTPUTS];
+    unsigned int output;
+    unsigned int i;
+
+    memset(histogram, 0, sizeof(histogram));
+    memset(mean, 0, sizeof(mean));
+
+    printf("\n%s: %.0f s, seed %llu\n", port_get_name(), duration_s,
+        (unsigned long long)seed);
+    printf("Output timing: %s\n\n", port_get_output_model());
+    printf("Output    Pulses   Mean error    Std dev   Worst case\n");
+
+    for (output = 0; output < PORT_NUMBER_OF_OUTPUTS; output++) {
+        output_statistics_t *s = &statistics[output];
+        double variance;
+
+        if (!port_has_output(output)) {
+            continue;
+        }
+
+        if (s->pulses == 0) {
+            printf("%-6s  %8u          n/a        n/a          n/a\n",
+                output_names[output], 0);
+            continue;
+        }
+
+        mean[output] = s->sum / s->pulses;
+        variance = s->sum_of_squares / s->pulses - mean[output] * mean[output];
+
+        printf("%-6s  %8u  %+8.3f us  %6.3f us  %+8.3f us\n",
+            output_names[output], s->pulses, mean[output] / 1e3,
+            sqrt(variance > 0 ? variance : 0) / 1e3, s->worst / 1e3);
+
+        // Bin 0 and the last bin collect everything outside the range
+        for (i = 0; i < s->pulses; i++) {
+            double jitter = s->errors[i] - mean[output];
+            int bin = (int)floor((jitter + HISTOGRAM_RANGE_NS) /
+                HISTOGRAM_BIN_NS) + 1;
+
+            if (bin < 0) {
+                bin = 0;
+            }
+            if (bin > HISTOGRAM_BINS + 1) {
+                bin = HISTOGRAM_BINS + 1;
+            }
+            ++histogram[output][bin];
+        }
+    }
+
+    printf("\nJitter around the mean error\n");
+    printf("                   ");
+    for (output = 0; output < PORT_NUMBER_OF_OUTPUTS; output++) {
+        if (port_has_output(output)) {
+            printf("  %8s", output_names[output]);
+        }
+    }
+    printf("\n");
+
+    for (i = 0; i < HISTOGRAM_BINS + 2; i++) {
+        int low = (int)i * HISTOGRAM_BIN_NS - HISTOGRAM_RANGE_NS -
+            HISTOGRAM_BIN_NS;
+
+        if (i == 0) {
+            printf("        < %+6.2f us", -HISTOGRAM_RANGE_NS / 1e3);
+        }
+        else if (i == HISTOGRAM_BINS + 1) {
+            printf("       >= %+6.2f us", HISTOGRAM_RANGE_NS / 1e3);
+        }
+        else {
+            printf("%+6.2f .. %+6.2f us", low / 1e3,
+                (low + HISTOGRAM_BIN_NS) / 1e3);
+        }
+
+        for (output = 0; output < PORT_NUMBER_OF_OUTPUTS; output++) {
+            if (port_has_output(output)) {
+                printf("  %8u", histogram[output][i]);
+            }
+        }
+        printf("\n");
+    }
+}
+
+
+// ****************************************************************************
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -t seconds          Duration of the simulation (default 60)\n"
+        "  -s seed             Seed for the random generator (default 1)\n",
+        name);
+    exit(1);
+}
+
+
+// ****************************************************************************
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:s:")) != -1) {
+        switch (opt) {
+            case 't':
+                duration_s = atof(optarg);
+                break;
+
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    prng_seed(seed);
+
+    port_set_edge_callback(edge);
+    simulation_init(BIND_DATA, prng_next() % SIMULATION_POWER_ON_TIME_US, 0);
+    simulation_run(duration_s * 1e6);
+
+    print_report();
+
+    return 0;
+}
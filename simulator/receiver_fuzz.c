@@ -0,0 +1,907 @@
+/******************************************************************************
+
+    Fuzz harness for the bind procedure and the payload parser
+
+    Drives the unmodified rc_receiver.c and rf.c of a port with arbitrary
+    sequences of packets, timer events and bind button changes, and checks
+    for
+
+    - crashes (and, in the libFuzzer build, memory and undefined behaviour
+      errors found by the sanitizers)
+    - channels above 125 passed to rf_set_channel() or rf_set_hop_channels()
+    - a receiver that is binding and does not bind to a transmitter
+    - a receiver that is deaf: not in RX mode, not accepting a packet on
+      the channel and address it listens on, or not reading it
+    - a receiver that does not hop after a valid stick data packet
+
+    The last three are checked after the input has been processed. The bind
+    button is released; if the receiver is binding, the HK310 transmitter
+    model sends its packets and the receiver has to bind to it within
+    100 ms. Then the receiver has to receive a stick data packet on its
+    current channel and hop within two hop periods.
+
+    The input is a sequence of events. Each event is one byte, the upper
+    3 bits select the event and the lower 5 bits are its argument, followed
+    by the payload bytes of the event (missing bytes at the end of the input
+    read as 0):
+
+        0  Payload: 10 bytes, sent on the channel and address the
+           receiver listens on
+        1  Stick data: 7 bytes for payload[0..6], payload[7] is 0x55,
+           2 bytes for payload[8..9]
+        2  Failsafe: 6 bytes for payload[0..5], payload[7] is 0xaa,
+           payload[8] is 0x5a (argument bit 0 set) or 0x5b
+        3  Bind packet (argument bits 0..1) on the bind channel and address:
+           0: ff aa 55 and 7 bytes; 1..3: the checksum of the last bind
+           packet 0 sent, 0..2 and 7 bytes
+        4  Wait (argument + 1) * 100 us
+        5  Wait (argument + 1) * 10 ms
+        6  Bind button pressed (argument bit 0 set) or released
+        7  Wait for the next timer event of the MCU
+
+    A packet takes its airtime before it arrives. Argument bit 4 of the
+    packet events keeps the RF interrupt pending, so that the next packet
+    arrives before the firmware reads the RX FIFO.
+
+    The firmware state is reset between inputs by restoring a snapshot of
+    the data and bss sections of the firmware, the port glue and the
+    nRF24L01+ model, taken after port_reset(). The makefile moves those
+    sections of the port objects to fuzz_data and fuzz_bss for this; prng.c
+    is left out, it generates the inputs of the stand-alone driver.
+
+    Built with FUZZ_LIBFUZZER the file provides LLVMFuzzerTestOneInput() and
+    aborts on the first finding. Otherwise main() generates random event
+    sequences, reports the findings and writes an example input of each
+    kind of finding; the -r option runs given input files, also from AFL.
+
+    Usage: see usage() below
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <nrf24l01.h>
+#include <hk310_transmitter.h>
+#include <port.h>
+#include <prng.h>
+
+#include <rf.h>
+
+
+#define NUMBER_OF_CHANNELS 3
+
+#define MAX_RF_CHANNEL 125
+#define BIND_START_TIME_US 40000            // Button release to binding
+#define BIND_RECOVERY_TIME_US 100000
+#define LIVENESS_ATTEMPTS 20
+#define LIVENESS_STICK_VALUE 0xf9c0
+
+#define FIFO_STATUS_RX_EMPTY (1 << 0)
+
+#define EVENT_PAYLOAD 0
+#define EVENT_STICKS 1
+#define EVENT_FAILSAFE 2
+#define EVENT_BIND 3
+#define EVENT_WAIT 4
+#define EVENT_WAIT_LONG 5
+#define EVENT_BUTTON 6
+#define EVENT_TIMER 7
+#define EVENT_ARGUMENT_MASK 0x1f
+#define EVENT_KEEP_IRQ_PENDING (1 << 4)
+
+#define MAX_INPUT_SIZE 4096
+
+// Random inputs of the stand-alone driver
+#define MAX_RANDOM_EVENTS 48
+#define TIME_CHECK_INTERVAL 10000
+
+enum {
+    FINDING_CHANNEL,
+    FINDING_BINDING,
+    FINDING_DEAF,
+    FINDING_NO_HOP,
+    NUMBER_OF_FINDINGS
+};
+
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+} input_t;
+
+
+void __real_rf_set_channel(uint8_t channel);
+void __wrap_rf_set_channel(uint8_t channel);
+void __real_rf_set_hop_channels(uint8_t count, const uint8_t hop_channels[]);
+void __wrap_rf_set_hop_channels(uint8_t count, const uint8_t hop_channels[]);
+void __real_rf_hop(uint8_t hop_index);
+void __wrap_rf_hop(uint8_t hop_index);
+
+extern uint16_t channels[NUMBER_OF_CHANNELS];
+
+// Created by the linker for the sections the makefile renames
+extern uint8_t __start_fuzz_data[] __attribute__((weak));
+extern uint8_t __stop_fuzz_data[] __attribute__((weak));
+extern uint8_t __start_fuzz_bss[] __attribute__((weak));
+extern uint8_t __stop_fuzz_bss[] __attribute__((weak));
+
+static const char * const FINDING_NAMES[NUMBER_OF_FINDINGS] = {
+    "channel",
+    "binding",
+    "deaf",
+    "no-hop"
+};
+
+// The default bind data of link_sim
+static const uint8_t BIND_DATA[HK310_BIND_DATA_SIZE] = {
+    0x2a, 0x91, 0x3c, 0x5e, 0x07,
+    0x14, 0x35, 0x16, 0x47, 0x18, 0x29, 0x1a, 0x4b, 0x1c, 0x3d,
+    0x1e, 0x2f, 0x20, 0x41, 0x22, 0x33, 0x24, 0x45, 0x26, 0x27
+};
+
+static uint8_t *data_snapshot;
+static uint8_t *bss_snapshot;
+static uint64_t snapshot_time_us;
+
+// Harness state, reset for every input
+static uint64_t now;
+static bool irq_active;
+static uint16_t bind_checksum;
+static unsigned int hops;
+static int finding;
+static char finding_message[160];
+
+static bool verbose;
+static const input_t *current_input;
+
+
+// ****************************************************************************
+static void report(int kind, const char *message, unsigned int value)
+{
+    if (finding >= 0) {
+        return;
+    }
+
+    finding = kind;
+    snprintf(finding_message, sizeof(finding_message), message, value);
+
+#ifdef FUZZ_LIBFUZZER
+    fprintf(stderr, "%s: %s: %s\n", port_get_name(), FINDING_NAMES[kind],
+        finding_message);
+    abort();
+#endif
+}
+
+
+// ****************************************************************************
+void __wrap_rf_set_channel(uint8_t channel)
+{
+    if (channel > MAX_RF_CHANNEL) {
+        report(FINDING_CHANNEL, "rf_set_channel(%u)", channel);
+    }
+
+    ++hops;
+    __real_rf_set_channel(channel);
+}
+
+
+// ****************************************************************************
+void __wrap_rf_set_hop_channels(uint8_t count, const uint8_t hop_channels[])
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        if (hop_channels[i] > MAX_RF_CHANNEL) {
+            report(FINDING_CHANNEL, "rf_set_hop_channels(..., %u, ...)",
+                hop_channels[i]);
+            break;
+        }
+    }
+
+    __real_rf_set_hop_channels(count, hop_channels);
+}
+
+
+// ****************************************************************************
+void __wrap_rf_hop(uint8_t hop_index)
+{
+    ++hops;
+    __real_rf_hop(hop_index);
+}
+
+
+// ****************************************************************************
+// With AddressSanitizer the sections include the redzones around globals, so
+// they are copied byte by byte without sanitizer checks.
+// ****************************************************************************
+#ifdef FUZZ_LIBFUZZER
+__attribute__((no_sanitize("address")))
+static void copy_section(void *destination, const void *source, size_t size)
+{
+    volatile uint8_t *d = destination;
+    const volatile uint8_t *s = source;
+
+    while (size--) {
+        *d++ = *s++;
+    }
+}
+#else
+#define copy_section memcpy
+#endif
+
+
+// ****************************************************************************
+static size_t section_size(const uint8_t *start, const uint8_t *stop)
+{
+    return (start && stop) ? (size_t)(stop - start) : 0;
+}
+
+
+// ****************************************************************************
+static void take_snapshot(void)
+{
+    size_t data_size = section_size(__start_fuzz_data, __stop_fuzz_data);
+    size_t bss_size = section_size(__start_fuzz_bss, __stop_fuzz_bss);
+
+    if (bss_size == 0) {
+        fprintf(stderr, "No fuzz_bss section: link with the fuzz objects\n");
+        exit(1);
+    }
+
+    port_reset(BIND_DATA);
+    snapshot_time_us = 0;
+
+    data_snapshot = malloc(data_size + 1);
+    bss_snapshot = malloc(bss_size);
+    if (data_snapshot == NULL || bss_snapshot == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    copy_section(data_snapshot, __start_fuzz_data, data_size);
+    copy_section(bss_snapshot, __start_fuzz_bss, bss_size);
+}
+
+
+// ****************************************************************************
+static void restore_snapshot(void)
+{
+    copy_section(__start_fuzz_data, data_snapshot,
+        section_size(__start_fuzz_data, __stop_fuzz_data));
+    copy_section(__start_fuzz_bss, bss_snapshot,
+        section_size(__start_fuzz_bss, __stop_fuzz_bss));
+
+    now = snapshot_time_us;
+    nrf24l01_set_time(now);
+    irq_active = nrf24l01_is_irq_active();
+    bind_checksum = 0;
+    hops = 0;
+    finding = -1;
+}
+
+
+// ****************************************************************************
+static uint8_t next_byte(input_t *input)
+{
+    if (input->offset >= input->size) {
+        return 0;
+    }
+    return input->data[input->offset++];
+}
+
+
+// ****************************************************************************
+// Falling edge on the IRQ line, as in simulation_run()
+// ****************************************************************************
+static void check_irq(void)
+{
+    if (nrf24l01_is_irq_active() && !irq_active) {
+        port_rf_interrupt();
+    }
+    irq_active = nrf24l01_is_irq_active();
+}
+
+
+// ****************************************************************************
+static void run_main_loop(void)
+{
+    check_irq();
+    port_run_main_loop();
+    irq_active = nrf24l01_is_irq_active();
+}
+
+
+// ****************************************************************************
+// Advance the MCU timers, running the main loop after every timer event
+// ****************************************************************************
+static void advance(uint32_t microseconds)
+{
+    while (microseconds  &&  finding < 0) {
+        uint32_t step = port_time_to_next_event();
+
+        if (step == 0) {
+            step = 1;
+        }
+        if (step > microseconds) {
+            step = microseconds;
+        }
+
+        port_advance(step);
+        now += step;
+        nrf24l01_set_time(now);
+        microseconds -= step;
+
+        run_main_loop();
+    }
+}
+
+
+// ****************************************************************************
+static bool is_binding(void)
+{
+    uint8_t address[NRF24L01_MAX_ADDRESS_WIDTH];
+
+    nrf24l01_get_rx_address(address);
+    return memcmp(address, hk310_get_bind_address(), HK310_ADDRESS_WIDTH) == 0;
+}
+
+
+// ****************************************************************************
+// Send a packet after its airtime, on the given channel and address or, if
+// address is NULL, on those the receiver listens on
+// ****************************************************************************
+static bool send_packet(uint8_t channel, const uint8_t *address,
+    const uint8_t *payload, bool keep_irq_pending)
+{
+    uint8_t rx_address[NRF24L01_MAX_ADDRESS_WIDTH];
+    bool received;
+
+    advance(nrf24l01_get_airtime_us(HK310_PAYLOAD_SIZE));
+
+    if (address == NULL) {
+        nrf24l01_get_rx_address(rx_address);
+        address = rx_address;
+        channel = nrf24l01_get_channel();
+    }
+
+    received = nrf24l01_receive_packet(channel, address, HK310_ADDRESS_WIDTH,
+        payload, HK310_PAYLOAD_SIZE);
+
+    if (verbose) {
+        int i;
+
+        printf("%10.6f s  channel 0x%02x  ", now / 1e6, channel);
+        for (i = 0; i < HK310_PAYLOAD_SIZE; i++) {
+            printf("%02x ", payload[i]);
+        }
+        printf(" %s\n", received ? "received" : "-");
+    }
+
+    if (!keep_irq_pending) {
+        run_main_loop();
+    }
+    return received;
+}
+
+
+// ****************************************************************************
+static void run_event(input_t *input)
+{
+    uint8_t event = next_byte(input);
+    uint8_t argument = event & EVENT_ARGUMENT_MASK;
+    bool keep_irq_pending = (argument & EVENT_KEEP_IRQ_PENDING) != 0;
+    uint8_t payload[HK310_PAYLOAD_SIZE];
+    int i;
+
+    memset(payload, 0, sizeof(payload));
+
+    switch (event >> 5) {
+        case EVENT_PAYLOAD:
+            for (i = 0; i < HK310_PAYLOAD_SIZE; i++) {
+                payload[i] = next_byte(input);
+            }
+            send_packet(0, NULL, payload, keep_irq_pending);
+            break;
+
+        case EVENT_STICKS:
+            for (i = 0; i < 7; i++) {
+                payload[i] = next_byte(input);
+            }
+            payload[7] = 0x55;
+            payload[8] = next_byte(input);
+            payload[9] = next_byte(input);
+            send_packet(0, NULL, payload, keep_irq_pending);
+            break;
+
+        case EVENT_FAILSAFE:
+            for (i = 0; i < 6; i++) {
+                payload[i] = next_byte(input);
+            }
+            payload[7] = 0xaa;
+            payload[8] = (argument & 1) ? 0x5a : 0x5b;
+            send_packet(0, NULL, payload, keep_irq_pending);
+            break;
+
+        case EVENT_BIND:
+            if ((argument & 3) == 0) {
+                payload[0] = 0xff;
+                payload[1] = 0xaa;
+                payload[2] = 0x55;
+                bind_checksum = 0;
+                for (i = 3; i < HK310_PAYLOAD_SIZE; i++) {
+                    payload[i] = next_byte(input);
+                    if (i < 3 + HK310_ADDRESS_WIDTH) {
+                        bind_checksum += payload[i];
+                    }
+                }
+            }
+            else {
+                payload[0] = bind_checksum & 0xff;
+                payload[1] = bind_checksum >> 8;
+                payload[2] = (argument & 3) - 1;
+                for (i = 3; i < HK310_PAYLOAD_SIZE; i++) {
+                    payload[i] = next_byte(input);
+                }
+            }
+            send_packet(HK310_BIND_CHANNEL, hk310_get_bind_address(), payload,
+                keep_irq_pending);
+            break;
+
+        case EVENT_WAIT:
+            advance((argument + 1) * 100);
+            break;
+
+        case EVENT_WAIT_LONG:
+            advance((argument + 1) * 10000);
+            break;
+
+        case EVENT_BUTTON:
+            port_set_bind_button(argument & 1);
+            break;
+
+        case EVENT_TIMER:
+        default:
+            advance(port_time_to_next_event() + 1);
+            break;
+    }
+}
+
+
+// ****************************************************************************
+// Send the packets of the HK310 transmitter model until the receiver has
+// bound to it
+// ****************************************************************************
+static void recover_binding(void)
+{
+    uint32_t airtime_us = nrf24l01_get_airtime_us(HK310_PAYLOAD_SIZE);
+    uint64_t end = now + BIND_RECOVERY_TIME_US;
+    hk310_packet_t packet;
+
+    hk310_init(BIND_DATA, now, 0);
+
+    while (is_binding()  &&  now < end  &&  finding < 0) {
+        hk310_next_packet(&packet, airtime_us);
+        advance(packet.time_us - now);
+        nrf24l01_receive_packet(packet.channel, packet.address,
+            HK310_ADDRESS_WIDTH, packet.payload, HK310_PAYLOAD_SIZE);
+        run_main_loop();
+    }
+}
+
+
+// ****************************************************************************
+// After the input the receiver must finish binding and then receive and
+// hop again
+// ****************************************************************************
+static void check_liveness(void)
+{
+    uint8_t payload[HK310_PAYLOAD_SIZE];
+    unsigned int hops_before;
+    int attempt;
+
+    port_set_bind_button(false);
+    advance(BIND_START_TIME_US);
+
+    if (is_binding()) {
+        recover_binding();
+    }
+    if (finding >= 0) {
+        return;
+    }
+    if (is_binding()) {
+        report(FINDING_BINDING, "not bound to the transmitter within %u ms",
+            BIND_RECOVERY_TIME_US / 1000);
+        return;
+    }
+
+    if ((nrf24l01_get_register(CONFIG) & (PWR_UP | PRIM_RX)) !=
+            (PWR_UP | PRIM_RX)  ||  !nrf24l01_ce()) {
+        report(FINDING_DEAF, "radio not in RX mode (CONFIG 0x%02x)",
+            nrf24l01_get_register(CONFIG));
+        return;
+    }
+
+    memset(payload, 0, sizeof(payload));
+    for (attempt = 0; attempt < NUMBER_OF_CHANNELS; attempt++) {
+        payload[attempt * 2] = LIVENESS_STICK_VALUE & 0xff;
+        payload[attempt * 2 + 1] = LIVENESS_STICK_VALUE >> 8;
+    }
+    payload[7] = 0x55;
+
+    // The packet may collide with a hop, or with the settling time after it
+    for (attempt = 0; attempt < LIVENESS_ATTEMPTS; attempt++) {
+        if (send_packet(0, NULL, payload, false)) {
+            break;
+        }
+        advance(HK310_HOP_TIME_US / 3);
+    }
+    if (finding >= 0) {
+        return;
+    }
+    if (attempt == LIVENESS_ATTEMPTS) {
+        report(FINDING_DEAF, "no packet accepted on channel 0x%02x",
+            nrf24l01_get_channel());
+        return;
+    }
+
+    if (!(nrf24l01_get_register(FIFO_STATUS) & FIFO_STATUS_RX_EMPTY)  ||
+            nrf24l01_is_irq_active()) {
+        report(FINDING_DEAF, "packet not read (STATUS 0x%02x)",
+            nrf24l01_get_register(STATUS));
+        return;
+    }
+
+    if (channels[0] != port_stick_to_channel(LIVENESS_STICK_VALUE)) {
+        report(FINDING_DEAF, "stick data not applied (channels[0] = %u)",
+            channels[0]);
+        return;
+    }
+
+    hops_before = hops;
+    advance(2 * HK310_HOP_TIME_US);
+    if (finding < 0  &&  hops == hops_before) {
+        report(FINDING_NO_HOP, "no hop within %u us after a packet",
+            2 * HK310_HOP_TIME_US);
+    }
+}
+
+
+// ****************************************************************************
+static int run_input(const uint8_t *data, size_t size)
+{
+    input_t input = {data, size, 0};
+
+    current_input = &input;
+    restore_snapshot();
+
+    while (input.offset < input.size  &&  finding < 0) {
+        run_event(&input);
+    }
+
+    if (finding < 0) {
+        check_liveness();
+    }
+
+    current_input = NULL;
+    return finding;
+}
+
+
+#ifdef FUZZ_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// ****************************************************************************
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (bss_snapshot == NULL) {
+        take_snapshot();
+    }
+
+    run_input(data, size);
+    return 0;
+}
+
+#else
+
+
+static unsigned int finding_counts[NUMBER_OF_FINDINGS];
+static const char *output_dir;
+
+
+// ****************************************************************************
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options] [-r input...]\n"
+        "  -n sequences        Number of random sequences (default 1000000)\n"
+        "  -t seconds          Run for the given time instead\n"
+        "  -s seed             Seed of the random sequences (default 1)\n"
+        "  -o directory        Write an example input of each finding there\n"
+        "  -r                  Run the given input files instead\n"
+        "  -v                  Print every packet of the -r inputs\n",
+        name);
+    exit(1);
+}
+
+
+// ****************************************************************************
+// Write the input that caused a finding as <port>-<finding>.bin
+// ****************************************************************************
+static void write_input(int kind, const uint8_t *data, size_t size)
+{
+    char filename[256];
+    FILE *f;
+
+    if (output_dir == NULL) {
+        return;
+    }
+
+    snprintf(filename, sizeof(filename), "%s/%s-%s.bin", output_dir,
+        port_get_name(), FINDING_NAMES[kind]);
+    f = fopen(filename, "wb");
+    if (f == NULL) {
+        perror(filename);
+        return;
+    }
+    fwrite(data, 1, size, f);
+    fclose(f);
+}
+
+
+// ****************************************************************************
+static void print_input(FILE *f, const uint8_t *data, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        fprintf(f, "%02x%s", data[i], (i % 32 == 31) ? "\n" : " ");
+    }
+    if (size % 32) {
+        fprintf(f, "\n");
+    }
+}
+
+
+// ****************************************************************************
+// Writes the input that crashed in the format of print_input(), using only
+// async-signal-safe functions
+// ****************************************************************************
+static void crash_handler(int signal_number)
+{
+    static const char HEX[] = "0123456789abcdef";
+    static const char MESSAGE[] = "crash on input:\n";
+    char text[3];
+    size_t i;
+
+    (void)signal_number;
+
+    if (write(STDERR_FILENO, MESSAGE, sizeof(MESSAGE) - 1) < 0) {
+        _exit(2);
+    }
+    if (current_input) {
+        for (i = 0; i < current_input->size; i++) {
+            text[0] = HEX[current_input->data[i] >> 4];
+            text[1] = HEX[current_input->data[i] & 0x0f];
+            text[2] = (i % 32 == 31) ? '\n' : ' ';
+            if (write(STDERR_FILENO, text, 3) < 0) {
+                break;
+            }
+        }
+        if (write(STDERR_FILENO, "\n", 1) < 0) {
+            _exit(2);
+        }
+    }
+    _exit(2);
+}
+
+
+// ****************************************************************************
+static uint8_t random_byte(void)
+{
+    return prng_next() & 0xff;
+}
+
+
+// ****************************************************************************
+// Random event with a bias towards the events that make progress in the
+// bind procedure, as the stand-alone driver gets no coverage feedback
+// ****************************************************************************
+static size_t random_event(uint8_t *data, unsigned int *bind_slot)
+{
+    static const uint8_t PAYLOAD_BYTES[8] = {10, 9, 6, 7, 0, 0, 0, 0};
+    uint8_t event = prng_next() % 8;
+    uint8_t argument = random_byte() & EVENT_ARGUMENT_MASK;
+    size_t size = 1;
+    unsigned int i;
+
+    if (event == EVENT_BIND) {
+        // Mostly the next packet of the bind sequence
+        if (prng_next() % 4) {
+            argument = (argument & ~3) | *bind_slot;
+            *bind_slot = (*bind_slot + 1) % 4;
+        }
+    }
+
+    if (event <= EVENT_BIND  &&  prng_next() % 4) {
+        argument &= ~EVENT_KEEP_IRQ_PENDING;
+    }
+
+    data[0] = (event << 5) | argument;
+    for (i = 0; i < PAYLOAD_BYTES[event]; i++) {
+        // Small values are hop channels within range more often
+        data[size++] = (prng_next() % 2) ? random_byte() % 0x50 : random_byte();
+    }
+    return size;
+}
+
+
+// ****************************************************************************
+static size_t random_input(uint8_t *data)
+{
+    unsigned int events = 1 + prng_next() % MAX_RANDOM_EVENTS;
+    unsigned int bind_slot = 0;
+    size_t size = 0;
+    unsigned int i;
+
+    // Start the bind procedure in most inputs
+    if (prng_next() % 4) {
+        data[size++] = (EVENT_BUTTON << 5) | 1;
+        data[size++] = (EVENT_WAIT_LONG << 5) | 2;
+        data[size++] = (EVENT_BUTTON << 5) | 0;
+        data[size++] = (EVENT_WAIT_LONG << 5) | 2;
+    }
+
+    for (i = 0; i < events; i++) {
+        size += random_event(&data[size], &bind_slot);
+    }
+    return size;
+}
+
+
+// ****************************************************************************
+static void record_finding(const uint8_t *data, size_t size)
+{
+    if (finding_counts[finding]++ == 0) {
+        printf("%s: %s\n", FINDING_NAMES[finding], finding_message);
+        print_input(stdout, data, size);
+        write_input(finding, data, size);
+    }
+}
+
+
+// ****************************************************************************
+static int run_files(int count, char *filenames[])
+{
+    static uint8_t data[MAX_INPUT_SIZE];
+    int result = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        FILE *f = fopen(filenames[i], "rb");
+        size_t size;
+
+        if (f == NULL) {
+            perror(filenames[i]);
+            exit(1);
+        }
+        size = fread(data, 1, sizeof(data), f);
+        fclose(f);
+
+        if (run_input(data, size) >= 0) {
+            printf("%s: %s: %s\n", filenames[i], FINDING_NAMES[finding],
+                finding_message);
+            result = 1;
+        }
+        else {
+            printf("%s: ok\n", filenames[i]);
+        }
+    }
+    return result;
+}
+
+
+// ****************************************************************************
+int main(int argc, char *argv[])
+{
+    static uint8_t data[MAX_INPUT_SIZE];
+    unsigned long sequences = 1000000;
+    double run_time = 0;
+    uint64_t seed = 1;
+    bool run_given_files = false;
+    unsigned long n;
+    clock_t start;
+    double elapsed;
+    int result = 0;
+    int opt;
+    int i;
+
+    while ((opt = getopt(argc, argv, "n:t:s:o:rv")) != -1) {
+        switch (opt) {
+            case 'n':
+                sequences = strtoul(optarg, NULL, 0);
+                break;
+
+            case 't':
+                run_time = atof(optarg);
+                break;
+
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+
+            case 'o':
+                output_dir = optarg;
+                break;
+
+            case 'r':
+                run_given_files = true;
+                break;
+
+            case 'v':
+                verbose = true;
+                break;
+
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    signal(SIGSEGV, crash_handler);
+    signal(SIGBUS, crash_handler);
+    signal(SIGFPE, crash_handler);
+    signal(SIGILL, crash_handler);
+    signal(SIGABRT, crash_handler);
+
+    take_snapshot();
+
+    if (run_given_files) {
+        if (optind >= argc) {
+            usage(argv[0]);
+        }
+        return run_files(argc - optind, &argv[optind]);
+    }
+    if (optind < argc) {
+        usage(argv[0]);
+    }
+
+    prng_seed(seed);
+    start = clock();
+
+    for (n = 0; run_time > 0 || n < sequences; n++) {
+        size_t size = random_input(data);
+
+        if (run_input(data, size) >= 0) {
+            record_finding(data, size);
+        }
+
+        if (run_time > 0  &&  n % TIME_CHECK_INTERVAL == 0  &&
+                (double)(clock() - start) / CLOCKS_PER_SEC >= run_time) {
+            ++n;
+            break;
+        }
+    }
+
+    elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("\n%s: %lu sequences, seed %llu, %.1f s, %.0f sequences/s\n\n",
+        port_get_name(), n, (unsigned long long)seed, elapsed,
+        elapsed > 0 ? n / elapsed : 0.0);
+    printf("Finding            Count\n");
+    for (i = 0; i < NUMBER_OF_FINDINGS; i++) {
+        printf("%-12s %11u\n", FINDING_NAMES[i], finding_counts[i]);
+        if (finding_counts[i]) {
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+#endif // FUZZ_LIBFUZZER
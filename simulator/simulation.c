@@ -0,0 +1,161 @@
+/******************************************************************************
+
+    Event driven simulation of the receiver firmware and the transmitter on
+    a virtual clock.
+
+    The clock always advances to the next event: a packet of the
+    transmitter being fully received, a timer event of the MCU, or the end
+    of the time the firmware spent busy in the last main loop iteration.
+    Packets that arrive while the firmware is busy are still put into the
+    RX FIFO at the right time, and the RF interrupt fires immediately.
+
+    Instead of the transmitter model, a packet source can provide the
+    packets on air, e.g. recorded packets that are played back.
+
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <nrf24l01.h>
+#include <hk310_transmitter.h>
+#include <port.h>
+#include <simulation.h>
+
+
+static simulation_loss_callback_t loss_callback;
+static simulation_main_loop_callback_t main_loop_callback;
+static simulation_packet_source_t packet_source;
+static simulation_packet_callback_t packet_callback;
+
+static uint64_t now;
+static uint64_t cpu_ready_time;
+static bool irq_active;
+static uint32_t airtime;
+static hk310_packet_t packet;
+
+
+// ****************************************************************************
+// Power-on reset of the receiver at SIMULATION_POWER_ON_TIME_US, with the
+// transmitter having been switched on at tx_start_time_us.
+// ****************************************************************************
+void simulation_init(const uint8_t *bind_data, uint64_t tx_start_time_us,
+    double drift_ppm)
+{
+    loss_callback = NULL;
+    main_loop_callback = NULL;
+    packet_source = NULL;
+    packet_callback = NULL;
+
+    now = SIMULATION_POWER_ON_TIME_US;
+    cpu_ready_time = now;
+    irq_active = false;
+
+    hk310_init(bind_data, tx_start_time_us, drift_ppm);
+
+    nrf24l01_set_time(now);
+    port_reset(bind_data);
+    airtime = nrf24l01_get_airtime_us(HK310_PAYLOAD_SIZE);
+
+    do {
+        hk310_next_packet(&packet, airtime);
+    } while (packet.time_us < now);
+}
+
+
+// ****************************************************************************
+void simulation_set_loss_callback(simulation_loss_callback_t callback)
+{
+    loss_callback = callback;
+}
+
+
+// ****************************************************************************
+void simulation_set_main_loop_callback(simulation_main_loop_callback_t callback)
+{
+    main_loop_callback = callback;
+}
+
+
+// ****************************************************************************
+// Replaces the transmitter model from the current time on
+// ****************************************************************************
+void simulation_set_packet_source(simulation_packet_source_t source)
+{
+    packet_source = source;
+    if (!packet_source(&packet)) {
+        packet.time_us = UINT64_MAX;
+    }
+}
+
+
+// ****************************************************************************
+void simulation_set_packet_callback(simulation_packet_callback_t callback)
+{
+    packet_callback = callback;
+}
+
+
+// ****************************************************************************
+static void next_packet(void)
+{
+    if (packet_source == NULL) {
+        hk310_next_packet(&packet, airtime);
+    }
+    else if (!packet_source(&packet)) {
+        packet.time_us = UINT64_MAX;
+    }
+}
+
+
+// ****************************************************************************
+void simulation_run(uint64_t duration_us)
+{
+    uint64_t end = now + duration_us;
+
+    while (now < end) {
+        uint64_t target = now + port_time_to_next_event();
+
+        if (packet.time_us < target) {
+            target = packet.time_us;
+        }
+        if (cpu_ready_time > now && cpu_ready_time < target) {
+            target = cpu_ready_time;
+        }
+
+        port_advance(target - now);
+        now = target;
+        nrf24l01_set_time(now);
+
+        while (packet.time_us <= now) {
+            bool received = false;
+
+            if (loss_callback == NULL || !loss_callback(&packet)) {
+                received = nrf24l01_receive_packet(packet.channel,
+                    packet.address, HK310_ADDRESS_WIDTH, packet.payload,
+                    HK310_PAYLOAD_SIZE);
+            }
+            if (packet_callback) {
+                packet_callback(&packet, received);
+            }
+            next_packet();
+        }
+
+        // The MCU triggers on the falling edge of the IRQ line
+        if (nrf24l01_is_irq_active() && !irq_active) {
+            port_rf_interrupt();
+        }
+        irq_active = nrf24l01_is_irq_active();
+
+        if (now < cpu_ready_time) {
+            continue;
+        }
+
+        cpu_ready_time = now + port_run_main_loop();
+        irq_active = nrf24l01_is_irq_active();
+
+        if (main_loop_callback && port_is_main_loop_complete()) {
+            main_loop_callback(now);
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <hk310_transmitter.h>
+
+// Time at which the receiver is powered on. The transmitter may start
+// earlier so that the receiver finds it at an arbitrary point of its hop
+// sequence.
+#define SIMULATION_POWER_ON_TIME_US 1000000
+
+
+// Decides whether a packet sent by the transmitter is lost on air
+typedef bool (* simulation_loss_callback_t)(const hk310_packet_t *packet);
+
+// Called after every iteration of the firmware main loop
+typedef void (* simulation_main_loop_callback_t)(uint64_t time_us);
+
+// Provides the next packet on air, in the order of time. Returns false if
+// there are no more packets.
+typedef bool (* simulation_packet_source_t)(hk310_packet_t *packet);
+
+// Called for every packet on air, with whether the nRF24 put it into the
+// RX FIFO
+typedef void (* simulation_packet_callback_t)(const hk310_packet_t *packet,
+    bool received);
+
+
+void simulation_init(const uint8_t *bind_data, uint64_t tx_start_time_us,
+    double drift_ppm);
+void simulation_set_loss_callback(simulation_loss_callback_t callback);
+void simulation_set_main_loop_callback(simulation_main_loop_callback_t callback);
+void simulation_set_packet_source(simulation_packet_source_t source);
+void simulation_set_packet_callback(simulation_packet_callback_t callback);
+void simulation_run(uint64_t duration_us);
@@ -0,0 +1,421 @@
+/******************************************************************************
+
+    SPI traffic benchmark for the rf.c functions
+
+    Runs the receiver firmware against the HK310 transmitter model and
+    counts the SPI transactions, bytes and busy-wait poll iterations caused
+    by each public function of rf.c.
+
+    The rf.c functions are wrapped at link time (ld --wrap), so rf.c and
+    rc_receiver.c are used unmodified. Calls between rf.c functions are not
+    wrapped: the traffic of rf_is_rx_fifo_emtpy() includes the
+    rf_get_status() it calls.
+
+    The traffic is also summed per event. Each iteration of the firmware main
+    loop is assigned to one event, together with the traffic of the
+    interrupt handlers that ran before it:
+
+    - received packet: the iteration read one or more packets from the
+      RX FIFO; the sum is divided by the number of packets
+    - hop: the iteration changed the RF channel but read no packet
+    - other: any other iteration that used the SPI
+
+    The report is sorted and the simulation deterministic, so two reports can
+    be compared with diff.
+
+    Usage: see usage() below
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <rf.h>
+
+#include <nrf24l01.h>
+#include <hk310_transmitter.h>
+#include <port.h>
+#include <prng.h>
+#include <simulation.h>
+
+
+#define EVENT_INIT 0
+#define EVENT_PACKET 1
+#define EVENT_HOP 2
+#define EVENT_OTHER 3
+#define NUMBER_OF_EVENTS 4
+
+
+typedef struct {
+    uint64_t transactions;
+    uint64_t bytes;
+    uint64_t polls;
+} spi_traffic_t;
+
+typedef struct {
+    unsigned int count;
+    spi_traffic_t traffic;
+} cost_t;
+
+// The public functions of rf.h, in the order of the header
+enum {
+    RF_ENABLE_CLOCK,
+    RF_DISABLE_CLOCK,
+    RF_SET_CE,
+    RF_CLEAR_CE,
+    RF_GET_STATUS,
+    RF_IS_RX_FIFO_EMTPY,
+    RF_IS_TX_FIFO_FULL,
+    RF_READ_FIFO,
+    RF_FLUSH_RX_FIFO,
+    RF_FLUSH_TX_FIFO,
+    RF_SET_IRQ_SOURCE,
+    RF_CLEAR_IRQ,
+    RF_ENABLE_TRANSMITTER,
+    RF_ENABLE_RECEIVER,
+    RF_POWER_DOWN,
+    RF_SET_CHANNEL,
+    RF_SET_CRC,
+    RF_SET_DATA_RATE,
+    RF_SET_ADDRESS_WIDTH,
+    RF_GET_ADDRESS_WIDTH,
+    RF_SET_DATA_PIPES,
+    RF_SET_PAYLOAD_SIZE,
+    RF_SET_RX_ADDRESS,
+    RF_VERIFY_REGISTERS,
+    RF_SET_HOP_CHANNELS,
+    RF_HOP,
+    NUMBER_OF_FUNCTIONS
+};
+
+
+static const char *function_names[NUMBER_OF_FUNCTIONS] = {
+    "rf_enable_clock",
+    "rf_disable_clock",
+    "rf_set_ce",
+    "rf_clear_ce",
+    "rf_get_status",
+    "rf_is_rx_fifo_emtpy",
+    "rf_is_tx_fifo_full",
+    "rf_read_fifo",
+    "rf_flush_rx_fifo",
+    "rf_flush_tx_fifo",
+    "rf_set_irq_source",
+    "rf_clear_irq",
+    "rf_enable_transmitter",
+    "rf_enable_receiver",
+    "rf_power_down",
+    "rf_set_channel",
+    "rf_set_crc",
+    "rf_set_data_rate",
+    "rf_set_address_width",
+    "rf_get_address_width",
+    "rf_set_data_pipes",
+    "rf_set_payload_size",
+    "rf_set_rx_address",
+    "rf_verify_registers",
+    "rf_set_hop_channels",
+    "rf_hop"
+};
+
+static const char *event_names[NUMBER_OF_EVENTS] = {
+    "initialization", "received packet", "hop", "other"
+};
+
+static const uint8_t BIND_DATA[HK310_BIND_DATA_SIZE] = {
+    0x2a, 0x91, 0x3c, 0x5e, 0x07,
+    0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27
+};
+
+static double duration_s = 60.0;
+static double loss_percent;
+static uint64_t seed = 1;
+
+static cost_t functions[NUMBER_OF_FUNCTIONS];
+static cost_t events[NUMBER_OF_EVENTS];
+
+// Nesting depth of wrapped calls, and the traffic when the outermost call
+// started
+static unsigned int call_depth;
+static spi_traffic_t call_start;
+
+static spi_traffic_t iteration_start;
+static unsigned int last_payloads_read;
+static unsigned int last_channel_changes;
+static unsigned int init_channel_changes;
+
+
+// ****************************************************************************
+static void get_spi_traffic(spi_traffic_t *traffic)
+{
+    nrf24l01_spi_statistics_t statistics;
+
+    nrf24l01_get_spi_statistics(&statistics);
+    traffic->transactions = statistics.transactions;
+    traffic->bytes = statistics.bytes;
+    traffic->polls = port_get_spi_polls();
+}
+
+
+// ****************************************************************************
+// Add the traffic since *start* to the given cost
+// ****************************************************************************
+static void add_traffic(cost_t *cost, const spi_traffic_t *start)
+{
+    spi_traffic_t now;
+
+    get_spi_traffic(&now);
+    cost->traffic.transactions += now.transactions - start->transactions;
+    cost->traffic.bytes += now.bytes - start->bytes;
+    cost->traffic.polls += now.polls - start->polls;
+}
+
+
+// ****************************************************************************
+static void call_begin(void)
+{
+    if (call_depth++ == 0) {
+        get_spi_traffic(&call_start);
+    }
+}
+
+
+// ****************************************************************************
+static void call_end(unsigned int function)
+{
+    if (--call_depth == 0) {
+        ++functions[function].count;
+        add_traffic(&functions[function], &call_start);
+    }
+}
+
+
+// ****************************************************************************
+// Wrappers for the rf.c functions. ld --wrap=name makes all calls from other
+// objects go to __wrap_name, which calls the original as __real_name.
+// ****************************************************************************
+#define WRAP_VOID(function, name, parameters, arguments) \
+    void __real_##name parameters; \
+    void __wrap_##name parameters; \
+    void __wrap_##name parameters \
+    { \
+        call_begin(); \
+        __real_##name arguments; \
+        call_end(function); \
+    }
+
+#define WRAP(type, function, name, parameters, arguments) \
+    type __real_##name parameters; \
+    type __wrap_##name parameters; \
+    type __wrap_##name parameters \
+    { \
+        type result; \
+        call_begin(); \
+        result = __real_##name arguments; \
+        call_end(function); \
+        return result; \
+    }
+
+WRAP_VOID(RF_ENABLE_CLOCK, rf_enable_clock, (void), ())
+WRAP_VOID(RF_DISABLE_CLOCK, rf_disable_clock, (void), ())
+WRAP_VOID(RF_SET_CE, rf_set_ce, (void), ())
+WRAP_VOID(RF_CLEAR_CE, rf_clear_ce, (void), ())
+WRAP(uint8_t, RF_GET_STATUS, rf_get_status, (void), ())
+WRAP(bool, RF_IS_RX_FIFO_EMTPY, rf_is_rx_fifo_emtpy, (void), ())
+WRAP(bool, RF_IS_TX_FIFO_FULL, rf_is_tx_fifo_full, (void), ())
+WRAP(uint8_t, RF_READ_FIFO, rf_read_fifo,
+    (uint8_t *buffer, size_t byte_count), (buffer, byte_count))
+WRAP(uint8_t, RF_FLUSH_RX_FIFO, rf_flush_rx_fifo, (void), ())
+WRAP(uint8_t, RF_FLUSH_TX_FIFO, rf_flush_tx_fifo, (void), ())
+WRAP_VOID(RF_SET_IRQ_SOURCE, rf_set_irq_source,
+    (uint8_t irq_source), (irq_source))
+WRAP(uint8_t, RF_CLEAR_IRQ, rf_clear_irq, (uint8_t irq_source), (irq_source))
+WRAP_VOID(RF_ENABLE_TRANSMITTER, rf_enable_transmitter, (void), ())
+WRAP_VOID(RF_ENABLE_RECEIVER, rf_enable_receiver, (void), ())
+WRAP_VOID(RF_POWER_DOWN, rf_power_down, (void), ())
+WRAP_VOID(RF_SET_CHANNEL, rf_set_channel, (uint8_t channel), (channel))
+WRAP_VOID(RF_SET_CRC, rf_set_crc, (uint8_t crc_size), (crc_size))
+WRAP_VOID(RF_SET_DATA_RATE, rf_set_data_rate, (uint8_t data_rate), (data_rate))
+WRAP_VOID(RF_SET_ADDRESS_WIDTH, rf_set_address_width, (uint8_t aw), (aw))
+WRAP(uint8_t, RF_GET_ADDRESS_WIDTH, rf_get_address_width, (void), ())
+WRAP_VOID(RF_SET_DATA_PIPES, rf_set_data_pipes,
+    (uint8_t pipes, uint8_t auto_acknowledge_pipes),
+    (pipes, auto_acknowledge_pipes))
+WRAP_VOID(RF_SET_PAYLOAD_SIZE, rf_set_payload_size,
+    (uint8_t pipes, uint8_t payload_size), (pipes, payload_size))
+WRAP_VOID(RF_SET_RX_ADDRESS, rf_set_rx_address,
+    (uint8_t pipe, uint8_t address_width, const uint8_t address[]),
+    (pipe, address_width, address))
+WRAP(bool, RF_VERIFY_REGISTERS, rf_verify_registers, (void), ())
+WRAP_VOID(RF_SET_HOP_CHANNELS, rf_set_hop_channels,
+    (uint8_t count, const uint8_t channels[]), (count, channels))
+WRAP_VOID(RF_HOP, rf_hop, (uint8_t hop_index), (hop_index))
+
+
+// ****************************************************************************
+static bool is_packet_lost(const hk310_packet_t *packet)
+{
+    (void)packet;
+    return prng_uniform() * 100.0 < loss_percent;
+}
+
+
+// ****************************************************************************
+// The firmware changes the RF channel with rf_hop() on a hop, and with
+// rf_set_channel() elsewhere
+// ****************************************************************************
+static unsigned int get_channel_changes(void)
+{
+    return functions[RF_SET_CHANNEL].count + functions[RF_HOP].count;
+}
+
+
+// ****************************************************************************
+// Assign the traffic of the last main loop iteration to an event
+// ****************************************************************************
+static void check_receiver(uint64_t now)
+{
+    nrf24l01_spi_statistics_t statistics;
+    unsigned int payloads;
+    unsigned int channel_changes;
+    cost_t *event;
+
+    (void)now;
+
+    nrf24l01_get_spi_statistics(&statistics);
+    payloads = statistics.payloads_read - last_payloads_read;
+    last_payloads_read = statistics.payloads_read;
+
+    channel_changes = get_channel_changes() - last_channel_changes;
+    last_channel_changes = get_channel_changes();
+
+    if (payloads) {
+        event = &events[EVENT_PACKET];
+        event->count += payloads;
+    }
+    else if (channel_changes) {
+        event = &events[EVENT_HOP];
+        event->count += channel_changes;
+    }
+    else if (statistics.transactions != iteration_start.transactions) {
+        event = &events[EVENT_OTHER];
+        ++event->count;
+    }
+    else {
+        return;
+    }
+
+    add_traffic(event, &iteration_start);
+    get_spi_traffic(&iteration_start);
+}
+
+
+// ****************************************************************************
+static void print_cost(const char *name, const cost_t *cost)
+{
+    double n = cost->count ? cost->count : 1;
+
+    printf("%-24s %8u %8.2f %8.2f %8.2f %9.1f\n", name, cost->count,
+        cost->traffic.transactions / n, cost->traffic.bytes / n,
+        cost->traffic.polls / n,
+        cost->traffic.bytes * 8.0 * 1e6 / port_get_spi_clock() / n);
+}
+
+
+// ****************************************************************************
+static void print_report(void)
+{
+    cost_t total;
+    unsigned int i;
+
+    printf("\n%s: %.0f s, loss %.1f %%, seed %llu, SPI at %.1f MHz\n\n",
+        port_get_name(), duration_s, loss_percent, (unsigned long long)seed,
+        port_get_spi_clock() / 1e6);
+
+    printf("%-24s %8s %8s %8s %8s %9s\n", "Function", "Calls", "Trans",
+        "Bytes", "Polls", "SPI us");
+    for (i = 0; i < NUMBER_OF_FUNCTIONS; i++) {
+        print_cost(function_names[i], &functions[i]);
+    }
+
+    printf("\n%-24s %8s %8s %8s %8s %9s\n", "Event", "Count", "Trans",
+        "Bytes", "Polls", "SPI us");
+    for (i = 0; i < NUMBER_OF_EVENTS; i++) {
+        print_cost(event_names[i], &events[i]);
+    }
+
+    // All traffic after initialization, per hop of the firmware
+    memset(&total, 0, sizeof(total));
+    for (i = EVENT_PACKET; i < NUMBER_OF_EVENTS; i++) {
+        total.traffic.transactions += events[i].traffic.transactions;
+        total.traffic.bytes += events[i].traffic.bytes;
+        total.traffic.polls += events[i].traffic.polls;
+    }
+    total.count = get_channel_changes() - init_channel_changes;
+    printf("\n");
+    print_cost("all traffic per hop", &total);
+    printf("\nTrans, Bytes, Polls and SPI us are averages per call or event. "
+        "SPI us is the time\nof the bytes on the bus.\n");
+}
+
+
+// ****************************************************************************
+static void usage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -t seconds          Duration of the simulation (default 60)\n"
+        "  -l percent          Random packet loss\n"
+        "  -s seed             Seed for the random generator (default 1)\n",
+        name);
+    exit(1);
+}
+
+
+// ****************************************************************************
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:l:s:")) != -1) {
+        switch (opt) {
+            case 't':
+                duration_s = atof(optarg);
+                break;
+
+            case 'l':
+                loss_percent = atof(optarg);
+                break;
+
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    prng_seed(seed);
+
+    simulation_init(BIND_DATA, prng_next() % SIMULATION_POWER_ON_TIME_US, 0);
+    simulation_set_loss_callback(is_packet_lost);
+    simulation_set_main_loop_callback(check_receiver);
+
+    // simulation_init() ran init_receiver()
+    events[EVENT_INIT].count = 1;
+    add_traffic(&events[EVENT_INIT], &iteration_start);
+    get_spi_traffic(&iteration_start);
+    init_channel_changes = get_channel_changes();
+    last_channel_changes = init_channel_changes;
+
+    simulation_run(duration_s * 1e6);
+
+    print_report();
+
+    return 0;
+}
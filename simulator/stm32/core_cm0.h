@@ -0,0 +1,146 @@
+#pragma once
+
+/******************************************************************************
+
+    Host replacement for the CMSIS Cortex-M0 core header, which is included
+    by stm32f0xx.h.
+
+    Only what the STM32 firmware uses is provided: the register access
+    qualifiers, the SysTick registers (as an ordinary variable), the NVIC
+    functions and the interrupt and barrier intrinsics. In the MCU model
+    build (MCU_MODEL) they drive the interrupt controller of mcu.c;
+    otherwise they do nothing.
+
+******************************************************************************/
+#include <stdint.h>
+
+#ifdef MCU_MODEL
+#include <mcu.h>
+#endif
+
+#define __I volatile const
+#define __O volatile
+#define __IO volatile
+
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t LOAD;
+    __IO uint32_t VAL;
+    __IO uint32_t CALIB;
+} SysTick_Type;
+
+extern SysTick_Type host_systick;
+#define SysTick (&host_systick)
+
+
+#ifdef MCU_MODEL
+
+// ****************************************************************************
+static inline void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    mcu_enable_irq(IRQn);
+}
+
+
+// ****************************************************************************
+static inline void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    mcu_disable_irq(IRQn);
+}
+
+
+// ****************************************************************************
+static inline void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    mcu_set_priority(IRQn, priority);
+}
+
+
+// ****************************************************************************
+static inline void __enable_irq(void)
+{
+    mcu_enable_interrupts();
+}
+
+
+// ****************************************************************************
+static inline void __disable_irq(void)
+{
+    mcu_disable_interrupts();
+}
+
+#else
+
+// ****************************************************************************
+static inline void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    (void) IRQn;
+}
+
+
+// ****************************************************************************
+static inline void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    (void) IRQn;
+}
+
+
+// ****************************************************************************
+static inline void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    (void) IRQn;
+    (void) priority;
+}
+
+
+// ****************************************************************************
+static inline void __enable_irq(void)
+{
+}
+
+
+// ****************************************************************************
+static inline void __disable_irq(void)
+{
+}
+
+#endif
+
+
+// ****************************************************************************
+// The firmware uses it to order its own accesses to data shared with the
+// interrupt handlers, so it must keep the compiler from reordering them
+// ****************************************************************************
+static inline void __DMB(void)
+{
+    __asm__ volatile ("" ::: "memory");
+}
+
+
+// ****************************************************************************
+static inline void __DSB(void)
+{
+}
+
+
+// ****************************************************************************
+static inline void __ISB(void)
+{
+}
+
+
+// ****************************************************************************
+static inline void __NOP(void)
+{
+}
+
+
+// ****************************************************************************
+static inline uint32_t SysTick_Config(uint32_t ticks)
+{
+    SysTick->LOAD = ticks - 1;
+    NVIC_SetPriority(SysTick_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+    SysTick->VAL = 0;
+    SysTick->CTRL = (1 << 2) | (1 << 1) | (1 << 0);
+    return 0;
+}
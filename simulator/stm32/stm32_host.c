@@ -0,0 +1,585 @@
+/******************************************************************************
+
+    Host stand-ins for the parts of the STM32F030 firmware that talk
+    directly to hardware: the register blocks, delay_us(),
+    get_timestamp_us(), the flash storage and the SPI driver.
+    spi_transaction() is routed to the nRF24L01+ model. spi_start_rx_dma()
+    drains the RX FIFO on the spot, as if the DMA interrupts had run before
+    it returned.
+
+    Also implements the port interface (port.h) for the simulation tools:
+    the hop timer TIM3 and the SysTick are advanced on the virtual clock,
+    and the interrupt handlers and the main loop are run the same way
+    main.c does it. The servo outputs are generated in hardware by TIM14
+    (CH1) and TIM1 (CH2, CH3) in PWM mode 1; their edges are modelled with
+    nanosecond timestamps.
+
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <stm32f0xx.h>
+#include <platform.h>
+#include <persistent_storage.h>
+#include <rc_receiver.h>
+#include <rf.h>
+#include <spi.h>
+
+#include <nrf24l01.h>
+#include <port.h>
+
+
+#define SYSTEM_CLOCK 48000000
+
+// SPI1 runs at PCLK / 4
+#define SPI_CLOCK (SYSTEM_CLOCK / 4)
+
+// spi.c polls TXE and RXNE for each byte, and BSY at the end of each
+// transaction. One iteration of a poll loop takes about SPI_POLL_CYCLES.
+#define SPI_POLL_CYCLES 6
+#define SPI_CYCLES_PER_BYTE (8 * SYSTEM_CLOCK / SPI_CLOCK)
+#define SPI_RXNE_POLLS \
+    ((SPI_CYCLES_PER_BYTE + SPI_POLL_CYCLES - 1) / SPI_POLL_CYCLES)
+
+#define NUMBER_OF_PWM_OUTPUTS 2
+
+
+typedef struct {
+    volatile uint32_t *ccr;
+    unsigned int output;
+    uint64_t clear_time;
+    bool level;
+} pwm_output_t;
+
+typedef struct {
+    TIM_TypeDef *timer;
+    uint64_t update_time;
+    unsigned int number_of_outputs;
+    pwm_output_t outputs[NUMBER_OF_PWM_OUTPUTS];
+} pwm_timer_t;
+
+
+TIM_TypeDef host_tim1;
+TIM_TypeDef host_tim3;
+TIM_TypeDef host_tim14;
+TIM_TypeDef host_tim16;
+GPIO_TypeDef host_gpioa;
+GPIO_TypeDef host_gpiob;
+RCC_TypeDef host_rcc;
+EXTI_TypeDef host_exti;
+SYSCFG_TypeDef host_syscfg;
+SPI_TypeDef host_spi1;
+FLASH_TypeDef host_flash;
+IWDG_TypeDef host_iwdg;
+SysTick_Type host_systick;
+
+// Global flag that is true for one mainloop every __SYSTICK_IN_MS
+bool systick;
+
+static uint8_t flash_storage[NUMBER_OF_PERSISTENT_ELEMENTS];
+static uint32_t delay_us_total;
+static uint32_t pending_delay_us;
+static uint32_t spi_polls;
+
+static void (* rx_dma_callback)(uint8_t status, const uint8_t *payload);
+static unsigned int rx_dma_count;
+
+static uint32_t systick_count;
+static uint32_t systick_timer;
+
+static port_edge_callback_t edge_callback;
+static uint64_t time_ns;
+
+static pwm_timer_t pwm_timers[] = {
+    {&host_tim14, 0, 1, {{&host_tim14.CCR1, PORT_CH1, 0, false}}},
+    {&host_tim1, 0, 2, {{&host_tim1.CCR3, PORT_CH2, 0, false},
+                        {&host_tim1.CCR2, PORT_CH3, 0, false}}}
+};
+
+
+// ****************************************************************************
+// BSRR is write-only on the real hardware and acts on ODR immediately. The
+// firmware only writes it, so it is enough to apply it before anything
+// that depends on the pin state.
+// ****************************************************************************
+static void gpio_apply_bsrr(GPIO_TypeDef *gpio)
+{
+    gpio->ODR |= gpio->BSRR & 0xffff;
+    gpio->ODR &= ~(gpio->BSRR >> 16);
+    gpio->BSRR = 0;
+}
+
+
+// ****************************************************************************
+static void stm32_host_reset(const uint8_t *bind_data)
+{
+    unsigned int i;
+
+    memset(&host_tim1, 0, sizeof(host_tim1));
+    memset(&host_tim3, 0, sizeof(host_tim3));
+    memset(&host_tim14, 0, sizeof(host_tim14));
+    memset(&host_tim16, 0, sizeof(host_tim16));
+    memset(&host_gpioa, 0, sizeof(host_gpioa));
+    memset(&host_gpiob, 0, sizeof(host_gpiob));
+    memset(&host_rcc, 0, sizeof(host_rcc));
+    memset(&host_exti, 0, sizeof(host_exti));
+    memset(&host_syscfg, 0, sizeof(host_syscfg));
+    memset(&host_spi1, 0, sizeof(host_spi1));
+    memset(&host_flash, 0, sizeof(host_flash));
+    memset(&host_iwdg, 0, sizeof(host_iwdg));
+    memset(&host_systick, 0, sizeof(host_systick));
+
+    // The bind button has a pull-up, so it reads as released
+    GPIOA->IDR = GPIO_IDR_4;
+
+    memcpy(flash_storage, bind_data, NUMBER_OF_PERSISTENT_ELEMENTS);
+    delay_us_total = 0;
+    pending_delay_us = 0;
+    spi_polls = 0;
+
+    systick = false;
+    systick_count = 0;
+    systick_timer = __SYSTICK_IN_MS * 1000;
+
+    time_ns = 0;
+
+    // Timer configuration as done by init_hardware() in main.c. The PWM
+    // timers run from power-on with 1.5 ms pulses; TIM3 counts down at
+    // 1 MHz and is started by rc_receiver.c.
+    TIM14->PSC = (24 - 1);
+    TIM14->ARR = ((2000000 / CH1_FREQUENCY) - 1);
+    TIM14->CCR1 = 2 * 1500;
+    TIM14->CR1 = TIM_CR1_CEN;
+
+    TIM1->PSC = (24 - 1);
+    TIM1->ARR = ((2000000 / CH2_CH3_FREQUENCY) - 1);
+    TIM1->CCR2 = 2 * 1500;
+    TIM1->CCR3 = 2 * 1500;
+    TIM1->CR1 = TIM_CR1_CEN;
+
+    TIM3->PSC = (48 - 1);
+    TIM3->ARR = (65536 - 1);
+    TIM3->CNT = (65536 - 1);
+    TIM3->CR1 = TIM_CR1_DIR;
+    TIM3->DIER = TIM_DIER_UIE;
+
+    for (i = 0; i < sizeof(pwm_timers) / sizeof(pwm_timers[0]); i++) {
+        unsigned int k;
+
+        pwm_timers[i].update_time = 0;
+        for (k = 0; k < pwm_timers[i].number_of_outputs; k++) {
+            pwm_timers[i].outputs[k].clear_time = UINT64_MAX;
+            pwm_timers[i].outputs[k].level = false;
+        }
+    }
+
+    nrf24l01_reset();
+}
+
+
+// ****************************************************************************
+static uint64_t timer_ticks_to_ns(TIM_TypeDef *timer, uint32_t ticks)
+{
+    return (uint64_t)ticks * (timer->PSC + 1) * 1000000000ull / SYSTEM_CLOCK;
+}
+
+
+// ****************************************************************************
+static void pwm_set_output(pwm_output_t *output, bool level, uint64_t time)
+{
+    if (output->level == level) {
+        return;
+    }
+
+    output->level = level;
+    if (edge_callback) {
+        edge_callback(output->output, level, time);
+    }
+}
+
+
+// ****************************************************************************
+// Update event of an up-counting PWM timer: the preloaded CCR values become
+// active, and in PWM mode 1 the outputs are high while CNT < CCR.
+// ****************************************************************************
+static void pwm_update(pwm_timer_t *pwm, uint64_t time)
+{
+    unsigned int i;
+
+    for (i = 0; i < pwm->number_of_outputs; i++) {
+        pwm_output_t *output = &pwm->outputs[i];
+        uint32_t ccr = *output->ccr;
+
+        output->clear_time = UINT64_MAX;
+        if (ccr == 0) {
+            pwm_set_output(output, false, time);
+            continue;
+        }
+
+        pwm_set_output(output, true, time);
+        if (ccr <= pwm->timer->ARR) {
+            output->clear_time = time + timer_ticks_to_ns(pwm->timer, ccr);
+        }
+    }
+
+    pwm->update_time = time + timer_ticks_to_ns(pwm->timer, pwm->timer->ARR + 1);
+}
+
+
+// ****************************************************************************
+static void pwm_advance(pwm_timer_t *pwm)
+{
+    if (!(pwm->timer->CR1 & TIM_CR1_CEN)) {
+        return;
+    }
+
+    while (1) {
+        uint64_t next = pwm->update_time;
+        pwm_output_t *output = NULL;
+        unsigned int i;
+
+        for (i = 0; i < pwm->number_of_outputs; i++) {
+            if (pwm->outputs[i].clear_time <= next) {
+                next = pwm->outputs[i].clear_time;
+                output = &pwm->outputs[i];
+            }
+        }
+
+        if (next > time_ns) {
+            return;
+        }
+
+        if (output) {
+            output->clear_time = UINT64_MAX;
+            pwm_set_output(output, false, next);
+        }
+        else {
+            pwm_update(pwm, next);
+        }
+    }
+}
+
+
+// ****************************************************************************
+// Number of 1 MHz ticks until the down-counting TIM3 underflows. The update
+// event happens on the tick after the counter reached 0, after which the
+// counter is reloaded from ARR.
+// ****************************************************************************
+static uint32_t tim3_time_to_update(void)
+{
+    if (!(TIM3->CR1 & TIM_CR1_CEN)) {
+        return UINT32_MAX;
+    }
+
+    return TIM3->CNT + 1;
+}
+
+
+// ****************************************************************************
+static void tim3_advance(uint32_t microseconds)
+{
+    while (microseconds) {
+        uint32_t step = tim3_time_to_update();
+
+        if (step == UINT32_MAX) {
+            return;
+        }
+
+        if (step > microseconds) {
+            TIM3->CNT -= microseconds;
+            return;
+        }
+
+        microseconds -= step;
+        TIM3->CNT = TIM3->ARR;
+        TIM3->SR |= TIM_SR_UIF;
+
+        if (TIM3->DIER & TIM_DIER_UIE) {
+            // TIM3_IRQHandler() in main.c
+            hop_timer_handler();
+            TIM3->SR &= ~TIM_SR_UIF;
+            gpio_apply_bsrr(GPIOA);
+        }
+    }
+}
+
+
+// ****************************************************************************
+void port_reset(const uint8_t *bind_data)
+{
+    stm32_host_reset(bind_data);
+    init_receiver();
+    gpio_apply_bsrr(GPIOA);
+}
+
+
+// ****************************************************************************
+uint32_t port_time_to_next_event(void)
+{
+    uint32_t tim3 = tim3_time_to_update();
+
+    return (tim3 < systick_timer) ? tim3 : systick_timer;
+}
+
+
+// ****************************************************************************
+void port_advance(uint32_t microseconds)
+{
+    uint32_t remaining = microseconds;
+    unsigned int i;
+
+    while (remaining) {
+        uint32_t step = port_time_to_next_event();
+
+        if (step == 0) {
+            step = 1;
+        }
+        if (step > remaining) {
+            step = remaining;
+        }
+
+        // The PWM outputs run independently of the firmware, so their edges
+        // only need to be generated in order up to the end of the step
+        time_ns += (uint64_t)step * 1000;
+        for (i = 0; i < sizeof(pwm_timers) / sizeof(pwm_timers[0]); i++) {
+            pwm_advance(&pwm_timers[i]);
+        }
+
+        tim3_advance(step);
+
+        // SysTick_Handler() in main.c
+        systick_timer -= step;
+        if (systick_timer == 0) {
+            systick_timer = __SYSTICK_IN_MS * 1000;
+            ++systick_count;
+        }
+
+        remaining -= step;
+    }
+}
+
+
+// ****************************************************************************
+void port_rf_interrupt(void)
+{
+    // EXTI2_3_IRQHandler() in main.c
+    EXTI->PR = EXTI_PR_PR2;
+    rf_interrupt_handler();
+}
+
+
+// ****************************************************************************
+uint32_t port_run_main_loop(void)
+{
+    nrf24l01_spi_statistics_t before;
+    nrf24l01_spi_statistics_t after;
+    uint32_t delay_before = delay_us_total;
+
+    // service_systick() in main.c
+    if (systick_count) {
+        systick = true;
+        --systick_count;
+    }
+    else {
+        systick = false;
+    }
+
+    nrf24l01_get_spi_statistics(&before);
+    process_receiver();
+    gpio_apply_bsrr(GPIOA);
+    nrf24l01_get_spi_statistics(&after);
+
+    return (delay_us_total - delay_before) +
+        (after.bytes - before.bytes) * 8 * 1000000 / SPI_CLOCK;
+}
+
+
+// ****************************************************************************
+bool port_is_main_loop_complete(void)
+{
+    return true;
+}
+
+
+// ****************************************************************************
+uint32_t port_get_spi_clock(void)
+{
+    return SPI_CLOCK;
+}
+
+
+// ****************************************************************************
+uint32_t port_get_spi_polls(void)
+{
+    return spi_polls;
+}
+
+
+// ****************************************************************************
+// Same calculation as stickdata2ms() in rc_receiver.c: channels[] holds the
+// pulse width in microseconds.
+// ****************************************************************************
+uint16_t port_stick_to_channel(uint16_t stick)
+{
+    uint32_t ms;
+
+    ms = (0xffff - stick);
+    ms = ((2100 - 900) * (ms) / (2750 - 1210) + 900) -
+        (2100 - 900) * (1210) / (2750 - 1210);
+
+    return ms & 0xffff;
+}
+
+
+// ****************************************************************************
+void port_set_bind_button(bool pressed)
+{
+    if (pressed) {
+        GPIOA->IDR &= ~GPIO_IDR_4;
+    }
+    else {
+        GPIOA->IDR |= GPIO_IDR_4;
+    }
+}
+
+
+// ****************************************************************************
+// rc_receiver.c binds on release, but GPIO_BIND in platform.h reads the pin
+// inverted, so it is the press of the button that starts binding.
+// ****************************************************************************
+bool port_binds_on_button_release(void)
+{
+    return false;
+}
+
+
+// ****************************************************************************
+const char *port_get_name(void)
+{
+    return "stm32";
+}
+
+
+// ****************************************************************************
+const char *port_get_output_model(void)
+{
+    return "ideal TIM14 and TIM1 PWM, the outputs change exactly on the timer tick";
+}
+
+
+// ****************************************************************************
+bool port_has_output(unsigned int output)
+{
+    return output < NUMBER_OF_CHANNELS;
+}
+
+
+// ****************************************************************************
+void port_set_edge_callback(port_edge_callback_t callback)
+{
+    edge_callback = callback;
+}
+
+
+// ****************************************************************************
+uint32_t port_channel_to_pulse_ns(uint16_t channel)
+{
+    return (uint32_t)channel * 1000;
+}
+
+
+// ****************************************************************************
+bool nrf24l01_ce(void)
+{
+    gpio_apply_bsrr(GPIOA);
+    return (GPIOA->ODR & GPIO_ODR_1) != 0;
+}
+
+
+// ****************************************************************************
+uint8_t spi_transaction(uint8_t command, unsigned int count,
+    const uint8_t *tx_data, uint8_t *rx_data)
+{
+    spi_polls += 1 + (count + 1) * (1 + SPI_RXNE_POLLS);
+    gpio_apply_bsrr(GPIOA);
+    return nrf24l01_spi_transaction(command, count, tx_data, rx_data);
+}
+
+
+// ****************************************************************************
+void spi_init_rx_dma(unsigned int count,
+    void (* callback)(uint8_t status, const uint8_t *payload))
+{
+    rx_dma_count = count;
+    rx_dma_callback = callback;
+}
+
+
+// ****************************************************************************
+void spi_start_rx_dma(void)
+{
+    static const uint8_t rx_dr_clear = RX_RD;
+    uint8_t payload[RF_MAX_BUFFER_LENGTH];
+    uint8_t status;
+
+    gpio_apply_bsrr(GPIOA);
+    do {
+        status = nrf24l01_spi_transaction(R_RX_PAYLOAD, rx_dma_count, NULL,
+            payload);
+        rx_dma_callback(status, payload);
+        status = nrf24l01_spi_transaction(W_REGISTER | STATUS, 1,
+            &rx_dr_clear, NULL);
+    } while (!RF_IS_RX_FIFO_EMPTY(status));
+}
+
+
+// ****************************************************************************
+void delay_us(uint32_t microseconds)
+{
+    gpio_apply_bsrr(GPIOA);
+    delay_us_total += microseconds;
+}
+
+
+// ****************************************************************************
+// The delay timer runs while the firmware does other work; only the part it
+// waits for in wait_for_delay() keeps the CPU busy. The host counts the
+// whole delay as busy time if the firmware waits for it.
+// ****************************************************************************
+void start_delay_us(uint32_t microseconds)
+{
+    gpio_apply_bsrr(GPIOA);
+    pending_delay_us = microseconds;
+}
+
+
+// ****************************************************************************
+void wait_for_delay(void)
+{
+    delay_us_total += pending_delay_us;
+    pending_delay_us = 0;
+}
+
+
+// ****************************************************************************
+// Simulation time at the start of the current main loop iteration
+// ****************************************************************************
+uint32_t get_timestamp_us(void)
+{
+    return time_ns / 1000;
+}
+
+
+// ****************************************************************************
+void load_persistent_storage(uint8_t *data)
+{
+    memcpy(data, flash_storage, NUMBER_OF_PERSISTENT_ELEMENTS);
+}
+
+
+// ****************************************************************************
+void save_persistent_storage(uint8_t *new_data)
+{
+    memcpy(flash_storage, new_data, NUMBER_OF_PERSISTENT_ELEMENTS);
+}
@@ -0,0 +1,1544 @@
+/******************************************************************************
+
+    Register-level models of the STM32F030 peripherals the firmware uses, so
+    that the complete firmware -- main.c, spi.c and persistent_storage.c
+    included -- runs unmodified on the host. See mcu.c for the runtime that
+    connects the register accesses to the models.
+
+    Modelled, on the CPU clock of mcu.c:
+
+    - TIM1, TIM3, TIM14, TIM16: 16-bit counter counting up or down, with
+      prescaler, auto-reload (with and without preload), CNT writes, the
+      update event (overflow, underflow and UG, including UDIS and URS),
+      one-pulse mode, the update interrupt, and the output compare channels
+      in PWM mode 1 and 2 with CCR preload, polarity, CCxE and MOE.
+      Not modelled: compare flags and interrupts, input capture, the
+      repetition counter, center-aligned mode, slave modes, DMA.
+    - SPI1 master: 4 byte TX and RX FIFOs, data packing of 16-bit accesses,
+      TXE, RXNE with FRXTH, BSY, FRLVL/FTLVL and overrun. The nRF24L01+
+      model is clocked frame by frame; CSN is a GPIO.
+    - DMA1 channel 2 (SPI1_RX) and channel 3 (SPI1_TX): byte transfers
+      between SPI1 and memory, in the direction of the request mapping,
+      with memory increment, CNDTR, the transfer complete flag and its
+      interrupt. A transfer takes no time. Not modelled: other channels,
+      half transfer and error flags, circular mode, 16- and 32-bit sizes.
+    - GPIOA, GPIOB: MODER, ODR, BSRR, BRR and IDR. PA0 is CSN and PA1 CE of
+      the nRF24, PA4 the bind button with its pull-up.
+    - EXTI: rising and falling edge detection, the pending register and
+      SWIER, for the nRF24 IRQ line on PA2.
+    - FLASH: LOCK and the key sequence, page erase and half-word
+      programming with the timing of the data sheet, BSY, EOP, PGERR and
+      WRPRTERR. The 16 KiB of flash are mapped at their real address,
+      because persistent_storage.c accesses them through FLASH_BASE.
+    - IWDG: the key register, and PVU/RVU while the prescaler and reload
+      value are updated. A refresh marks the end of a main loop iteration;
+      the watchdog does not count down.
+
+    The system clock is 48 MHz from the PLL, as set up by SystemInit() in
+    the startup code before main(). RCC and SYSCFG are plain memory.
+
+    Also implements the port interface (port.h) for the simulation tools.
+
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <stm32f0xx.h>
+#include <platform.h>
+#include <persistent_storage.h>
+
+#include <mcu.h>
+#include <nrf24l01.h>
+#include <port.h>
+
+
+#define SYSTEM_CLOCK 48000000
+#define CPU_CLOCK_MHZ (SYSTEM_CLOCK / 1000000)
+
+// One iteration of a poll loop (load from the APB, test, branch) takes about
+// POLL_CYCLES on the Cortex-M0
+#define POLL_CYCLES 6
+
+#define NUMBER_OF_TIMERS 4
+#define TIM_CHANNELS 4
+#define TIM_MAX_OUTPUTS 2
+#define TIM_CCMR_OCM(ccmr, channel) (((ccmr) >> (4 + 8 * ((channel) & 1))) & 0x7)
+#define TIM_CCMR_OCPE(ccmr, channel) (((ccmr) >> (3 + 8 * ((channel) & 1))) & 0x1)
+#define TIM_CCER_CCE(ccer, channel) (((ccer) >> (4 * (channel))) & 0x1)
+#define TIM_CCER_CCP(ccer, channel) (((ccer) >> (4 * (channel) + 1)) & 0x1)
+#define TIM_OCM_FORCE_INACTIVE 4
+#define TIM_OCM_FORCE_ACTIVE 5
+#define TIM_OCM_PWM1 6
+#define TIM_OCM_PWM2 7
+
+#define SPI_FIFO_SIZE 4
+#define SPI_CR1_BR_DIVIDER(cr1) (2u << (((cr1) >> 3) & 0x7))
+#define SPI_CR2_DS_BITS(cr2) ((((cr2) >> 8) & 0xf) + 1)
+#define SPI_SR_FRLVL_SHIFT 9
+#define SPI_SR_FTLVL_SHIFT 11
+
+#define DMA_CHANNELS 2
+#define DMA_ISR_CHANNEL_FLAGS(channel) (0xfu << (4 * ((channel) - 1)))
+#define DMA_IFCR_CGIF(channel) (1u << (4 * ((channel) - 1)))
+
+#define GPIO_MODER_OUTPUT 1
+#define GPIO_PIN_NRF_CSN 0
+#define GPIO_PIN_NRF_CE 1
+#define EXTI_LINE_NRF_IRQ 2
+
+// Data sheet: 16-bit programming time and page erase time (maximum)
+#define FLASH_MEMORY_SIZE (16 * 1024)
+#define FLASH_MEMORY_PAGE_SIZE 1024
+#define FLASH_PROGRAM_NS 53500
+#define FLASH_ERASE_NS 40000000
+#define FLASH_SR_CLEAR_MASK (FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPRTERR)
+
+// The IWDG registers are updated in the LSI clock domain, which takes up to
+// 5 periods of the 40 kHz LSI
+#define IWDG_KEY_REFRESH 0xaaaa
+#define IWDG_KEY_WRITE_ACCESS 0x5555
+#define IWDG_UPDATE_NS (5 * 1000000000ull / LSI_VALUE)
+
+
+// An output compare channel of a timer that drives a servo output
+typedef struct {
+    unsigned int channel;
+    unsigned int output;
+} tim_output_t;
+
+// The state of a timer. The counter has the value "value" since "cycle";
+// the model jumps from one value of interest (compare or update) to the next.
+typedef struct {
+    TIM_TypeDef *registers;
+    int irq;
+    bool has_break;
+    unsigned int number_of_outputs;
+    tim_output_t outputs[TIM_MAX_OUTPUTS];
+
+    bool running;
+    uint16_t value;
+    uint64_t cycle;
+    uint32_t prescaler;
+    uint32_t arr;
+    uint32_t ccr[TIM_CHANNELS];
+    uint16_t sr;
+    bool reference[TIM_CHANNELS];
+    bool pin[TIM_MAX_OUTPUTS];
+} tim_t;
+
+
+// The channel of DMA1 that serves a SPI1 request. memory is the address
+// latched from CMAR when the channel is enabled.
+typedef struct {
+    DMA_Channel_TypeDef *registers;
+    unsigned int number;
+    uint32_t isr_tcif;
+    uint32_t spi_cr2_enable;
+    uint8_t *memory;
+} dma_channel_t;
+
+
+// Interrupt handlers of main.c and spi.c, which the startup code puts into
+// the vector table
+void SysTick_Handler(void);
+void EXTI2_3_IRQHandler(void);
+void TIM3_IRQHandler(void);
+void DMA1_Channel2_3_IRQHandler(void);
+
+
+TIM_TypeDef host_tim1;
+TIM_TypeDef host_tim3;
+TIM_TypeDef host_tim14;
+TIM_TypeDef host_tim16;
+GPIO_TypeDef host_gpioa;
+GPIO_TypeDef host_gpiob;
+RCC_TypeDef host_rcc;
+EXTI_TypeDef host_exti;
+SYSCFG_TypeDef host_syscfg;
+SPI_TypeDef host_spi1;
+FLASH_TypeDef host_flash;
+IWDG_TypeDef host_iwdg;
+DMA_TypeDef host_dma1;
+DMA_Channel_TypeDef host_dma1_channel2;
+DMA_Channel_TypeDef host_dma1_channel3;
+SysTick_Type host_systick;
+
+static port_edge_callback_t edge_callback;
+static uint64_t time_ns;
+
+// CH1 is TIM14_CH1, CH2 is TIM1_CH3 and CH3 is TIM1_CH2
+static tim_t timers[NUMBER_OF_TIMERS] = {
+    {.registers = &host_tim1, .irq = TIM1_BRK_UP_TRG_COM_IRQn,
+        .has_break = true, .number_of_outputs = 2,
+        .outputs = {{2, PORT_CH2}, {1, PORT_CH3}}},
+    {.registers = &host_tim3, .irq = TIM3_IRQn},
+    {.registers = &host_tim14, .irq = TIM14_IRQn,
+        .number_of_outputs = 1, .outputs = {{0, PORT_CH1}}},
+    {.registers = &host_tim16, .irq = TIM16_IRQn, .has_break = true}
+};
+
+static uint8_t spi_tx_fifo[SPI_FIFO_SIZE];
+static unsigned int spi_tx_level;
+static uint8_t spi_rx_fifo[SPI_FIFO_SIZE];
+static unsigned int spi_rx_level;
+static bool spi_shifting;
+static uint8_t spi_shift[2];
+static unsigned int spi_shift_bytes;
+static uint64_t spi_shift_end_cycle;
+static bool spi_overrun;
+
+static dma_channel_t dma_rx = {
+    .registers = &host_dma1_channel2, .number = 2,
+    .isr_tcif = DMA_ISR_TCIF2 | DMA_ISR_GIF2,
+    .spi_cr2_enable = SPI_CR2_RXDMAEN
+};
+static dma_channel_t dma_tx = {
+    .registers = &host_dma1_channel3, .number = 3,
+    .isr_tcif = DMA_ISR_TCIF3 | DMA_ISR_GIF3,
+    .spi_cr2_enable = SPI_CR2_TXDMAEN
+};
+
+static uint16_t gpio_odr[2];
+static bool nrf_selected;
+static bool bind_button_pressed;
+
+static uint32_t exti_pending;
+
+static uint8_t *flash_memory;
+static uint8_t flash_contents[FLASH_MEMORY_SIZE];
+static uint32_t flash_cr;
+static uint32_t flash_sr;
+static unsigned int flash_keys;
+static uint64_t flash_busy_until_ns;
+
+static bool iwdg_write_access;
+static uint64_t iwdg_pr_busy_until_ns;
+static uint64_t iwdg_rlr_busy_until_ns;
+
+static mcu_peripheral_t spi_peripheral;
+
+
+// ****************************************************************************
+static uint64_t now_cycle(void)
+{
+    return mcu_ns_to_cycles(mcu_get_time_ns());
+}
+
+
+// ****************************************************************************
+static uint64_t cycle_to_ns(uint64_t cycle)
+{
+    return (cycle == MCU_NEVER) ? MCU_NEVER : mcu_cycles_to_ns(cycle);
+}
+
+
+// ****************************************************************************
+static uint64_t earliest(uint64_t a, uint64_t b)
+{
+    return (a < b) ? a : b;
+}
+
+
+// ****************************************************************************
+// Timers
+// ****************************************************************************
+static tim_t *tim_find(volatile void *address)
+{
+    uintptr_t a = (uintptr_t)address;
+    unsigned int i;
+
+    for (i = 0; i < NUMBER_OF_TIMERS; i++) {
+        if (a - (uintptr_t)timers[i].registers < sizeof(TIM_TypeDef)) {
+            return &timers[i];
+        }
+    }
+    return NULL;
+}
+
+
+// ****************************************************************************
+static volatile uint32_t *tim_ccr_register(tim_t *t, unsigned int channel)
+{
+    return &t->registers->CCR1 + channel;
+}
+
+
+// ****************************************************************************
+static uint16_t tim_ccmr(const tim_t *t, unsigned int channel)
+{
+    return (channel < 2) ? t->registers->CCMR1 : t->registers->CCMR2;
+}
+
+
+// ****************************************************************************
+static bool tim_counts_down(const tim_t *t)
+{
+    return (t->registers->CR1 & TIM_CR1_DIR) != 0;
+}
+
+
+// ****************************************************************************
+static void tim_update_irq(tim_t *t)
+{
+    mcu_set_irq_level(t->irq, (t->sr & t->registers->DIER & TIM_SR_UIF) != 0);
+}
+
+
+// ****************************************************************************
+// The output compare channels of the servo outputs at the current counter
+// value. A disabled channel drives its pin low.
+// ****************************************************************************
+static void tim_set_outputs(tim_t *t, uint64_t cycle)
+{
+    uint16_t ccer = t->registers->CCER;
+    unsigned int i;
+
+    for (i = 0; i < t->number_of_outputs; i++) {
+        unsigned int channel = t->outputs[i].channel;
+        bool *reference = &t->reference[channel];
+        bool pin;
+
+        switch (TIM_CCMR_OCM(tim_ccmr(t, channel), channel)) {
+            case TIM_OCM_FORCE_INACTIVE:
+                *reference = false;
+                break;
+
+            case TIM_OCM_FORCE_ACTIVE:
+                *reference = true;
+                break;
+
+            case TIM_OCM_PWM1:
+                *reference = t->value < t->ccr[channel];
+                break;
+
+            case TIM_OCM_PWM2:
+                *reference = t->value >= t->ccr[channel];
+                break;
+
+            default:
+                break;
+        }
+
+        pin = *reference != TIM_CCER_CCP(ccer, channel);
+        if (!TIM_CCER_CCE(ccer, channel) ||
+                (t->has_break && !(t->registers->BDTR & TIM_BDTR_MOE))) {
+            pin = false;
+        }
+
+        if (pin != t->pin[i]) {
+            t->pin[i] = pin;
+            if (edge_callback) {
+                edge_callback(t->outputs[i].output, pin, cycle_to_ns(cycle));
+            }
+        }
+    }
+}
+
+
+// ****************************************************************************
+// Update event: the preloaded registers become active, and the counter
+// restarts. URS limits the update flag to overflow and underflow.
+// ****************************************************************************
+static void tim_update_event(tim_t *t, uint64_t cycle, bool overflow)
+{
+    TIM_TypeDef *r = t->registers;
+    unsigned int i;
+
+    if (!(r->CR1 & TIM_CR1_UDIS)) {
+        t->prescaler = r->PSC + 1;
+        t->arr = r->ARR & 0xffff;
+        for (i = 0; i < TIM_CHANNELS; i++) {
+            t->ccr[i] = *tim_ccr_register(t, i) & 0xffff;
+        }
+        if (overflow || !(r->CR1 & TIM_CR1_URS)) {
+            t->sr |= TIM_SR_UIF;
+        }
+    }
+
+    t->value = tim_counts_down(t) ? t->arr : 0;
+    t->cycle = cycle;
+
+    if (overflow && (r->CR1 & TIM_CR1_OPM)) {
+        r->CR1 &= ~TIM_CR1_CEN;
+        t->running = false;
+    }
+
+    tim_update_irq(t);
+    tim_set_outputs(t, cycle);
+}
+
+
+// ****************************************************************************
+// The cycle of the next overflow or underflow, or of the next compare value
+// of a servo output, and the counter value there
+// ****************************************************************************
+static uint64_t tim_next_step(const tim_t *t, uint16_t *value, bool *update)
+{
+    uint64_t next;
+    unsigned int i;
+
+    *value = t->value;
+    *update = true;
+
+    if (!t->running) {
+        return MCU_NEVER;
+    }
+
+    if (tim_counts_down(t)) {
+        next = t->cycle + ((uint64_t)t->value + 1) * t->prescaler;
+
+        for (i = 0; i < t->number_of_outputs; i++) {
+            uint32_t ccr = t->ccr[t->outputs[i].channel];
+
+            if (ccr != 0 && ccr - 1 < t->value) {
+                uint64_t cycle = t->cycle +
+                    (uint64_t)(t->value - (ccr - 1)) * t->prescaler;
+
+                if (cycle < next) {
+                    next = cycle;
+                    *value = ccr - 1;
+                    *update = false;
+                }
+            }
+        }
+    }
+    else {
+        // A counter above ARR counts up to 0xffff before it wraps
+        uint32_t limit = (t->value <= t->arr) ? t->arr : 0xffff;
+
+        next = t->cycle + ((uint64_t)limit - t->value + 1) * t->prescaler;
+
+        for (i = 0; i < t->number_of_outputs; i++) {
+            uint32_t ccr = t->ccr[t->outputs[i].channel];
+
+            if (ccr > t->value && ccr <= limit) {
+                uint64_t cycle = t->cycle +
+                    (uint64_t)(ccr - t->value) * t->prescaler;
+
+                if (cycle < next) {
+                    next = cycle;
+                    *value = ccr;
+                    *update = false;
+                }
+            }
+        }
+    }
+
+    return next;
+}
+
+
+// ****************************************************************************
+static void tim_step(tim_t *t, uint64_t now)
+{
+    while (1) {
+        uint16_t value;
+        bool update;
+        uint64_t cycle = tim_next_step(t, &value, &update);
+
+        if (cycle > now) {
+            return;
+        }
+
+        if (update) {
+            tim_update_event(t, cycle, true);
+        }
+        else {
+            t->value = value;
+            t->cycle = cycle;
+            tim_set_outputs(t, cycle);
+        }
+    }
+}
+
+
+// ****************************************************************************
+// The counter advances to the last full tick before a register changes. No
+// step is skipped, as the model is up to date.
+// ****************************************************************************
+static void tim_sync(tim_t *t, uint64_t now)
+{
+    uint64_t ticks;
+
+    if (!t->running) {
+        return;
+    }
+
+    ticks = (now - t->cycle) / t->prescaler;
+    t->value = tim_counts_down(t) ? t->value - ticks : t->value + ticks;
+    t->cycle += ticks * t->prescaler;
+}
+
+
+// ****************************************************************************
+static void tim_update(void)
+{
+    uint64_t now = now_cycle();
+    unsigned int i;
+
+    for (i = 0; i < NUMBER_OF_TIMERS; i++) {
+        tim_step(&timers[i], now);
+    }
+}
+
+
+// ****************************************************************************
+static uint64_t tim_next_event_ns(void)
+{
+    uint64_t next = MCU_NEVER;
+    unsigned int i;
+
+    for (i = 0; i < NUMBER_OF_TIMERS; i++) {
+        uint16_t value;
+        bool update;
+
+        next = earliest(next, tim_next_step(&timers[i], &value, &update));
+    }
+    return cycle_to_ns(next);
+}
+
+
+// ****************************************************************************
+static uint64_t tim_read(volatile void *address, unsigned int size)
+{
+    tim_t *t = tim_find(address);
+    uint64_t now = now_cycle();
+    uint16_t value;
+    bool update;
+
+    (void) size;
+
+    tim_sync(t, now);
+    t->registers->CNT = t->value;
+    t->registers->SR = t->sr;
+
+    if (address == &t->registers->CNT && t->running) {
+        return cycle_to_ns(t->cycle + t->prescaler);
+    }
+    return cycle_to_ns(tim_next_step(t, &value, &update));
+}
+
+
+// ****************************************************************************
+static void tim_write(volatile void *address, unsigned int size)
+{
+    tim_t *t = tim_find(address);
+    TIM_TypeDef *r = t->registers;
+    uint64_t now = now_cycle();
+    unsigned int i;
+
+    (void) size;
+
+    tim_sync(t, now);
+
+    if (address == &r->CR1) {
+        if ((r->CR1 & TIM_CR1_CEN) && !t->running) {
+            t->cycle = now;
+        }
+        t->running = (r->CR1 & TIM_CR1_CEN) != 0;
+    }
+    else if (address == &r->CNT) {
+        t->value = r->CNT & 0xffff;
+        t->cycle = now;
+    }
+    else if (address == &r->ARR) {
+        if (!(r->CR1 & TIM_CR1_ARPE)) {
+            t->arr = r->ARR & 0xffff;
+        }
+    }
+    else if (address == &r->EGR) {
+        if (r->EGR & TIM_EGR_UG) {
+            tim_update_event(t, now, false);
+        }
+        r->EGR = 0;
+    }
+    else if (address == &r->SR) {
+        // rc_w0: writing 1 leaves a flag unchanged
+        t->sr &= r->SR;
+        r->SR = t->sr;
+    }
+
+    for (i = 0; i < TIM_CHANNELS; i++) {
+        if (address == tim_ccr_register(t, i) &&
+                !TIM_CCMR_OCPE(tim_ccmr(t, i), i)) {
+            t->ccr[i] = *tim_ccr_register(t, i) & 0xffff;
+        }
+    }
+
+    tim_update_irq(t);
+    tim_set_outputs(t, now);
+}
+
+
+// ****************************************************************************
+static void tim_reset(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < NUMBER_OF_TIMERS; i++) {
+        tim_t *t = &timers[i];
+
+        memset(t->registers, 0, sizeof(*t->registers));
+        t->registers->ARR = 0xffff;
+
+        t->running = false;
+        t->value = 0;
+        t->cycle = 0;
+        t->prescaler = 1;
+        t->arr = 0xffff;
+        t->sr = 0;
+        memset(t->ccr, 0, sizeof(t->ccr));
+        memset(t->reference, 0, sizeof(t->reference));
+        memset(t->pin, 0, sizeof(t->pin));
+    }
+}
+
+
+// ****************************************************************************
+// SPI1 master. Frames of up to 8 bits take one byte in the FIFOs, larger
+// ones two.
+// ****************************************************************************
+static unsigned int spi_frame_bytes(void)
+{
+    return (SPI_CR2_DS_BITS(SPI1->CR2) > 8) ? 2 : 1;
+}
+
+
+// ****************************************************************************
+static void spi_fifo_pop(uint8_t *fifo, unsigned int *level, uint8_t *data,
+    unsigned int count)
+{
+    memcpy(data, fifo, count);
+    memmove(fifo, fifo + count, *level - count);
+    *level -= count;
+}
+
+
+// ****************************************************************************
+static void spi_start_frame(uint64_t cycle)
+{
+    unsigned int bytes = spi_frame_bytes();
+
+    if (spi_shifting || spi_tx_level < bytes ||
+            (SPI1->CR1 & (SPI_CR1_SPE | SPI_CR1_MSTR)) !=
+                (SPI_CR1_SPE | SPI_CR1_MSTR)) {
+        return;
+    }
+
+    spi_fifo_pop(spi_tx_fifo, &spi_tx_level, spi_shift, bytes);
+    spi_shift_bytes = bytes;
+    spi_shifting = true;
+    spi_shift_end_cycle = cycle +
+        SPI_CR2_DS_BITS(SPI1->CR2) * (uint64_t)SPI_CR1_BR_DIVIDER(SPI1->CR1);
+}
+
+
+// ****************************************************************************
+// The frame has been shifted out, MSB first, in bytes to the nRF24. The
+// FIFOs hold frames little-endian.
+// ****************************************************************************
+static void spi_end_frame(void)
+{
+    uint8_t received[2];
+    unsigned int i;
+
+    spi_shifting = false;
+
+    for (i = spi_shift_bytes; i-- > 0;) {
+        received[i] = nrf24l01_spi_exchange(spi_shift[i]);
+    }
+
+    if (spi_rx_level + spi_shift_bytes > SPI_FIFO_SIZE) {
+        spi_overrun = true;
+        return;
+    }
+    memcpy(spi_rx_fifo + spi_rx_level, received, spi_shift_bytes);
+    spi_rx_level += spi_shift_bytes;
+}
+
+
+// ****************************************************************************
+// DMA1 channels 2 and 3 move bytes between the SPI1 FIFOs and memory while
+// SPI1 requests them: RXNE for channel 2, TXE for channel 3
+// ****************************************************************************
+static bool dma_is_active(const dma_channel_t *channel)
+{
+    return (channel->registers->CCR & DMA_CCR_EN) &&
+        channel->registers->CNDTR &&
+        (SPI1->CR2 & channel->spi_cr2_enable);
+}
+
+
+// ****************************************************************************
+static void dma_update_irq(void)
+{
+    bool level = false;
+
+    if ((DMA1->ISR & DMA_ISR_TCIF2) && (dma_rx.registers->CCR & DMA_CCR_TCIE)) {
+        level = true;
+    }
+    if ((DMA1->ISR & DMA_ISR_TCIF3) && (dma_tx.registers->CCR & DMA_CCR_TCIE)) {
+        level = true;
+    }
+    mcu_set_irq_level(DMA1_Channel2_3_IRQn, level);
+}
+
+
+// ****************************************************************************
+static void dma_transferred(dma_channel_t *channel)
+{
+    if (channel->registers->CCR & DMA_CCR_MINC) {
+        ++channel->memory;
+    }
+    if (--channel->registers->CNDTR == 0) {
+        DMA1->ISR |= channel->isr_tcif;
+    }
+}
+
+
+// ****************************************************************************
+static void dma_service(void)
+{
+    while (dma_is_active(&dma_rx) && spi_rx_level) {
+        spi_fifo_pop(spi_rx_fifo, &spi_rx_level, dma_rx.memory, 1);
+        dma_transferred(&dma_rx);
+    }
+
+    while (dma_is_active(&dma_tx) && spi_tx_level <= SPI_FIFO_SIZE / 2) {
+        spi_tx_fifo[spi_tx_level++] = *dma_tx.memory;
+        dma_transferred(&dma_tx);
+    }
+
+    dma_update_irq();
+}
+
+
+// ****************************************************************************
+static void spi_update(void)
+{
+    uint64_t now = now_cycle();
+
+    while (spi_shifting && spi_shift_end_cycle <= now) {
+        spi_end_frame();
+        dma_service();
+        spi_start_frame(spi_shift_end_cycle);
+    }
+}
+
+
+// ****************************************************************************
+static uint64_t spi_next_event_ns(void)
+{
+    return spi_shifting ? cycle_to_ns(spi_shift_end_cycle) : MCU_NEVER;
+}
+
+
+// ****************************************************************************
+static unsigned int spi_fifo_level_bits(unsigned int level)
+{
+    return (level < 3) ? level : 3;
+}
+
+
+// ****************************************************************************
+static uint64_t spi_read(volatile void *address, unsigned int size)
+{
+    unsigned int rxne_level = (SPI1->CR2 & SPI_CR2_FRXTH) ? 1 : 2;
+
+    if (address == &SPI1->SR) {
+        ++spi_peripheral.polls;
+        SPI1->SR = (spi_rx_level >= rxne_level ? SPI_SR_RXNE : 0) |
+            (spi_tx_level <= SPI_FIFO_SIZE / 2 ? SPI_SR_TXE : 0) |
+            (spi_overrun ? SPI_SR_OVR : 0) |
+            ((spi_shifting || spi_tx_level) ? SPI_SR_BSY : 0) |
+            (spi_fifo_level_bits(spi_rx_level) << SPI_SR_FRLVL_SHIFT) |
+            (spi_fifo_level_bits(spi_tx_level) << SPI_SR_FTLVL_SHIFT);
+        return spi_next_event_ns();
+    }
+
+    // A 16-bit read packs two frames of up to 8 bits
+    if (address == &SPI1->DR) {
+        uint8_t data[2] = {0, 0};
+        unsigned int count = (size >= 2) ? 2 : 1;
+
+        if (count > spi_rx_level) {
+            count = spi_rx_level;
+        }
+        spi_fifo_pop(spi_rx_fifo, &spi_rx_level, data, count);
+        SPI1->DR = data[0] | (data[1] << 8);
+        spi_overrun = false;
+    }
+
+    return MCU_NEVER;
+}
+
+
+// ****************************************************************************
+static void spi_write(volatile void *address, unsigned int size)
+{
+    if (address == &SPI1->DR) {
+        uint16_t dr = SPI1->DR;
+        unsigned int count = (size >= 2) ? 2 : 1;
+
+        if (spi_tx_level + count <= SPI_FIFO_SIZE) {
+            spi_tx_fifo[spi_tx_level++] = dr & 0xff;
+            if (count == 2) {
+                spi_tx_fifo[spi_tx_level++] = dr >> 8;
+            }
+        }
+    }
+
+    dma_service();
+    spi_start_frame(now_cycle());
+}
+
+
+// ****************************************************************************
+static void spi_reset(void)
+{
+    memset(&host_spi1, 0, sizeof(host_spi1));
+    SPI1->CR2 = 0x0700;
+    SPI1->SR = SPI_SR_TXE;
+
+    spi_tx_level = 0;
+    spi_rx_level = 0;
+    spi_shifting = false;
+    spi_overrun = false;
+}
+
+
+// ****************************************************************************
+// DMA1 registers. The transfers themselves run from the SPI1 model.
+// ****************************************************************************
+static uint64_t dma_read(volatile void *address, unsigned int size)
+{
+    (void) address;
+    (void) size;
+
+    return MCU_NEVER;
+}
+
+
+// ****************************************************************************
+// CGIFx clears all flags of channel x
+// ****************************************************************************
+static void dma_channel_write(dma_channel_t *channel, volatile void *address)
+{
+    if (address == &DMA1->IFCR &&
+            (DMA1->IFCR & DMA_IFCR_CGIF(channel->number))) {
+        DMA1->ISR &= ~DMA_ISR_CHANNEL_FLAGS(channel->number);
+    }
+
+    if (address == &channel->registers->CCR &&
+            (channel->registers->CCR & DMA_CCR_EN)) {
+        channel->memory = (uint8_t *)(uintptr_t)channel->registers->CMAR;
+    }
+}
+
+
+// ****************************************************************************
+static void dma_write(volatile void *address, unsigned int size)
+{
+    (void) size;
+
+    if (address == &DMA1->IFCR) {
+        DMA1->ISR &= ~DMA1->IFCR;
+    }
+    dma_channel_write(&dma_rx, address);
+    dma_channel_write(&dma_tx, address);
+
+    dma_service();
+    spi_start_frame(now_cycle());
+}
+
+
+// ****************************************************************************
+static void dma_reset(void)
+{
+    memset(&host_dma1, 0, sizeof(host_dma1));
+    memset(&host_dma1_channel2, 0, sizeof(host_dma1_channel2));
+    memset(&host_dma1_channel3, 0, sizeof(host_dma1_channel3));
+    dma_rx.memory = NULL;
+    dma_tx.memory = NULL;
+}
+
+
+// ****************************************************************************
+// GPIO. CSN of the nRF24 floats high until PA0 is an output.
+// ****************************************************************************
+static unsigned int gpio_index(volatile void *address)
+{
+    uintptr_t a = (uintptr_t)address;
+
+    return (a - (uintptr_t)GPIOA < sizeof(GPIO_TypeDef)) ? 0 : 1;
+}
+
+
+// ****************************************************************************
+static bool gpio_output_level(GPIO_TypeDef *gpio, unsigned int pin,
+    bool floating)
+{
+    if (((gpio->MODER >> (2 * pin)) & 0x3) != GPIO_MODER_OUTPUT) {
+        return floating;
+    }
+    return (gpio_odr[gpio_index(gpio)] >> pin) & 1;
+}
+
+
+// ****************************************************************************
+static void gpio_update_nrf_csn(void)
+{
+    bool csn = gpio_output_level(GPIOA, GPIO_PIN_NRF_CSN, true);
+
+    if (!csn && !nrf_selected) {
+        nrf_selected = true;
+        nrf24l01_spi_select();
+    }
+    else if (csn && nrf_selected) {
+        nrf_selected = false;
+        nrf24l01_spi_deselect();
+    }
+}
+
+
+// ****************************************************************************
+static void gpio_update(void)
+{
+}
+
+
+// ****************************************************************************
+static uint64_t gpio_read(volatile void *address, unsigned int size)
+{
+    unsigned int i = gpio_index(address);
+    GPIO_TypeDef *gpio = i ? GPIOB : GPIOA;
+    uint16_t idr = gpio_odr[i];
+
+    (void) size;
+
+    if (gpio == GPIOA) {
+        idr &= ~GPIO_IDR_4;
+        idr |= bind_button_pressed ? 0 : GPIO_IDR_4;
+    }
+
+    gpio->IDR = idr;
+    gpio->ODR = gpio_odr[i];
+    gpio->BSRR = 0;
+    gpio->BRR = 0;
+    return MCU_NEVER;
+}
+
+
+// ****************************************************************************
+// In BSRR the set bits take priority over the reset bits
+// ****************************************************************************
+static void gpio_write(volatile void *address, unsigned int size)
+{
+    unsigned int i = gpio_index(address);
+    GPIO_TypeDef *gpio = i ? GPIOB : GPIOA;
+
+    (void) size;
+
+    if (address == &gpio->BSRR) {
+        gpio_odr[i] = (gpio_odr[i] & ~(gpio->BSRR >> 16)) | (gpio->BSRR & 0xffff);
+        gpio->BSRR = 0;
+    }
+    else if (address == &gpio->BRR) {
+        gpio_odr[i] &= ~gpio->BRR;
+        gpio->BRR = 0;
+    }
+    else if (address == &gpio->ODR) {
+        gpio_odr[i] = gpio->ODR;
+    }
+    gpio->ODR = gpio_odr[i];
+
+    gpio_update_nrf_csn();
+}
+
+
+// ****************************************************************************
+static void gpio_reset(void)
+{
+    memset(&host_gpioa, 0, sizeof(host_gpioa));
+    memset(&host_gpiob, 0, sizeof(host_gpiob));
+
+    // SWDIO and SWCLK
+    GPIOA->MODER = 0x28000000;
+
+    gpio_odr[0] = 0;
+    gpio_odr[1] = 0;
+    nrf_selected = false;
+}
+
+
+// ****************************************************************************
+// EXTI, for the lines on port A
+// ****************************************************************************
+static void exti_update_irq(void)
+{
+    uint32_t active = exti_pending & EXTI->IMR;
+
+    mcu_set_irq_level(EXTI0_1_IRQn, (active & 0x0003) != 0);
+    mcu_set_irq_level(EXTI2_3_IRQn, (active & 0x000c) != 0);
+    mcu_set_irq_level(EXTI4_15_IRQn, (active & 0xfff0) != 0);
+}
+
+
+// ****************************************************************************
+static void exti_edge(unsigned int line, bool rising)
+{
+    uint32_t bit = 1 << line;
+    unsigned int port = (SYSCFG->EXTICR[line / 4] >> (4 * (line % 4))) & 0xf;
+
+    if (port != 0) {
+        return;
+    }
+
+    if ((rising ? EXTI->RTSR : EXTI->FTSR) & bit) {
+        exti_pending |= bit;
+    }
+    exti_update_irq();
+}
+
+
+// ****************************************************************************
+static void exti_update(void)
+{
+}
+
+
+// ****************************************************************************
+static uint64_t exti_read(volatile void *address, unsigned int size)
+{
+    (void) address;
+    (void) size;
+
+    EXTI->PR = exti_pending;
+    return MCU_NEVER;
+}
+
+
+// ****************************************************************************
+// PR is rc_w1. Clearing a pending bit also clears the SWIER bit.
+// ****************************************************************************
+static void exti_write(volatile void *address, unsigned int size)
+{
+    (void) size;
+
+    if (address == &EXTI->PR) {
+        exti_pending &= ~EXTI->PR;
+        EXTI->SWIER &= ~EXTI->PR;
+    }
+    else if (address == &EXTI->SWIER) {
+        exti_pending |= EXTI->SWIER;
+    }
+
+    EXTI->PR = exti_pending;
+    exti_update_irq();
+}
+
+
+// ****************************************************************************
+// Flash interface. A write to a flash address has already changed the
+// mapped memory; the model restores it unless the write programs the flash.
+// ****************************************************************************
+static void flash_update(void)
+{
+    if ((flash_sr & FLASH_SR_BSY) && mcu_get_time_ns() >= flash_busy_until_ns) {
+        flash_sr &= ~FLASH_SR_BSY;
+        flash_sr |= FLASH_SR_EOP;
+        flash_cr &= ~FLASH_CR_STRT;
+    }
+}
+
+
+// ****************************************************************************
+static uint64_t flash_next_event_ns(void)
+{
+    return (flash_sr & FLASH_SR_BSY) ? flash_busy_until_ns : MCU_NEVER;
+}
+
+
+// ****************************************************************************
+static void flash_start(uint64_t duration_ns)
+{
+    flash_sr |= FLASH_SR_BSY;
+    flash_busy_until_ns = mcu_get_time_ns() + duration_ns;
+}
+
+
+// ****************************************************************************
+static uint64_t flash_read(volatile void *address, unsigned int size)
+{
+    (void) address;
+    (void) size;
+
+    FLASH->SR = flash_sr;
+    FLASH->CR = flash_cr;
+    return flash_next_event_ns();
+}
+
+
+// ****************************************************************************
+static void flash_write(volatile void *address, unsigned int size)
+{
+    (void) size;
+
+    if (address == &FLASH->KEYR) {
+        if (FLASH->KEYR == FLASH_FKEY1) {
+            flash_keys = 1;
+        }
+        else if (FLASH->KEYR == FLASH_FKEY2 && flash_keys == 1) {
+            flash_cr &= ~FLASH_CR_LOCK;
+            flash_keys = 0;
+        }
+        else {
+            flash_keys = 0;
+        }
+    }
+    else if (address == &FLASH->CR && !(flash_cr & FLASH_CR_LOCK)) {
+        uint32_t cr = FLASH->CR;
+
+        if ((cr & FLASH_CR_STRT) && (cr & FLASH_CR_PER) &&
+                !(flash_sr & FLASH_SR_BSY)) {
+            uint32_t page = (FLASH->AR - FLASH_BASE) & ~(FLASH_MEMORY_PAGE_SIZE - 1);
+
+            if (page < FLASH_MEMORY_SIZE) {
+                memset(flash_contents + page, 0xff, FLASH_MEMORY_PAGE_SIZE);
+                memcpy(flash_memory + page, flash_contents + page,
+                    FLASH_MEMORY_PAGE_SIZE);
+            }
+            flash_start(FLASH_ERASE_NS);
+        }
+        else if (!(flash_sr & FLASH_SR_BSY)) {
+            cr &= ~FLASH_CR_STRT;
+        }
+        flash_cr = cr;
+    }
+    else if (address == &FLASH->SR) {
+        flash_sr &= ~(FLASH->SR & FLASH_SR_CLEAR_MASK);
+    }
+
+    FLASH->CR = flash_cr;
+    FLASH->SR = flash_sr;
+}
+
+
+// ****************************************************************************
+static uint64_t flash_memory_read(volatile void *address, unsigned int size)
+{
+    (void) address;
+    (void) size;
+
+    return MCU_NEVER;
+}
+
+
+// ****************************************************************************
+// Programming writes a half-word into erased flash, or zero anywhere
+// ****************************************************************************
+static void flash_memory_write(volatile void *address, unsigned int size)
+{
+    uintptr_t offset = (uintptr_t)address - (uintptr_t)flash_memory;
+    uint16_t old;
+    uint16_t new;
+
+    memcpy(&old, flash_contents + offset, sizeof(old));
+    memcpy(&new, flash_memory + offset, sizeof(new));
+
+    if (size == 2 && !(offset & 1) && (flash_cr & FLASH_CR_PG) &&
+            !(flash_cr & FLASH_CR_LOCK) && !(flash_sr & FLASH_SR_BSY)) {
+        if (old == 0xffff || new == 0) {
+            memcpy(flash_contents + offset, &new, sizeof(new));
+            flash_start(FLASH_PROGRAM_NS);
+            return;
+        }
+        flash_sr |= FLASH_SR_PGERR;
+    }
+
+    memcpy(flash_memory + offset, flash_contents + offset, size);
+}
+
+
+// ****************************************************************************
+// The flash memory at its address on the STM32, filled with the bind data
+// on the last page where persistent_storage.c keeps it
+// ****************************************************************************
+static void flash_reset(const uint8_t *bind_data)
+{
+    uint32_t last_page = FLASH_MEMORY_SIZE - FLASH_MEMORY_PAGE_SIZE;
+
+    if (flash_memory == NULL) {
+        flash_memory = mmap((void *)(uintptr_t)FLASH_BASE, FLASH_MEMORY_SIZE,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (flash_memory != (uint8_t *)(uintptr_t)FLASH_BASE) {
+            perror("mmap of the flash memory");
+            exit(1);
+        }
+    }
+
+    memset(flash_contents, 0xff, sizeof(flash_contents));
+    memcpy(flash_contents + last_page, bind_data, NUMBER_OF_PERSISTENT_ELEMENTS);
+    memcpy(flash_memory, flash_contents, FLASH_MEMORY_SIZE);
+
+    memset(&host_flash, 0, sizeof(host_flash));
+    flash_cr = FLASH_CR_LOCK;
+    flash_sr = 0;
+    flash_keys = 0;
+    FLASH->CR = flash_cr;
+}
+
+
+// ****************************************************************************
+// Independent watchdog: the main loop refreshes it once per iteration
+// ****************************************************************************
+static void iwdg_update(void)
+{
+}
+
+
+// ****************************************************************************
+static uint64_t iwdg_read(volatile void *address, unsigned int size)
+{
+    uint64_t now = mcu_get_time_ns();
+    uint64_t next = MCU_NEVER;
+
+    (void) address;
+    (void) size;
+
+    IWDG->SR = 0;
+    if (now < iwdg_pr_busy_until_ns) {
+        IWDG->SR |= IWDG_SR_PVU;
+        next = iwdg_pr_busy_until_ns;
+    }
+    if (now < iwdg_rlr_busy_until_ns) {
+        IWDG->SR |= IWDG_SR_RVU;
+        next = earliest(next, iwdg_rlr_busy_until_ns);
+    }
+    return next;
+}
+
+
+// ****************************************************************************
+static void iwdg_write(volatile void *address, unsigned int size)
+{
+    uint64_t now = mcu_get_time_ns();
+
+    (void) size;
+
+    if (address == &IWDG->KR) {
+        uint32_t key = IWDG->KR & 0xffff;
+
+        iwdg_write_access = (key == IWDG_KEY_WRITE_ACCESS);
+        if (key == IWDG_KEY_REFRESH) {
+            mcu_end_of_main_loop();
+        }
+    }
+    else if (address == &IWDG->PR && iwdg_write_access) {
+        iwdg_pr_busy_until_ns = now + IWDG_UPDATE_NS;
+    }
+    else if (address == &IWDG->RLR && iwdg_write_access) {
+        iwdg_rlr_busy_until_ns = now + IWDG_UPDATE_NS;
+    }
+}
+
+
+// ****************************************************************************
+static void iwdg_reset(void)
+{
+    memset(&host_iwdg, 0, sizeof(host_iwdg));
+    IWDG->RLR = 0xfff;
+    iwdg_write_access = false;
+    iwdg_pr_busy_until_ns = 0;
+    iwdg_rlr_busy_until_ns = 0;
+}
+
+
+// ****************************************************************************
+static mcu_peripheral_t tim_peripherals[NUMBER_OF_TIMERS] = {
+    {.base = &host_tim1, .size = sizeof(host_tim1),
+        .update = tim_update, .read = tim_read, .write = tim_write},
+    {.base = &host_tim3, .size = sizeof(host_tim3),
+        .update = tim_update, .read = tim_read, .write = tim_write},
+    {.base = &host_tim14, .size = sizeof(host_tim14),
+        .update = tim_update, .read = tim_read, .write = tim_write},
+    {.base = &host_tim16, .size = sizeof(host_tim16),
+        .update = tim_update, .read = tim_read, .write = tim_write}
+};
+
+static mcu_peripheral_t spi_peripheral = {
+    .base = &host_spi1, .size = sizeof(host_spi1),
+    .update = spi_update, .read = spi_read, .write = spi_write
+};
+
+static mcu_peripheral_t dma_peripherals[] = {
+    {.base = &host_dma1, .size = sizeof(host_dma1),
+        .update = spi_update, .read = dma_read, .write = dma_write},
+    {.base = &host_dma1_channel2, .size = sizeof(host_dma1_channel2),
+        .update = spi_update, .read = dma_read, .write = dma_write},
+    {.base = &host_dma1_channel3, .size = sizeof(host_dma1_channel3),
+        .update = spi_update, .read = dma_read, .write = dma_write}
+};
+
+static mcu_peripheral_t gpioa_peripheral = {
+    .base = &host_gpioa, .size = sizeof(host_gpioa),
+    .update = gpio_update, .read = gpio_read, .write = gpio_write
+};
+
+static mcu_peripheral_t gpiob_peripheral = {
+    .base = &host_gpiob, .size = sizeof(host_gpiob),
+    .update = gpio_update, .read = gpio_read, .write = gpio_write
+};
+
+static mcu_peripheral_t exti_peripheral = {
+    .base = &host_exti, .size = sizeof(host_exti),
+    .update = exti_update, .read = exti_read, .write = exti_write
+};
+
+static mcu_peripheral_t flash_peripheral = {
+    .base = &host_flash, .size = sizeof(host_flash),
+    .update = flash_update, .read = flash_read, .write = flash_write
+};
+
+static mcu_peripheral_t flash_memory_peripheral = {
+    .base = (volatile void *)(uintptr_t)FLASH_BASE, .size = FLASH_MEMORY_SIZE,
+    .update = flash_update, .read = flash_memory_read,
+    .write = flash_memory_write
+};
+
+static mcu_peripheral_t iwdg_peripheral = {
+    .base = &host_iwdg, .size = sizeof(host_iwdg),
+    .update = iwdg_update, .read = iwdg_read, .write = iwdg_write
+};
+
+
+// ****************************************************************************
+static void update_models(void)
+{
+    tim_update();
+    spi_update();
+    flash_update();
+}
+
+
+// ****************************************************************************
+static uint64_t next_event_ns(void)
+{
+    uint64_t next = mcu_get_next_event_ns();
+
+    next = earliest(next, tim_next_event_ns());
+    next = earliest(next, spi_next_event_ns());
+    next = earliest(next, flash_next_event_ns());
+    return next;
+}
+
+
+// ****************************************************************************
+// Power-on reset. The firmware starts with the first port_run_main_loop();
+// init_receiver() runs after the 20 ms start-up delay of main().
+// ****************************************************************************
+void port_reset(const uint8_t *bind_data)
+{
+    unsigned int i;
+
+    memset(&host_rcc, 0, sizeof(host_rcc));
+    memset(&host_syscfg, 0, sizeof(host_syscfg));
+    memset(&host_exti, 0, sizeof(host_exti));
+
+    tim_reset();
+    spi_reset();
+    dma_reset();
+    gpio_reset();
+    flash_reset(bind_data);
+    iwdg_reset();
+    exti_pending = 0;
+    bind_button_pressed = false;
+
+    time_ns = 0;
+    mcu_reset(CPU_CLOCK_MHZ, POLL_CYCLES);
+    for (i = 0; i < NUMBER_OF_TIMERS; i++) {
+        mcu_add_peripheral(&tim_peripherals[i]);
+    }
+    mcu_add_peripheral(&spi_peripheral);
+    for (i = 0; i < sizeof(dma_peripherals) / sizeof(dma_peripherals[0]); i++) {
+        mcu_add_peripheral(&dma_peripherals[i]);
+    }
+    mcu_add_peripheral(&gpioa_peripheral);
+    mcu_add_peripheral(&gpiob_peripheral);
+    mcu_add_peripheral(&exti_peripheral);
+    mcu_add_peripheral(&flash_peripheral);
+    mcu_add_peripheral(&flash_memory_peripheral);
+    mcu_add_peripheral(&iwdg_peripheral);
+    mcu_add_systick(&host_systick);
+
+    mcu_set_handler(SysTick_IRQn, SysTick_Handler);
+    mcu_set_handler(EXTI2_3_IRQn, EXTI2_3_IRQHandler);
+    mcu_set_handler(TIM3_IRQn, TIM3_IRQHandler);
+    mcu_set_handler(DMA1_Channel2_3_IRQn, DMA1_Channel2_3_IRQHandler);
+
+    nrf24l01_reset();
+}
+
+
+// ****************************************************************************
+uint32_t port_time_to_next_event(void)
+{
+    uint64_t next = next_event_ns();
+
+    if (next == MCU_NEVER) {
+        return UINT32_MAX;
+    }
+    if (next <= time_ns + 1000) {
+        return 1;
+    }
+    return (next - time_ns + 999) / 1000;
+}
+
+
+// ****************************************************************************
+// Advance in steps from one model event to the next, running the interrupt
+// handlers that become pending on the way
+// ****************************************************************************
+void port_advance(uint32_t microseconds)
+{
+    uint64_t end = time_ns + (uint64_t)microseconds * 1000;
+
+    while (1) {
+        uint64_t next = next_event_ns();
+
+        if (next > end) {
+            break;
+        }
+        if (next > time_ns) {
+            time_ns = next;
+        }
+
+        mcu_set_simulation_time(time_ns);
+        update_models();
+        mcu_dispatch_interrupts();
+    }
+
+    time_ns = end;
+    mcu_set_simulation_time(time_ns);
+    update_models();
+    mcu_dispatch_interrupts();
+}
+
+
+// ****************************************************************************
+void port_rf_interrupt(void)
+{
+    exti_edge(EXTI_LINE_NRF_IRQ, false);
+    mcu_dispatch_interrupts();
+}
+
+
+// ****************************************************************************
+uint32_t port_run_main_loop(void)
+{
+    return mcu_run();
+}
+
+
+// ****************************************************************************
+bool port_is_main_loop_complete(void)
+{
+    return mcu_is_main_loop_complete();
+}
+
+
+// ****************************************************************************
+uint32_t port_get_spi_clock(void)
+{
+    return SYSTEM_CLOCK / SPI_CR1_BR_DIVIDER(SPI1->CR1);
+}
+
+
+// ****************************************************************************
+uint32_t port_get_spi_polls(void)
+{
+    return spi_peripheral.polls;
+}
+
+
+// ****************************************************************************
+// Same calculation as stickdata2ms() in rc_receiver.c: channels[] holds the
+// pulse width in microseconds.
+// ****************************************************************************
+uint16_t port_stick_to_channel(uint16_t stick)
+{
+    uint32_t ms;
+
+    ms = (0xffff - stick);
+    ms = ((2100 - 900) * (ms) / (2750 - 1210) + 900) -
+        (2100 - 900) * (1210) / (2750 - 1210);
+
+    return ms & 0xffff;
+}
+
+
+// ****************************************************************************
+void port_set_bind_button(bool pressed)
+{
+    bind_button_pressed = pressed;
+}
+
+
+// ****************************************************************************
+// rc_receiver.c binds on release, but GPIO_BIND in platform.h reads the pin
+// inverted, so it is the press of the button that starts binding.
+// ****************************************************************************
+bool port_binds_on_button_release(void)
+{
+    return false;
+}
+
+
+// ****************************************************************************
+const char *port_get_name(void)
+{
+    return "stm32_mcu";
+}
+
+
+// ****************************************************************************
+const char *port_get_output_model(void)
+{
+    return "register model of TIM14 and TIM1 PWM, the outputs change exactly on the timer tick";
+}
+
+
+// ****************************************************************************
+bool port_has_output(unsigned int output)
+{
+    return output < NUMBER_OF_CHANNELS;
+}
+
+
+// ****************************************************************************
+void port_set_edge_callback(port_edge_callback_t callback)
+{
+    edge_callback = callback;
+}
+
+
+// ****************************************************************************
+// rc_receiver.c writes 2 * channels[] into the compare registers of the PWM
+// timers
+// ****************************************************************************
+uint32_t port_channel_to_pulse_ns(uint16_t channel)
+{
+    return mcu_cycles_to_ns(2ull * channel * (TIM14->PSC + 1));
+}
+
+
+// ****************************************************************************
+bool nrf24l01_ce(void)
+{
+    return gpio_output_level(GPIOA, GPIO_PIN_NRF_CE, false);
+}
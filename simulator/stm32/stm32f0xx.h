@@ -0,0 +1,61 @@
+#pragma once
+
+/******************************************************************************
+
+    Host wrapper around the STM32F0xx device header of the firmware.
+
+    The register definitions are taken from the original header; only the
+    peripheral pointers are redirected to ordinary variables defined in
+    stm32_host.c. This directory must come before the firmware startup
+    directory in the include path.
+
+******************************************************************************/
+#include_next "stm32f0xx.h"
+
+extern TIM_TypeDef host_tim1;
+extern TIM_TypeDef host_tim3;
+extern TIM_TypeDef host_tim14;
+extern TIM_TypeDef host_tim16;
+extern GPIO_TypeDef host_gpioa;
+extern GPIO_TypeDef host_gpiob;
+extern RCC_TypeDef host_rcc;
+extern EXTI_TypeDef host_exti;
+extern SYSCFG_TypeDef host_syscfg;
+extern SPI_TypeDef host_spi1;
+extern FLASH_TypeDef host_flash;
+extern IWDG_TypeDef host_iwdg;
+extern DMA_TypeDef host_dma1;
+extern DMA_Channel_TypeDef host_dma1_channel2;
+extern DMA_Channel_TypeDef host_dma1_channel3;
+
+#undef TIM1
+#undef TIM3
+#undef TIM14
+#undef TIM16
+#undef GPIOA
+#undef GPIOB
+#undef RCC
+#undef EXTI
+#undef SYSCFG
+#undef SPI1
+#undef FLASH
+#undef IWDG
+#undef DMA1
+#undef DMA1_Channel2
+#undef DMA1_Channel3
+
+#define TIM1 (&host_tim1)
+#define TIM3 (&host_tim3)
+#define TIM14 (&host_tim14)
+#define TIM16 (&host_tim16)
+#define GPIOA (&host_gpioa)
+#define GPIOB (&host_gpiob)
+#define RCC (&host_rcc)
+#define EXTI (&host_exti)
+#define SYSCFG (&host_syscfg)
+#define SPI1 (&host_spi1)
+#define FLASH (&host_flash)
+#define IWDG (&host_iwdg)
+#define DMA1 (&host_dma1)
+#define DMA1_Channel2 (&host_dma1_channel2)
+#define DMA1_Channel3 (&host_dma1_channel3)
@@ -23,6 +23,7 @@
 // Global flag that is true for one mainloop every __SYSTICK_IN_MS
 bool systick;
 static volatile uint32_t systick_count;
+static volatile uint32_t systick_total;
 
 // ****************************************************************************
 static void service_systick(void)
@@ -79,6 +80,7 @@ void SysTick_Handler (void)
 {
     if (SysTick->CTRL & (1 << 16)) {       // Read and clear Countflag
         ++systick_count;
+        ++systick_total;
     }
 }
 
@@ -179,11 +181,15 @@ static void init_hardware_final(void)
     /* SysTick config */
     SysTick_Config(48000*__SYSTICK_IN_MS);
     NVIC_EnableIRQ(SysTick_IRQn);
-    
-    NVIC_SetPriority(EXTI2_3_IRQn, 0);
+
+    // The nRF24 interrupt takes a timestamp with get_timestamp_us(), which
+    // needs the SysTick interrupt to preempt it when the counter wraps
+    NVIC_SetPriority(SysTick_IRQn, 0);
+
+    NVIC_SetPriority(EXTI2_3_IRQn, 1);
     NVIC_EnableIRQ(EXTI2_3_IRQn);
     
-    NVIC_SetPriority(TIM3_IRQn, 1);
+    NVIC_SetPriority(TIM3_IRQn, 2);
     NVIC_EnableIRQ(TIM3_IRQn);
     
 }
@@ -211,6 +217,51 @@ void delay_us(uint32_t microseconds)
 }
 
 
+// ****************************************************************************
+// Start TIM16 for a delay of up to 65535 us without waiting for it to
+// expire, so that the CPU can do other work in the meantime
+// ****************************************************************************
+void start_delay_us(uint32_t microseconds)
+{
+    if (microseconds > 65535)
+    {
+        microseconds = 65535;
+    }
+    TIM16->SR = 0;
+    TIM16->CNT = 65535 - microseconds;
+    TIM16->CR1 |= TIM_CR1_CEN;
+}
+
+
+// ****************************************************************************
+// Wait until the delay started by start_delay_us() has expired
+// ****************************************************************************
+void wait_for_delay(void)
+{
+    while ((TIM16->SR & TIM_SR_UIF) == 0);
+}
+
+
+// ****************************************************************************
+// Microseconds since power-on, for time stamping received packets. SysTick
+// counts down at 48 MHz. Wraps after 71 minutes.
+// ****************************************************************************
+uint32_t get_timestamp_us(void)
+{
+    uint32_t ticks;
+    uint32_t value;
+
+    // Read again if the SysTick interrupt counted in between
+    do
+    {
+        ticks = systick_total;
+        value = SysTick->VAL;
+    } while (ticks != systick_total);
+
+    return ticks * __SYSTICK_IN_MS * 1000 + (SysTick->LOAD - value) / 48;
+}
+
+
 // ****************************************************************************
 void startWatchdog (uint16_t ms)
 {
@@ -40,3 +40,6 @@
 #define GPIO_BIND           ((GPIOA->IDR & GPIO_IDR_4) != GPIO_IDR_4)
 
 void delay_us(uint32_t microseconds);
+void start_delay_us(uint32_t microseconds);
+void wait_for_delay(void);
+uint32_t get_timestamp_us(void);
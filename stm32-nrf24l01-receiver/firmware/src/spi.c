@@ -1,11 +1,30 @@
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "stm32f0xx.h"
 #include "platform.h"
 #include "spi.h"
+#include "rf.h"
 
 
+// DMA1 channel 2 is SPI1_RX, channel 3 is SPI1_TX
+#define DMA_RX DMA1_Channel2
+#define DMA_TX DMA1_Channel3
+
+static void (* rx_dma_callback)(uint8_t status, const uint8_t *payload);
+static unsigned int rx_dma_count;
+static uint8_t rx_dma_tx_buffer[1 + RF_MAX_BUFFER_LENGTH];
+static uint8_t rx_dma_rx_buffer[1 + RF_MAX_BUFFER_LENGTH];
+static const uint8_t RX_DR_CLEAR = RX_RD;
+
+// The DMA sequence owns the bus
+static volatile bool rx_dma_active;
+// spi_transaction() owns the bus
+static volatile bool transaction_active;
+// The nRF24 interrupt arrived while spi_transaction() owned the bus
+static volatile bool rx_dma_pending;
+
 
 // ****************************************************************************
 void init_spi(void)
@@ -26,22 +45,172 @@ void init_spi(void)
 
 
 // ****************************************************************************
-uint8_t spi_transaction(unsigned int count, uint8_t *buffer)
+static uint8_t exchange(uint8_t command, unsigned int count,
+    const uint8_t *tx_data, uint8_t *rx_data)
 {
+    uint8_t status;
+    uint8_t value;
+
     GPIO_NRF_CSN_LO();
 
-    uint8_t *ptr = buffer;
+    while ((SPI1->SR & SPI_SR_TXE) == 0);
+    *(uint8_t *)&(SPI1->DR) = command;
+    while ((SPI1->SR & SPI_SR_RXNE) == 0);
+    status = (uint8_t) SPI1->DR;
+
     while (count--)
     {
         while ((SPI1->SR & SPI_SR_TXE) == 0);
-        *(uint8_t *)&(SPI1->DR) = (uint8_t) *ptr;
+        *(uint8_t *)&(SPI1->DR) = tx_data ? *tx_data++ : 0;
         while ((SPI1->SR & SPI_SR_RXNE) == 0);
-        *ptr = (uint8_t) SPI1->DR;
-        ++ptr;
+        value = (uint8_t) SPI1->DR;
+        if (rx_data)
+        {
+            *rx_data++ = value;
+        }
     }
     
     while ((SPI1->SR & SPI_SR_BSY));
     GPIO_NRF_CSN_HI();
     
-    return *buffer;
+    return status;
+}
+
+
+// ****************************************************************************
+// Send R_RX_PAYLOAD and the zeros that clock in the payload by DMA. The RX
+// channel interrupts when the last byte is in rx_dma_rx_buffer.
+// ****************************************************************************
+static void start_rx_dma(void)
+{
+    rx_dma_active = true;
+
+    GPIO_NRF_CSN_LO();
+
+    SPI1->CR2 |= SPI_CR2_RXDMAEN;
+
+    DMA_RX->CNDTR = 1 + rx_dma_count;
+    DMA_RX->CCR = DMA_CCR_MINC | DMA_CCR_TCIE | DMA_CCR_PL_1 | DMA_CCR_EN;
+
+    DMA_TX->CNDTR = 1 + rx_dma_count;
+    DMA_TX->CCR = DMA_CCR_MINC | DMA_CCR_DIR | DMA_CCR_EN;
+
+    SPI1->CR2 |= SPI_CR2_TXDMAEN;
+}
+
+
+// ****************************************************************************
+// Send the command byte, followed by count data bytes from tx_data, or zeros
+// if tx_data is NULL. The bytes received for the data go to rx_data unless
+// it is NULL, so payloads need no staging buffer.
+// Returns the STATUS register value, received with the command byte.
+//
+// Waits for a running DMA read of the RX FIFO; one requested in the meantime
+// starts when the transaction is done. Must not be called from interrupt
+// handlers.
+// ****************************************************************************
+uint8_t spi_transaction(uint8_t command, unsigned int count,
+    const uint8_t *tx_data, uint8_t *rx_data)
+{
+    uint8_t status;
+
+    for (;;)
+    {
+        __disable_irq();
+        if (!rx_dma_active)
+        {
+            transaction_active = true;
+            __enable_irq();
+            break;
+        }
+        __enable_irq();
+    }
+
+    status = exchange(command, count, tx_data, rx_data);
+
+    __disable_irq();
+    transaction_active = false;
+    if (rx_dma_pending)
+    {
+        rx_dma_pending = false;
+        start_rx_dma();
+    }
+    __enable_irq();
+
+    return status;
+}
+
+
+// ****************************************************************************
+// Prepare the DMA read of count payload bytes. callback runs in interrupt
+// context for every read, with the STATUS register value sent with
+// R_RX_PAYLOAD; the payload is only valid if that shows a non-empty FIFO.
+// ****************************************************************************
+void spi_init_rx_dma(unsigned int count,
+    void (* callback)(uint8_t status, const uint8_t *payload))
+{
+    rx_dma_count = count;
+    rx_dma_callback = callback;
+    rx_dma_tx_buffer[0] = R_RX_PAYLOAD;
+
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+
+    DMA_RX->CPAR = (uint32_t)&(SPI1->DR);
+    DMA_RX->CMAR = (uint32_t)rx_dma_rx_buffer;
+    DMA_TX->CPAR = (uint32_t)&(SPI1->DR);
+    DMA_TX->CMAR = (uint32_t)rx_dma_tx_buffer;
+
+    // Same priority as the nRF24 interrupt, which starts the reads
+    NVIC_SetPriority(DMA1_Channel2_3_IRQn, 1);
+    NVIC_EnableIRQ(DMA1_Channel2_3_IRQn);
+}
+
+
+// ****************************************************************************
+// Called from the nRF24 interrupt: read the RX FIFO by DMA as soon as the
+// bus is free. A running read sequence picks up the new packet by itself.
+// ****************************************************************************
+void spi_start_rx_dma(void)
+{
+    if (rx_dma_active)
+    {
+        return;
+    }
+
+    if (transaction_active)
+    {
+        rx_dma_pending = true;
+        return;
+    }
+
+    start_rx_dma();
+}
+
+
+// ****************************************************************************
+// The payload is in RAM: hand it over, then clear RX_DR. Its STATUS byte
+// tells whether another packet waits in the FIFO, which is read right away.
+// ****************************************************************************
+void DMA1_Channel2_3_IRQHandler(void)
+{
+    uint8_t status;
+
+    DMA1->IFCR = DMA_IFCR_CGIF2 | DMA_IFCR_CGIF3;
+    DMA_RX->CCR = 0;
+    DMA_TX->CCR = 0;
+    SPI1->CR2 &= ~(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+
+    while ((SPI1->SR & SPI_SR_BSY));
+    GPIO_NRF_CSN_HI();
+
+    rx_dma_callback(rx_dma_rx_buffer[0], &rx_dma_rx_buffer[1]);
+
+    status = exchange(W_REGISTER | STATUS, 1, &RX_DR_CLEAR, NULL);
+    if (!RF_IS_RX_FIFO_EMPTY(status))
+    {
+        start_rx_dma();
+        return;
+    }
+
+    rx_dma_active = false;
 }
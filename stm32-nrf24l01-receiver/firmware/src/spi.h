@@ -3,5 +3,8 @@
 #include <stdint.h>
 
 void init_spi(void);
-uint8_t spi_transaction(unsigned int count, uint8_t *buffer);
-
+uint8_t spi_transaction(uint8_t command, unsigned int count,
+    const uint8_t *tx_data, uint8_t *rx_data);
+void spi_init_rx_dma(unsigned int count,
+    void (* callback)(uint8_t status, const uint8_t *payload));
+void spi_start_rx_dma(void);
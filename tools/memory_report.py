@@ -0,0 +1,783 @@
+#!/usr/bin/env python3
+'''
+Flash, RAM and stack report for the receiver firmware of all three ports.
+
+The report lists the flash used by each function, the RAM used by each
+object and the worst-case stack depth. The worst case is the deepest call
+chain of the main program plus, for each interrupt priority level, the
+deepest call chain of the interrupt handlers of that level: handlers of
+different priority levels can interrupt each other, handlers of the same
+level can not.
+
+Input files per port:
+
+- lpc812: the GCC map file, the -fstack-usage files (*.su) of all objects
+  and optionally the ELF file. The call graph is taken from the ELF file
+  with objdump; without it only the stack frames of the individual functions
+  are known.
+- stm32: the map file and the static call graph (.htm) that the Keil linker
+  writes with the "Callgraph" listing option.
+- nrf24le1: the SDCC map file (.map), memory summary (.mem) and the linked
+  listings (*.rst). SDCC places the local variables of non-reentrant
+  functions in the data and overlay segments, so the stack only holds
+  return addresses and the registers pushed by the functions.
+
+The output is sorted and stable, so reports of two builds can be compared
+with diff. The exit code is 1 if the image does not fit the flash or if the
+worst-case stack does not fit the free RAM.
+'''
+from __future__ import print_function
+
+import argparse
+import collections
+import os
+import re
+import subprocess
+import sys
+
+
+# Memory sizes, entry points and interrupt priority levels of each port.
+# The priorities are the ones set up in main.c; only whether two levels are
+# different matters.
+PORTS = {
+    'lpc812': {
+        'flash': 16 * 1024,
+        # receiver.ld keeps the top 32 bytes of RAM free for the IAP ROM
+        'ram': 4 * 1024 - 32,
+        'main': 'crt0',
+        # PININT0 and WDT run at priority 1 so that SysTick can preempt their
+        # get_timestamp_us(); the others run at the default priority 0
+        'interrupts': {
+            'PININT0_irq_handler': 1,
+            'WDT_irq_handler': 1,
+            'SCT_irq_handler': 0,
+            'SPI0_irq_handler': 0,
+            'SysTick_handler': 0,
+            'UART0_irq_handler': 0,
+        },
+        # The Cortex-M0 pushes 8 registers on exception entry
+        'exception_frame': 32,
+        'call_cost': 0,
+    },
+    'stm32': {
+        'flash': 16 * 1024,
+        'ram': 4 * 1024,
+        'main': 'main',
+        # SysTick runs at the highest priority so that it can preempt the
+        # get_timestamp_us() of the nRF24 interrupt
+        'interrupts': {
+            'SysTick_Handler': 0,
+            'EXTI2_3_IRQHandler': 1,
+            'DMA1_Channel2_3_IRQHandler': 1,
+            'TIM3_IRQHandler': 2,
+        },
+        'exception_frame': 32,
+        'call_cost': 0,
+    },
+    'nrf24le1': {
+        'flash': 16 * 1024,
+        'ram': 256,
+        'main': 'main',
+        # IP0 gives Timer 1 the high priority level
+        'interrupts': {
+            'servo_pulse_timer_handler': 1,
+            'timer0_isr': 0,
+            'hop_timer_handler': 0,
+            'rf_interrupt_handler': 0,
+        },
+        # The return address
+        'exception_frame': 2,
+        # LCALL pushes the return address
+        'call_cost': 2,
+    },
+}
+
+
+class Function(object):
+    ''' A function in the firmware image '''
+
+    def __init__(self, name, size=0, module=''):
+        self.name = name
+        self.size = size
+        self.module = module
+        self.frame = None           # Own stack usage, None if not known
+        self.dynamic = False        # Stack usage depends on run-time data
+        self.indirect = False       # Contains calls through a pointer
+        self.calls = set()
+
+
+class Image(object):
+    ''' Everything we know about a firmware image '''
+
+    def __init__(self):
+        self.functions = {}
+        self.objects = []           # (name, memory, section, module, size)
+        self.memories = []          # (name, used, size)
+        self.flash_used = 0
+        self.stack_available = None
+
+    def function(self, name):
+        ''' Return the function with the given name, create it if needed '''
+        if name not in self.functions:
+            self.functions[name] = Function(name)
+        return self.functions[name]
+
+    def is_linked(self, name):
+        ''' Whether the function is part of the image '''
+        return name in self.functions and self.functions[name].size > 0
+
+
+def module_name(path):
+    ''' Module name of an object file path, e.g. build/rf.o -> rf.o '''
+    return os.path.basename(path.strip())
+
+
+# ****************************************************************************
+# GCC (LPC812)
+# ****************************************************************************
+SECTION_PREFIXES = ['.text.startup.', '.text.', '.rodata.', '.data.', '.bss.']
+
+
+def parse_gcc_map(image, filename):
+    ''' Read regions, sections and symbols from a GNU ld map file '''
+    regions = {}
+    output_sections = []
+    input_sections = []
+
+    with open(filename) as mapfile:
+        lines = mapfile.read().splitlines()
+
+    region_pattern = re.compile(
+        r'^(\w+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+\w+)?\s*$')
+    output_pattern = re.compile(
+        r'^(\.[\w.]+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)'
+        r'(?:\s+load address 0x([0-9a-f]+))?\s*$')
+    input_pattern = re.compile(
+        r'^ ([.\w]\S*)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$')
+    symbol_pattern = re.compile(r'^\s+0x([0-9a-f]+)\s+([A-Za-z_$][\w.$]*)\s*$')
+    name_only_pattern = re.compile(r'^ ?([.\w]\S*)\s*$')
+
+    state = None
+    index = 0
+    while index < len(lines):
+        line = lines[index]
+        index += 1
+
+        if line.startswith('Memory Configuration'):
+            state = 'regions'
+            continue
+        if line.startswith('Linker script and memory map'):
+            state = 'map'
+            continue
+
+        if state == 'regions':
+            match = region_pattern.match(line)
+            if match and match.group(1) != 'Name':
+                regions[match.group(1)] = (int(match.group(2), 16),
+                                           int(match.group(3), 16))
+            continue
+
+        if state != 'map':
+            continue
+
+        # Long section names are followed by their address and size on the
+        # next line
+        match = name_only_pattern.match(line)
+        if match and index < len(lines) and \
+                lines[index].lstrip().startswith('0x'):
+            line = line.rstrip() + ' ' + lines[index].strip()
+            index += 1
+
+        match = output_pattern.match(line)
+        if match:
+            output_sections.append({
+                'name': match.group(1),
+                'address': int(match.group(2), 16),
+                'size': int(match.group(3), 16),
+                'load': int(match.group(4), 16) if match.group(4) else None,
+            })
+            continue
+
+        match = input_pattern.match(line)
+        if match and match.group(1) != '*fill*':
+            input_sections.append({
+                'name': match.group(1),
+                'address': int(match.group(2), 16),
+                'size': int(match.group(3), 16),
+                'module': module_name(match.group(4)),
+                'output': output_sections[-1]['name'] if output_sections else '',
+                'symbols': [],
+            })
+            continue
+
+        match = symbol_pattern.match(line)
+        if match and input_sections:
+            input_sections[-1]['symbols'].append(
+                (int(match.group(1), 16), match.group(2)))
+
+    def region_of(section):
+        for name, (origin, length) in regions.items():
+            if name != '*default*' and \
+                    origin <= section['address'] < origin + length:
+                return 'RAM' if 'RAM' in name else 'FLASH'
+        if len(regions) > 1:
+            return None
+        # No MEMORY in the linker script: go by the section name
+        name = section.get('output', section['name'])
+        if name.startswith(('.data', '.bss')):
+            return 'RAM'
+        if name.startswith(('.text', '.rodata')):
+            return 'FLASH'
+        return None
+
+    for section in output_sections:
+        region = region_of(section)
+        if section['size'] == 0 or region is None:
+            continue
+        if region == 'RAM':
+            if section['load'] is not None:
+                image.flash_used += section['size']
+        else:
+            image.flash_used += section['size']
+
+    ram_used = 0
+    for section in input_sections:
+        if section['size'] == 0:
+            continue
+        region = region_of(section)
+        if region is None:
+            continue
+        for name, size in split_input_section(section):
+            if section['name'].startswith(('.text', '.after_vectors')):
+                function = image.function(name)
+                function.size = size
+                function.module = section['module']
+            else:
+                memory = 'RAM' if region == 'RAM' else 'Flash'
+                image.objects.append((name, memory, section['output'],
+                                      section['module'], size))
+                if memory == 'RAM':
+                    ram_used += size
+
+    image.memories.append(('Flash', image.flash_used, None))
+    image.memories.append(('RAM (data + bss)', ram_used, None))
+    return ram_used
+
+
+def split_input_section(section):
+    ''' Names and sizes of the functions or objects in an input section '''
+    name = section['name']
+    for prefix in SECTION_PREFIXES:
+        if name.startswith(prefix):
+            return [(name[len(prefix):], section['size'])]
+
+    # Sections of objects compiled without -ffunction-sections, e.g. from
+    # libgcc: split by the global symbols they contain
+    symbols = sorted(set(section['symbols']))
+    if not symbols:
+        return [('%s(%s)' % (section['module'], name), section['size'])]
+
+    result = []
+    end = section['address'] + section['size']
+    for i, (address, symbol) in enumerate(symbols):
+        next_address = symbols[i + 1][0] if i + 1 < len(symbols) else end
+        # Aliases share the address of the previous symbol
+        if i > 0 and address == symbols[i - 1][0]:
+            continue
+        if address == section['address'] or result:
+            result.append((symbol, next_address - address))
+        else:
+            result.append(('%s(%s)' % (section['module'], name),
+                           address - section['address']))
+            result.append((symbol, next_address - address))
+    return result
+
+
+def parse_stack_usage(image, filenames):
+    ''' Read the stack frame sizes from the -fstack-usage output '''
+    for filename in filenames:
+        with open(filename) as sufile:
+            for line in sufile:
+                fields = line.rstrip('\n').split('\t')
+                if len(fields) < 3:
+                    continue
+                name = fields[0].rsplit(':', 1)[-1]
+                function = image.function(name)
+                function.frame = int(fields[1])
+                function.dynamic = fields[2].startswith('dynamic')
+                if not function.module:
+                    function.module = \
+                        os.path.splitext(os.path.basename(filename))[0] + '.o'
+
+
+def parse_objdump(image, filename, objdump):
+    ''' Build the call graph from the disassembly of the ELF file '''
+    try:
+        output = subprocess.check_output([objdump, '-d', filename])
+    except (OSError, subprocess.CalledProcessError) as error:
+        print("Can not disassemble %s: %s" % (filename, error))
+        sys.exit(1)
+
+    function_pattern = re.compile(r'^[0-9a-f]+ <([^>]+)>:$')
+    # Direct calls, and branches to the start of another function (tail
+    # calls). Branches within a function show as <name+offset>.
+    call_pattern = re.compile(
+        r'\t(?:bl|blx|b|b\.n|b\.w|call|callq|jmp|jmpq)\s+'
+        r'[0-9a-f]+ <([^>+]+)>\s*$')
+    indirect_pattern = re.compile(
+        r'\t(?:blx\s+r\d+|bx\s+r[0-9]\b|call\w*\s+\*|jmp\w*\s+\*)')
+
+    function = None
+    for line in output.decode('utf-8', 'replace').splitlines():
+        match = function_pattern.match(line)
+        if match:
+            function = image.function(match.group(1))
+            continue
+        if function is None:
+            continue
+
+        match = call_pattern.search(line)
+        if match:
+            callee = match.group(1).split('@')[0]
+            if callee != function.name:
+                function.calls.add(callee)
+            continue
+
+        # bx lr is a return, bx with any other register an indirect call
+        if indirect_pattern.search(line) and 'bx\tlr' not in line:
+            function.indirect = True
+
+
+def read_gcc(image, port, args):
+    ''' LPC812: GNU ld map file, -fstack-usage output and objdump '''
+    ram_used = parse_gcc_map(image, args.map)
+    parse_stack_usage(image, args.stack_usage)
+    if args.elf:
+        parse_objdump(image, args.elf, args.objdump)
+    image.stack_available = port['ram'] - ram_used
+
+
+# ****************************************************************************
+# Keil MDK (STM32)
+# ****************************************************************************
+def read_keil(image, port, args):
+    ''' STM32: armlink map file and static call graph '''
+    with open(args.map) as mapfile:
+        text = mapfile.read()
+
+    symbol_pattern = re.compile(
+        r'^\s+(\S+)\s+0x([0-9a-fA-F]{8})\s+(Data|Thumb Code|ARM Code)\s+'
+        r'(\d+)\s+([^\s(]+)\(([^)]+)\)', re.MULTILINE)
+
+    ram_used = 0
+    stack_reserved = None
+    seen = set()
+    for match in symbol_pattern.finditer(text):
+        name, address, kind, size, module, section = match.groups()
+        address = int(address, 16)
+        size = int(size)
+        if (name, address) in seen or size == 0:
+            continue
+        seen.add((name, address))
+
+        if kind != 'Data':
+            function = image.function(name)
+            function.size = size
+            function.module = module
+            continue
+
+        memory = 'RAM' if address >= 0x20000000 else 'Flash'
+        if name == 'Stack_Mem':
+            stack_reserved = size
+            continue
+        image.objects.append((name, memory, section, module, size))
+        if memory == 'RAM':
+            ram_used += size
+
+    match = re.search(r'Total ROM Size \(Code \+ RO Data \+ RW Data\)\s+(\d+)',
+                      text)
+    image.flash_used = int(match.group(1)) if match else \
+        sum(f.size for f in image.functions.values())
+
+    image.memories.append(('Flash', image.flash_used, None))
+    image.memories.append(('RAM (data + bss)', ram_used, None))
+    if stack_reserved is not None:
+        # The startup code reserves a fixed stack in RAM
+        image.memories.append(('Stack reserved', stack_reserved, None))
+        image.stack_available = stack_reserved
+    else:
+        image.stack_available = port['ram'] - ram_used
+
+    if args.callgraph:
+        parse_keil_callgraph(image, args.callgraph)
+
+
+def parse_keil_callgraph(image, filename):
+    ''' Stack frames and calls from the armlink static call graph (.htm) '''
+    with open(filename) as htmfile:
+        text = htmfile.read()
+
+    header_pattern = re.compile(
+        r'<STRONG><a name="\[\w+\]"></a>([^<]+)</STRONG>\s*'
+        r'\((?:Thumb|ARM), (\d+) bytes, Stack size (\d+) bytes, ([^(,]+)')
+    call_pattern = re.compile(r'&nbsp;&nbsp;&nbsp;([^\s<&]+)')
+
+    headers = list(header_pattern.finditer(text))
+    for i, match in enumerate(headers):
+        end = headers[i + 1].start() if i + 1 < len(headers) else len(text)
+        block = text[match.end():end]
+
+        function = image.function(match.group(1).strip())
+        function.size = function.size or int(match.group(2))
+        function.frame = int(match.group(3))
+        function.module = function.module or match.group(4).strip()
+
+        calls = re.search(r'\[Calls\]<UL>(.*?)</UL>', block, re.DOTALL)
+        if calls:
+            for callee in call_pattern.findall(calls.group(1)):
+                if callee != function.name:
+                    function.calls.add(callee)
+
+        if 'Untraceable' in block or '[Calls]<UL><LI>Function Pointer' in block:
+            function.indirect = True
+
+
+# ****************************************************************************
+# SDCC (nRF24LE1)
+# ****************************************************************************
+# Internal RAM of the 8051, in bytes (BSEG counts bits)
+INTERNAL_AREAS = ['DSEG', 'OSEG', 'ISEG', 'BSEG', 'REG_BANK_0', 'REG_BANK_1',
+                  'REG_BANK_2', 'REG_BANK_3', 'BIT_BANK']
+EXTERNAL_AREAS = ['XSEG', 'XISEG', 'PSEG', 'XABS']
+
+
+def sdcc_name(symbol):
+    ''' C name of an SDCC assembler symbol: _foo -> foo '''
+    return symbol[1:] if symbol.startswith('_') else symbol
+
+
+def parse_sdcc_map(filename):
+    ''' Start and size of all areas from the SDCC linker map file '''
+    areas = {}
+    pattern = re.compile(
+        r'^(\w+)\s+([0-9A-Fa-f]{4,8})\s+([0-9A-Fa-f]{4,8})\s+=\s+(\d+)\.\s+bytes')
+
+    with open(filename) as mapfile:
+        for line in mapfile:
+            match = pattern.match(line)
+            if match:
+                areas[match.group(1)] = (int(match.group(2), 16),
+                                         int(match.group(4)))
+    return areas
+
+
+def parse_sdcc_mem(image, filename):
+    ''' Stack space and memory totals from the SDCC memory summary '''
+    with open(filename) as memfile:
+        text = memfile.read()
+
+    match = re.search(r'Stack starts at: (0x[0-9a-fA-F]+).*?with (\d+) bytes '
+                      r'available', text)
+    if match:
+        image.stack_available = int(match.group(2))
+        image.memories.append(('Internal RAM', int(match.group(1), 16), 256))
+
+    for name, label in [('EXTERNAL RAM', 'External RAM (xdata)'),
+                        ('ROM/EPROM/FLASH', 'Flash')]:
+        match = re.search(r'^\s*' + re.escape(name) +
+                          r'\s+(?:0x\w+\s+0x\w+\s+)?(\d+)\s+(\d+)',
+                          text, re.MULTILINE)
+        if match:
+            image.memories.append((label, int(match.group(1)),
+                                   int(match.group(2))))
+            if label == 'Flash':
+                image.flash_used = int(match.group(1))
+
+
+def parse_sdcc_rst(image, filenames, areas):
+    ''' Functions, calls, pushes and data objects from the .rst listings '''
+    area_pattern = re.compile(r'\s\.area\s+(\w+)')
+    function_pattern = re.compile(r'\d+\s;\s+function\s+(\w+)\s*$')
+    label_pattern = re.compile(r'^\s*([0-9A-Fa-f]{4,8})\s+\d+\s+(\w+)::?\s*$')
+    ds_pattern = re.compile(r'\d+\s+\.ds\s+(\d+)')
+    instruction_pattern = re.compile(
+        r'^\s*[0-9A-Fa-f]{4,8}\s.*\d+\s+(push|lcall|acall|ljmp|ajmp)\s+(\S+)')
+
+    starts = []
+    for filename in filenames:
+        module = os.path.splitext(os.path.basename(filename))[0] + '.rel'
+        area = None
+        function = None
+        label = None
+
+        with open(filename) as rstfile:
+            for line in rstfile:
+                match = area_pattern.search(line)
+                if match:
+                    area = match.group(1)
+                    function = None
+                    label = None
+                    continue
+
+                match = function_pattern.search(line)
+                if match:
+                    function = image.function(match.group(1))
+                    function.module = module
+                    function.frame = 0
+                    continue
+
+                match = label_pattern.match(line)
+                if match:
+                    label = (match.group(2), int(match.group(1), 16))
+                    if function and area == 'CSEG' and \
+                            sdcc_name(label[0]) == function.name:
+                        starts.append((label[1], function.name))
+                    continue
+
+                match = ds_pattern.search(line)
+                if match and label and area in INTERNAL_AREAS + EXTERNAL_AREAS:
+                    size = int(match.group(1))
+                    memory = 'xdata' if area in EXTERNAL_AREAS else 'data'
+                    if area == 'BSEG':
+                        memory = 'bit'
+                    image.objects.append((sdcc_name(label[0]), memory, area,
+                                          module, size))
+                    label = None
+                    continue
+
+                match = instruction_pattern.match(line)
+                if match and function and area == 'CSEG':
+                    mnemonic, operand = match.groups()
+                    if mnemonic == 'push':
+                        function.frame += 1
+                    elif operand.startswith('_'):
+                        # ljmp/ajmp to another function is a tail call
+                        callee = sdcc_name(operand)
+                        if callee != function.name:
+                            function.calls.add(callee)
+
+    # Function sizes: distance to the next function in the code segment
+    starts.sort()
+    code_end = areas['CSEG'][0] + areas['CSEG'][1] if 'CSEG' in areas else None
+    for i, (address, name) in enumerate(starts):
+        if i + 1 < len(starts):
+            image.functions[name].size = starts[i + 1][0] - address
+        elif code_end is not None:
+            image.functions[name].size = code_end - address
+
+
+def read_sdcc(image, port, args):
+    ''' nRF24LE1: SDCC map, memory summary and linked listings '''
+    areas = parse_sdcc_map(args.map)
+    parse_sdcc_mem(image, args.mem)
+    parse_sdcc_rst(image, args.rst, areas)
+    if image.stack_available is None:
+        image.stack_available = port['ram'] - sum(
+            size for _, memory, _, _, size in image.objects
+            if memory == 'data')
+
+
+# ****************************************************************************
+# Stack analysis
+# ****************************************************************************
+class StackAnalysis(object):
+    ''' Worst-case stack depth of each function including its callees '''
+
+    def __init__(self, image, call_cost):
+        self.image = image
+        self.call_cost = call_cost
+        self.depth = {}
+        self.chain = {}
+        self.unknown = set()
+        self.recursive = set()
+
+    def worst(self, name, active=None):
+        ''' Worst-case stack depth of the function with the given name '''
+        if name in self.depth:
+            return self.depth[name]
+
+        active = active or []
+        if name in active:
+            self.recursive.add(name)
+            return 0
+
+        function = self.image.functions.get(name)
+        if function is None or function.frame is None:
+            self.unknown.add(name)
+        if function is None:
+            self.depth[name] = 0
+            self.chain[name] = [name]
+            return 0
+
+        deepest = 0
+        chain = []
+        for callee in sorted(function.calls):
+            depth = self.call_cost + self.worst(callee, active + [name])
+            if depth > deepest:
+                deepest = depth
+                chain = self.chain[callee]
+
+        self.depth[name] = (function.frame or 0) + deepest
+        self.chain[name] = [name] + chain
+        return self.depth[name]
+
+
+# ****************************************************************************
+# Report
+# ****************************************************************************
+def report(image, port_name, port):
+    ''' Print the report; return False if the image is over budget '''
+    analysis = StackAnalysis(image, port['call_cost'])
+    ok = True
+
+    print("%s memory report" % port_name)
+    print("")
+
+    # Worst-case stack: main program plus one handler per priority level
+    roots = []
+    if image.is_linked(port['main']):
+        roots.append(('Main program', 0, port['main']))
+
+    levels = collections.defaultdict(list)
+    for name, level in port['interrupts'].items():
+        if image.is_linked(name):
+            levels[level].append(name)
+    for level in sorted(levels):
+        handler = max(sorted(levels[level]), key=analysis.worst)
+        roots.append(('Priority %d' % level, port['exception_frame'], handler))
+
+    stack = sum(frame + analysis.worst(name) for _, frame, name in roots)
+
+    print("%-26s %8s %8s" % ("Memory", "Used", "Size"))
+    for name, used, size in image.memories:
+        if name == 'Flash':
+            size = port['flash']
+            if used > size:
+                ok = False
+        print("%-26s %8d %8s" % (name, used, size if size else ''))
+    print("%-26s %8d %8s" % ("Stack (worst case)", stack,
+                             image.stack_available
+                             if image.stack_available is not None else ''))
+    if image.stack_available is not None and stack > image.stack_available:
+        ok = False
+
+    print("")
+    print("Worst-case stack")
+    for label, frame, name in roots:
+        depth = analysis.worst(name)
+        print("  %-24s %8d  %s" % (label, frame + depth,
+                                   ' > '.join(analysis.chain[name])))
+    print("  %-24s %8d" % ("Total", stack))
+
+    for level in sorted(levels):
+        if len(levels[level]) > 1:
+            print("  Priority %d handlers: %s" % (level, ', '.join(
+                "%s %d" % (name, port['exception_frame'] +
+                           analysis.worst(name))
+                for name in sorted(levels[level]))))
+
+    print("")
+    print("%-36s %-22s %6s %6s %6s" % (
+        "Function", "Module", "Flash", "Stack", "Worst"))
+    functions = [f for f in image.functions.values() if f.size]
+    functions.sort(key=lambda f: (-f.size, f.name))
+    for function in functions:
+        print("%-36s %-22s %6d %6s %6d" % (
+            function.name, function.module, function.size,
+            function.frame if function.frame is not None else '?',
+            analysis.worst(function.name)))
+    print("%-36s %-22s %6d" % ("Total", "",
+                               sum(f.size for f in functions)))
+
+    print("")
+    print("%-36s %-22s %-10s %6s" % ("Object", "Module", "Memory", "Bytes"))
+    objects = sorted(image.objects, key=lambda o: (o[1] != 'RAM' and
+                                                   o[1] != 'data', o[1],
+                                                   -o[4], o[0]))
+    for name, memory, section, module, size in objects:
+        print("%-36s %-22s %-10s %6d" % (name, module, memory, size))
+
+    notes = []
+    for name in sorted(analysis.unknown):
+        if name in image.functions and image.functions[name].size == 0 and \
+                not image.functions[name].calls:
+            notes.append("%s: not in the image, stack usage unknown" % name)
+        else:
+            notes.append("%s: stack usage unknown" % name)
+    for function in sorted(image.functions.values(), key=lambda f: f.name):
+        if function.dynamic:
+            notes.append("%s: dynamic stack usage" % function.name)
+        if function.indirect:
+            notes.append("%s: calls through a function pointer are not "
+                         "followed" % function.name)
+    for name in sorted(analysis.recursive):
+        notes.append("%s: recursion, depth not bounded" % name)
+
+    if notes:
+        print("")
+        print("Notes")
+        for note in notes:
+            print("  " + note)
+
+    if not ok:
+        print("")
+        print("ERROR: %s does not fit the flash or the stack does not fit "
+              "the free RAM" % port_name)
+    return ok
+
+
+def parse_commandline():
+    ''' Command line argument parsing '''
+    parser = argparse.ArgumentParser(
+        description="Flash, RAM and worst-case stack report of the receiver "
+                    "firmware.")
+
+    parser.add_argument("port", choices=sorted(PORTS.keys()),
+        help="the receiver port the files belong to")
+
+    parser.add_argument("map",
+        help="map file of the linker")
+
+    parser.add_argument("--elf",
+        help="lpc812: ELF file to build the call graph from")
+
+    parser.add_argument("--objdump", default="arm-none-eabi-objdump",
+        help="lpc812: objdump executable. Default is arm-none-eabi-objdump.")
+
+    parser.add_argument("--stack-usage", nargs='*', default=[],
+        help="lpc812: the .su files written by GCC with -fstack-usage")
+
+    parser.add_argument("--callgraph",
+        help="stm32: static call graph (.htm) written by the Keil linker")
+
+    parser.add_argument("--mem",
+        help="nrf24le1: memory summary (.mem) written by SDCC")
+
+    parser.add_argument("--rst", nargs='*', default=[],
+        help="nrf24le1: the linked listings (.rst) written by SDCC")
+
+    args = parser.parse_args()
+    if args.port == 'nrf24le1' and not args.mem:
+        parser.error("nrf24le1 needs --mem")
+    return args
+
+
+def main():
+    ''' Program start '''
+    args = parse_commandline()
+    port = PORTS[args.port]
+    image = Image()
+
+    if args.port == 'lpc812':
+        read_gcc(image, port, args)
+    elif args.port == 'stm32':
+        read_keil(image, port, args)
+    else:
+        read_sdcc(image, port, args)
+
+    if not report(image, args.port, port):
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
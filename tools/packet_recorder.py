@@ -0,0 +1,416 @@
+#!/usr/bin/env python3
+'''
+Capture the frames of the packet recorder firmware (see packet_recorder.c in
+the LPC812 and nRF24LE1 firmware) into an indexed capture file, and inspect
+capture files.
+
+    packet_recorder.py record -p /dev/ttyUSB0 -b 115200 session.rxcap
+    packet_recorder.py list session.rxcap
+    packet_recorder.py dump [-S session] session.rxcap
+
+"record" reads from a serial port (pyserial is required) or, with -i, from
+a file containing the raw bytes received from the UART. Frames with a bad
+CRC are dropped; missing sequence numbers are counted as lost frames.
+
+A capture file has a 16 byte header, followed by the frames exactly as the
+firmware sent them, followed by the index. All values are little endian.
+
+    Header:
+        8 bytes     "RXCAP001"
+        uint64      file offset of the index, 0 if the recording was aborted
+
+    Index:
+        4 bytes     "RXIX"
+        uint32      number of index entries
+        uint32      number of frames
+        uint32      number of frames dropped due to a CRC error
+        uint32      number of frames lost (gaps in the sequence numbers)
+        entries:
+            uint64  file offset of the frame
+            uint64  timestamp of the frame in us since power-on, unwrapped
+            uint32  frame number
+            uint16  session
+            uint16  flags, bit 0: first frame of a session
+
+A session starts with the bind data frame the firmware sends at power-on.
+Frames recorded before the first power-on belong to session 0, which can
+not be replayed. The index has an entry for the start of each session and
+for the first frame of every second within a session.
+
+simulator/packet_replay.c plays a session back into the host build of the
+firmware.
+'''
+from __future__ import print_function
+
+import argparse
+import struct
+import sys
+import time
+
+
+SYNC_BYTE = 0xa5
+FRAME_TYPE_BIND_DATA = ord('B')
+FRAME_TYPE_PACKET = ord('P')
+
+# Frame size including sync byte, type, sequence number and CRC
+FRAME_SIZES = {
+    FRAME_TYPE_BIND_DATA: 4 + 30,
+    FRAME_TYPE_PACKET: 4 + 17,
+}
+
+BIND_DATA_FLAG_BOUND = (1 << 0)
+PACKET_FLAG_BINDING = (1 << 0)
+PACKET_FLAG_SAME_DRAIN = (1 << 1)
+
+HEADER_MAGIC = b'RXCAP001'
+HEADER_FORMAT = '<8sQ'
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+INDEX_MAGIC = b'RXIX'
+INDEX_FORMAT = '<4sIIII'
+INDEX_ENTRY_FORMAT = '<QQIHH'
+INDEX_FLAG_SESSION_START = (1 << 0)
+
+INDEX_INTERVAL_US = 1000000
+
+
+def crc8(data):
+    ''' CRC-8 with polynomial 0x07, as calculated by the firmware '''
+    crc = 0
+    for byte in bytearray(data):
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) if crc & 0x80 else (crc << 1)
+            crc &= 0xff
+    return crc
+
+
+class Frame(object):
+    ''' A decoded frame of the packet recorder '''
+
+    def __init__(self, raw):
+        self.raw = bytes(raw)
+        self.type = bytearray(raw)[1]
+        self.sequence = bytearray(raw)[2]
+        self.timestamp = struct.unpack_from('<I', raw, 3)[0]
+        if self.type == FRAME_TYPE_BIND_DATA:
+            self.flags = bytearray(raw)[7]
+            self.bind_data = bytearray(raw[8:33])
+        else:
+            self.hop_index, self.hops_without_packet, self.flags = \
+                bytearray(raw[7:10])
+            self.payload = bytearray(raw[10:20])
+
+    def is_power_on(self):
+        return (self.type == FRAME_TYPE_BIND_DATA and
+            not self.flags & BIND_DATA_FLAG_BOUND)
+
+
+class FrameParser(object):
+    ''' Finds the frames in the byte stream received from the UART '''
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.crc_errors = 0
+
+    def feed(self, data):
+        self.buffer.extend(data)
+        frames = []
+
+        while self.buffer:
+            if self.buffer[0] != SYNC_BYTE:
+                del self.buffer[0]
+                continue
+
+            if len(self.buffer) < 2:
+                break
+
+            size = FRAME_SIZES.get(self.buffer[1])
+            if size is None:
+                del self.buffer[0]
+                continue
+
+            if len(self.buffer) < size:
+                break
+
+            if crc8(self.buffer[1:size - 1]) != self.buffer[size - 1]:
+                self.crc_errors += 1
+                del self.buffer[0]
+                continue
+
+            frames.append(Frame(self.buffer[:size]))
+            del self.buffer[:size]
+
+        return frames
+
+
+class CaptureWriter(object):
+    ''' Writes frames into a capture file and builds the index '''
+
+    def __init__(self, filename):
+        self.file = open(filename, 'wb')
+        self.file.write(struct.pack(HEADER_FORMAT, HEADER_MAGIC, 0))
+        self.offset = HEADER_SIZE
+        self.frames = 0
+        self.lost = 0
+        self.session = 0
+        self.sequence = None
+        self.last_timestamp = 0
+        self.wraps = 0
+        self.next_index_time = 0
+        self.index = []
+
+    def write(self, frame):
+        if frame.is_power_on():
+            self.session += 1
+            self.lost += frame.sequence
+            self.wraps = 0
+            self.next_index_time = 0
+        elif self.sequence is not None:
+            self.lost += (frame.sequence - self.sequence - 1) & 0xff
+        self.sequence = frame.sequence
+
+        if frame.timestamp < self.last_timestamp and not frame.is_power_on():
+            self.wraps += 1
+        self.last_timestamp = frame.timestamp
+        time_us = (self.wraps << 32) + frame.timestamp
+
+        if frame.is_power_on():
+            self.index.append((self.offset, time_us, self.frames,
+                self.session, INDEX_FLAG_SESSION_START))
+            self.next_index_time = time_us + INDEX_INTERVAL_US
+        elif time_us >= self.next_index_time:
+            self.index.append((self.offset, time_us, self.frames,
+                self.session, 0))
+            self.next_index_time = \
+                (time_us // INDEX_INTERVAL_US + 1) * INDEX_INTERVAL_US
+
+        self.file.write(frame.raw)
+        self.offset += len(frame.raw)
+        self.frames += 1
+
+    def close(self, crc_errors):
+        self.file.write(struct.pack(INDEX_FORMAT, INDEX_MAGIC,
+            len(self.index), self.frames, crc_errors, self.lost))
+        for entry in self.index:
+            self.file.write(struct.pack(INDEX_ENTRY_FORMAT, *entry))
+
+        self.file.seek(0)
+        self.file.write(struct.pack(HEADER_FORMAT, HEADER_MAGIC, self.offset))
+        self.file.close()
+
+
+class Capture(object):
+    ''' A capture file opened for reading '''
+
+    def __init__(self, filename):
+        with open(filename, 'rb') as f:
+            data = f.read()
+
+        if len(data) < HEADER_SIZE:
+            raise ValueError('%s: not a capture file' % filename)
+        magic, index_offset = struct.unpack_from(HEADER_FORMAT, data)
+        if magic != HEADER_MAGIC:
+            raise ValueError('%s: not a capture file' % filename)
+
+        self.indexed = index_offset != 0
+        self.index = []
+        self.crc_errors = None
+        self.lost = None
+        end = index_offset if self.indexed else len(data)
+
+        if self.indexed:
+            magic, count, _, self.crc_errors, self.lost = \
+                struct.unpack_from(INDEX_FORMAT, data, index_offset)
+            if magic != INDEX_MAGIC:
+                raise ValueError('%s: index is corrupt' % filename)
+            offset = index_offset + struct.calcsize(INDEX_FORMAT)
+            for _ in range(count):
+                self.index.append(
+                    struct.unpack_from(INDEX_ENTRY_FORMAT, data, offset))
+                offset += struct.calcsize(INDEX_ENTRY_FORMAT)
+
+        # The frames were checked when recording; parsing them again also
+        # recovers a capture whose recording was aborted.
+        parser = FrameParser()
+        self.frames = parser.feed(data[HEADER_SIZE:end])
+
+    def sessions(self):
+        ''' Returns a list of (session number, [frames]) '''
+        sessions = [(0, [])]
+        for frame in self.frames:
+            if frame.is_power_on():
+                sessions.append((len(sessions), []))
+            sessions[-1][1].append(frame)
+        if not sessions[0][1]:
+            del sessions[0]
+        return sessions
+
+
+def session_time(frames):
+    ''' Unwrapped timestamps of the frames of one session '''
+    wraps = 0
+    last = 0
+    times = []
+    for frame in frames:
+        if frame.timestamp < last:
+            wraps += 1
+        last = frame.timestamp
+        times.append((wraps << 32) + frame.timestamp)
+    return times
+
+
+def format_bytes(data):
+    return ' '.join('%02x' % b for b in data)
+
+
+def open_source(args):
+    if args.input:
+        if args.input == '-':
+            return getattr(sys.stdin, 'buffer', sys.stdin)
+        return open(args.input, 'rb')
+
+    try:
+        import serial
+    except ImportError:
+        sys.exit('pyserial is required to record from a serial port')
+    return serial.Serial(args.port, args.baudrate, timeout=0.1)
+
+
+def record(args):
+    source = open_source(args)
+    writer = CaptureWriter(args.capture)
+    parser = FrameParser()
+    start = time.time()
+    next_status = start + 1
+
+    try:
+        while not args.time or time.time() - start < args.time:
+            data = source.read(4096)
+            if not data:
+                if args.input:
+                    break
+                continue
+
+            for frame in parser.feed(data):
+                writer.write(frame)
+
+            if args.input is None and time.time() >= next_status:
+                next_status += 1
+                sys.stderr.write('\r%u frames, %u CRC errors, %u lost' %
+                    (writer.frames, parser.crc_errors, writer.lost))
+                sys.stderr.flush()
+    except KeyboardInterrupt:
+        pass
+
+    writer.close(parser.crc_errors)
+    if args.input is None:
+        sys.stderr.write('\n')
+    print('%s: %u frames in %u sessions, %u CRC errors, %u lost' % (
+        args.capture, writer.frames, writer.session, parser.crc_errors,
+        writer.lost))
+
+
+def list_capture(args):
+    capture = Capture(args.capture)
+
+    print('%s: %u frames' % (args.capture, len(capture.frames)), end='')
+    if capture.indexed:
+        print(', %u CRC errors, %u lost, %u index entries' % (
+            capture.crc_errors, capture.lost, len(capture.index)))
+    else:
+        print(' (no index, the recording was aborted)')
+
+    print('\n%7s %8s %8s %8s %10s %6s  %s' % ('Session', 'Frames',
+        'Packets', 'Binding', 'Duration', 'Lost', 'Model address'))
+
+    for number, frames in capture.sessions():
+        times = session_time(frames)
+        packets = [f for f in frames if f.type == FRAME_TYPE_PACKET]
+        binding = [f for f in packets if f.flags & PACKET_FLAG_BINDING]
+        lost = 0
+        for previous, frame in zip(frames, frames[1:]):
+            lost += (frame.sequence - previous.sequence - 1) & 0xff
+        address = '-'
+        if number:
+            address = ':'.join('%02x' % b for b in frames[0].bind_data[:5])
+
+        print('%7u %8u %8u %8u %8.2f s %6u  %s' % (number, len(frames),
+            len(packets), len(binding), (times[-1] - times[0]) / 1e6, lost,
+            address))
+
+
+def dump(args):
+    capture = Capture(args.capture)
+
+    for number, frames in capture.sessions():
+        if args.session is not None and number != args.session:
+            continue
+
+        times = session_time(frames)
+        for frame, time_us in zip(frames, times):
+            if frame.type == FRAME_TYPE_BIND_DATA:
+                print('# session %u: %s bind data %s' % (number,
+                    'new' if frame.flags & BIND_DATA_FLAG_BOUND
+                    else 'power-on', format_bytes(frame.bind_data)))
+                continue
+
+            flags = []
+            if frame.flags & PACKET_FLAG_BINDING:
+                flags.append('binding')
+            if frame.flags & PACKET_FLAG_SAME_DRAIN:
+                flags.append('same-drain')
+            print('%s  # %12.6f s seq %3u hop %2u without %2u %s' % (
+                format_bytes(frame.payload), time_us / 1e6, frame.sequence,
+                frame.hop_index, frame.hops_without_packet,
+                ' '.join(flags)))
+
+
+def parse_commandline():
+    ''' Parse the command line and return the arguments '''
+    parser = argparse.ArgumentParser(
+        description='''Record and inspect captures of the packet recorder
+        firmware.''')
+    commands = parser.add_subparsers(dest='command')
+    commands.required = True
+
+    p = commands.add_parser('record',
+        help='Record frames from the UART into a capture file')
+    p.add_argument('-p', '--port', default='/dev/ttyUSB0',
+        help='Serial port (default: %(default)s)')
+    p.add_argument('-b', '--baudrate', type=int, default=115200,
+        help='Baudrate: 115200 for the LPC812, 125000 for the nRF24LE1 '
+            '(default: %(default)s)')
+    p.add_argument('-i', '--input',
+        help='Read the raw UART bytes from a file instead; - for stdin')
+    p.add_argument('-t', '--time', type=float, default=0,
+        help='Stop after the given number of seconds')
+    p.add_argument('capture', help='Capture file to write')
+    p.set_defaults(handler=record)
+
+    p = commands.add_parser('list',
+        help='Print the sessions of a capture file')
+    p.add_argument('capture', help='Capture file')
+    p.set_defaults(handler=list_capture)
+
+    p = commands.add_parser('dump',
+        help='Print the frames of a capture file in the text format of '
+            'packet_bench')
+    p.add_argument('-S', '--session', type=int,
+        help='Only print the given session')
+    p.add_argument('capture', help='Capture file')
+    p.set_defaults(handler=dump)
+
+    return parser.parse_args()
+
+
+def main():
+    ''' Program start '''
+    args = parse_commandline()
+    try:
+        args.handler(args)
+    except (IOError, ValueError) as error:
+        sys.exit(str(error))
+
+
+if __name__ == '__main__':
+    main()